@@ -21,6 +21,7 @@
 #include <sysexits.h>
 
 #include "globals-inst.h"
+#include "loopprofile.h"
 #include "randlib.h"
 #include "precision.h"
 
@@ -124,6 +125,8 @@ static size_t simulateCount(double p, size_t W, uint64_t *seed) {
 static void simulateBound(long double alpha, double H, size_t W, size_t simulation_rounds) {
   size_t *results;
   double p;
+  struct loopProfile profile;
+  struct threadConfig config;
 
   assert(W > 0);
   assert(H > 0);
@@ -136,11 +139,17 @@ static void simulateBound(long double alpha, double H, size_t W, size_t simulati
   // The probability of the most likely symbol (MLS) only needs to be calculated once...
   p = pow(2.0, -H);
 
+  saveThreadConfig(&config);
+  loopProfileInit(&profile, "apt-sim", simulation_rounds, false, true);
 #pragma omp parallel
   {
     struct randstate rstate;
     size_t *localResults;
     uint64_t seed[4];
+    double threadStart;
+    size_t threadIterations = 0;
+
+    loadThreadConfig(&config);
 
     initGenerator(&rstate);
     seedGenerator(&rstate);
@@ -151,10 +160,14 @@ static void simulateBound(long double alpha, double H, size_t W, size_t simulati
       exit(EX_OSERR);
     }
 
-#pragma omp for
+    // The rounds are independent and only tallied, so the runtime schedule is safe to use here (by default, static).
+    threadStart = loopProfileNow();
+#pragma omp for schedule(runtime) nowait
     for (size_t i = 0; i < simulation_rounds; i++) {
       localResults[simulateCount(p, W, seed)]++;
+      threadIterations++;
     }
+    loopProfileThreadDone(&profile, threadStart, threadIterations);
 
 #pragma omp critical(resultUpdate)
     {
@@ -163,6 +176,7 @@ static void simulateBound(long double alpha, double H, size_t W, size_t simulati
 
     free(localResults);
   }
+  loopProfileFinish(&profile);
 
   if (configVerbose > 0) {
     char startChar = '{';
@@ -254,6 +268,9 @@ int main(int argc, char *argv[]) {
   argc -= optind;
   argv += optind;
 
+  // The schedule(runtime) loops stay static unless OMP_SCHEDULE says otherwise.
+  loopScheduleDefault(omp_sched_static, 0);
+
   if (argc != 1) {
     useageExit();
   }
@@ -8,13 +8,20 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "assessments.h"
+#include "binutil.h"
 #include "bootstrap.h"
 #include "entlib.h"
 #include "enttypes.h"
+#include "globals.h"
 #include "randlib.h"
+#include "telemetry.h"
 
 double bootstrapAssessments(struct entropyTestingResult *results, size_t count, size_t bitWidth, double *IIDminent, struct randstate *rstate) {
   double *entropyResults;
@@ -32,7 +39,7 @@ double bootstrapAssessments(struct entropyTestingResult *results, size_t count,
 
   if ((entropyResults = malloc(sizeof(double) * count)) == NULL) {
     perror("Can't allocate memory for result data");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   // 6.3.1
@@ -333,7 +340,7 @@ double bootstrapParameters(struct entropyTestingResult *results, size_t count, s
 
   if ((entropyResults = malloc(sizeof(double) * count)) == NULL) {
     perror("Can't allocate memory for result data");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   // 6.3.1
@@ -634,3 +641,205 @@ double bootstrapParameters(struct entropyTestingResult *results, size_t count, s
 
   return minminent;
 }
+
+/*Expand each symbol into its active bits (one bit per output symbol), most-significant first unless littleEndian.*/
+void makeBitstring(const statData_t *data, statData_t *bitData, size_t datalen, statData_t activeBits, bool littleEndian) {
+  // Populate bitData
+  statData_t bitsToDo;
+  statData_t *curBitData;
+  statData_t curBit;
+
+  curBitData = bitData;
+  for (size_t l = 0; l < datalen; l++) {
+    if (littleEndian) {
+      curBit = 0x01;
+    } else {
+      curBit = highBit(activeBits);
+    }
+
+    bitsToDo = activeBits;
+
+    while (bitsToDo != 0) {
+      if ((curBit & bitsToDo) != 0) {
+        *curBitData = ((curBit & data[l]) == 0) ? 0 : 1;
+        curBitData++;
+        bitsToDo = (statData_t)(bitsToDo & (~curBit));
+      }
+
+      if (littleEndian) {
+        curBit = (statData_t)(curBit << 1);
+      } else {
+        curBit = (statData_t)(curBit >> 1);
+      }
+    }
+  }
+  assert((size_t)(curBitData - bitData) == datalen * ((size_t)__builtin_popcount(activeBits)));
+}
+
+// Close out an estimator's span, and report it.
+static void estimatorDone(struct telemetrySpan *span, const char *label, size_t block, const char *estimator, size_t datalen, size_t k, double entropy, size_t *scratchPeak) {
+  telemetryStop(span);
+  telemetryRecord("estimator", label, block, estimator, datalen, k, span, entropy);
+  if (span->scratchPeak > *scratchPeak) *scratchPeak = span->scratchPeak;
+}
+
+/*The estimators in testBitmask that can assess datalen samples drawn from k symbols. The t-tuple and LRS estimates
+ *need some symbol to repeat, which is only certain when there are more samples than symbols.
+ */
+uint32_t applicableEstimators(size_t datalen, size_t k, uint32_t testBitmask) {
+  uint32_t applicable = testBitmask;
+
+  if (datalen < MCVESTIMATEMINLEN) applicable &= ~(uint32_t)MCVESTIMATEMASK;
+  if (datalen < COLSESTIMATEMINLEN) applicable &= ~(uint32_t)COLSESTIMATEMASK;
+  if (datalen < MARKOVESTIMATEMINLEN) applicable &= ~(uint32_t)MARKOVESTIMATEMASK;
+  if (datalen < COMPESTIMATEMINLEN) applicable &= ~(uint32_t)COMPESTIMATEMASK;
+  if ((datalen < SAESTIMATEMINLEN) || (datalen <= k)) applicable &= ~(uint32_t)SAESTIMATEMASK;
+  if (datalen < MCWESTIMATEMINLEN) applicable &= ~(uint32_t)MCWESTIMATEMASK;
+  if (datalen < LAGESTIMATEMINLEN) applicable &= ~(uint32_t)LAGESTIMATEMASK;
+  if (datalen < TREEMMCESTIMATEMINLEN) applicable &= ~(uint32_t)TREEMMCESTIMATEMASK;
+  if (datalen < TREELZ78YESTIMATEMINLEN) applicable &= ~(uint32_t)TREELZ78YESTIMATEMASK;
+
+  return applicable;
+}
+
+/*Run each of the SP 800-90B non-IID estimators selected in testBitmask on the data (with k symbols), recording each in result.
+ *Returns the assessed min entropy, the minimum across the estimators.
+ *The run times are the CPU time of the calling thread (the estimators are single threaded), so they remain meaningful when
+ *several blocks are assessed in parallel. The block number only labels the telemetry records.
+ */
+double entropyAssessment(const statData_t *data, size_t datalen, size_t k, uint32_t testBitmask, struct entropyTestingResult *result, const char *label, size_t block) {
+  struct telemetrySpan span;
+  struct telemetrySpan overallSpan;
+  size_t scratchPeak;
+  double minminent;
+  double minIIDminent;
+  double curminent, curminent2;
+  size_t j;
+
+  initEntropyTestingResult(label, result);
+
+  minminent = DBL_INFINITY;
+  minIIDminent = DBL_INFINITY;
+  scratchPeak = 0;
+
+  telemetryStart(&overallSpan);
+
+  if (testBitmask & MCVESTIMATEMASK) {
+    telemetryStart(&span);
+    curminent = mostCommonValueEstimate(data, datalen, k, &(result->mcv));
+    estimatorDone(&span, label, block, "mcv", datalen, k, curminent, &scratchPeak);
+    minminent = curminent;
+    minIIDminent = curminent;
+    result->mcv.runTime = span.cpuTime;
+  }
+
+  if ((k == 2) && (testBitmask & COLSESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = collisionEstimate(data, datalen, &(result->cols));
+    estimatorDone(&span, label, block, "collision", datalen, k, curminent, &scratchPeak);
+    if ((curminent >= 0) && (curminent < minminent)) {
+      minminent = curminent;
+    }
+    result->cols.runTime = span.cpuTime;
+  }
+
+  if ((k == 2) && (testBitmask & MARKOVESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = markovEstimate(data, datalen, &(result->markov));
+    estimatorDone(&span, label, block, "markov", datalen, k, curminent, &scratchPeak);
+    if (curminent < minminent) {
+      minminent = curminent;
+    }
+
+    result->markov.runTime = span.cpuTime;
+  }
+
+  if ((k == 2) && (testBitmask & COMPESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = compressionEstimate(data, datalen, &(result->comp));
+    estimatorDone(&span, label, block, "compression", datalen, k, curminent, &scratchPeak);
+    if ((curminent >= 0.0) && (curminent < minminent)) {
+      minminent = curminent;
+    }
+    result->comp.runTime = span.cpuTime;
+  }
+
+  if ((testBitmask & SAESTIMATEMASK)) {
+    telemetryStart(&span);
+    SAalgs(data, datalen, k, &(result->sa));
+    curminent = result->sa.tTupleEntropy;
+    curminent2 = result->sa.lrsEntropy;
+    // The t-tuple and LRS estimates share the suffix array, so they are reported together.
+    estimatorDone(&span, label, block, "sa", datalen, k, ((curminent2 >= 0.0) && ((curminent < 0.0) || (curminent2 < curminent))) ? curminent2 : curminent, &scratchPeak);
+    result->sa.runTime = span.cpuTime;
+
+    if ((curminent >= 0) && (curminent < minminent)) {
+      minminent = curminent;
+    }
+    if ((curminent2 >= 0.0) && (curminent2 < minminent)) {
+      minminent = curminent2;
+    }
+  }
+
+  if ((testBitmask & MCWESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = multiMCWPredictionEstimate(data, datalen, k, &(result->mcw));
+    estimatorDone(&span, label, block, "multimcw", datalen, k, curminent, &scratchPeak);
+    if ((curminent >= 0.0) && (curminent < minminent)) {
+      minminent = curminent;
+    }
+    result->mcw.runTime = span.cpuTime;
+  }
+
+  if ((testBitmask & LAGESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = lagPredictionEstimate(data, datalen, k, &(result->lag));
+    estimatorDone(&span, label, block, "lag", datalen, k, curminent, &scratchPeak);
+    if (curminent < minminent) {
+      minminent = curminent;
+    }
+    result->lag.runTime = span.cpuTime;
+  }
+
+  if ((testBitmask & TREEMMCESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = treeMultiMMCPredictionEstimate(data, datalen, k, &(result->mmc));
+    estimatorDone(&span, label, block, "multimmc", datalen, k, curminent, &scratchPeak);
+    if (curminent < minminent) {
+      minminent = curminent;
+    }
+    result->mmc.runTime = span.cpuTime;
+  }
+
+  if ((testBitmask & TREELZ78YESTIMATEMASK)) {
+    telemetryStart(&span);
+    curminent = treeLZ78YPredictionEstimate(data, datalen, k, &(result->lz78y));
+    estimatorDone(&span, label, block, "lz78y", datalen, k, curminent, &scratchPeak);
+    if (curminent < minminent) {
+      minminent = curminent;
+    }
+    result->lz78y.runTime = span.cpuTime;
+  }
+
+  telemetryStop(&overallSpan);
+  assert(globalScratchBytes == overallSpan.scratchBase);
+  // The estimators run one after another (each freeing its scratch), so the block's peak is the largest estimator peak.
+  overallSpan.scratchPeak = scratchPeak;
+  telemetryRecord("assessment", label, block, NULL, datalen, k, &overallSpan, minminent);
+  if (configTelemetry != NULL) fflush(configTelemetry);
+
+  result->runTime = overallSpan.cpuTime;
+
+  if (configVerbose > 3) {
+    for (j = 0; j < ERRORSLOTS; j++) {
+      if (globalErrors[j] >= 0.0) fprintf(stderr, "%s rel errors = %.17g\n", errorLabels[j], globalErrors[j]);
+    }
+  }
+
+  assert(isfinite(minminent) != 0);
+  result->assessedEntropy = minminent;
+
+  result->assessedIIDEntropy = minIIDminent;
+
+  return minminent;
+}
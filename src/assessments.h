@@ -12,11 +12,15 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "entlib.h"
 #include "randlib.h"
 
 double bootstrapAssessments(struct entropyTestingResult *result, size_t count, size_t bitWidth, double *IIDminent, struct randstate *rstate);
+void makeBitstring(const statData_t *data, statData_t *bitData, size_t datalen, statData_t activeBits, bool littleEndian);
+uint32_t applicableEstimators(size_t datalen, size_t k, uint32_t testBitmask);
+double entropyAssessment(const statData_t *data, size_t datalen, size_t k, uint32_t testBitmask, struct entropyTestingResult *result, const char *label, size_t block);
 double bootstrapParameters(struct entropyTestingResult *result, size_t count, size_t bitWidth, double *IIDminent, struct randstate *rstate);
 
 #endif
@@ -26,8 +26,9 @@
 #include "entlib.h"
 #include "globals.h"
 #include "precision.h"
+#include "textio.h"
 
-static size_t getfilesize(FILE *input) {
+size_t getfilesize(FILE *input) {
   long size, savedLoc;
 
   if ((savedLoc = ftell(input)) < 0) {
@@ -245,152 +246,114 @@ void mergeSortedLists(const double *in1, size_t len1, const double *in2, size_t
   }
 }
 
+/*Make sure that buffer has room for at least needed elements, growing it geometrically.*/
+static void *reserveascii(void *buffer, size_t *curbuflen, size_t needed, size_t elementSize) {
+  void *newbuffer;
+  size_t newbuflen;
+
+  if (needed * elementSize <= *curbuflen) return buffer;
+
+  newbuflen = (*curbuflen == 0) ? TEXTIO_BLOCKBYTES : 2 * (*curbuflen);
+  if ((newbuffer = realloc(buffer, newbuflen)) == NULL) {
+    perror("Cannot allocate new memory block");
+    exit(EX_OSERR);
+  }
+  *curbuflen = newbuflen;
+  return newbuffer;
+}
+
 size_t readasciidoubles(FILE *input, double **buffer) {
-  double *newbuffer;
-  long int scdata;
   size_t curbuflen = 0;
-  size_t pagesize;
   size_t readdoubles = 0;
-  char curline[4096];
+  struct textReader reader;
+  char *curline;
   double indouble;
   char *afterDouble;
 
   assert(buffer != NULL);
 
-  scdata = sysconf(_SC_PAGESIZE);
-  assert(scdata > 0);
-  pagesize = (size_t)scdata;
-
-  while (feof(input) == 0) {
-    if (((readdoubles + 1) * sizeof(double)) > curbuflen) {
-      if ((newbuffer = realloc(*buffer, curbuflen + pagesize)) == NULL) {
-        perror("Cannot allocate new memory block");
-        exit(EX_OSERR);
-      } else {
-        *buffer = newbuffer;
-        curbuflen += pagesize;
-      }
-    }
+  initTextReader(&reader, input);
+  while ((curline = readTextLine(&reader, NULL)) != NULL) {
+    *buffer = reserveascii(*buffer, &curbuflen, readdoubles + 1, sizeof(double));
 
-    if (fgets(curline, sizeof(curline), input) != NULL) {
-      indouble = strtod(curline, &afterDouble);
-      if (((*afterDouble != '\r') && (*afterDouble != '\n') && (*afterDouble != '\0')) || (indouble >= HUGE_VAL) || (indouble <= -HUGE_VAL) || (errno == ERANGE)) {
-        fprintf(stderr, "data error\n");
-        exit(EX_DATAERR);
-      }
-      (*buffer)[readdoubles] = indouble;
-      readdoubles++;
-    }
-
-    if (ferror(input) != 0) {
-      perror("Error reading input file");
-      exit(EX_OSERR);
+    errno = 0;
+    indouble = textToDouble(curline, &afterDouble);
+    if (((*afterDouble != '\r') && (*afterDouble != '\0')) || (indouble >= HUGE_VAL) || (indouble <= -HUGE_VAL) || (errno == ERANGE)) {
+      fprintf(stderr, "data error on line %zu\n", reader.lineNumber);
+      exit(EX_DATAERR);
     }
+    (*buffer)[readdoubles] = indouble;
+    readdoubles++;
   }
+  freeTextReader(&reader);
 
   return readdoubles;
 }
 
 size_t readasciidoublepoints(FILE *input, double **buffer) {
-  double *newbuffer;
-  long int scdata;
   size_t curbuflen = 0;
-  size_t pagesize;
   size_t readdoubles = 0;
-  char curline[4096];
+  struct textReader reader;
+  char *curline;
   char *curloc;
   double indouble;
   char *afterDouble;
 
   assert(buffer != NULL);
 
-  scdata = sysconf(_SC_PAGESIZE);
-  assert(scdata > 0);
-  pagesize = (size_t)scdata;
-
-  while (feof(input) == 0) {
-    if (((readdoubles + 2) * sizeof(double)) > curbuflen) {
-      if ((newbuffer = realloc(*buffer, curbuflen + pagesize)) == NULL) {
-        perror("Cannot allocate new memory block");
-        exit(EX_OSERR);
-      } else {
-        *buffer = newbuffer;
-        curbuflen += pagesize;
-      }
+  initTextReader(&reader, input);
+  while ((curline = readTextLine(&reader, NULL)) != NULL) {
+    *buffer = reserveascii(*buffer, &curbuflen, readdoubles + 2, sizeof(double));
+
+    curloc = curline;
+    if ((*curloc == '(') || (*curloc == '[') || (*curloc == '{')) curloc++;
+    errno = 0;
+    indouble = textToDouble(curloc, &afterDouble);
+    if ((*afterDouble != ',') || (errno == ERANGE)) {
+      fprintf(stderr, "First place data error on line %zu\n", reader.lineNumber);
+      exit(EX_DATAERR);
     }
+    (*buffer)[readdoubles++] = indouble;
 
-    if (fgets(curline, sizeof(curline), input) != NULL) {
-      curloc = curline;
-      if ((*curloc == '(') || (*curloc == '[') || (*curloc == '{')) curloc++;
-      indouble = strtod(curloc, &afterDouble);
-      if ((*afterDouble != ',') || (errno == ERANGE)) {
-        fprintf(stderr, "First place data error\n");
-        exit(EX_DATAERR);
-      }
-      (*buffer)[readdoubles++] = indouble;
-
-      curloc = afterDouble + 1;
-      indouble = strtod(curloc, &afterDouble);
-
-      if (((*afterDouble != '\r') && (*afterDouble != '\n') && (*afterDouble != '\0') && (*afterDouble != ')') && (*afterDouble != ']') && (*afterDouble != '}')) || (errno == ERANGE) || !isfinite(indouble)) {
-        fprintf(stderr, "Second place data error: \"%c\"\n", *afterDouble);
-        exit(EX_DATAERR);
-      }
-      (*buffer)[readdoubles++] = indouble;
-    }
+    curloc = afterDouble + 1;
+    indouble = textToDouble(curloc, &afterDouble);
 
-    if (ferror(input) != 0) {
-      perror("Error reading input file");
-      exit(EX_OSERR);
+    if (((*afterDouble != '\r') && (*afterDouble != '\0') && (*afterDouble != ')') && (*afterDouble != ']') && (*afterDouble != '}')) || (errno == ERANGE) || !isfinite(indouble)) {
+      fprintf(stderr, "Second place data error on line %zu: \"%c\"\n", reader.lineNumber, *afterDouble);
+      exit(EX_DATAERR);
     }
+    (*buffer)[readdoubles++] = indouble;
   }
+  freeTextReader(&reader);
 
   return readdoubles / 2;
 }
 
 size_t readasciiuint64s(FILE *input, uint64_t **buffer) {
-  uint64_t *newbuffer;
-  long int scdata;
   size_t curbuflen = 0;
-  size_t pagesize;
   size_t readuints = 0;
-  char curline[4096];
+  struct textReader reader;
+  char *curline;
   unsigned long long inInt;
   char *afterInt;
 
   assert(buffer != NULL);
 
-  scdata = sysconf(_SC_PAGESIZE);
-  assert(scdata > 0);
-  pagesize = (size_t)scdata;
-
-  while (feof(input) == 0) {
-    if (((readuints + 1) * sizeof(uint64_t)) > curbuflen) {
-      if ((newbuffer = realloc(*buffer, curbuflen + pagesize)) == NULL) {
-        perror("Cannot allocate new memory block");
-        exit(EX_OSERR);
-      } else {
-        *buffer = newbuffer;
-        curbuflen += pagesize;
-      }
-    }
+  initTextReader(&reader, input);
+  while ((curline = readTextLine(&reader, NULL)) != NULL) {
+    *buffer = reserveascii(*buffer, &curbuflen, readuints + 1, sizeof(uint64_t));
 
-    if (fgets(curline, sizeof(curline), input) != NULL) {
-      inInt = strtoull(curline, &afterInt, 0);
+    errno = 0;
+    inInt = textToUint64(curline, &afterInt, 0);
 
-      if (((*afterInt != '\r') && (*afterInt != '\n') && (*afterInt != '\0')) || ((inInt == ULLONG_MAX) && (errno == ERANGE))) {
-        fprintf(stderr, "data error\n");
-        exit(EX_DATAERR);
-      }
-      (*buffer)[readuints] = inInt;
-      readuints++;
-    }
-
-    if (ferror(input) != 0) {
-      perror("Error reading input file");
-      exit(EX_OSERR);
+    if (((*afterInt != '\r') && (*afterInt != '\0')) || ((inInt == ULLONG_MAX) && (errno == ERANGE))) {
+      fprintf(stderr, "data error on line %zu\n", reader.lineNumber);
+      exit(EX_DATAERR);
     }
+    (*buffer)[readuints] = inInt;
+    readuints++;
   }
+  freeTextReader(&reader);
 
   return readuints;
 }
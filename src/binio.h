@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include "entlib.h"
 
+size_t getfilesize(FILE *input);
 size_t readuint32file(FILE *input, uint32_t **buffer);
 size_t readuint64file(FILE *input, uint64_t **buffer);
 size_t readuintfile(FILE *input, statData_t **buffer);
@@ -0,0 +1,150 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sysexits.h>
+
+#include "binning.h"
+
+/*The cutoffs must be strictly increasing.
+ *Each bucket of 2^16 values records the bin of its first value and the cutoffs that fall inside it, so binning a value is a table
+ *look-up followed by a comparison against each of the (usually zero) cutoffs inside its bucket.
+ */
+void initBinIndex(struct binIndex *index, const uint32_t *cutoffs, size_t cutoffCount) {
+  size_t next;
+
+  assert(index != NULL);
+  assert((cutoffs != NULL) || (cutoffCount == 0));
+  assert(cutoffCount <= BININDEX_MAXCUTOFFS);
+
+  index->cutoffCount = cutoffCount;
+  for (size_t i = 0; i < cutoffCount; i++) {
+    assert((i == 0) || (cutoffs[i - 1] < cutoffs[i]));
+    index->cutoffs[i] = cutoffs[i];
+  }
+
+  next = 0;
+  for (size_t bucket = 0; bucket < BININDEX_BUCKETS; bucket++) {
+    uint32_t first = (uint32_t)(bucket << (32 - BININDEX_RADIXBITS));
+    uint32_t last = first | (UINT32_MAX >> BININDEX_RADIXBITS);
+    size_t span;
+
+    while ((next < cutoffCount) && (cutoffs[next] <= first)) next++;
+    index->firstBin[bucket] = (uint8_t)next;
+
+    span = 0;
+    while ((next + span < cutoffCount) && (cutoffs[next + span] <= last)) span++;
+    index->spanCount[bucket] = (uint8_t)span;
+  }
+
+  if ((index->counts = calloc(cutoffCount + 1, sizeof(size_t))) == NULL) {
+    perror("Can't allocate bin counts");
+    exit(EX_OSERR);
+  }
+}
+
+/*Writes the bin of each value, and adds each value to its bin's count.*/
+void binValues(struct binIndex *index, const uint32_t *data, uint8_t *bins, size_t datalen) {
+  assert(index != NULL);
+  assert(((data != NULL) && (bins != NULL)) || (datalen == 0));
+
+  for (size_t i = 0; i < datalen; i++) {
+    uint32_t value = data[i];
+    size_t bucket = value >> (32 - BININDEX_RADIXBITS);
+    size_t first = index->firstBin[bucket];
+    size_t bin = first;
+
+    for (size_t k = 0; k < index->spanCount[bucket]; k++) {
+      bin += (value >= index->cutoffs[first + k]) ? 1 : 0;
+    }
+
+    bins[i] = (uint8_t)bin;
+    index->counts[bin]++;
+  }
+}
+
+void freeBinIndex(struct binIndex *index) {
+  assert(index != NULL);
+
+  free(index->counts);
+  index->counts = NULL;
+}
+
+void initRangeHistogram(struct rangeHistogram *histogram) {
+  assert(histogram != NULL);
+
+  histogram->base = 0;
+  histogram->capacity = 0;
+  histogram->counts = NULL;
+  histogram->minValue = UINT32_MAX;
+  histogram->maxValue = 0;
+  histogram->total = 0;
+}
+
+/*The first pass: extend the histogram's range to include the data, without counting it.*/
+void rangeHistogramScan(struct rangeHistogram *histogram, const uint32_t *data, size_t datalen) {
+  assert(histogram != NULL);
+  assert(histogram->counts == NULL);
+  assert((data != NULL) || (datalen == 0));
+
+  for (size_t i = 0; i < datalen; i++) {
+    if (data[i] < histogram->minValue) histogram->minValue = data[i];
+    if (data[i] > histogram->maxValue) histogram->maxValue = data[i];
+  }
+}
+
+/*Allocate the counts for the range found by rangeHistogramScan(), so that the counts are allocated once, at their final size.*/
+void rangeHistogramAllocate(struct rangeHistogram *histogram) {
+  assert(histogram != NULL);
+  assert(histogram->counts == NULL);
+
+  if (histogram->minValue > histogram->maxValue) return;
+
+  histogram->base = histogram->minValue;
+  histogram->capacity = (size_t)(histogram->maxValue - histogram->minValue) + 1;
+  if ((histogram->counts = calloc(histogram->capacity, sizeof(size_t))) == NULL) {
+    perror("Can't allocate histogram");
+    exit(EX_OSERR);
+  }
+}
+
+/*The second pass: count the data, which must be within the scanned range.*/
+void rangeHistogramAdd(struct rangeHistogram *histogram, const uint32_t *data, size_t datalen) {
+  assert(histogram != NULL);
+  assert((data != NULL) || (datalen == 0));
+  assert((histogram->counts != NULL) || (datalen == 0));
+
+  for (size_t i = 0; i < datalen; i++) {
+    assert((data[i] >= histogram->base) && ((size_t)(data[i] - histogram->base) < histogram->capacity));
+    histogram->counts[data[i] - histogram->base]++;
+  }
+
+  histogram->total += datalen;
+}
+
+size_t rangeHistogramCount(const struct rangeHistogram *histogram, uint32_t value) {
+  assert(histogram != NULL);
+
+  if ((histogram->capacity == 0) || (value < histogram->base) || ((uint64_t)value >= (uint64_t)histogram->base + histogram->capacity)) return 0;
+
+  return histogram->counts[value - histogram->base];
+}
+
+void freeRangeHistogram(struct rangeHistogram *histogram) {
+  assert(histogram != NULL);
+
+  free(histogram->counts);
+  histogram->counts = NULL;
+  histogram->capacity = 0;
+}
@@ -0,0 +1,54 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef BINNING_H
+#define BINNING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The first level of the bin index is on this many of the high bits of each value.
+#define BININDEX_RADIXBITS 16
+#define BININDEX_BUCKETS (((size_t)1) << BININDEX_RADIXBITS)
+#define BININDEX_MAXCUTOFFS 255
+
+/*Maps uint32_t values to bins given by sorted cutoffs, where each cutoff is the first value of the next bin.
+ *The bin of a value is the number of cutoffs less than or equal to it.
+ */
+struct binIndex {
+  size_t cutoffCount;
+  uint32_t cutoffs[BININDEX_MAXCUTOFFS];
+  uint8_t firstBin[BININDEX_BUCKETS];  // the bin of the smallest value in each bucket
+  uint8_t spanCount[BININDEX_BUCKETS];  // the number of cutoffs that fall inside each bucket (after its first value)
+  size_t *counts;  // per-bin counts of all the values binned so far
+};
+
+/*Counts of each value in [minValue, maxValue], built in two passes over the data: rangeHistogramScan() finds the range,
+ *rangeHistogramAllocate() allocates its counts, and rangeHistogramAdd() counts the values.
+ */
+struct rangeHistogram {
+  uint32_t base;  // the value counted in counts[0]
+  size_t capacity;  // values covered by counts
+  size_t *counts;
+  uint32_t minValue;  // the smallest value scanned
+  uint32_t maxValue;  // the largest value scanned
+  size_t total;  // number of values counted
+};
+
+void initBinIndex(struct binIndex *index, const uint32_t *cutoffs, size_t cutoffCount);
+void binValues(struct binIndex *index, const uint32_t *data, uint8_t *bins, size_t datalen);
+void freeBinIndex(struct binIndex *index);
+
+void initRangeHistogram(struct rangeHistogram *histogram);
+void rangeHistogramScan(struct rangeHistogram *histogram, const uint32_t *data, size_t datalen);
+void rangeHistogramAllocate(struct rangeHistogram *histogram);
+void rangeHistogramAdd(struct rangeHistogram *histogram, const uint32_t *data, size_t datalen);
+size_t rangeHistogramCount(const struct rangeHistogram *histogram, uint32_t value);
+void freeRangeHistogram(struct rangeHistogram *histogram);
+#endif
@@ -12,6 +12,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sysexits.h>
 #include <unistd.h>
 
@@ -25,7 +26,7 @@
 #include "precision.h"
 
 uint32_t extractbits(const uint32_t input, const uint32_t bitMask) {
-#ifndef BMI2
+#if !defined(BMI2) || defined(SLOWPEXT)
   /*Taken from Hacker's Delight, 2nd edition, pp 153*/
   uint32_t mk, mp, mv, t, m;
   uint32_t i;
@@ -56,63 +57,223 @@ uint32_t extractbits(const uint32_t input, const uint32_t bitMask) {
 #endif
 }
 
-void extractbitsArray(const uint32_t *input, statData_t *output, const size_t datalen, const uint32_t bitMask) {
+/*Fill in the look-up tables for input bytes firstByte through lastByte, where contribution[b] is the output
+ *value that input bit b (alone) produces. Each entry is the OR of the contributions of the bits set in its index.
+ */
+static void fillByteTables(uint32_t table[4][256], const uint32_t *contribution, uint32_t firstByte, uint32_t lastByte) {
+  for (uint32_t j = firstByte; j <= lastByte; j++) {
+    table[j][0] = 0;
+    for (uint32_t b = 1; b < 256; b++) {
+      // Add the lowest set bit to the (already computed) entry for the remaining bits.
+      table[j][b] = table[j][b & (b - 1)] | contribution[8U * j + (uint32_t)__builtin_ctz(b)];
+    }
+  }
+}
+
+/*Prepare to extract the bits selected by bitMask from many values.
+ *Contiguous masks reduce to a shift and mask. Otherwise, we use PEXT where it is fast, and a look-up table per
+ *input byte where it is not (or where it is unavailable). Each table maps the byte's value to its contribution
+ *to the extracted value, so the extraction is a few loads and ORs.
+ */
+void initExtractPlan(struct extractPlan *plan, const uint32_t bitMask) {
+  assert(plan != NULL);
+
+  plan->bitMask = bitMask;
+  plan->shift = (bitMask == 0) ? 0U : (uint32_t)__builtin_ctz(bitMask);
+  plan->firstByte = plan->shift / 8U;
+  plan->lastByte = (bitMask == 0) ? 0U : (31U - (uint32_t)__builtin_clz(bitMask)) / 8U;
+
+  if ((((bitMask >> plan->shift) + 1U) & (bitMask >> plan->shift)) == 0) {
+    // The mask is a single run of set bits (or is empty).
+    plan->method = EXTRACT_SHIFT;
+    return;
+  }
+
+#if defined(BMI2) && !defined(SLOWPEXT)
+  plan->method = EXTRACT_PEXT;
+#else
+  plan->method = EXTRACT_TABLE;
+  {
+    uint32_t contribution[32];
+    uint32_t outBit = 0;
+
+    for (uint32_t b = 0; b < 32; b++) {
+      if ((bitMask >> b) & 1U) {
+        contribution[b] = 1U << outBit;
+        outBit++;
+      } else {
+        contribution[b] = 0;
+      }
+    }
+    fillByteTables(plan->table, contribution, plan->firstByte, plan->lastByte);
+  }
+#endif
+}
+
+uint32_t extractPlanValue(const struct extractPlan *plan, const uint32_t input) {
+  uint32_t out;
+
+  switch (plan->method) {
+    case EXTRACT_SHIFT:
+      return (input & plan->bitMask) >> plan->shift;
+    case EXTRACT_PEXT:
+#ifdef BMI2
+      return _pext_u32(input, plan->bitMask);
+#else
+      return extractbits(input, plan->bitMask);
+#endif
+    case EXTRACT_TABLE:
+      out = 0;
+      for (uint32_t j = plan->firstByte; j <= plan->lastByte; j++) {
+        out |= plan->table[j][(input >> (8U * j)) & 0xFFU];
+      }
+      return out;
+    default:
+      assert(false);
+      return extractbits(input, plan->bitMask);
+  }
+}
+
+void extractPlanArray(const struct extractPlan *plan, const uint32_t *input, statData_t *output, const size_t datalen) {
   size_t i;
-#ifndef BMI2
-  /*Taken from Hacker's Delight, 2nd edition, pp 153-154*/
-  uint32_t masks[5];
-  uint32_t mv0, mv1, mv2, mv3, mv4;
-  uint32_t q, m, zm, x;
+  uint32_t mask;
+  uint32_t shift;
+  const uint32_t *t0;
+  const uint32_t *t1;
+  const uint32_t *t2;
+  const uint32_t *t3;
+
+  assert(plan != NULL);
+  assert((unsigned)__builtin_popcount(plan->bitMask) <= STATDATA_BITS);
+
+  mask = plan->bitMask;
+  shift = plan->shift;
+
+  switch (plan->method) {
+    case EXTRACT_SHIFT:
+      // This form is readily vectorized by the compiler.
+      for (i = 0; i < datalen; i++) {
+        output[i] = (statData_t)((input[i] & mask) >> shift);
+      }
+      break;
+    case EXTRACT_PEXT:
+      for (i = 0; i < datalen; i++) {
+        output[i] = (statData_t)extractPlanValue(plan, input[i]);
+      }
+      break;
+    case EXTRACT_TABLE:
+      // The common cases are masks within two adjacent bytes, so handle these without the inner loop.
+      t0 = plan->table[plan->firstByte];
+      if (plan->firstByte == plan->lastByte) {
+        shift = 8U * plan->firstByte;
+        for (i = 0; i < datalen; i++) {
+          output[i] = (statData_t)t0[(input[i] >> shift) & 0xFFU];
+        }
+      } else if (plan->firstByte + 1 == plan->lastByte) {
+        t1 = plan->table[plan->lastByte];
+        shift = 8U * plan->firstByte;
+        for (i = 0; i < datalen; i++) {
+          output[i] = (statData_t)(t0[(input[i] >> shift) & 0xFFU] | t1[(input[i] >> (shift + 8U)) & 0xFFU]);
+        }
+      } else if ((plan->firstByte == 0) && (plan->lastByte == 3)) {
+        t1 = plan->table[1];
+        t2 = plan->table[2];
+        t3 = plan->table[3];
+        for (i = 0; i < datalen; i++) {
+          output[i] = (statData_t)(t0[input[i] & 0xFFU] | t1[(input[i] >> 8) & 0xFFU] | t2[(input[i] >> 16) & 0xFFU] | t3[input[i] >> 24]);
+        }
+      } else {
+        for (i = 0; i < datalen; i++) {
+          output[i] = (statData_t)extractPlanValue(plan, input[i]);
+        }
+      }
+      break;
+    default:
+      assert(false);
+  }
+}
 
-  assert((unsigned)__builtin_popcount(bitMask) <= STATDATA_BITS);
+void extractbitsArray(const uint32_t *input, statData_t *output, const size_t datalen, const uint32_t bitMask) {
+  struct extractPlan plan;
 
-  /*Prep the mv0 to mv4 constants for the eventual reuse throughout the array*/
-  m = ~bitMask;
-  zm = bitMask;
-  for (i = 0; i < 5; i++) {
-    q = m;
-    m ^= m << 1;
-    m ^= m << 2;
-    m ^= m << 4;
-    m ^= m << 8;
-    m ^= m << 16;
-    masks[i] = (m << 1) & zm;
-    m = q & ~m;
-    q = zm & masks[i];
-    zm = zm ^ q ^ (q >> (1 << i));
+  initExtractPlan(&plan, bitMask);
+  extractPlanArray(&plan, input, output, datalen);
+}
+
+/*Compile a bit permutation. The output has bitCount bits; bitpos lists the input bit for each output bit, from the output MSB
+ *to the output LSB (the format used by u32-bit-permute). If reverseInput is set, the input is byte reversed (as per reverse32) first;
+ *this is folded into the tables.
+ *Any fixed permutation is then four table look-ups and three ORs per value, rather than a shift and mask per bit.
+ */
+void initPermutePlan(struct permutePlan *plan, const uint8_t *bitpos, const size_t bitCount, const bool reverseInput) {
+  uint32_t contribution[32];
+  uint32_t inputMask = 0;
+  uint32_t inBit;
+
+  assert(plan != NULL);
+  assert((bitpos != NULL) || (bitCount == 0));
+  assert(bitCount <= 32);
+
+  memset(contribution, 0, sizeof(contribution));
+  for (size_t k = 0; k < bitCount; k++) {
+    assert(bitpos[k] < 32);
+    inBit = bitpos[k];
+    // Bit b of reverse32(x) is bit (b XOR 24) of x.
+    if (reverseInput) inBit ^= 24U;
+    contribution[inBit] |= 1U << (bitCount - 1 - k);
+    inputMask |= 1U << inBit;
   }
 
-  mv0 = masks[0];
-  mv1 = masks[1];
-  mv2 = masks[2];
-  mv3 = masks[3];
-  mv4 = masks[4];
-
-  for (i = 0; i < datalen; i++) {
-    x = input[i] & bitMask;  // input
-    q = x & mv0;
-    x = x ^ q ^ (q >> 1);
-    q = x & mv1;
-    x = x ^ q ^ (q >> 2);
-    q = x & mv2;
-    x = x ^ q ^ (q >> 4);
-    q = x & mv3;
-    x = x ^ q ^ (q >> 8);
-    q = x & mv4;
-    output[i] = (statData_t)(x ^ q ^ (q >> 16));  // output
-    // assert(output[i]==_pext_u32(input[i], bitMask));
+  if (inputMask == 0) {
+    plan->firstByte = 0;
+    plan->lastByte = 0;
+  } else {
+    plan->firstByte = (uint32_t)__builtin_ctz(inputMask) / 8U;
+    plan->lastByte = (31U - (uint32_t)__builtin_clz(inputMask)) / 8U;
   }
 
-#else
-  assert((unsigned int)__builtin_popcount(bitMask) <= STATDATA_BITS);
-  for (i = 0; i < datalen; i++) {
-    output[i] = (statData_t)_pext_u32(input[i], bitMask);
+  memset(plan->table, 0, sizeof(plan->table));
+  fillByteTables(plan->table, contribution, plan->firstByte, plan->lastByte);
+}
+
+uint32_t permutePlanValue(const struct permutePlan *plan, const uint32_t input) {
+  uint32_t out = 0;
+
+  for (uint32_t j = plan->firstByte; j <= plan->lastByte; j++) {
+    out |= plan->table[j][(input >> (8U * j)) & 0xFFU];
+  }
+
+  return out;
+}
+
+void permutePlanArray(const struct permutePlan *plan, const uint32_t *input, uint32_t *output, const size_t datalen) {
+  const uint32_t *t0;
+  const uint32_t *t1;
+  const uint32_t *t2;
+  const uint32_t *t3;
+
+  assert(plan != NULL);
+  assert((input != NULL) || (datalen == 0));
+  assert((output != NULL) || (datalen == 0));
+
+  if ((plan->firstByte == 0) && (plan->lastByte == 3)) {
+    // The general case for permutations.
+    t0 = plan->table[0];
+    t1 = plan->table[1];
+    t2 = plan->table[2];
+    t3 = plan->table[3];
+    for (size_t i = 0; i < datalen; i++) {
+      output[i] = t0[input[i] & 0xFFU] | t1[(input[i] >> 8) & 0xFFU] | t2[(input[i] >> 16) & 0xFFU] | t3[input[i] >> 24];
+    }
+  } else {
+    for (size_t i = 0; i < datalen; i++) {
+      output[i] = permutePlanValue(plan, input[i]);
+    }
   }
-#endif
 }
 
 uint32_t expandBits(const uint32_t input, const uint32_t bitMask) {
-#ifndef BMI2
+#if !defined(BMI2) || defined(SLOWPEXT)
   uint32_t m0, mk, mp, mv, t, x, m;
   uint32_t array[5];
   int i;
@@ -148,116 +309,6 @@ uint32_t expandBits(const uint32_t input, const uint32_t bitMask) {
 #endif
 }
 
-uint32_t getActiveBits(const uint32_t *data, size_t datalen) {
-  uint32_t andmask, ormask;
-  uint32_t andRelated[32];
-  uint32_t orRelated[32];
-  uint32_t bitmask;
-  uint32_t curIndep;
-  uint32_t discardBits;
-  uint32_t activeBits;
-
-  andmask = UINT32_MAX;
-  ormask = 0;
-  for (size_t i = 0; i < 32; i++) {
-    andRelated[i] = UINT32_MAX;
-    orRelated[i] = 0;
-  }
-
-  for (size_t i = 0; i < datalen; i++) {
-    andmask &= data[i];
-    ormask |= data[i];
-    bitmask = 1;
-    for (size_t j = 0; j < 32; j++) {
-      if ((bitmask & data[i]) == 0) {
-        andRelated[j] &= ~(data[i]);
-        orRelated[j] |= ~(data[i]);
-      } else {
-        andRelated[j] &= data[i];
-        orRelated[j] |= data[i];
-      }
-
-      bitmask <<= 1;
-    }
-  }
-
-  // First, look for any fixed bits.
-  activeBits = ~andmask & ormask;
-
-  if (configVerbose > 0) fprintf(stderr, "Non-fixed bits: 0x%08X.\n", activeBits);
-
-  // Now, look for equivalent bits (bits that are always equal to other places, or are alway the bitwise compliment of other places)
-  bitmask = 0x80000000;
-  for (int j = 31; j >= 0; j--) {
-    if (activeBits & bitmask) {
-      curIndep = (~andRelated[j] & orRelated[j]) | bitmask;
-      discardBits = (~curIndep) & activeBits;
-      if (discardBits != 0) {
-        if (configVerbose > 0) fprintf(stderr, "Discarding bits equivalent to bit %d: 0x%08X.\n", j, discardBits);
-        activeBits &= curIndep;
-      }
-    }
-    bitmask >>= 1;
-  }
-
-  if (configVerbose > 0) fprintf(stderr, "Bits to analyze: 0x%08X.\n", activeBits);
-  return activeBits;
-}
-
-statData_t getActiveBitsSD(const statData_t *data, size_t datalen) {
-  statData_t andmask, ormask;
-  statData_t andRelated[STATDATA_BITS];
-  statData_t orRelated[STATDATA_BITS];
-  statData_t bitmask;
-  statData_t curIndep;
-  statData_t discardBits;
-  statData_t activeBits;
-
-  andmask = STATDATA_MAX;
-  ormask = 0;
-  for (size_t i = 0; i < STATDATA_BITS; i++) {
-    andRelated[i] = STATDATA_MAX;
-    orRelated[i] = 0;
-  }
-
-  for (size_t i = 0; i < datalen; i++) {
-    andmask &= data[i];
-    ormask |= data[i];
-    bitmask = 1;
-    for (size_t j = 0; j < STATDATA_BITS; j++) {
-      if ((bitmask & data[i]) == 0) {
-        andRelated[j] = (statData_t)(andRelated[j] & ~(data[i]));
-        orRelated[j] = (statData_t)(orRelated[j] | ~(data[i]));
-      } else {
-        andRelated[j] = (statData_t)(andRelated[j] & data[i]);
-        orRelated[j] = (statData_t)(orRelated[j] | data[i]);
-      }
-
-      bitmask = (statData_t)(bitmask << 1);
-    }
-  }
-
-  activeBits = (statData_t)(~andmask & ormask);
-
-  if (configVerbose > 0) fprintf(stderr, "Non-fixed bits: 0x%08X.\n", activeBits);
-
-  bitmask = (statData_t)(1U << (STATDATA_BITS - 1));
-  for (int j = STATDATA_BITS - 1; j >= 0; j--) {
-    if (activeBits & bitmask) {
-      curIndep = (statData_t)((~andRelated[j] & orRelated[j]) | bitmask);
-      discardBits = (statData_t)((~curIndep) & activeBits);
-      if (discardBits != 0) {
-        if (configVerbose > 0) fprintf(stderr, "Discarding bits equivalent to bit %d: 0x%08X.\n", j, discardBits);
-        activeBits &= curIndep;
-      }
-    }
-    bitmask = (statData_t)(bitmask >> 1);
-  }
-
-  if (configVerbose > 0) fprintf(stderr, "Bits to analyze: 0x%08X.\n", activeBits);
-  return activeBits;
-}
-
 statData_t lowBit(statData_t in) {
   return (statData_t)(in & (-in));
 }
@@ -10,14 +10,39 @@
 #ifndef BINUTIL_H
 #define BINUTIL_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "entlib.h"
 
+enum extractMethod { EXTRACT_SHIFT, EXTRACT_PEXT, EXTRACT_TABLE };
+
+/*A precomputed approach for extracting the bits selected by a fixed mask (see initExtractPlan).*/
+struct extractPlan {
+  uint32_t bitMask;
+  enum extractMethod method;
+  uint32_t shift;  // position of the lowest set bit in the mask
+  uint32_t firstByte;  // the lowest byte with any bits set in the mask
+  uint32_t lastByte;  // the highest byte with any bits set in the mask
+  uint32_t table[4][256];  // (EXTRACT_TABLE only) the extracted bits contributed by each value of each byte
+};
+
+/*A fixed 32-bit permutation (or selection) of bits, compiled into per-byte look-up tables (see initPermutePlan).*/
+struct permutePlan {
+  uint32_t firstByte;  // the lowest input byte that contributes to the output
+  uint32_t lastByte;  // the highest input byte that contributes to the output
+  uint32_t table[4][256];  // the output bits contributed by each value of each input byte
+};
+
 uint32_t extractbits(const uint32_t input, const uint32_t bitMask);
+void initExtractPlan(struct extractPlan *plan, const uint32_t bitMask);
+uint32_t extractPlanValue(const struct extractPlan *plan, const uint32_t input);
+void extractPlanArray(const struct extractPlan *plan, const uint32_t *input, statData_t *output, const size_t datalen);
 void extractbitsArray(const uint32_t *input, statData_t *output, const size_t datalen, const uint32_t bitMask);
+void initPermutePlan(struct permutePlan *plan, const uint8_t *bitpos, const size_t bitCount, const bool reverseInput);
+uint32_t permutePlanValue(const struct permutePlan *plan, const uint32_t input);
+void permutePlanArray(const struct permutePlan *plan, const uint32_t *input, uint32_t *output, const size_t datalen);
 uint32_t expandBits(const uint32_t input, const uint32_t bitMask);
-uint32_t getActiveBits(const uint32_t *data, size_t datalen);
-statData_t getActiveBitsSD(const statData_t *data, size_t datalen);
 statData_t highBit(statData_t in);
 statData_t lowBit(statData_t in);
 uint32_t u32highBit(uint32_t in);
@@ -20,6 +20,7 @@
 
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "globals-inst.h"
 #include "precision.h"
 
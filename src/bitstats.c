@@ -0,0 +1,218 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020-2021 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bitstats.h"
+#include "entlib.h"
+#include "globals.h"
+#include "precision.h"
+
+// Values are processed in chunks of this size, which are distributed across threads.
+#define BITSTATSCHUNK 65536
+// Values are widened from statData_t in blocks of this size.
+#define BITSTATSWIDEN 4096
+
+void initBitStatistics(struct bitStatistics *stats) {
+  assert(stats != NULL);
+
+  stats->count = 0;
+  stats->andMask = UINT32_MAX;
+  stats->orMask = 0;
+  stats->minValue = UINT32_MAX;
+  stats->maxValue = 0;
+  for (size_t j = 0; j < 32; j++) {
+    stats->andRelated[j] = UINT32_MAX;
+    stats->orRelated[j] = 0;
+    stats->bitCounts[j] = 0;
+  }
+}
+
+/*Accumulate data[0], data[stride], ..., data[(datalen-1)*stride] into stats.
+ *The per-bit work is branch-free with a fixed trip count, so that the compiler can vectorize it across the bits.
+ */
+void addBitStatistics(struct bitStatistics *stats, const uint32_t *data, size_t datalen, size_t stride) {
+  uint32_t andRelated[32];
+  uint32_t orRelated[32];
+  uint32_t bitCounts[32];
+  uint32_t andMask, orMask, minValue, maxValue;
+  uint32_t x, differs;
+  size_t i, j;
+
+  assert(stats != NULL);
+  assert((data != NULL) || (datalen == 0));
+  assert(stride > 0);
+
+  andMask = stats->andMask;
+  orMask = stats->orMask;
+  minValue = stats->minValue;
+  maxValue = stats->maxValue;
+  for (j = 0; j < 32; j++) {
+    andRelated[j] = stats->andRelated[j];
+    orRelated[j] = stats->orRelated[j];
+  }
+
+  while (datalen > 0) {
+    // The local counters are 32 bits, so flush them periodically.
+    size_t blockLen = (datalen < BITSTATSCHUNK) ? datalen : BITSTATSCHUNK;
+
+    for (j = 0; j < 32; j++) bitCounts[j] = 0;
+
+    for (i = 0; i < blockLen; i++) {
+      x = data[i * stride];
+      andMask &= x;
+      orMask |= x;
+      if (x < minValue) minValue = x;
+      if (x > maxValue) maxValue = x;
+
+      for (j = 0; j < 32; j++) {
+        // Bit k of differs is set if bit k of x differs from bit j of x.
+        differs = x ^ (0U - ((x >> j) & 1U));
+        andRelated[j] &= differs;
+        orRelated[j] |= differs;
+        bitCounts[j] += (x >> j) & 1U;
+      }
+    }
+
+    for (j = 0; j < 32; j++) stats->bitCounts[j] += bitCounts[j];
+    stats->count += blockLen;
+    data += blockLen * stride;
+    datalen -= blockLen;
+  }
+
+  stats->andMask = andMask;
+  stats->orMask = orMask;
+  stats->minValue = minValue;
+  stats->maxValue = maxValue;
+  for (j = 0; j < 32; j++) {
+    stats->andRelated[j] = andRelated[j];
+    stats->orRelated[j] = orRelated[j];
+  }
+}
+
+void mergeBitStatistics(struct bitStatistics *stats, const struct bitStatistics *other) {
+  assert(stats != NULL);
+  assert(other != NULL);
+
+  stats->count += other->count;
+  stats->andMask &= other->andMask;
+  stats->orMask |= other->orMask;
+  if (other->minValue < stats->minValue) stats->minValue = other->minValue;
+  if (other->maxValue > stats->maxValue) stats->maxValue = other->maxValue;
+  for (size_t j = 0; j < 32; j++) {
+    stats->andRelated[j] &= other->andRelated[j];
+    stats->orRelated[j] |= other->orRelated[j];
+    stats->bitCounts[j] += other->bitCounts[j];
+  }
+}
+
+/*Gather the statistics for data[0], data[stride], ..., data[(datalen-1)*stride], with the chunks processed in parallel.*/
+void getBitStatistics(struct bitStatistics *stats, const uint32_t *data, size_t datalen, size_t stride) {
+  size_t chunkCount;
+
+  assert(stats != NULL);
+
+  initBitStatistics(stats);
+  chunkCount = (datalen + BITSTATSCHUNK - 1) / BITSTATSCHUNK;
+
+#pragma omp parallel
+  {
+    struct bitStatistics localStats;
+
+    initBitStatistics(&localStats);
+
+#pragma omp for
+    for (size_t c = 0; c < chunkCount; c++) {
+      size_t start = c * BITSTATSCHUNK;
+      addBitStatistics(&localStats, data + start * stride, (datalen - start < BITSTATSCHUNK) ? (datalen - start) : BITSTATSCHUNK, stride);
+    }
+
+#pragma omp critical(bitStatisticsUpdate)
+    mergeBitStatistics(stats, &localStats);
+  }
+}
+
+/*Identify the bits that are not fixed, and then reduce these to a set of bits where no bit is always equal to (or
+ *always the bitwise complement of) another retained bit. Where bits are related in this way, the highest such
+ *bit is retained.
+ */
+uint32_t activeBitsFromStatistics(const struct bitStatistics *stats) {
+  uint32_t bitmask;
+  uint32_t curIndep;
+  uint32_t discardBits;
+  uint32_t activeBits;
+
+  assert(stats != NULL);
+
+  // First, look for any fixed bits.
+  activeBits = ~stats->andMask & stats->orMask;
+
+  if (configVerbose > 0) fprintf(stderr, "Non-fixed bits: 0x%08X.\n", activeBits);
+
+  // Now, look for equivalent bits (bits that are always equal to other places, or are alway the bitwise compliment of other places)
+  bitmask = 0x80000000;
+  for (int j = 31; j >= 0; j--) {
+    if (activeBits & bitmask) {
+      // Bits that sometimes differ from bit j, and sometimes do not, are independent of bit j.
+      curIndep = (~stats->andRelated[j] & stats->orRelated[j]) | bitmask;
+      discardBits = (~curIndep) & activeBits;
+      if (discardBits != 0) {
+        if (configVerbose > 0) fprintf(stderr, "Discarding bits equivalent to bit %d: 0x%08X.\n", j, discardBits);
+        activeBits &= curIndep;
+      }
+    }
+    bitmask >>= 1;
+  }
+
+  if (configVerbose > 0) fprintf(stderr, "Bits to analyze: 0x%08X.\n", activeBits);
+  return activeBits;
+}
+
+uint32_t getActiveBits(const uint32_t *data, size_t datalen) {
+  struct bitStatistics stats;
+
+  getBitStatistics(&stats, data, datalen, 1);
+  return activeBitsFromStatistics(&stats);
+}
+
+statData_t getActiveBitsSD(const statData_t *data, size_t datalen) {
+  struct bitStatistics stats;
+  size_t chunkCount;
+
+  assert((data != NULL) || (datalen == 0));
+
+  initBitStatistics(&stats);
+  chunkCount = (datalen + BITSTATSWIDEN - 1) / BITSTATSWIDEN;
+
+#pragma omp parallel
+  {
+    struct bitStatistics localStats;
+    uint32_t widened[BITSTATSWIDEN];
+
+    initBitStatistics(&localStats);
+
+#pragma omp for
+    for (size_t c = 0; c < chunkCount; c++) {
+      size_t start = c * BITSTATSWIDEN;
+      size_t blockLen = (datalen - start < BITSTATSWIDEN) ? (datalen - start) : BITSTATSWIDEN;
+
+      for (size_t i = 0; i < blockLen; i++) widened[i] = data[start + i];
+      addBitStatistics(&localStats, widened, blockLen, 1);
+    }
+
+#pragma omp critical(bitStatisticsUpdate)
+    mergeBitStatistics(&stats, &localStats);
+  }
+
+  // The widened bits above STATDATA_BITS are always 0, so these are never active.
+  return (statData_t)activeBitsFromStatistics(&stats);
+}
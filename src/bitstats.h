@@ -0,0 +1,36 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef BITSTATS_H
+#define BITSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "entlib.h"
+
+// Summary of the bit behavior of a set of 32-bit values, gathered in one pass.
+struct bitStatistics {
+  size_t count;
+  uint32_t andMask;  // bits that are always set
+  uint32_t orMask;  // bits that are ever set
+  uint32_t minValue;
+  uint32_t maxValue;
+  uint32_t andRelated[32];  // bit k is set if bit k always differs from bit j
+  uint32_t orRelated[32];  // bit k is set if bit k ever differs from bit j
+  size_t bitCounts[32];  // number of values with bit j set
+};
+
+void initBitStatistics(struct bitStatistics *stats);
+void addBitStatistics(struct bitStatistics *stats, const uint32_t *data, size_t datalen, size_t stride);
+void mergeBitStatistics(struct bitStatistics *stats, const struct bitStatistics *other);
+void getBitStatistics(struct bitStatistics *stats, const uint32_t *data, size_t datalen, size_t stride);
+uint32_t activeBitsFromStatistics(const struct bitStatistics *stats);
+uint32_t getActiveBits(const uint32_t *data, size_t datalen);
+statData_t getActiveBitsSD(const statData_t *data, size_t datalen);
+#endif
@@ -0,0 +1,550 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include "blockio.h"
+
+static unsigned char *allocBlock(size_t bytes) {
+  void *block;
+
+  assert(bytes > 0);
+
+  if (posix_memalign(&block, BLOCKIO_ALIGNMENT, bytes) != 0) {
+    perror("Can't allocate I/O block");
+    exit(EX_OSERR);
+  }
+
+  return block;
+}
+
+static size_t elementsPerBlock(size_t elementSize) {
+  assert(elementSize > 0);
+
+  if (elementSize >= BLOCKIO_BLOCKBYTES) {
+    return 1;
+  } else {
+    return BLOCKIO_BLOCKBYTES / elementSize;
+  }
+}
+
+/*Read up to one block of complete elements. Any trailing partial element is discarded, as with fread.*/
+static size_t fillBlock(FILE *input, unsigned char *buffer, size_t elementSize, size_t blockElements) {
+  size_t res;
+
+  res = fread(buffer, elementSize, blockElements, input);
+  if ((res < blockElements) && (ferror(input) != 0)) {
+    perror("Can't read from input");
+    exit(EX_OSERR);
+  }
+
+  return res;
+}
+
+/*The asynchronous reader alternates between the two buffers, filling each once the caller has released it.
+ *The end of the input is signaled by a block with no elements.
+ */
+static void *readerThread(void *ptr) {
+  struct blockReader *reader;
+  size_t next;
+  size_t res;
+  bool atEnd;
+
+  reader = ptr;
+  next = 0;
+  atEnd = false;
+
+  for (;;) {
+    if (pthread_mutex_lock(&reader->lock) != 0) {
+      perror("Can't get block reader lock");
+      exit(EX_OSERR);
+    }
+    while (reader->full[next] && !reader->stopping) {
+      if (pthread_cond_wait(&reader->changed, &reader->lock) != 0) {
+        perror("Can't wait on block reader condition");
+        exit(EX_OSERR);
+      }
+    }
+    if (reader->stopping) {
+      pthread_mutex_unlock(&reader->lock);
+      break;
+    }
+    if (pthread_mutex_unlock(&reader->lock) != 0) {
+      perror("Can't release block reader lock");
+      exit(EX_OSERR);
+    }
+
+    // Once the end of the input is encountered, post only the empty block.
+    res = atEnd ? 0 : fillBlock(reader->input, reader->buffers[next], reader->elementSize, reader->blockElements);
+    atEnd = (res < reader->blockElements);
+
+    if (pthread_mutex_lock(&reader->lock) != 0) {
+      perror("Can't get block reader lock");
+      exit(EX_OSERR);
+    }
+    reader->counts[next] = res;
+    reader->full[next] = true;
+    if (pthread_cond_broadcast(&reader->changed) != 0) {
+      perror("Can't signal block reader condition");
+      exit(EX_OSERR);
+    }
+    if (pthread_mutex_unlock(&reader->lock) != 0) {
+      perror("Can't release block reader lock");
+      exit(EX_OSERR);
+    }
+
+    if (res == 0) {
+      break;
+    }
+
+    next ^= 1;
+  }
+
+  return NULL;
+}
+
+void initBlockReader(struct blockReader *reader, FILE *input, size_t elementSize, bool async) {
+  assert(reader != NULL);
+  assert(input != NULL);
+
+  reader->input = input;
+  reader->elementSize = elementSize;
+  reader->blockElements = elementsPerBlock(elementSize);
+  reader->buffers[0] = allocBlock(reader->blockElements * elementSize);
+  reader->buffers[1] = async ? allocBlock(reader->blockElements * elementSize) : NULL;
+  reader->counts[0] = reader->counts[1] = 0;
+  reader->full[0] = reader->full[1] = false;
+  reader->current = 0;
+  reader->available = 0;
+  reader->position = 0;
+  reader->started = false;
+  reader->finished = false;
+  reader->async = async;
+  reader->stopping = false;
+
+  if (async) {
+    if (pthread_mutex_init(&reader->lock, NULL) != 0) {
+      perror("Can't initialize block reader lock");
+      exit(EX_OSERR);
+    }
+    if (pthread_cond_init(&reader->changed, NULL) != 0) {
+      perror("Can't initialize block reader condition");
+      exit(EX_OSERR);
+    }
+    if (pthread_create(&reader->readThread, NULL, readerThread, reader) != 0) {
+      perror("Can't create block reader thread");
+      exit(EX_OSERR);
+    }
+  }
+}
+
+/*Load the next block, and return the number of complete elements within it (0 at the end of the input)*/
+static size_t nextBlock(struct blockReader *reader) {
+  size_t res;
+
+  if (reader->finished) {
+    return 0;
+  }
+
+  if (!reader->async) {
+    res = fillBlock(reader->input, reader->buffers[0], reader->elementSize, reader->blockElements);
+  } else {
+    if (pthread_mutex_lock(&reader->lock) != 0) {
+      perror("Can't get block reader lock");
+      exit(EX_OSERR);
+    }
+
+    // Release the block that the caller has finished with
+    if (reader->started) {
+      reader->full[reader->current] = false;
+      reader->current ^= 1;
+      if (pthread_cond_broadcast(&reader->changed) != 0) {
+        perror("Can't signal block reader condition");
+        exit(EX_OSERR);
+      }
+    }
+
+    while (!reader->full[reader->current]) {
+      if (pthread_cond_wait(&reader->changed, &reader->lock) != 0) {
+        perror("Can't wait on block reader condition");
+        exit(EX_OSERR);
+      }
+    }
+    res = reader->counts[reader->current];
+
+    if (pthread_mutex_unlock(&reader->lock) != 0) {
+      perror("Can't release block reader lock");
+      exit(EX_OSERR);
+    }
+  }
+
+  reader->started = true;
+  reader->available = res;
+  reader->position = 0;
+  if (res == 0) {
+    reader->finished = true;
+  }
+
+  return res;
+}
+
+/*Returns the number of unread complete elements (and sets *block to point to them), or 0 at the end of the input.
+ *These are the remainder of a block partially consumed by readElement, or otherwise the next block.
+ *The block remains valid until the next call.
+ */
+size_t readBlock(struct blockReader *reader, const void **block) {
+  size_t res;
+
+  assert(reader != NULL);
+  assert(block != NULL);
+
+  if (reader->position >= reader->available) {
+    if (nextBlock(reader) == 0) {
+      *block = NULL;
+      return 0;
+    }
+  }
+
+  *block = reader->buffers[reader->current] + reader->position * reader->elementSize;
+  res = reader->available - reader->position;
+  reader->position = reader->available;
+
+  return res;
+}
+
+/*Copy out the next element. Returns false at the end of the input.*/
+bool readElement(struct blockReader *reader, void *element) {
+  assert(reader != NULL);
+  assert(element != NULL);
+
+  if (reader->position >= reader->available) {
+    if (nextBlock(reader) == 0) {
+      return false;
+    }
+  }
+
+  memcpy(element, reader->buffers[reader->current] + reader->position * reader->elementSize, reader->elementSize);
+  reader->position++;
+
+  return true;
+}
+
+void freeBlockReader(struct blockReader *reader) {
+  assert(reader != NULL);
+
+  if (reader->async) {
+    if (pthread_mutex_lock(&reader->lock) != 0) {
+      perror("Can't get block reader lock");
+      exit(EX_OSERR);
+    }
+    reader->stopping = true;
+    if (pthread_cond_broadcast(&reader->changed) != 0) {
+      perror("Can't signal block reader condition");
+      exit(EX_OSERR);
+    }
+    if (pthread_mutex_unlock(&reader->lock) != 0) {
+      perror("Can't release block reader lock");
+      exit(EX_OSERR);
+    }
+
+    if (pthread_join(reader->readThread, NULL) != 0) {
+      perror("Can't join block reader thread");
+      exit(EX_OSERR);
+    }
+
+    pthread_cond_destroy(&reader->changed);
+    pthread_mutex_destroy(&reader->lock);
+  }
+
+  free(reader->buffers[0]);
+  free(reader->buffers[1]);
+  reader->buffers[0] = reader->buffers[1] = NULL;
+}
+
+void initBlockWriter(struct blockWriter *writer, FILE *output, size_t elementSize) {
+  assert(writer != NULL);
+  assert(output != NULL);
+
+  writer->output = output;
+  writer->elementSize = elementSize;
+  writer->blockElements = elementsPerBlock(elementSize);
+  writer->buffer = allocBlock(writer->blockElements * elementSize);
+  writer->count = 0;
+}
+
+void flushBlockWriter(struct blockWriter *writer) {
+  assert(writer != NULL);
+
+  if (writer->count > 0) {
+    if (fwrite(writer->buffer, writer->elementSize, writer->count, writer->output) != writer->count) {
+      perror("Can't write to output");
+      exit(EX_OSERR);
+    }
+    writer->count = 0;
+  }
+}
+
+void writeElement(struct blockWriter *writer, const void *element) {
+  assert(writer != NULL);
+  assert(element != NULL);
+
+  if (writer->count == writer->blockElements) {
+    flushBlockWriter(writer);
+  }
+
+  memcpy(writer->buffer + writer->count * writer->elementSize, element, writer->elementSize);
+  writer->count++;
+}
+
+void writeElements(struct blockWriter *writer, const void *elements, size_t count) {
+  const unsigned char *curElements;
+  size_t toCopy;
+
+  assert(writer != NULL);
+  assert((elements != NULL) || (count == 0));
+
+  curElements = elements;
+  while (count > 0) {
+    if (writer->count == writer->blockElements) {
+      flushBlockWriter(writer);
+    }
+
+    toCopy = writer->blockElements - writer->count;
+    if (toCopy > count) {
+      toCopy = count;
+    }
+
+    memcpy(writer->buffer + writer->count * writer->elementSize, curElements, toCopy * writer->elementSize);
+    writer->count += toCopy;
+    curElements += toCopy * writer->elementSize;
+    count -= toCopy;
+  }
+}
+
+/*Provides space for the caller to produce output elements directly into the writer's buffer.
+ *Returns a pointer to the space, and sets *count to the number of elements that fit (always at least 1).
+ *The elements that were actually produced are then recorded using commitElements.
+ */
+void *reserveElements(struct blockWriter *writer, size_t *count) {
+  assert(writer != NULL);
+  assert(count != NULL);
+
+  if (writer->count == writer->blockElements) {
+    flushBlockWriter(writer);
+  }
+
+  *count = writer->blockElements - writer->count;
+  return writer->buffer + writer->count * writer->elementSize;
+}
+
+void commitElements(struct blockWriter *writer, size_t count) {
+  assert(writer != NULL);
+  assert(writer->count + count <= writer->blockElements);
+
+  writer->count += count;
+}
+
+/*Flushes any remaining buffered output, and releases the buffer*/
+void freeBlockWriter(struct blockWriter *writer) {
+  assert(writer != NULL);
+
+  flushBlockWriter(writer);
+  if (fflush(writer->output) != 0) {
+    perror("Can't flush output");
+    exit(EX_OSERR);
+  }
+
+  free(writer->buffer);
+  writer->buffer = NULL;
+}
+
+/*out[c * rows + s] = in[s * rate + c] for each class c < rate and each row s < rows*/
+static void transposeClasses(unsigned char *out, const unsigned char *in, size_t elementSize, size_t rows, size_t rate) {
+  switch (elementSize) {
+    case 1:
+      for (size_t s = 0; s < rows; s++) {
+        for (size_t c = 0; c < rate; c++) {
+          out[c * rows + s] = in[s * rate + c];
+        }
+      }
+      break;
+    case 4:
+      for (size_t s = 0; s < rows; s++) {
+        for (size_t c = 0; c < rate; c++) {
+          memcpy(out + 4 * (c * rows + s), in + 4 * (s * rate + c), 4);
+        }
+      }
+      break;
+    default:
+      for (size_t s = 0; s < rows; s++) {
+        for (size_t c = 0; c < rate; c++) {
+          memcpy(out + elementSize * (c * rows + s), in + elementSize * (s * rate + c), elementSize);
+        }
+      }
+      break;
+  }
+}
+
+static void writeAt(int fd, const unsigned char *data, size_t bytes, off_t offset) {
+  ssize_t written;
+
+  while (bytes > 0) {
+    if ((written = pwrite(fd, data, bytes, offset)) <= 0) {
+      perror("Can't write output");
+      exit(EX_OSERR);
+    }
+    data += written;
+    bytes -= (size_t)written;
+    offset += written;
+  }
+}
+
+static void rewindInput(FILE *input) {
+  if (fseek(input, 0, SEEK_SET) != 0) {
+    perror("Can't rewind input");
+    exit(EX_OSERR);
+  }
+  clearerr(input);
+}
+
+/*Writes the first datalen elements of input (which must be a multiple of rate) grouped by index into modular classes mod rate:
+ *first the elements with index = 0 (mod rate) in order, then those with index = 1 (mod rate), and so on.
+ *Roughly bufferBytes of memory is used for reordering, however long the input is.
+ *If the output is a regular file, the input is read once, a buffer's worth at a time, and each class's part of that buffer is
+ *written directly to its place in the output. Otherwise, the input is read once for each group of classes that fits in the buffer
+ *(a class that doesn't fit in the buffer is written as it is read).
+ */
+void writeModularClasses(FILE *input, FILE *output, size_t elementSize, size_t datalen, size_t rate, size_t bufferBytes) {
+  struct stat outputStat;
+  size_t classLength;
+  size_t classesPerPass;
+  off_t base;
+  int outputFlags;
+
+  assert(input != NULL);
+  assert(output != NULL);
+  assert(elementSize > 0);
+  assert(rate > 0);
+  assert((datalen % rate) == 0);
+
+  if (datalen == 0) return;
+
+  classLength = datalen / rate;
+
+  if (fflush(output) != 0) {
+    perror("Can't flush output");
+    exit(EX_OSERR);
+  }
+
+  // pwrite ignores the offset on a file opened for appending, so that case is handled as a stream.
+  if ((fstat(fileno(output), &outputStat) == 0) && S_ISREG(outputStat.st_mode) && ((outputFlags = fcntl(fileno(output), F_GETFL)) >= 0) && ((outputFlags & O_APPEND) == 0) && ((base = ftello(output)) >= 0)) {
+    unsigned char *chunk;
+    unsigned char *classes;
+    size_t rowsPerChunk;
+    size_t row;
+
+    rowsPerChunk = bufferBytes / (2 * rate * elementSize);
+    if (rowsPerChunk == 0) rowsPerChunk = 1;
+    if (rowsPerChunk > classLength) rowsPerChunk = classLength;
+
+    chunk = allocBlock(rowsPerChunk * rate * elementSize);
+    classes = allocBlock(rowsPerChunk * rate * elementSize);
+
+    rewindInput(input);
+    for (row = 0; row < classLength; row += rowsPerChunk) {
+      size_t rows = ((classLength - row) < rowsPerChunk) ? (classLength - row) : rowsPerChunk;
+
+      if (fillBlock(input, chunk, elementSize, rows * rate) != rows * rate) {
+        fprintf(stderr, "Input ended early\n");
+        exit(EX_DATAERR);
+      }
+
+      transposeClasses(classes, chunk, elementSize, rows, rate);
+
+      for (size_t c = 0; c < rate; c++) {
+        writeAt(fileno(output), classes + c * rows * elementSize, rows * elementSize, base + (off_t)((c * classLength + row) * elementSize));
+      }
+    }
+
+    if (fseeko(output, base + (off_t)(datalen * elementSize), SEEK_SET) != 0) {
+      perror("Can't seek output");
+      exit(EX_OSERR);
+    }
+
+    free(chunk);
+    free(classes);
+    return;
+  }
+
+  classesPerPass = bufferBytes / (classLength * elementSize);
+  if (classesPerPass == 0) classesPerPass = 1;
+  if (classesPerPass > rate) classesPerPass = rate;
+
+  for (size_t firstClass = 0; firstClass < rate; firstClass += classesPerPass) {
+    struct blockReader reader;
+    struct blockWriter writer;
+    const unsigned char *block;
+    unsigned char *held;
+    size_t lastClass;
+    size_t blockLen;
+    size_t index;
+    size_t c;
+
+    lastClass = ((rate - firstClass) < classesPerPass) ? rate : (firstClass + classesPerPass);
+    held = (lastClass - firstClass > 1) ? allocBlock((lastClass - firstClass) * classLength * elementSize) : NULL;
+
+    rewindInput(input);
+    initBlockReader(&reader, input, elementSize, true);
+    initBlockWriter(&writer, output, elementSize);
+
+    index = 0;
+    c = 0;
+    while ((index < datalen) && ((blockLen = readBlock(&reader, (const void **)&block)) > 0)) {
+      if (blockLen > datalen - index) blockLen = datalen - index;
+
+      for (size_t j = 0; j < blockLen; j++) {
+        if ((c >= firstClass) && (c < lastClass)) {
+          if (held == NULL) {
+            writeElement(&writer, block + j * elementSize);
+          } else {
+            memcpy(held + ((c - firstClass) * classLength + index / rate) * elementSize, block + j * elementSize, elementSize);
+          }
+        }
+
+        index++;
+        c++;
+        if (c == rate) c = 0;
+      }
+    }
+
+    if (index != datalen) {
+      fprintf(stderr, "Input ended early\n");
+      exit(EX_DATAERR);
+    }
+
+    if (held != NULL) {
+      writeElements(&writer, held, (lastClass - firstClass) * classLength);
+      free(held);
+    }
+
+    freeBlockReader(&reader);
+    freeBlockWriter(&writer);
+  }
+}
@@ -0,0 +1,67 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef BLOCKIO_H
+#define BLOCKIO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Target number of bytes per block
+#define BLOCKIO_BLOCKBYTES (((size_t)1) << 20)
+// Alignment of the block buffers
+#define BLOCKIO_ALIGNMENT 64
+
+// Reads a stream of fixed-size elements a block at a time.
+// In asynchronous mode, a reader thread fills one buffer while the caller processes the other.
+struct blockReader {
+  FILE *input;
+  size_t elementSize;
+  size_t blockElements;  // complete elements per block
+  unsigned char *buffers[2];
+  size_t counts[2];  // elements in each filled buffer (shared with the reader thread)
+  bool full[2];  // (async) is this buffer waiting to be consumed?
+  size_t current;  // the buffer most recently handed to the caller
+  size_t available;  // elements in the buffer most recently handed to the caller
+  size_t position;  // next unread element of that buffer
+  bool started;
+  bool finished;  // the end of the input has been handed to the caller
+  bool async;
+  bool stopping;  // (async) the caller is done with this stream
+  pthread_t readThread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+};
+
+// Collects fixed-size elements and writes them a block at a time.
+struct blockWriter {
+  FILE *output;
+  size_t elementSize;
+  size_t blockElements;
+  unsigned char *buffer;
+  size_t count;  // elements presently buffered
+};
+
+void initBlockReader(struct blockReader *reader, FILE *input, size_t elementSize, bool async);
+size_t readBlock(struct blockReader *reader, const void **block);
+bool readElement(struct blockReader *reader, void *element);
+void freeBlockReader(struct blockReader *reader);
+
+void initBlockWriter(struct blockWriter *writer, FILE *output, size_t elementSize);
+void writeElement(struct blockWriter *writer, const void *element);
+void writeElements(struct blockWriter *writer, const void *elements, size_t count);
+void *reserveElements(struct blockWriter *writer, size_t *count);
+void commitElements(struct blockWriter *writer, size_t count);
+void flushBlockWriter(struct blockWriter *writer);
+void freeBlockWriter(struct blockWriter *writer);
+
+void writeModularClasses(FILE *input, FILE *output, size_t elementSize, size_t datalen, size_t rate, size_t bufferBytes);
+#endif
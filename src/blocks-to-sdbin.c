@@ -18,6 +18,7 @@
 #include <stdnoreturn.h>
 #include <string.h>
 #include <sysexits.h>
+#include "blockio.h"
 #include "entlib.h"
 #include "precision.h"
 
@@ -63,7 +64,10 @@ int main(int argc, char *argv[]) {
   size_t outputBytesPerBlock;
   bool configLTH;
   size_t blockSize;
-  char *buffer;
+  const char *buffer;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
   int *order;
   char *curStrLoc;
   char *nextStrLoc;
@@ -95,11 +99,6 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  if ((buffer = malloc(sizeof(char) * blockSize)) == NULL) {
-    perror("Can't allocate block");
-    exit(EX_OSERR);
-  }
-
   if ((order = malloc(sizeof(int) * blockSize)) == NULL) {
     perror("Can't allocate block order array");
     exit(EX_OSERR);
@@ -145,8 +144,12 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  while (feof(stdin) == 0) {
-    if (fread(buffer, blockSize, 1, stdin) == 1) {
+  // Each element is one blockSize-byte block
+  initBlockReader(&reader, stdin, blockSize, false);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+
+  while ((count = readBlock(&reader, (const void **)&buffer)) > 0) {
+    for (size_t i = 0; i < count; i++, buffer += blockSize) {
       for (size_t k = 0; k < outputBytesPerBlock; k++) {
         statData_t curByte = (statData_t)buffer[order[k]];
         if (configLTH) {
@@ -157,10 +160,7 @@ int main(int argc, char *argv[]) {
 
         for (size_t j = 0; j < 8; j++) {
           outdata = (statData_t)(((curByte & bitmask) == 0) ? 0U : 1U);
-          if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-            perror("Can't write to output");
-            exit(EX_OSERR);
-          }
+          writeElement(&writer, &outdata);
 
           if (configLTH) {
             bitmask = (uint8_t)((bitmask << 1) & 0xFF);
@@ -172,7 +172,8 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  free(buffer);
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
   free(order);
 
   return (0);
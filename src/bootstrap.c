@@ -24,7 +24,9 @@
 #include "bootstrap.h"
 #include "cephes.h"
 #include "fancymath.h"
+#include "globals.h"
 #include "incbeta.h"
+#include "loopprofile.h"
 #include "randlib.h"
 
 #define BIRTHDAYBOUNDEXP 10
@@ -55,6 +57,53 @@ static void bootstrapSample(const double *data, double *bootstrapData, size_t da
   }
 }
 
+/*Each thread in a bootstrap's parallel region gets its own generator and re-sample buffer. These are set up before the
+ *region, as a fatal error (see globals.h) can't be returned from within it.
+ */
+struct bootstrapThread {
+  struct randstate rstate;
+  double *bootstrapData;
+};
+
+// The array has a zeroed final entry, so that it can be released (see globals.h) without its length.
+static void releaseBootstrapThreads(void *block) {
+  struct bootstrapThread *threads = block;
+
+  for (size_t t = 0; threads[t].bootstrapData != NULL; t++) {
+    free(threads[t].bootstrapData);
+  }
+  free(threads);
+}
+
+static struct bootstrapThread *initBootstrapThreads(size_t datalen, size_t *threadCount) {
+  struct bootstrapThread *threads;
+
+  *threadCount = (size_t)omp_get_max_threads();
+  if ((threads = calloc(*threadCount + 1, sizeof(struct bootstrapThread))) == NULL) {
+    perror("Can't allocate room for bootstrap thread state");
+    fatalError(EX_OSERR);
+  }
+  trackAllocation(threads, releaseBootstrapThreads);
+
+  for (size_t t = 0; t < *threadCount; t++) {
+    initGenerator(&threads[t].rstate);
+    seedGenerator(&threads[t].rstate);
+
+    if ((threads[t].bootstrapData = malloc(sizeof(double) * datalen)) == NULL) {
+      perror("Can't allocate room for bootstrap");
+      fatalError(EX_OSERR);
+    }
+  }
+
+  return threads;
+}
+
+static void freeBootstrapThreads(struct bootstrapThread *threads, size_t threadCount) {
+  assert(threads[threadCount].bootstrapData == NULL);
+  untrackAllocation(threads);
+  releaseBootstrapThreads(threads);
+}
+
 /*Assume the data is sorted. Find the number of elements below the passed in value*/
 size_t belowValue(double value, const double *data, size_t datalen) {
   size_t lowindex;
@@ -384,6 +433,10 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
   size_t i;
   double *bootstrapPercentiles;
   double percentile;
+  struct bootstrapThread *threads;
+  size_t threadCount;
+  struct loopProfile profile;
+  struct threadConfig config;
   struct compensatedState runningAccelNumerator;
   struct compensatedState runningAccelDenominator;
   long double accelNumerator;
@@ -532,30 +585,38 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
 
   if ((bootstrapPercentiles = malloc(sizeof(double) * rounds)) == NULL) {
     perror("Can't allocate room for bootstrap percentiles");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(bootstrapPercentiles, free);
 
+  threads = initBootstrapThreads(datalen, &threadCount);
+
+  saveThreadConfig(&config);
+  loopProfileInit(&profile, "bootstrap-percentile", rounds, true, true);
 #pragma omp parallel
   {
-    struct randstate threadRstate;
-    double *bootstrapData;
+    struct bootstrapThread *thread = &threads[omp_get_thread_num()];
+    double threadStart;
+    size_t threadIterations = 0;
 
-    initGenerator(&threadRstate);
-    seedGenerator(&threadRstate);
+    loadThreadConfig(&config);
 
     // Do the bootstrap sampling
-    if ((bootstrapData = malloc(sizeof(double) * datalen)) == NULL) {
-      perror("Can't allocate room for bootstrap");
-      exit(EX_OSERR);
-    }
-#pragma omp for
+    // The results are sorted below, so the order in which the rounds are run (and by which thread) doesn't matter.
+    threadStart = loopProfileNow();
+#pragma omp for schedule(runtime) nowait
     for (size_t j = 0; j < rounds; j++) {
-      bootstrapSample(data, bootstrapData, datalen, &threadRstate);
-      bootstrapPercentiles[j] = processedCalculatePercentile(p, bootstrapData, datalen, false, -8);
+      double iterationStart = loopProfileNow();
+      bootstrapSample(data, thread->bootstrapData, datalen, &thread->rstate);
+      bootstrapPercentiles[j] = processedCalculatePercentile(p, thread->bootstrapData, datalen, false, -8);
       if (configVerbose > 6) fprintf(stderr, "Bootstrap percentile: %.17g\n", bootstrapPercentiles[j]);
+      loopProfileIteration(&profile, j, iterationStart);
+      threadIterations++;
     }
-    free(bootstrapData);
+    loopProfileThreadDone(&profile, threadStart, threadIterations);
   }  // end threads
+  loopProfileFinish(&profile);
+  freeBootstrapThreads(threads, threadCount);
 
   // Sort the resulting percentiles
   qsort(bootstrapPercentiles, rounds, sizeof(double), doublecompare);
@@ -566,6 +627,7 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
     assert(relEpsilonEqual(bootstrapPercentiles[0], percentile, ABSEPSILON, RELEPSILON, ULPEPSILON));
     confidenceInterval[0] = percentile;
     confidenceInterval[1] = percentile;
+    untrackAllocation(bootstrapPercentiles);
     free(bootstrapPercentiles);
     if (configVerbose > 0) fprintf(stderr, "Sample %.17g %% Percentile: %.17g, Bootstrap Extremal Values (%zu bootstrap rounds): [ %.17g, %.17g ]\n", p * 100.0, percentile, rounds, confidenceInterval[0], confidenceInterval[1]);
     return percentile;
@@ -581,6 +643,7 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
   if (useExtremalBootstrapValues) {
     confidenceInterval[0] = bootstrapPercentiles[0];
     confidenceInterval[1] = bootstrapPercentiles[rounds - 1];
+    untrackAllocation(bootstrapPercentiles);
     free(bootstrapPercentiles);
     if (configVerbose > 0) fprintf(stderr, "Sample %.17g %% Percentile: %.17g, Bootstrap Extremal Values (%zu bootstrap rounds): [ %.17g, %.17g ]\n", p * 100.0, percentile, rounds, confidenceInterval[0], confidenceInterval[1]);
     return percentile;
@@ -614,8 +677,9 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
 
     if ((JKests = malloc(sizeof(double) * datalen)) == NULL) {
       perror("Can't allocate room for JK estimates.");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
+    trackAllocation(JKests, free);
 
     // Use a jackknife approach to estimate the acceleration factor for the original data
     JKtheta = calculateJackknifePercentileEstimates(p, data, JKests, datalen);
@@ -704,6 +768,7 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
         fprintf(stderr, "Sample %.17g %% Percentile: %.17g, %.17g %% BC Percentile Bootstrap Confidence Interval (%zu bootstrap rounds): [ %.17g, %.17g ]\n", p * 100.0, percentile, 100.0 * alpha, rounds, confidenceInterval[0], confidenceInterval[1]);
       }
     }
+    untrackAllocation(JKests);
     free(JKests);
   } else {
     // The BCa / BC bootstrap parameters aren't valid, so return a percentile bound.
@@ -737,6 +802,7 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
 
   assert(confidenceInterval[0] <= confidenceInterval[1]);
 
+  untrackAllocation(bootstrapPercentiles);
   free(bootstrapPercentiles);
 
   exceptions = fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW);
@@ -755,7 +821,7 @@ double BCaBootstrapPercentile(double p, double *data, size_t datalen, double val
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   return percentile;
@@ -782,6 +848,8 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
   size_t i;
   double *bootstrapMeans;
   double sampleMean;
+  struct bootstrapThread *threads;
+  size_t threadCount;
   struct compensatedState runningAccelNumerator;
   struct compensatedState runningAccelDenominator;
   long double accelNumerator;
@@ -794,6 +862,8 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
   double alpha1;
   double alpha2;
   size_t valuesUnderMean;
+  struct loopProfile profile;
+  struct threadConfig config;
   bool validBias;
   bool validAcceleration;
   bool useExtremalBootstrapValues = false;
@@ -872,30 +942,38 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
 
   if ((bootstrapMeans = malloc(sizeof(double) * rounds)) == NULL) {
     perror("Can't allocate room for bootstrap sample means");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(bootstrapMeans, free);
 
+  threads = initBootstrapThreads(datalen, &threadCount);
+
+  saveThreadConfig(&config);
+  loopProfileInit(&profile, "bootstrap-mean", rounds, true, true);
 #pragma omp parallel
   {
-    struct randstate threadRstate;
-    double *bootstrapData;
+    struct bootstrapThread *thread = &threads[omp_get_thread_num()];
+    double threadStart;
+    size_t threadIterations = 0;
 
-    initGenerator(&threadRstate);
-    seedGenerator(&threadRstate);
+    loadThreadConfig(&config);
 
     // Do the bootstrap sampling
-    if ((bootstrapData = malloc(sizeof(double) * datalen)) == NULL) {
-      perror("Can't allocate room for bootstrap");
-      exit(EX_OSERR);
-    }
-#pragma omp for
+    // The results are sorted below, so the order in which the rounds are run (and by which thread) doesn't matter.
+    threadStart = loopProfileNow();
+#pragma omp for schedule(runtime) nowait
     for (size_t j = 0; j < rounds; j++) {
-      bootstrapSample(data, bootstrapData, datalen, &threadRstate);
-      bootstrapMeans[j] = calculateMean(bootstrapData, datalen);
+      double iterationStart = loopProfileNow();
+      bootstrapSample(data, thread->bootstrapData, datalen, &thread->rstate);
+      bootstrapMeans[j] = calculateMean(thread->bootstrapData, datalen);
       if (configVerbose > 6) fprintf(stderr, "Bootstrap mean: %.17g\n", bootstrapMeans[j]);
+      loopProfileIteration(&profile, j, iterationStart);
+      threadIterations++;
     }
-    free(bootstrapData);
+    loopProfileThreadDone(&profile, threadStart, threadIterations);
   }  // end threads
+  loopProfileFinish(&profile);
+  freeBootstrapThreads(threads, threadCount);
 
   // Sort the resulting means
   qsort(bootstrapMeans, rounds, sizeof(double), doublecompare);
@@ -906,6 +984,7 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
     assert(relEpsilonEqual(bootstrapMeans[0], sampleMean, ABSEPSILON, RELEPSILON, ULPEPSILON));
     confidenceInterval[0] = sampleMean;
     confidenceInterval[1] = sampleMean;
+    untrackAllocation(bootstrapMeans);
     free(bootstrapMeans);
     if (configVerbose > 0) fprintf(stderr, "Sample Mean: %.17g, Bootstrap Extremal Values (%zu bootstrap rounds): [ %.17g, %.17g ]\n", sampleMean, rounds, confidenceInterval[0], confidenceInterval[1]);
     return sampleMean;
@@ -921,6 +1000,7 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
   if (useExtremalBootstrapValues) {
     confidenceInterval[0] = bootstrapMeans[0];
     confidenceInterval[1] = bootstrapMeans[rounds - 1];
+    untrackAllocation(bootstrapMeans);
     free(bootstrapMeans);
     if (configVerbose > 0) fprintf(stderr, "Sample Mean: %.17g, Bootstrap Extremal Values (%zu bootstrap rounds): [ %.17g, %.17g ]\n", sampleMean, rounds, confidenceInterval[0], confidenceInterval[1]);
     return sampleMean;
@@ -953,8 +1033,9 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
 
     if ((JKests = malloc(sizeof(double) * datalen)) == NULL) {
       perror("Can't allocate room for JK estimates.");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
+    trackAllocation(JKests, free);
 
     // Use a jackknife approach to estimate the acceleration factor for the original data
     calculateJackknifeMeanEstimates(data, JKests, datalen);
@@ -1042,6 +1123,7 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
         fprintf(stderr, "Sample Mean: %.17g, %.17g %% BC Mean Bootstrap Confidence Interval (%zu bootstrap rounds): [ %.17g, %.17g ]\n", sampleMean, 100.0 * alpha, rounds, confidenceInterval[0], confidenceInterval[1]);
       }
     }
+    untrackAllocation(JKests);
     free(JKests);
   } else {
     // The BCa / BC bootstrap parameters aren't valid, so return a mean bound.
@@ -1075,6 +1157,7 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
 
   assert(confidenceInterval[0] <= confidenceInterval[1]);
 
+  untrackAllocation(bootstrapMeans);
   free(bootstrapMeans);
 
   exceptions = fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW);
@@ -1093,7 +1176,7 @@ double BCaBootstrapMean(double *data, size_t datalen, double validMin, double va
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   return sampleMean;
@@ -59,7 +59,7 @@ static double PI = 3.14159265358979323846;  // pi, duh!
 static double big = 4.503599627370496e15;
 static double biginv = 2.22044604925031308085e-16;
 
-static int sgngam = 0;
+static _Thread_local int sgngam = 0;
 
 /* A[]: Stirling's formula expansion of log gamma
  * B[], C[]: log gamma function between 2 and 3
@@ -0,0 +1,375 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+#include "binutil.h"
+#include "convert.h"
+#include "divisor.h"
+#include "globals.h"
+
+/*Relabel the symbols as 0, ..., k-1 (in order), using the estimators' linear-time translation (translate.c, built for
+ *32-bit symbols as translateU32).
+ */
+bool u32translate(uint32_t *S, size_t L, size_t *k) {
+  double translatedMedian;
+
+  return translateU32(S, L, k, &translatedMedian);
+}
+
+uint64_t mullerDeltaToNanosecondDelta(uint64_t delta) {
+  // The upper 32 bits of the delta contains the number of seconds since the epoch. We do not (in general) expect this to roll over.
+  // Note: if the time is adjusted between samples, then it may go negative, but these should be discarded, not treated as integer rollovers.
+  const uint64_t secondsPlace = (delta >> 32) * 1000000000UL;
+  const uint64_t nanosecondsPlace = delta & 0xFFFFFFFFUL;
+
+  // Process the lower 32bits (the nanosecond count).
+  // Did the _seconds_ place get borrowed from?
+  // The nanoseconds place should normally be in the range [0, 999999999],
+  // but in the instance where the second count is borrowed from,  the calculation then 2^32 was added (by borrowing from seconds place).
+  // As a consequence, bit 31 (the high order bit in the 32-bit word) signals if borrowing occurred.
+  // If so, the lower bits need to have the (wrong) borrow reversed (the original borrow was 2^32), and the correct one applied (10^9).
+  // This is done without a branch, so that loops over this function can be vectorized.
+  const uint64_t borrowCorrection = (nanosecondsPlace >> 31) * (((uint64_t)0x0100000000UL) - 1000000000UL);
+
+  return secondsPlace + nanosecondsPlace - borrowCorrection;
+}
+
+/*Convert a series of jent deltas to nanosecond deltas (in place).
+ *The byte ordering (native or swapped) that tends to yield the smaller deltas is selected.
+ */
+void jentDeltaToNanoseconds(uint64_t *data, size_t datalen) {
+  size_t nativeSmallerCount = 0;
+  size_t i;
+
+  assert(data != NULL);
+  assert(datalen > 0);
+
+  for (i = 0; i < datalen; i++) {
+    nativeSmallerCount += (mullerDeltaToNanosecondDelta(data[i]) <= mullerDeltaToNanosecondDelta(__builtin_bswap64(data[i])));
+  }
+
+  if (nativeSmallerCount >= (datalen - nativeSmallerCount)) {
+    fprintf(stderr, "Native byte order seems better (%g)\n", (double)nativeSmallerCount / (double)datalen);
+    for (i = 0; i < datalen; i++) {
+      data[i] = mullerDeltaToNanosecondDelta(data[i]);
+    }
+  } else {
+    fprintf(stderr, "Swapped byte order seems better (%g)\n", (double)(datalen - nativeSmallerCount) / (double)datalen);
+    for (i = 0; i < datalen; i++) {
+      data[i] = mullerDeltaToNanosecondDelta(__builtin_bswap64(data[i]));
+    }
+  }
+}
+
+/*Counter decoding is done in two streaming passes over the data. The first (u32CounterScan) gathers everything needed to
+ *decide on the translation (the byte order vote and the delta range), a block at a time. The second (u32CounterDecode)
+ *applies the byte swap, the delta and the rebasing together, again a block at a time. Neither pass needs the whole
+ *data set in memory, and each inner loop is branch free, so the compiler can vectorize it (the byte swaps become shuffles).
+ */
+void initU32CounterStats(struct u32CounterStats *stats) {
+  assert(stats != NULL);
+
+  stats->count = 0;
+  stats->last = 0;
+  stats->incNative = 0;
+  stats->incReversed = 0;
+  stats->minDelta = UINT32_MAX;
+  stats->maxDelta = 0;
+  stats->minSignedDelta = INT64_MAX;
+  stats->maxSignedDelta = INT64_MIN;
+}
+
+static inline void u32CounterScanPair(struct u32CounterStats *stats, uint32_t previous, uint32_t current) {
+  const uint32_t delta = current - previous;
+  const int64_t signedDelta = (int64_t)current - (int64_t)previous;
+
+  stats->incNative += (previous <= current);
+  stats->incReversed += (__builtin_bswap32(previous) <= __builtin_bswap32(current));
+  stats->minDelta = (delta < stats->minDelta) ? delta : stats->minDelta;
+  stats->maxDelta = (delta > stats->maxDelta) ? delta : stats->maxDelta;
+  stats->minSignedDelta = (signedDelta < stats->minSignedDelta) ? signedDelta : stats->minSignedDelta;
+  stats->maxSignedDelta = (signedDelta > stats->maxSignedDelta) ? signedDelta : stats->maxSignedDelta;
+}
+
+void u32CounterScan(struct u32CounterStats *stats, const uint32_t *data, size_t datalen) {
+  assert(stats != NULL);
+  assert((data != NULL) || (datalen == 0));
+
+  if (datalen == 0) return;
+
+  // The first value of this block pairs with the last value of the prior block.
+  if (stats->count > 0) u32CounterScanPair(stats, stats->last, data[0]);
+
+  for (size_t i = 1; i < datalen; i++) {
+    u32CounterScanPair(stats, data[i - 1], data[i]);
+  }
+
+  stats->last = data[datalen - 1];
+  stats->count += datalen;
+}
+
+/*The output is (in order) optionally byte reversed, optionally replaced by the (mod 2^32) difference from the prior value,
+ *and then reduced (mod 2^32) by offset.
+ */
+void initU32CounterDecoder(struct u32CounterDecoder *decoder, bool reverse, bool delta, uint32_t offset) {
+  assert(decoder != NULL);
+
+  decoder->reverse = reverse;
+  decoder->delta = delta;
+  decoder->offset = offset;
+  decoder->previous = 0;
+  decoder->started = false;
+}
+
+/*Decode a block. In delta mode, the first value of the stream produces no output, so this returns the number of outputs
+ *written (datalen, or one fewer for the first block in delta mode). output may be the same as input.
+ */
+size_t u32CounterDecode(struct u32CounterDecoder *decoder, const uint32_t *input, uint32_t *output, size_t datalen) {
+  const uint32_t offset = decoder->offset;
+  uint32_t previous;
+  size_t outlen;
+
+  assert(decoder != NULL);
+  assert((input != NULL) || (datalen == 0));
+  assert((output != NULL) || (datalen == 0));
+
+  if (datalen == 0) return 0;
+
+  if (!decoder->delta) {
+    if (decoder->reverse) {
+      for (size_t i = 0; i < datalen; i++) output[i] = __builtin_bswap32(input[i]) - offset;
+    } else {
+      for (size_t i = 0; i < datalen; i++) output[i] = input[i] - offset;
+    }
+    return datalen;
+  }
+
+  previous = decoder->previous;
+  decoder->previous = decoder->reverse ? __builtin_bswap32(input[datalen - 1]) : input[datalen - 1];
+
+  if (decoder->started) {
+    // Each output only depends on inputs at or after its own index, so this works in place.
+    output[0] = (decoder->reverse ? __builtin_bswap32(input[0]) : input[0]) - previous - offset;
+    outlen = 1;
+  } else {
+    decoder->started = true;
+    outlen = 0;
+  }
+
+  if (decoder->reverse) {
+    for (size_t i = 1; i < datalen; i++) output[outlen + i - 1] = __builtin_bswap32(input[i]) - __builtin_bswap32(input[i - 1]) - offset;
+  } else {
+    for (size_t i = 1; i < datalen; i++) output[outlen + i - 1] = input[i] - input[i - 1] - offset;
+  }
+
+  return outlen + datalen - 1;
+}
+
+/*The offset that translates the (signed) deltas so that the smallest is 0, or exit if the resulting range doesn't fit in 32 bits.*/
+uint32_t u32DeltaTranslateOffset(const struct u32CounterStats *stats) {
+  assert(stats != NULL);
+
+  if (stats->count < 2) {
+    fprintf(stderr, "Too little data\n");
+    exit(EX_DATAERR);
+  }
+
+  fprintf(stderr, "min diff: %" PRId64 ", max diff: %" PRId64 "\n", stats->minSignedDelta, stats->maxSignedDelta);
+  if (stats->maxSignedDelta - stats->minSignedDelta > UINT32_MAX) {
+    fprintf(stderr, "Can't map this to the appropriate range\n");
+    exit(EX_DATAERR);
+  }
+
+  // Everything is in range, so the translation can be done mod 2^32.
+  return (uint32_t)stats->minSignedDelta;
+}
+
+/*Replace the data with the deltas between adjacent values, translated so that the smallest delta is 0.
+ *Returns the new data length (datalen - 1).
+ */
+size_t u32DeltaTranslate(uint32_t *data, size_t datalen) {
+  struct u32CounterStats stats;
+  struct u32CounterDecoder decoder;
+
+  assert(data != NULL);
+
+  initU32CounterStats(&stats);
+  u32CounterScan(&stats, data, datalen);
+  initU32CounterDecoder(&decoder, false, true, u32DeltaTranslateOffset(&stats));
+
+  return u32CounterDecode(&decoder, data, data, datalen);
+}
+
+void initU64CounterStats(struct u64CounterStats *stats, bool trackGCD) {
+  assert(stats != NULL);
+
+  stats->count = 0;
+  stats->last = 0;
+  stats->minDelta = UINT64_MAX;
+  stats->maxDelta = 0;
+  stats->firstDelta = 0;
+  stats->deltaGCD = 0;
+  stats->trackGCD = trackGCD;
+}
+
+void u64CounterScan(struct u64CounterStats *stats, const uint64_t *data, size_t datalen) {
+  uint64_t delta;
+  uint64_t previous;
+  uint64_t difference;
+  size_t i;
+
+  assert(stats != NULL);
+  assert((data != NULL) || (datalen == 0));
+
+  if (datalen == 0) return;
+
+  previous = (stats->count > 0) ? stats->last : data[0];
+  i = (stats->count > 0) ? 0 : 1;
+  if ((stats->count < 2) && (datalen > i)) stats->firstDelta = data[i] - previous;
+
+  for (; i < datalen; i++) {
+    delta = data[i] - previous;
+    previous = data[i];
+    stats->minDelta = (delta < stats->minDelta) ? delta : stats->minDelta;
+    stats->maxDelta = (delta > stats->maxDelta) ? delta : stats->maxDelta;
+
+    /*The GCD of the rebased deltas (delta - minDelta) is the GCD of the differences between the deltas, which
+     *is the GCD of the differences from any one of them. This allows the GCD to be found before minDelta is known.
+     */
+    if (stats->trackGCD && (stats->deltaGCD != 1)) {
+      difference = (delta >= stats->firstDelta) ? (delta - stats->firstDelta) : (stats->firstDelta - delta);
+      stats->deltaGCD = binaryGCD64(stats->deltaGCD, difference);
+    }
+  }
+
+  stats->last = data[datalen - 1];
+  stats->count += datalen;
+}
+
+/*As with the u32 decoder, but without byte reversal. The delta outputs are ((current - previous) - offset) / divisor, where
+ *divisor is known to divide each value exactly.
+ */
+void initU64CounterDecoder(struct u64CounterDecoder *decoder, uint64_t offset, uint64_t divisor) {
+  assert(decoder != NULL);
+  assert(divisor > 0);
+
+  decoder->offset = offset;
+  decoder->divisor = divisor;
+  decoder->previous = 0;
+  decoder->started = false;
+}
+
+size_t u64CounterDecode(struct u64CounterDecoder *decoder, const uint64_t *input, uint64_t *output, size_t datalen) {
+  const uint64_t offset = decoder->offset;
+  uint64_t previous;
+  size_t outlen;
+
+  assert(decoder != NULL);
+  assert((input != NULL) || (datalen == 0));
+  assert((output != NULL) || (datalen == 0));
+
+  if (datalen == 0) return 0;
+
+  previous = decoder->previous;
+  decoder->previous = input[datalen - 1];
+
+  if (decoder->started) {
+    output[0] = input[0] - previous - offset;
+    outlen = 1;
+  } else {
+    decoder->started = true;
+    outlen = 0;
+  }
+
+  for (size_t i = 1; i < datalen; i++) output[outlen + i - 1] = input[i] - input[i - 1] - offset;
+
+  outlen += datalen - 1;
+  u64DivideExactArray(output, outlen, decoder->divisor);
+  return outlen;
+}
+
+/*Replace the data with the XOR of adjacent values. Returns the new data length (datalen - 1).*/
+size_t u32XORDiff(uint32_t *data, size_t datalen) {
+  size_t i;
+
+  assert(data != NULL);
+
+  if (datalen < 2) {
+    fprintf(stderr, "Too little data\n");
+    exit(EX_DATAERR);
+  }
+
+  for (i = 0; i < datalen - 1; i++) {
+    data[i] ^= data[i + 1];
+  }
+
+  return datalen - 1;
+}
+
+/*Group the data by index into modular classes mod rate, with each class occupying a contiguous range.
+ *Only data than can be evenly partitioned into a multiple of rate blocks, each of size blockSize, is retained.
+ *Returns the new data length.
+ */
+size_t u32Downsample(uint32_t *data, size_t datalen, uint32_t rate, size_t blockSize) {
+  uint32_t *outputBuffer;
+  size_t trimLen;
+  size_t conjClass;
+  size_t conjClassSubIndex;
+  size_t conjClassPartitionSize;
+  size_t j;
+
+  assert(data != NULL);
+  assert(rate > 0);
+  assert(blockSize > 0);
+
+  trimLen = datalen % (rate * blockSize);
+  fprintf(stderr, "Trimming %zu samples\n", trimLen);
+  datalen = datalen - trimLen;
+
+  if (datalen == 0) {
+    fprintf(stderr, "Too little data\n");
+    exit(EX_DATAERR);
+  }
+
+  if ((outputBuffer = malloc(datalen * sizeof(uint32_t))) == NULL) {
+    perror("Can't allocate output buffer");
+    exit(EX_OSERR);
+  }
+
+  conjClass = 0;
+  conjClassSubIndex = 0;
+  assert((datalen % rate) == 0);
+  conjClassPartitionSize = datalen / rate;
+
+  for (j = 0; j < datalen; j++) {
+    outputBuffer[conjClass * conjClassPartitionSize + conjClassSubIndex] = data[j];
+    conjClass++;
+    if (conjClass == rate) {
+      conjClass = 0;
+      conjClassSubIndex++;
+    }
+  }
+
+  assert(conjClass == 0);
+  assert((conjClassSubIndex % blockSize) == 0);
+
+  memcpy(data, outputBuffer, datalen * sizeof(uint32_t));
+  free(outputBuffer);
+
+  return datalen;
+}
@@ -0,0 +1,72 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Statistics gathered over a stream of u32 counter values, a block at a time (see u32CounterScan)
+struct u32CounterStats {
+  size_t count;  // values seen
+  uint32_t last;  // the most recent value
+  size_t incNative;  // adjacent pairs that don't decrease in native byte order
+  size_t incReversed;  // adjacent pairs that don't decrease in reversed byte order
+  uint32_t minDelta;  // smallest native order delta (treating the values as counters that roll over)
+  uint32_t maxDelta;  // largest native order delta (treating the values as counters that roll over)
+  int64_t minSignedDelta;  // smallest native order delta (without rollover)
+  int64_t maxSignedDelta;  // largest native order delta (without rollover)
+};
+
+struct u32CounterDecoder {
+  bool reverse;  // byte reverse the inputs
+  bool delta;  // output differences between adjacent values
+  uint32_t offset;  // subtracted from each output
+  uint32_t previous;  // (delta mode) the last value of the prior block, after any reversal
+  bool started;
+};
+
+// Statistics gathered over a stream of u64 counter values, a block at a time (see u64CounterScan)
+struct u64CounterStats {
+  size_t count;  // values seen
+  uint64_t last;  // the most recent value
+  uint64_t minDelta;  // smallest delta (treating the values as counters that roll over)
+  uint64_t maxDelta;  // largest delta (treating the values as counters that roll over)
+  uint64_t firstDelta;
+  uint64_t deltaGCD;  // (if trackGCD) the GCD of the deltas after subtracting minDelta (0 if these are all 0)
+  bool trackGCD;
+};
+
+struct u64CounterDecoder {
+  uint64_t offset;  // subtracted from each delta
+  uint64_t divisor;  // divides each delta (after the offset is subtracted)
+  uint64_t previous;  // the last value of the prior block
+  bool started;
+};
+
+// translate() (see translate.h) for 32-bit symbols.
+bool translateU32(uint32_t *S, size_t L, size_t *k, double *translatedMedian);
+bool u32translate(uint32_t *S, size_t L, size_t *k);
+uint64_t mullerDeltaToNanosecondDelta(uint64_t delta);
+void jentDeltaToNanoseconds(uint64_t *data, size_t datalen);
+void initU32CounterStats(struct u32CounterStats *stats);
+void u32CounterScan(struct u32CounterStats *stats, const uint32_t *data, size_t datalen);
+void initU32CounterDecoder(struct u32CounterDecoder *decoder, bool reverse, bool delta, uint32_t offset);
+size_t u32CounterDecode(struct u32CounterDecoder *decoder, const uint32_t *input, uint32_t *output, size_t datalen);
+uint32_t u32DeltaTranslateOffset(const struct u32CounterStats *stats);
+size_t u32DeltaTranslate(uint32_t *data, size_t datalen);
+void initU64CounterStats(struct u64CounterStats *stats, bool trackGCD);
+void u64CounterScan(struct u64CounterStats *stats, const uint64_t *data, size_t datalen);
+void initU64CounterDecoder(struct u64CounterDecoder *decoder, uint64_t offset, uint64_t divisor);
+size_t u64CounterDecode(struct u64CounterDecoder *decoder, const uint64_t *input, uint64_t *output, size_t datalen);
+size_t u32XORDiff(uint32_t *data, size_t datalen);
+size_t u32Downsample(uint32_t *data, size_t datalen, uint32_t rate, size_t blockSize);
+#endif
@@ -8,6 +8,7 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,7 +18,9 @@
 #include <stdnoreturn.h>
 #include <string.h>
 #include <sysexits.h>
+#include "blockio.h"
 #include "precision.h"
+#include "textio.h"
 
 /*
 noreturn static void useageExit(void) {
@@ -29,18 +32,36 @@ noreturn static void useageExit(void) {
 */
 
 int main(void) {
-  int res;
-  uint64_t indata;
+  uint64_t inInt;
+  char *curline;
+  char *curloc;
+  char *afterInt;
+  struct textReader reader;
+  struct blockWriter writer;
 
-  while (feof(stdin) == 0) {
-    res = scanf("%" SCNu64 "\n", &indata);
-    if (res == 1) {
-      if (fwrite(&indata, sizeof(uint64_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
+  initTextReader(&reader, stdin);
+  initBlockWriter(&writer, stdout, sizeof(uint64_t));
+
+  while ((curline = readTextLine(&reader, NULL)) != NULL) {
+    // Values are separated by white space; blank lines are ignored.
+    curloc = curline;
+    for (;;) {
+      while ((*curloc == ' ') || (*curloc == '\t') || (*curloc == '\r')) curloc++;
+      if (*curloc == '\0') break;
+
+      errno = 0;
+      inInt = textToUint64(curloc, &afterInt, 10);
+      if ((*curloc == '-') || (afterInt == curloc) || (errno == ERANGE) || ((*afterInt != ' ') && (*afterInt != '\t') && (*afterInt != '\r') && (*afterInt != '\0'))) {
+        fprintf(stderr, "data error on line %zu\n", reader.lineNumber);
+        exit(EX_DATAERR);
       }
+      writeElement(&writer, &inInt);
+      curloc = afterInt;
     }
   }
 
+  freeBlockWriter(&writer);
+  freeTextReader(&reader);
+
   return (0);
 }
@@ -19,6 +19,7 @@
 
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -36,9 +37,9 @@ int main(int argc, char *argv[]) {
   statData_t *data = NULL;
   uint32_t *u32data = NULL;
   uint32_t bitmask;
-  statData_t maxval, minval;
   uint32_t bits;
   double doubleBits;
+  struct bitStatistics stats;
 
   configVerbose = 2;
 
@@ -66,34 +67,22 @@ int main(int argc, char *argv[]) {
     exit(EX_OSERR);
   }
 
-  maxval = 0;
-  minval = STATDATA_MAX;
-
   for (size_t i = 0; i < datalen; i++) {
-    if (data[i] > maxval) {
-      maxval = data[i];
-    }
-    if (data[i] < minval) {
-      minval = data[i];
-    }
     u32data[i] = data[i];
   }
 
-  doubleBits = ceil(log2((double)maxval + 1.0));
+  getBitStatistics(&stats, u32data, datalen, 1);
+
+  doubleBits = ceil(log2((double)stats.maxValue + 1.0));
   assert(doubleBits >= 0.0);
   bits = (statData_t)doubleBits;
 
-  bitmask = getActiveBits(u32data, datalen);
+  bitmask = activeBitsFromStatistics(&stats);
 
-  fprintf(stderr, "Symbols in the range [%u, %u], %u bit, bitmask: 0x%08X\n", minval, maxval, bits, bitmask);
+  fprintf(stderr, "Symbols in the range [%u, %u], %u bit, bitmask: 0x%08X\n", stats.minValue, stats.maxValue, bits, bitmask);
 
   fprintf(stderr, "Outputting data\n");
-  for (size_t i = 0; i < datalen; i++) {
-    uint32_t out;
-    out = extractbits(u32data[i], bitmask);
-    assert(out <= STATDATA_MAX);
-    data[i] = (statData_t)out;
-  }
+  extractbitsArray(u32data, data, datalen, bitmask);
 
   if (fwrite(data, sizeof(statData_t), datalen, stdout) != datalen) {
     perror("Can't write output to stdout");
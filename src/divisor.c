@@ -0,0 +1,239 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "divisor.h"
+
+// Values are reduced in chunks of this size, which are distributed across threads.
+#define DIVISORCHUNK 65536
+
+// Stein's binary GCD. Note that gcd(a, 0) = a.
+uint32_t binaryGCD32(uint32_t a, uint32_t b) {
+  int shift;
+  uint32_t c;
+
+  if (a == 0) return b;
+  if (b == 0) return a;
+
+  shift = __builtin_ctz(a | b);
+  a >>= __builtin_ctz(a);
+
+  do {
+    b >>= __builtin_ctz(b);
+    if (a > b) {
+      c = a;
+      a = b;
+      b = c;
+    }
+    b -= a;
+  } while (b != 0);
+
+  return a << shift;
+}
+
+uint64_t binaryGCD64(uint64_t a, uint64_t b) {
+  int shift;
+  uint64_t c;
+
+  if (a == 0) return b;
+  if (b == 0) return a;
+
+  shift = __builtin_ctzll(a | b);
+  a >>= __builtin_ctzll(a);
+
+  do {
+    b >>= __builtin_ctzll(b);
+    if (a > b) {
+      c = a;
+      a = b;
+      b = c;
+    }
+    b -= a;
+  } while (b != 0);
+
+  return a << shift;
+}
+
+/*The GCD of all the values (0 if all the values are 0).
+ *The GCD is associative, so each thread reduces its chunks separately. Once any chunk reduces to 1, the
+ *result must be 1, so the remaining chunks are skipped.
+ */
+uint32_t u32ArrayGCD(const uint32_t *data, size_t datalen) {
+  uint32_t result;
+  size_t chunkCount;
+  bool done;
+
+  assert((data != NULL) || (datalen == 0));
+
+  result = 0;
+  done = false;
+  chunkCount = (datalen + DIVISORCHUNK - 1) / DIVISORCHUNK;
+
+#pragma omp parallel
+  {
+    uint32_t localGCD = 0;
+
+#pragma omp for schedule(dynamic)
+    for (size_t c = 0; c < chunkCount; c++) {
+      bool curDone;
+      size_t end = ((c + 1) * DIVISORCHUNK < datalen) ? (c + 1) * DIVISORCHUNK : datalen;
+
+#pragma omp atomic read
+      curDone = done;
+
+      for (size_t i = c * DIVISORCHUNK; (i < end) && !curDone && (localGCD != 1); i++) {
+        localGCD = binaryGCD32(localGCD, data[i]);
+      }
+
+      if (localGCD == 1) {
+#pragma omp atomic write
+        done = true;
+      }
+    }
+
+#pragma omp critical(arrayGCDUpdate)
+    result = binaryGCD32(result, localGCD);
+  }
+
+  return done ? 1 : result;
+}
+
+uint64_t u64ArrayGCD(const uint64_t *data, size_t datalen) {
+  uint64_t result;
+  size_t chunkCount;
+  bool done;
+
+  assert((data != NULL) || (datalen == 0));
+
+  result = 0;
+  done = false;
+  chunkCount = (datalen + DIVISORCHUNK - 1) / DIVISORCHUNK;
+
+#pragma omp parallel
+  {
+    uint64_t localGCD = 0;
+
+#pragma omp for schedule(dynamic)
+    for (size_t c = 0; c < chunkCount; c++) {
+      bool curDone;
+      size_t end = ((c + 1) * DIVISORCHUNK < datalen) ? (c + 1) * DIVISORCHUNK : datalen;
+
+#pragma omp atomic read
+      curDone = done;
+
+      for (size_t i = c * DIVISORCHUNK; (i < end) && !curDone && (localGCD != 1); i++) {
+        localGCD = binaryGCD64(localGCD, data[i]);
+      }
+
+      if (localGCD == 1) {
+#pragma omp atomic write
+        done = true;
+      }
+    }
+
+#pragma omp critical(arrayGCDUpdate)
+    result = binaryGCD64(result, localGCD);
+  }
+
+  return done ? 1 : result;
+}
+
+// gcds[i] = gcd(data[i], data[i+1]) for i in [0, datalen-2]
+void u32PairwiseGCD(const uint32_t *data, uint32_t *gcds, size_t datalen) {
+  assert(data != NULL);
+  assert(gcds != NULL);
+
+#pragma omp parallel for
+  for (size_t i = 1; i < datalen; i++) {
+    gcds[i - 1] = binaryGCD32(data[i - 1], data[i]);
+  }
+}
+
+/*Replace each value with floor(value / divisor).
+ *This uses a precomputed multiplier rather than a division: for 32-bit n and d > 1, with M = floor((2^64 - 1) / d) + 1,
+ *floor(n / d) = floor(M * n / 2^64). See Lemire, Kaser and Kurz, "Faster Remainder by Direct Computation" (2019).
+ */
+void u32DivideArray(uint32_t *data, size_t datalen, uint32_t divisor) {
+  uint64_t multiplier;
+
+  assert((data != NULL) || (datalen == 0));
+  assert(divisor > 0);
+
+  if (divisor == 1) return;
+
+  multiplier = UINT64_MAX / divisor + 1;
+
+#pragma omp parallel for
+  for (size_t i = 0; i < datalen; i++) {
+    data[i] = (uint32_t)(((unsigned __int128)multiplier * data[i]) >> 64);
+  }
+}
+
+/*Replace each value with value / divisor, where divisor is known to divide every value exactly.
+ *With divisor = 2^s * q for odd q, value / divisor = (value >> s) * q^{-1} (mod 2^32). See Hacker's Delight, 2nd Edition, Section 10-16.
+ *This is only a shift and a 32-bit multiply, so the compiler can vectorize it.
+ */
+void u32DivideExactArray(uint32_t *data, size_t datalen, uint32_t divisor) {
+  uint32_t inverse;
+  uint32_t odd;
+  int shift;
+
+  assert((data != NULL) || (datalen == 0));
+  assert(divisor > 0);
+
+  if (divisor == 1) return;
+
+  shift = __builtin_ctz(divisor);
+  odd = divisor >> shift;
+
+  // Newton's method; each step doubles the number of correct low-order bits (odd * odd = 1 mod 8, so we start with 3 bits).
+  inverse = odd;
+  for (int i = 0; i < 4; i++) {
+    inverse *= 2 - odd * inverse;
+  }
+  assert(odd * inverse == 1);
+
+#pragma omp parallel for
+  for (size_t i = 0; i < datalen; i++) {
+    data[i] = (data[i] >> shift) * inverse;
+  }
+}
+
+/*Replace each value with value / divisor, where divisor is known to divide every value exactly.
+ *As with u32DivideExactArray, this is a shift and a multiply by the inverse of the odd part of the divisor (mod 2^64).
+ */
+void u64DivideExactArray(uint64_t *data, size_t datalen, uint64_t divisor) {
+  uint64_t inverse;
+  uint64_t odd;
+  int shift;
+
+  assert((data != NULL) || (datalen == 0));
+  assert(divisor > 0);
+
+  if (divisor == 1) return;
+
+  shift = __builtin_ctzll(divisor);
+  odd = divisor >> shift;
+
+  // Newton's method; each step doubles the number of correct low-order bits (odd * odd = 1 mod 8, so we start with 3 bits).
+  inverse = odd;
+  for (int i = 0; i < 5; i++) {
+    inverse *= 2 - odd * inverse;
+  }
+  assert(odd * inverse == 1);
+
+#pragma omp parallel for
+  for (size_t i = 0; i < datalen; i++) {
+    data[i] = (data[i] >> shift) * inverse;
+  }
+}
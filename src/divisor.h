@@ -0,0 +1,24 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef DIVISOR_H
+#define DIVISOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t binaryGCD32(uint32_t a, uint32_t b);
+uint64_t binaryGCD64(uint64_t a, uint64_t b);
+uint32_t u32ArrayGCD(const uint32_t *data, size_t datalen);
+uint64_t u64ArrayGCD(const uint64_t *data, size_t datalen);
+void u32PairwiseGCD(const uint32_t *data, uint32_t *gcds, size_t datalen);
+void u32DivideArray(uint32_t *data, size_t datalen, uint32_t divisor);
+void u32DivideExactArray(uint32_t *data, size_t datalen, uint32_t divisor);
+void u64DivideExactArray(uint64_t *data, size_t datalen, uint64_t divisor);
+#endif
@@ -87,12 +87,8 @@ int main(int argc, char *argv[]) {
   qsort(data, datalen, sizeof(double), doublecompare);
 
   fprintf(stderr, "Writing the data.\n");
-  while ((datalen > 0) && (ferror(stdout) != 0)) {
-    size_t written;
-
-    written = fwrite(data, sizeof(double), datalen, stdout);
-    data += written;
-    datalen -= written;
+  for (size_t start = 0; (start < datalen) && (ferror(stdout) == 0);) {
+    start += fwrite(data + start, sizeof(double), datalen - start, stdout);
   }
 
   if (ferror(stdout) != 0) {
@@ -0,0 +1,381 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fenv.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+#include "entlib.h"
+#include "globals-inst.h"
+#include "precision.h"
+#include "randlib.h"
+#include "translate.h"
+
+/*Times the entlib estimator kernels on deterministic synthetic data, and reports the results as tab-separated values
+ *(one line per data set and estimator) so that reports from different builds can be compared directly.
+ */
+
+enum benchModel { iidModel, biasedModel, markovModel, roModel };
+static const char *const modelNames[] = {"iid", "biased", "markov", "ro"};
+
+// Each kernel runs on data with symbols in [0, k), and returns an entropy (or, for translate, the number of symbols found).
+typedef double (*benchKernel)(statData_t *data, size_t L, size_t k);
+
+struct benchEstimator {
+  const char *name;
+  benchKernel kernel;
+  bool binaryOnly;  // only applies to data with k = 2
+  bool modifiesData;  // the data is restored before each run
+  size_t minLength;  // the fewest samples the estimator can assess (see entlib.h)
+  bool needsRepeat;  // some symbol must repeat, so there must be more than k samples
+};
+
+static double benchMCV(statData_t *data, size_t L, size_t k) {
+  struct MCVresult result;
+  return mostCommonValueEstimate(data, L, k, &result);
+}
+
+static double benchCollision(statData_t *data, size_t L, size_t k) {
+  struct colsResult result;
+  (void)k;
+  return collisionEstimate(data, L, &result);
+}
+
+static double benchMarkov(statData_t *data, size_t L, size_t k) {
+  struct markovResult result;
+  (void)k;
+  return markovEstimate(data, L, &result);
+}
+
+static double benchCompression(statData_t *data, size_t L, size_t k) {
+  struct compResult result;
+  (void)k;
+  return compressionEstimate(data, L, &result);
+}
+
+static double benchSA(statData_t *data, size_t L, size_t k) {
+  struct SAresult result;
+  SAalgs(data, L, k, &result);
+  return fmin(result.tTupleEntropy, result.lrsEntropy);
+}
+
+static double benchMultiMCW(statData_t *data, size_t L, size_t k) {
+  struct predictorResult result;
+  return multiMCWPredictionEstimate(data, L, k, &result);
+}
+
+static double benchLag(statData_t *data, size_t L, size_t k) {
+  struct predictorResult result;
+  return lagPredictionEstimate(data, L, k, &result);
+}
+
+static double benchMultiMMC(statData_t *data, size_t L, size_t k) {
+  struct predictorResult result;
+  return treeMultiMMCPredictionEstimate(data, L, k, &result);
+}
+
+static double benchLZ78Y(statData_t *data, size_t L, size_t k) {
+  struct predictorResult result;
+  return treeLZ78YPredictionEstimate(data, L, k, &result);
+}
+
+static double benchNSAMarkov(statData_t *data, size_t L, size_t k) {
+  return NSAMarkovEstimate(data, L, k, "Literal", false, 0.0);
+}
+
+static double benchTranslate(statData_t *data, size_t L, size_t k) {
+  size_t foundk = 0;
+  double median;
+
+  (void)k;
+  translate(data, L, &foundk, &median);
+  return (double)foundk;
+}
+
+static const struct benchEstimator estimators[] = {
+    {"translate", benchTranslate, false, true, 1, false},
+    {"mcv", benchMCV, false, false, MCVESTIMATEMINLEN, false},
+    {"collision", benchCollision, true, false, COLSESTIMATEMINLEN, false},
+    {"markov", benchMarkov, true, false, MARKOVESTIMATEMINLEN, false},
+    {"compression", benchCompression, true, false, COMPESTIMATEMINLEN, false},
+    {"sa", benchSA, false, false, SAESTIMATEMINLEN, true},
+    {"multimcw", benchMultiMCW, false, false, MCWESTIMATEMINLEN, false},
+    {"lag", benchLag, false, false, LAGESTIMATEMINLEN, false},
+    {"multimmc", benchMultiMMC, false, false, TREEMMCESTIMATEMINLEN, false},
+    {"lz78y", benchLZ78Y, false, false, TREELZ78YESTIMATEMINLEN, false},
+    {"nsamarkov", benchNSAMarkov, false, false, 1, false},
+};
+
+noreturn static void useageExit(void) {
+  fprintf(stderr, "Usage:\n");
+  fprintf(stderr, "entlib-bench [-q] [-r <reps>] [-w <warmups>] [-L <samples>] [-e <estimator>]\n");
+  fprintf(stderr, "Times the entropy estimators on deterministic IID, biased, Markov and ring oscillator data.\n");
+  fprintf(stderr, "-q\tQuick mode: use smaller data sets.\n");
+  fprintf(stderr, "-r <reps>\tTimed runs of each estimator (default 5).\n");
+  fprintf(stderr, "-w <warmups>\tUntimed runs of each estimator before the timed runs (default 1).\n");
+  fprintf(stderr, "-L <samples>\tUse only data sets of this many samples. Estimators that need more data are reported as skipped.\n");
+  fprintf(stderr, "-e <estimator>\tOnly time this estimator.\n");
+  fprintf(stderr, "The report is sent to stdout as tab-separated values.\n");
+  exit(EX_USAGE);
+}
+
+/*Generate L samples with symbols in [0, k) from the selected model.
+ *The generator is seeded deterministically for each data set, so the data depends only on (model, L, k).
+ */
+static void generateData(enum benchModel model, statData_t *data, size_t L, size_t k) {
+  struct randstate rstate;
+  uint32_t bits;
+
+  assert((k >= 2) && (k - 1 <= STATDATA_MAX));
+
+  initGenerator(&rstate);
+  rstate.deterministic = true;
+  seedGenerator(&rstate);
+
+  switch (model) {
+    case iidModel:
+      genRandInts(data, L, (uint32_t)(k - 1), &rstate);
+      break;
+    case biasedModel:
+      // The most likely symbol has probability 0.75 (k is a power of 2).
+      bits = (uint32_t)__builtin_ctzll((unsigned long long)k);
+      assert(((size_t)1 << bits) == k);
+      for (size_t i = 0; i < L; i++) data[i] = (statData_t)genRandBiasedInt(bits, 0.75, &rstate);
+      break;
+    case markovModel:
+      // Each sample repeats the previous one with probability 0.75, and is otherwise uniform.
+      data[0] = (statData_t)randomRange((uint32_t)(k - 1), &rstate);
+      for (size_t i = 1; i < L; i++) {
+        data[i] = (randomUnit(&rstate) < 0.75) ? data[i - 1] : (statData_t)randomRange((uint32_t)(k - 1), &rstate);
+      }
+      break;
+    case roModel: {
+      // The reference ring oscillator design in non-iid-main: 1 GHz, sampled near 1 MHz, with 1% jitter.
+      double oscFreq = 1000000000.0;
+      double oscJitter = (1.0 / oscFreq) * 0.01;
+      double oscPhase = randomUnit(&rstate);
+      double samplePhase = 0.0;
+
+      assert(k == 2);
+      for (size_t i = 0; i < L; i++) data[i] = ringOscillatorNextNonDeterministicSample(oscFreq, oscJitter, &oscPhase, oscFreq / 1000.1, &samplePhase, &rstate);
+      break;
+    }
+    default:
+      assert(false);
+  }
+}
+
+static double elapsed(const struct timespec *start, const struct timespec *end) {
+  return ((double)end->tv_sec - (double)start->tv_sec) + ((double)end->tv_nsec - (double)start->tv_nsec) * 1.0e-9;
+}
+
+static int doublecompare(const void *in1, const void *in2) {
+  const double *left = in1;
+  const double *right = in2;
+
+  if (*left < *right) {
+    return -1;
+  } else if (*left > *right) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+/*Run the estimator once. Returns false if it ended with a fatal error (as the prediction estimators can on short,
+ *highly predictable data), which is caught here so that the remaining estimators are still timed.
+ */
+static bool runKernel(const struct benchEstimator *est, statData_t *data, size_t L, size_t k, double *result) {
+  jmp_buf fatalJump;
+  size_t scratchBytes = globalScratchBytes;
+
+  globalFatalJump = &fatalJump;
+  if (setjmp(fatalJump) != 0) {
+    globalFatalJump = NULL;
+    globalScratchBytes = scratchBytes;
+    feclearexcept(FE_ALL_EXCEPT);
+    return false;
+  }
+
+  *result = est->kernel(data, L, k);
+  globalFatalJump = NULL;
+  return true;
+}
+
+static void benchDataset(enum benchModel model, size_t L, size_t k, size_t reps, size_t warmups, const char *onlyEstimator, statData_t *original, statData_t *scratch, double *times) {
+  generateData(model, original, L, k);
+
+  for (size_t e = 0; e < sizeof(estimators) / sizeof(estimators[0]); e++) {
+    const struct benchEstimator *est = estimators + e;
+    double result = 0.0;
+    double total = 0.0;
+    double median;
+    bool failed = false;
+
+    if ((onlyEstimator != NULL) && (strcmp(onlyEstimator, est->name) != 0)) continue;
+    if (est->binaryOnly && (k != 2)) continue;
+
+    // Too little data would stop the program; the skipped estimator is reported with no times.
+    if ((L < est->minLength) || (est->needsRepeat && (L <= k))) {
+      printf("%s\t%zu\t%zu\t%s\t0\tNA\tNA\tNA\tskipped\n", modelNames[model], L, k, est->name);
+      fflush(stdout);
+      continue;
+    }
+
+    memcpy(scratch, original, L * sizeof(statData_t));
+
+    for (size_t i = 0; i < warmups + reps; i++) {
+      struct timespec start, end;
+
+      if (est->modifiesData && (i > 0)) memcpy(scratch, original, L * sizeof(statData_t));
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      failed = !runKernel(est, scratch, L, k, &result);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      if (failed) break;
+
+      if (i >= warmups) times[i - warmups] = elapsed(&start, &end);
+    }
+
+    if (failed) {
+      printf("%s\t%zu\t%zu\t%s\t0\tNA\tNA\tNA\tfailed\n", modelNames[model], L, k, est->name);
+      fflush(stdout);
+      continue;
+    }
+
+    qsort(times, reps, sizeof(double), doublecompare);
+    for (size_t i = 0; i < reps; i++) total += times[i];
+    median = ((reps % 2) == 1) ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2.0;
+
+    printf("%s\t%zu\t%zu\t%s\t%zu\t%.9f\t%.9f\t%.9f\t%.17g\n", modelNames[model], L, k, est->name, reps, times[0], median, total / (double)reps, result);
+    fflush(stdout);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const size_t fullLengths[] = {100000, 1000000};
+  const size_t quickLengths[] = {10000, 100000};
+  const size_t alphabetSizes[] = {2, 16, 256};
+  const size_t *lengths;
+  size_t lengthCount;
+  size_t configReps;
+  size_t configWarmups;
+  size_t configLength;
+  const char *configEstimator;
+  statData_t *original;
+  statData_t *scratch;
+  double *times;
+  size_t maxLength;
+  unsigned long long inint;
+  char *nextOption;
+  int opt;
+
+  configVerbose = 0;
+  configReps = 5;
+  configWarmups = 1;
+  configLength = 0;
+  configEstimator = NULL;
+  lengths = fullLengths;
+  lengthCount = sizeof(fullLengths) / sizeof(fullLengths[0]);
+
+  while ((opt = getopt(argc, argv, "qr:w:L:e:")) != -1) {
+    switch (opt) {
+      case 'q':
+        lengths = quickLengths;
+        lengthCount = sizeof(quickLengths) / sizeof(quickLengths[0]);
+        break;
+      case 'r':
+        inint = strtoull(optarg, &nextOption, 0);
+        if ((inint == 0) || (inint > 1000000) || (errno == EINVAL) || (*nextOption != '\0')) {
+          useageExit();
+        }
+        configReps = (size_t)inint;
+        break;
+      case 'w':
+        inint = strtoull(optarg, &nextOption, 0);
+        if ((inint > 1000000) || (errno == EINVAL) || (*nextOption != '\0')) {
+          useageExit();
+        }
+        configWarmups = (size_t)inint;
+        break;
+      case 'L':
+        inint = strtoull(optarg, &nextOption, 0);
+        if ((inint < 2) || (inint > SIZE_MAX / 2) || (errno == EINVAL) || (*nextOption != '\0')) {
+          useageExit();
+        }
+        configLength = (size_t)inint;
+        break;
+      case 'e':
+        configEstimator = optarg;
+        break;
+      default: /* ? */
+        useageExit();
+    }
+  }
+
+  if (optind != argc) {
+    useageExit();
+  }
+
+  if (configLength > 0) {
+    lengths = &configLength;
+    lengthCount = 1;
+  }
+
+  if (configEstimator != NULL) {
+    bool found = false;
+    for (size_t e = 0; e < sizeof(estimators) / sizeof(estimators[0]); e++) {
+      if (strcmp(configEstimator, estimators[e].name) == 0) found = true;
+    }
+    if (!found) useageExit();
+  }
+
+  maxLength = 0;
+  for (size_t i = 0; i < lengthCount; i++) {
+    if (lengths[i] > maxLength) maxLength = lengths[i];
+  }
+
+  if (((original = malloc(maxLength * sizeof(statData_t))) == NULL) || ((scratch = malloc(maxLength * sizeof(statData_t))) == NULL) || ((times = malloc(configReps * sizeof(double))) == NULL)) {
+    perror("Can't allocate benchmark buffers");
+    exit(EX_OSERR);
+  }
+
+  printf("model\tL\tk\testimator\treps\tmin_s\tmedian_s\tmean_s\tresult\n");
+
+  for (size_t i = 0; i < lengthCount; i++) {
+    for (size_t j = 0; j < sizeof(alphabetSizes) / sizeof(alphabetSizes[0]); j++) {
+      size_t k = alphabetSizes[j];
+
+      if (k - 1 > STATDATA_MAX) continue;
+
+      benchDataset(iidModel, lengths[i], k, configReps, configWarmups, configEstimator, original, scratch, times);
+      benchDataset(biasedModel, lengths[i], k, configReps, configWarmups, configEstimator, original, scratch, times);
+      benchDataset(markovModel, lengths[i], k, configReps, configWarmups, configEstimator, original, scratch, times);
+      if (k == 2) benchDataset(roModel, lengths[i], k, configReps, configWarmups, configEstimator, original, scratch, times);
+    }
+  }
+
+  free(original);
+  free(scratch);
+  free(times);
+  return EX_OK;
+}
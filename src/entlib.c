@@ -26,6 +26,7 @@
 #include "hashmodulus.h"
 #include "precision.h"
 #include "sa.h"
+#include "telemetry.h"
 
 void initEntropyTestingResult(const char *label, struct entropyTestingResult *result) {
   assert(label != NULL);
@@ -240,7 +241,7 @@ double shannonEntropyEstimate(const statData_t *S, size_t L, size_t k) {
 #if STATDATA_BITS > 8
   if ((count = calloc(k, sizeof(size_t))) == NULL) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 #else
   assert(k <= 256);
@@ -288,7 +289,7 @@ double mostCommonValueEstimate(const statData_t *S, size_t L, size_t k, struct M
 #if STATDATA_BITS > 8
   if ((count = calloc(k, sizeof(size_t))) == NULL) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 #else
   assert(k <= 256);
@@ -434,7 +435,7 @@ double collisionEstimate(const statData_t *S, size_t L, struct colsResult *resul
       fprintf(stderr, "Underflow ");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   result->done = true;
@@ -577,7 +578,7 @@ double markovEstimate(const statData_t *S, size_t L, struct markovResult *result
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   result->done = true;
@@ -696,7 +697,7 @@ static double compG(double z, size_t blockCount, size_t d) {
       fprintf(stderr, "Divided by 0 ");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   exceptions = fetestexcept(FE_OVERFLOW | FE_UNDERFLOW);
@@ -782,13 +783,16 @@ static void maurerStats(const statData_t *S, size_t L, size_t b, size_t d, doubl
   // Allocate and zero
   if ((dict = calloc(k, sizeof(size_t))) == NULL) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(dict, free);
 
   if ((D = calloc(v, sizeof(size_t))) == NULL) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(D, free);
+  scratchAllocated((k + v) * sizeof(size_t));
 
   for (j = 0; j < d; j++) {
     curdata = maurerAccess(S, d - j - 1, b);
@@ -822,10 +826,13 @@ static void maurerStats(const statData_t *S, size_t L, size_t b, size_t d, doubl
   delCompensatedSum(&maurerSumOfSquares);
   delCompensatedSum(&maurerSum);
 
+  untrackAllocation(D);
   free(D);
   D = NULL;
+  untrackAllocation(dict);
   free(dict);
   dict = NULL;
+  scratchFreed((k + v) * sizeof(size_t));
 
   c = 0.5907;
 
@@ -930,7 +937,7 @@ double compressionEstimate(const statData_t *S, size_t L, struct compResult *res
       fprintf(stderr, "Underflow ");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   result->done = true;
@@ -959,6 +966,7 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
   long double pu;
   uint64_t *S;  // Each value 0 <= S[i] < n^3
   int exceptions;
+  size_t scratchBytes;  // SA, LCP, Q, A and I
 
   assert(n > 0);
   assert(k > 0);
@@ -980,14 +988,17 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
   /*First, allocate the necessary structures*/
   if((SA = (saidx_t *)malloc((n + 1) * sizeof(saidx_t)))==NULL) {
     perror("Cannot allocate memory for SA array.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(SA, free);
 
   if((LCP = (saidx_t *)malloc((n + 2) * sizeof(saidx_t)))==NULL) {
-    free(SA);
     perror("Cannot allocate memory for LCP array.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(LCP, free);
+  scratchBytes = (2 * n + 3) * sizeof(saidx_t);
+  scratchAllocated(scratchBytes);
 
   if (configVerbose > 3) {
     fprintf(stderr, "Calculate SA/LCP, size: %zu, symbols: %zu\n", n, k);
@@ -1035,31 +1046,27 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
   }
 
   if((Q=malloc(((size_t)v + 1) * sizeof(saidx_t)))==NULL) {
-    free(SA);
-    free(LCP);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(Q, free);
 
   if((A = calloc((size_t)v + 2, sizeof(saidx_t)))==NULL) {
-    free(SA);
-    free(LCP);
-    free(Q);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(A, free);
 
   // j takes the value 0 to v+1
   // Note that I is indexed by at most j+1. (so I[v+2] should work)
   // I stores indices of A, and there are only v+2 of these
   if((I = calloc((size_t)v + 3, sizeof(saidx_t)))==NULL) {
-    free(SA);
-    free(LCP);
-    free(Q);
-    free(A);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(I, free);
+  scratchAllocated(3 * ((size_t)v + 2) * sizeof(saidx_t));
+  scratchBytes += 3 * ((size_t)v + 2) * sizeof(saidx_t);
 
   for (j = 0; j <= v; j++) Q[j] = 1;
 
@@ -1178,11 +1185,17 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
 
   if (v < u) {
     fprintf(stderr, "v < u, so we skip the lrs test.\n");
+    untrackAllocation(SA);
     free(SA);
+    untrackAllocation(LCP);
     free(LCP);
+    untrackAllocation(Q);
     free(Q);
+    untrackAllocation(A);
     free(A);
+    untrackAllocation(I);
     free(I);
+    scratchFreed(scratchBytes);
     result->lrsEntropy = -1.0;
     result->lrsPmax = -1.0;
     result->lrsPu = -1.0;
@@ -1193,8 +1206,10 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
 
   if ((S = calloc((size_t)(v + 1), sizeof(uint64_t))) == NULL) {
     perror("Cannot allocate memory to sum P_W.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(S, free);
+  scratchAllocated((size_t)(v + 1) * sizeof(uint64_t));
   memset(A, 0, sizeof(saidx_t) * ((size_t)v + 2));
 
   // O(nv) operations
@@ -1266,18 +1281,25 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
   result->lrsEntropy = (double)-log2l(pu);
   result->lrsDone = true;
 
+  untrackAllocation(S);
   free(S);
   S = NULL;
+  untrackAllocation(I);
   free(I);
   I = NULL;
+  untrackAllocation(SA);
   free(SA);
   SA = NULL;
+  untrackAllocation(LCP);
   free(LCP);
   L = NULL;
+  untrackAllocation(Q);
   free(Q);
   Q = NULL;
+  untrackAllocation(A);
   free(A);
   A = NULL;
+  scratchFreed(scratchBytes + (size_t)(v + 1) * sizeof(uint64_t));
 
   exceptions = fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW);
   if (exceptions != 0) {
@@ -1295,7 +1317,7 @@ static void SAalgs32(const statData_t *data, size_t n, size_t k, struct SAresult
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   return;
@@ -1318,6 +1340,7 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
   long double pu;
   uint128_t *S=NULL;  // Each value 0 <= S[i] < n^3
   int exceptions;
+  size_t scratchBytes;  // SA, LCP, Q, A and I
 
   assert(n > 0);
   assert(k > 0);
@@ -1339,14 +1362,17 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
   /*First, allocate the necessary structures*/
   if((SA = (saidx64_t *)malloc((n + 1) * sizeof(saidx64_t)))==NULL) {
     perror("Cannot allocate memory for SA array.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(SA, free);
 
   if((LCP = (saidx64_t *)malloc((n + 2) * sizeof(saidx64_t)))==NULL) {
-    free(SA);
     perror("Cannot allocate memory for LCP array.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(LCP, free);
+  scratchBytes = (2 * n + 3) * sizeof(saidx64_t);
+  scratchAllocated(scratchBytes);
 
   if (configVerbose > 3) {
     fprintf(stderr, "Calculate SA/LCP, size: %zu, symbols: %zu\n", n, k);
@@ -1394,31 +1420,27 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
   }
 
   if((Q=malloc(((size_t)v + 1) * sizeof(saidx64_t)))==NULL) {
-    free(SA);
-    free(LCP);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(Q, free);
 
   if((A = calloc((size_t)v + 2, sizeof(saidx64_t)))==NULL) {
-    free(SA);
-    free(LCP);
-    free(Q);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(A, free);
 
   // j takes the value 0 to v+1
   // Note that I is indexed by at most j+1. (so I[v+2] should work)
   // I stores indices of A, and there are only v+2 of these
   if((I = calloc((size_t)v + 3, sizeof(saidx64_t)))==NULL) {
-    free(SA);
-    free(LCP);
-    free(Q);
-    free(A);
     perror("Cannot allocate memory for state data.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(I, free);
+  scratchAllocated(3 * ((size_t)v + 2) * sizeof(saidx64_t));
+  scratchBytes += 3 * ((size_t)v + 2) * sizeof(saidx64_t);
 
   for (j = 0; j <= v; j++) Q[j] = 1;
 
@@ -1537,11 +1559,17 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
 
   if (v < u) {
     fprintf(stderr, "v < u, so we skip the lrs test.\n");
+    untrackAllocation(SA);
     free(SA);
+    untrackAllocation(LCP);
     free(LCP);
+    untrackAllocation(Q);
     free(Q);
+    untrackAllocation(A);
     free(A);
+    untrackAllocation(I);
     free(I);
+    scratchFreed(scratchBytes);
     result->lrsEntropy = -1.0;
     result->lrsPmax = -1.0;
     result->lrsPu = -1.0;
@@ -1552,8 +1580,10 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
 
   if ((S = calloc((size_t)(v + 1), sizeof(uint128_t))) == NULL) {
     perror("Cannot allocate memory to sum P_W.\n");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(S, free);
+  scratchAllocated((size_t)(v + 1) * sizeof(uint128_t));
   memset(A, 0, sizeof(saidx64_t) * ((size_t)v + 2));
 
   // O(nv) operations
@@ -1627,18 +1657,25 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
   result->lrsEntropy = (double)-log2l(pu);
   result->lrsDone = true;
 
+  untrackAllocation(S);
   free(S);
   S = NULL;
+  untrackAllocation(I);
   free(I);
   I = NULL;
+  untrackAllocation(SA);
   free(SA);
   SA = NULL;
+  untrackAllocation(LCP);
   free(LCP);
   L = NULL;
+  untrackAllocation(Q);
   free(Q);
   Q = NULL;
+  untrackAllocation(A);
   free(A);
   A = NULL;
+  scratchFreed(scratchBytes + (size_t)(v + 1) * sizeof(uint128_t));
 
   exceptions = fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW);
   if (exceptions != 0) {
@@ -1656,7 +1693,7 @@ static void SAalgs64(const statData_t *data, size_t n, size_t k, struct SAresult
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   return;
@@ -1679,6 +1716,25 @@ struct multiMCWPredictorState {
   size_t k;
 };
 
+static void delMultiMCWPredictor(struct multiMCWPredictorState *in) {
+  if (in != NULL) {
+    untrackAllocation(in);
+    if (in->counts != NULL) {
+      free(in->counts);
+      in->counts = NULL;
+    }
+    if (in->symbolLastSeen != NULL) {
+      free(in->symbolLastSeen);
+      in->symbolLastSeen = NULL;
+    }
+    free(in);
+  }
+}
+
+static void releaseMultiMCWPredictor(void *in) {
+  delMultiMCWPredictor(in);
+}
+
 static struct multiMCWPredictorState *initMCWPredictor(const statData_t *S, size_t L, size_t k, size_t inWindowSize) {
   struct multiMCWPredictorState *out;
   size_t j;
@@ -1689,17 +1745,20 @@ static struct multiMCWPredictorState *initMCWPredictor(const statData_t *S, size
 
   if ((out = malloc(sizeof(struct multiMCWPredictorState))) == NULL) {
     perror("Can't allocate predictor (1)");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  out->counts = NULL;
+  out->symbolLastSeen = NULL;
+  trackAllocation(out, releaseMultiMCWPredictor);
 
   if ((out->counts = malloc(sizeof(size_t) * k)) == NULL) {
     perror("Can't allocate predictor (2)");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   if ((out->symbolLastSeen = malloc(sizeof(size_t) * k)) == NULL) {
     perror("Can't allocate predictor (2)");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   // Initialize the multiMCWPredictorState structure
@@ -1726,20 +1785,6 @@ static struct multiMCWPredictorState *initMCWPredictor(const statData_t *S, size
   return (out);
 }
 
-static void delMultiMCWPredictor(struct multiMCWPredictorState *in) {
-  if (in != NULL) {
-    if (in->counts != NULL) {
-      free(in->counts);
-      in->counts = NULL;
-    }
-    if (in->symbolLastSeen != NULL) {
-      free(in->symbolLastSeen);
-      in->symbolLastSeen = NULL;
-    }
-    free(in);
-  }
-}
-
 static void updateMultiMCWPrediction(struct multiMCWPredictorState *in) {
   size_t j;
 
@@ -1833,7 +1878,7 @@ static double predictionEstFct(double pin, const size_t *params) {
       fprintf(stderr, "Found an overflow ");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   return (double)res;
@@ -1972,7 +2017,7 @@ static double predictionEstimateResult(size_t correctCount, size_t N, size_t r,
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   result->done = true;
@@ -2098,8 +2143,9 @@ double lagPredictionEstimate(const statData_t *S, size_t L, size_t k, struct pre
 
   if ((ringBuffers = malloc(k * sizeof(struct lagBuf))) == NULL) {
     perror("Can't allocate ring buffers for lag prediction");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  scratchAllocated(k * sizeof(struct lagBuf));
 
   // Flag all the rings as empty
   for (size_t j = 0; j < k; j++) {
@@ -2164,6 +2210,7 @@ double lagPredictionEstimate(const statData_t *S, size_t L, size_t k, struct pre
   }
 
   free(ringBuffers);
+  scratchFreed(k * sizeof(struct lagBuf));
 
   if(configVerbose > 3) {
     fprintf(stderr, "Lag Prediction Estimate: Winner lag is %zu (High score is %zu)\n", winner+1, highScore);
@@ -2232,7 +2279,7 @@ static double binaryMultiMMCPredictionEstimate(const statData_t *S, size_t L, st
   uint32_t curPattern = 0;
   size_t dictElems[MULTIMMCD] = {0};
 
-  assert(L > 3);
+  assert(L > MULTIMMCD);
   assert(MULTIMMCD < 32);  // MULTIMMCD < 32 to make the bit shifts well defined
 
   // Initialize the dictionary memory
@@ -2243,8 +2290,10 @@ static double binaryMultiMMCPredictionEstimate(const statData_t *S, size_t L, st
     // calloc sets the values to all 0.
     if ((binaryDict[j] = calloc(1U << (j + 2), sizeof(size_t))) == NULL) {
       perror("Can't allocate array binary dictionary");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
+    trackAllocation(binaryDict[j], free);
+    scratchAllocated((1U << (j + 2)) * sizeof(size_t));
   }
 
   // initialize MMC counts
@@ -2338,7 +2387,9 @@ static double binaryMultiMMCPredictionEstimate(const statData_t *S, size_t L, st
   }
 
   for (j = 0; j < MULTIMMCD; j++) {
+    untrackAllocation(binaryDict[j]);
     free(binaryDict[j]);
+    scratchFreed((1U << (j + 2)) * sizeof(size_t));
     binaryDict[j] = NULL;
   }
 
@@ -2368,8 +2419,10 @@ static double binaryLZ78YPredictionEstimate(const statData_t *S, size_t L, struc
     // calloc sets the values to all 0.
     if ((binaryDict[j] = calloc(1U << (j + 2), sizeof(size_t))) == NULL) {
       perror("Can't allocate array binary dictionary");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
+    trackAllocation(binaryDict[j], free);
+    scratchAllocated((1U << (j + 2)) * sizeof(size_t));
   }
 
   // initialize LZ78Y counts with {(S[15]), S[16]}, {(S[14], S[15]), S[16]}, ..., {(S[0]), S[1], ..., S[15]), S[16]},
@@ -2451,7 +2504,9 @@ static double binaryLZ78YPredictionEstimate(const statData_t *S, size_t L, struc
   }
 
   for (j = 0; j < LZ78YB; j++) {
+    untrackAllocation(binaryDict[j]);
     free(binaryDict[j]);
+    scratchFreed((1U << (j + 2)) * sizeof(size_t));
     binaryDict[j] = NULL;
   }
 
@@ -2495,7 +2550,7 @@ double treeMultiMMCPredictionEstimate(const statData_t *S, size_t L, size_t k, s
   size_t poolMem = 0;
   size_t curPoolMem = 0;
 
-  assert(L > 3);
+  assert(L > MULTIMMCD);
   assert(MULTIMMCD < 32);
 
   if (k == 2) return binaryMultiMMCPredictionEstimate(S, L, result);
@@ -2824,10 +2879,59 @@ static double mindouble(double *list, size_t len, size_t *chosen) {
 
 #define DESIRABLE_MAX_EPSILON 0.05
 double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *label, bool conservative, double probCutoff) {
+  size_t *count;
+  size_t *oij;
+  statData_t lastsymbol;
+  const statData_t *curdataptr;
+  double result;
+  size_t i;
+
+  assert(S != NULL);
+  if (L <= 2) {
+    fprintf(stderr, "Markov Estimate only defined for data samples larger than 1 sample.\n");
+    return -1.0;
+  }
+
+  count = calloc(k, sizeof(size_t));
+  oij = calloc(k * k, sizeof(size_t));
+
+  if (!count || !oij) {
+    perror("Memory allocation error");
+    fatalError(EX_OSERR);
+  }
+
+  /*Initialize oij and counts*/
+  lastsymbol = S[0];
+  assert((size_t)lastsymbol < k);
+  curdataptr = S + 1;
+  count[lastsymbol]++;
+
+  for (i = 1; i < L; i++) {
+    assert((size_t)*curdataptr < k);
+    count[*curdataptr]++;
+    oij[((size_t)lastsymbol) * k + (size_t)(*curdataptr)]++;
+    lastsymbol = *curdataptr;
+    curdataptr++;
+  }
+
+  result = NSAMarkovEstimateFromCounts(count, oij, S[L - 1], L, k, label, conservative, probCutoff);
+
+  free(count);
+  free(oij);
+
+  return result;
+}
+
+/* The NSA Markov estimate depends on the data only through the symbol counts, the transition counts, and the final symbol.
+ * symbolCounts is of length k, and contains the number of occurrences of each symbol in all L samples.
+ * oij is a k x k matrix (row major) containing the number of (i, j) transitions in the L-1 adjacent sample pairs.
+ * lastSymbol is the final symbol of the data (S[L-1]).
+ * Neither array is altered.
+ */
+double NSAMarkovEstimateFromCounts(const size_t *symbolCounts, const size_t *oij, statData_t lastSymbol, size_t L, size_t k, const char *label, bool conservative, double probCutoff) {
   size_t d = 128;
 
   size_t *count;
-  size_t *oij;
 
   double *T;
   double *P;
@@ -2838,10 +2942,8 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
   double chain_minentropy;
   double result;
 
-  statData_t lastsymbol;
   size_t i, j, c;
 
-  const statData_t *curdataptr;
   double curprob;
 
   int exceptions;
@@ -2858,7 +2960,9 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
   assert(probCutoff >= 0.0);
 
   assert(fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW) == 0);
-  assert(S != NULL);
+  assert(symbolCounts != NULL);
+  assert(oij != NULL);
+  assert((size_t)lastSymbol < k);
   if (L <= 2) {
     fprintf(stderr, "Markov Estimate only defined for data samples larger than 1 sample.\n");
     return -1.0;
@@ -2867,18 +2971,20 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
   assert(fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW) == 0);
   feclearexcept(FE_ALL_EXCEPT);
 
-  count = calloc(k, sizeof(size_t));
-  oij = calloc(k * k, sizeof(size_t));
+  count = malloc(k * sizeof(size_t));
   T = malloc(sizeof(double) * k * k);
   P = malloc(sizeof(double) * k);
   Pp = malloc(sizeof(double) * k);
   h = malloc(sizeof(double) * k);
 
-  if (!count || !oij || !T || !P || !Pp || !h) {
+  if (!count || !T || !P || !Pp || !h) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
+  // The symbol counts are adjusted as uncommon symbols are excluded, so work on a copy.
+  memcpy(count, symbolCounts, k * sizeof(size_t));
+
   for (i = 0; i < k; i++) {
     P[i] = DBL_INFINITY;
   }
@@ -2890,20 +2996,6 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
     fprintf(stderr, "%s NSA Markov Estimate: Symbol cutoff count is %zu.\n", label, countCutoff);
   }
 
-  /*Initialize oij and counts*/
-  lastsymbol = S[0];
-  assert((size_t)lastsymbol < k);
-  curdataptr = S + 1;
-  count[lastsymbol]++;
-
-  for (i = 1; i < L; i++) {
-    assert((size_t)*curdataptr < k);
-    count[*curdataptr]++;
-    oij[((size_t)lastsymbol) * k + (size_t)(*curdataptr)]++;
-    lastsymbol = *curdataptr;
-    curdataptr++;
-  }
-
   isStable = false;
 
   // We don't a priori know how many symbols are ultimately going to be excluded. Loop until all the
@@ -3008,9 +3100,9 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
     /*# 3. Remove one count from the last symbol.
      *     o_{S_L} -- (where, in the specification, S is not zero-indexed...)
      */
-    if (count[S[L - 1]] > 0) {
+    if (count[lastSymbol] > 0) {
       reducedTrailingSymbolCount = true;
-      count[S[L - 1]]--;
+      count[lastSymbol]--;
     } else {
       reducedTrailingSymbolCount = false;
     }
@@ -3088,7 +3180,7 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
     }  // for, iterating over rows
 
     // If the trailing symbol was reduced, put it back in for the loop.
-    if (reducedTrailingSymbolCount) count[S[L - 1]]++;
+    if (reducedTrailingSymbolCount) count[lastSymbol]++;
 
     if (isStable && conservative && (configVerbose > 2)) {
       fprintf(stderr, "%s NSA Markov Estimate: Maximum Epsilon_i is %.17g.\n", label, maxEpsilon);
@@ -3148,7 +3240,6 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
 
   chain_minentropy = fabs(chain_minentropy);  //-0 arises
 
-  free(oij);
   free(T);
   free(P);
   free(Pp);
@@ -3178,7 +3269,7 @@ double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *la
       fprintf(stderr, "Found an Underflow");
     }
     fprintf(stderr, "\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 
   if (configVerbose > 0) {
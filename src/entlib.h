@@ -39,6 +39,17 @@
 #define TREELZ78YESTIMATEMASK 0x0100
 #define NSAMARKOVESTIMATEMASK 0x0200
 
+// The fewest samples each estimator can assess (see applicableEstimators() in assessments.c).
+#define MCVESTIMATEMINLEN 1
+#define COLSESTIMATEMINLEN 6
+#define MARKOVESTIMATEMINLEN 2
+#define COMPESTIMATEMINLEN 6001
+#define SAESTIMATEMINLEN 2  // and some symbol must repeat
+#define MCWESTIMATEMINLEN 4096
+#define LAGESTIMATEMINLEN 3
+#define TREEMMCESTIMATEMINLEN 17  // MULTIMMCD + 1: the initialization reads the first MULTIMMCD + 1 samples
+#define TREELZ78YESTIMATEMINLEN 19
+
 #define likely(x) __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
@@ -147,6 +158,7 @@ double calcPrun(double Pglobal, size_t N, size_t r);
 
 /*Now retired, be we still use it*/
 double NSAMarkovEstimate(const statData_t *S, size_t L, size_t k, const char *label, bool conservative, double probCutoff);
+double NSAMarkovEstimateFromCounts(const size_t *symbolCounts, const size_t *oij, statData_t lastSymbol, size_t L, size_t k, const char *label, bool conservative, double probCutoff);
 
 struct entropyTestingResult {
   char label[16];  //"Literal" or "Bitstring"
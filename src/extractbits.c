@@ -19,6 +19,7 @@
 
 #include "binio.h"
 #include "binutil.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -34,11 +35,14 @@ noreturn static void useageExit(void) {
 int main(int argc, char *argv[]) {
   FILE *infp;
   size_t datalen;
-  statData_t outdata;
+  statData_t *outdata;
   uint32_t *data = NULL;
   size_t i;
+  size_t count;
+  struct extractPlan plan;
   uint32_t outputBits;
   uint32_t bitmask;
+  struct blockWriter writer;
 
   if (argc != 3) {
     fprintf(stderr, "Wrong number of arguments: argc=%d\n", argc);
@@ -70,13 +74,15 @@ int main(int argc, char *argv[]) {
   }
 
   fprintf(stderr, "Outputting data\n");
-  for (i = 0; i < datalen; i++) {
-    outdata = (statData_t)extractbits(data[i], bitmask);
-    if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-      perror("Can't write output to stdout");
-      exit(EX_OSERR);
-    }
+  initExtractPlan(&plan, bitmask);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+  for (i = 0; i < datalen; i += count) {
+    outdata = reserveElements(&writer, &count);
+    if (count > datalen - i) count = datalen - i;
+    extractPlanArray(&plan, data + i, outdata, count);
+    commitElements(&writer, count);
   }
+  freeBlockWriter(&writer);
 
   free(data);
 
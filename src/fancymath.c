@@ -23,6 +23,7 @@
 
 #include "entlib.h"
 #include "fancymath.h"
+#include "globals.h"
 #include "incbeta.h"
 
 #ifdef SLOWCHECKS
@@ -290,19 +291,25 @@ static long double kahanSumResultl(struct kahanState *state) {
 static void initAdaptiveSum(struct adaptiveState *state) {
   if ((state->partials = malloc(PARTIALBLOCK * sizeof(double))) == NULL) {
     perror("Can't allocate partials list");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(state->partials, free);
 
   state->numOfPartials = 0;
   state->partialListCapacity = PARTIALBLOCK;
 }
 
 static void growAdaptiveSum(struct adaptiveState *state) {
+  double *partials;
+
   state->partialListCapacity += PARTIALBLOCK;
-  if ((state->partials = realloc(state->partials, state->partialListCapacity * sizeof(double))) == NULL) {
+  if ((partials = realloc(state->partials, state->partialListCapacity * sizeof(double))) == NULL) {
     perror("Can't allocate partials list");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  untrackAllocation(state->partials);
+  state->partials = partials;
+  trackAllocation(state->partials, free);
 }
 
 static void adaptiveSum(struct adaptiveState *state, double x) {
@@ -428,6 +435,7 @@ static double adaptiveSumResult(struct adaptiveState *state) {
 static void delAdaptiveSum(struct adaptiveState *state) {
   assert(state != NULL);
   assert(state->partials != NULL);
+  untrackAllocation(state->partials);
   free(state->partials);
   state->partials = NULL;
   state->numOfPartials = 0;
@@ -989,7 +997,7 @@ void safeAdduint64(uint64_t a, uint64_t b, uint64_t *res) {
 #endif
   if(sumOverflow) {
     fprintf(stderr, "Integer overflow in calculation.\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 }
 
@@ -1008,7 +1016,7 @@ void safeAdduint128(uint128_t a, uint128_t b, uint128_t *res) {
 #endif
   if(sumOverflow) {
     fprintf(stderr, "Integer overflow in calculation.\n");
-    exit(EX_DATAERR);
+    fatalError(EX_DATAERR);
   }
 }
 
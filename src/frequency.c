@@ -0,0 +1,357 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+#include "frequency.h"
+
+// The smallest table that we allocate
+#define COUNTTABLEMINBITS 10
+
+/*Fibonacci hashing; the high bits of the product are the best mixed.*/
+static inline size_t countTableSlot(const struct u32CountTable *table, uint32_t symbol) {
+  return (size_t)((symbol * 0x9E3779B1U) >> (32U - table->bits));
+}
+
+static void allocateCountTable(struct u32CountTable *table, unsigned int bits) {
+  assert((bits >= COUNTTABLEMINBITS) && (bits <= 32));
+
+  table->bits = bits;
+  table->capacity = ((size_t)1) << bits;
+  table->distinct = 0;
+
+  if (((table->symbols = malloc(table->capacity * sizeof(uint32_t))) == NULL) || ((table->counts = calloc(table->capacity, sizeof(size_t))) == NULL)) {
+    perror("Can't allocate symbol count table");
+    exit(EX_OSERR);
+  }
+}
+
+void initCountTable(struct u32CountTable *table, size_t expectedDistinct) {
+  unsigned int bits;
+
+  assert(table != NULL);
+
+  // Keep the load factor at most 1/2.
+  for (bits = COUNTTABLEMINBITS; (bits < 32) && ((((size_t)1) << (bits - 1)) < expectedDistinct); bits++)
+    ;
+
+  allocateCountTable(table, bits);
+  table->total = 0;
+}
+
+void freeCountTable(struct u32CountTable *table) {
+  assert(table != NULL);
+
+  free(table->symbols);
+  free(table->counts);
+  table->symbols = NULL;
+  table->counts = NULL;
+  table->capacity = 0;
+  table->distinct = 0;
+}
+
+static void growCountTable(struct u32CountTable *table) {
+  struct u32CountTable newTable;
+  size_t slot;
+
+  allocateCountTable(&newTable, table->bits + 1);
+
+  for (size_t j = 0; j < table->capacity; j++) {
+    if (table->counts[j] != 0) {
+      for (slot = countTableSlot(&newTable, table->symbols[j]); newTable.counts[slot] != 0; slot = (slot + 1) & (newTable.capacity - 1))
+        ;
+      newTable.symbols[slot] = table->symbols[j];
+      newTable.counts[slot] = table->counts[j];
+    }
+  }
+
+  newTable.distinct = table->distinct;
+  newTable.total = table->total;
+  free(table->symbols);
+  free(table->counts);
+  *table = newTable;
+}
+
+/*Returns the slot for this symbol, adding the symbol (with a count of 0) if it isn't present.*/
+static size_t countTableInsert(struct u32CountTable *table, uint32_t symbol) {
+  size_t slot;
+
+  // Keep the load factor at most 1/2. A 32 bit table has a slot for every symbol, so it can fill completely instead of growing.
+  if ((table->bits < 32) && (2 * (table->distinct + 1) > table->capacity)) {
+    growCountTable(table);
+  }
+
+  for (slot = countTableSlot(table, symbol); table->counts[slot] != 0; slot = (slot + 1) & (table->capacity - 1)) {
+    if (table->symbols[slot] == symbol) return slot;
+  }
+
+  table->symbols[slot] = symbol;
+  table->distinct++;
+  return slot;
+}
+
+void countTableAdd(struct u32CountTable *table, const uint32_t *data, size_t datalen) {
+  uint32_t lastSymbol;
+  size_t lastSlot;
+
+  assert(table != NULL);
+  assert((data != NULL) || (datalen == 0));
+
+  if (datalen == 0) return;
+
+  // Runs of a symbol are common in the data we look at, so avoid repeating the look up.
+  lastSymbol = data[0];
+  lastSlot = countTableInsert(table, lastSymbol);
+  table->counts[lastSlot]++;
+
+  for (size_t i = 1; i < datalen; i++) {
+    if (data[i] != lastSymbol) {
+      lastSymbol = data[i];
+      lastSlot = countTableInsert(table, lastSymbol);
+    }
+    table->counts[lastSlot]++;
+  }
+
+  table->total += datalen;
+}
+
+/*Returns the slot holding symbol, or SIZE_MAX if the symbol was never counted.*/
+size_t countTableFind(const struct u32CountTable *table, uint32_t symbol) {
+  size_t slot;
+
+  assert(table != NULL);
+
+  for (slot = countTableSlot(table, symbol); table->counts[slot] != 0; slot = (slot + 1) & (table->capacity - 1)) {
+    if (table->symbols[slot] == symbol) return slot;
+  }
+
+  return SIZE_MAX;
+}
+
+/*Remove the symbol in this slot, shifting later members of the probe sequence back so that no tombstone is needed.*/
+static void countTableRemove(struct u32CountTable *table, size_t slot) {
+  size_t next;
+  size_t home;
+
+  assert(table->counts[slot] != 0);
+
+  // The scan also stops if it wraps around to the vacated slot, which can happen in a full (32 bit) table.
+  for (next = (slot + 1) & (table->capacity - 1); (table->counts[next] != 0) && (next != slot); next = (next + 1) & (table->capacity - 1)) {
+    home = countTableSlot(table, table->symbols[next]);
+    // Move this entry if its home slot is not cyclically within (slot, next].
+    if (((next - home) & (table->capacity - 1)) >= ((next - slot) & (table->capacity - 1))) {
+      table->symbols[slot] = table->symbols[next];
+      table->counts[slot] = table->counts[next];
+      slot = next;
+    }
+  }
+
+  table->counts[slot] = 0;
+  table->distinct--;
+}
+
+/*Is a a better entry than b? Higher counts are better, and then smaller symbols.*/
+static inline bool symbolCountBetter(const struct symbolCount *a, const struct symbolCount *b) {
+  return (a->count > b->count) || ((a->count == b->count) && (a->symbol < b->symbol));
+}
+
+// A min-heap (the worst entry on top) of the best entries seen so far.
+static void topKSiftDown(struct symbolCount *heap, size_t size, size_t pos) {
+  size_t child;
+  struct symbolCount tmp;
+
+  while ((child = 2 * pos + 1) < size) {
+    if ((child + 1 < size) && symbolCountBetter(heap + child, heap + child + 1)) child++;
+    if (!symbolCountBetter(heap + pos, heap + child)) break;
+    tmp = heap[pos];
+    heap[pos] = heap[child];
+    heap[child] = tmp;
+    pos = child;
+  }
+}
+
+static void topKOffer(struct symbolCount *heap, size_t *size, size_t k, const struct symbolCount *candidate) {
+  size_t pos;
+  size_t parent;
+
+  if (*size < k) {
+    pos = (*size)++;
+    heap[pos] = *candidate;
+    while ((pos > 0) && symbolCountBetter(heap + (parent = (pos - 1) / 2), heap + pos)) {
+      struct symbolCount tmp = heap[pos];
+      heap[pos] = heap[parent];
+      heap[parent] = tmp;
+      pos = parent;
+    }
+  } else if ((k > 0) && symbolCountBetter(candidate, heap)) {
+    heap[0] = *candidate;
+    topKSiftDown(heap, k, 0);
+  }
+}
+
+static int symbolCountCompare(const void *in1, const void *in2) {
+  const struct symbolCount *left = in1;
+  const struct symbolCount *right = in2;
+
+  if (symbolCountBetter(left, right)) {
+    return -1;
+  } else if (symbolCountBetter(right, left)) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+/*Find the k most common symbols (fewer, if fewer were seen), in decreasing order of count.
+ *Ties are broken in favor of the smaller symbol. This takes O(D log k) time for D distinct symbols.
+ *Returns the number of entries written to out.
+ */
+size_t countTableTopK(const struct u32CountTable *table, size_t k, struct symbolCount *out) {
+  size_t size = 0;
+  struct symbolCount candidate;
+
+  assert(table != NULL);
+  assert((out != NULL) || (k == 0));
+
+  candidate.error = 0;
+  for (size_t j = 0; j < table->capacity; j++) {
+    if (table->counts[j] != 0) {
+      candidate.symbol = table->symbols[j];
+      candidate.count = table->counts[j];
+      topKOffer(out, &size, k, &candidate);
+    }
+  }
+
+  qsort(out, size, sizeof(struct symbolCount), symbolCountCompare);
+  return size;
+}
+
+void initSpaceSaving(struct spaceSaving *sketch, size_t capacity) {
+  assert(sketch != NULL);
+  assert(capacity > 0);
+
+  sketch->capacity = capacity;
+  sketch->size = 0;
+  sketch->total = 0;
+
+  if (((sketch->symbols = malloc(capacity * sizeof(uint32_t))) == NULL) || ((sketch->counts = malloc(capacity * sizeof(size_t))) == NULL) || ((sketch->errors = malloc(capacity * sizeof(size_t))) == NULL) ||
+      ((sketch->heap = malloc(capacity * sizeof(size_t))) == NULL) || ((sketch->heapPos = malloc(capacity * sizeof(size_t))) == NULL)) {
+    perror("Can't allocate Space-Saving sketch");
+    exit(EX_OSERR);
+  }
+
+  initCountTable(&sketch->index, capacity);
+}
+
+void freeSpaceSaving(struct spaceSaving *sketch) {
+  assert(sketch != NULL);
+
+  free(sketch->symbols);
+  free(sketch->counts);
+  free(sketch->errors);
+  free(sketch->heap);
+  free(sketch->heapPos);
+  freeCountTable(&sketch->index);
+}
+
+static void spaceSavingSiftDown(struct spaceSaving *sketch, size_t pos) {
+  size_t child;
+  size_t tmp;
+
+  while ((child = 2 * pos + 1) < sketch->size) {
+    if ((child + 1 < sketch->size) && (sketch->counts[sketch->heap[child + 1]] < sketch->counts[sketch->heap[child]])) child++;
+    if (sketch->counts[sketch->heap[pos]] <= sketch->counts[sketch->heap[child]]) break;
+    tmp = sketch->heap[pos];
+    sketch->heap[pos] = sketch->heap[child];
+    sketch->heap[child] = tmp;
+    sketch->heapPos[sketch->heap[pos]] = pos;
+    sketch->heapPos[sketch->heap[child]] = child;
+    pos = child;
+  }
+}
+
+static void spaceSavingSiftUp(struct spaceSaving *sketch, size_t pos) {
+  size_t parent;
+  size_t tmp;
+
+  while ((pos > 0) && (sketch->counts[sketch->heap[parent = (pos - 1) / 2]] > sketch->counts[sketch->heap[pos]])) {
+    tmp = sketch->heap[pos];
+    sketch->heap[pos] = sketch->heap[parent];
+    sketch->heap[parent] = tmp;
+    sketch->heapPos[sketch->heap[pos]] = pos;
+    sketch->heapPos[sketch->heap[parent]] = parent;
+    pos = parent;
+  }
+}
+
+/*Each symbol either increments its own counter, takes a free counter, or replaces the symbol with the smallest count
+ *(inheriting that count as its error bound). Any symbol with true frequency above total / capacity is guaranteed to be held.
+ */
+void spaceSavingAdd(struct spaceSaving *sketch, const uint32_t *data, size_t datalen) {
+  size_t slot;
+  size_t counter;
+
+  assert(sketch != NULL);
+  assert((data != NULL) || (datalen == 0));
+
+  for (size_t i = 0; i < datalen; i++) {
+    if ((slot = countTableFind(&sketch->index, data[i])) != SIZE_MAX) {
+      // Counts only increase, so the counter can only move down the heap.
+      counter = sketch->index.counts[slot] - 1;
+      sketch->counts[counter]++;
+      spaceSavingSiftDown(sketch, sketch->heapPos[counter]);
+    } else if (sketch->size < sketch->capacity) {
+      counter = sketch->size;
+      sketch->symbols[counter] = data[i];
+      sketch->counts[counter] = 1;
+      sketch->errors[counter] = 0;
+      sketch->heap[counter] = counter;
+      sketch->heapPos[counter] = counter;
+      sketch->size++;
+      spaceSavingSiftUp(sketch, counter);
+      sketch->index.counts[countTableInsert(&sketch->index, data[i])] = counter + 1;
+    } else {
+      counter = sketch->heap[0];
+      countTableRemove(&sketch->index, countTableFind(&sketch->index, sketch->symbols[counter]));
+      sketch->symbols[counter] = data[i];
+      sketch->errors[counter] = sketch->counts[counter];
+      sketch->counts[counter]++;
+      sketch->index.counts[countTableInsert(&sketch->index, data[i])] = counter + 1;
+      spaceSavingSiftDown(sketch, 0);
+    }
+  }
+
+  sketch->total += datalen;
+}
+
+/*The k counters with the highest counts, in decreasing order of count. Each reported count is an upper bound on the true
+ *count, and count - error is a lower bound.*/
+size_t spaceSavingTopK(const struct spaceSaving *sketch, size_t k, struct symbolCount *out) {
+  size_t size = 0;
+  struct symbolCount candidate;
+
+  assert(sketch != NULL);
+  assert((out != NULL) || (k == 0));
+
+  for (size_t j = 0; j < sketch->size; j++) {
+    candidate.symbol = sketch->symbols[j];
+    candidate.count = sketch->counts[j];
+    candidate.error = sketch->errors[j];
+    topKOffer(out, &size, k, &candidate);
+  }
+
+  qsort(out, size, sizeof(struct symbolCount), symbolCountCompare);
+  return size;
+}
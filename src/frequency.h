@@ -0,0 +1,55 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef FREQUENCY_H
+#define FREQUENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct symbolCount {
+  uint32_t symbol;
+  size_t count;
+  size_t error;  // the count may overstate the true count by up to this much (always 0 for exact counts)
+};
+
+// Exact symbol counts in an open addressing hash table. A count of 0 marks an empty slot.
+struct u32CountTable {
+  uint32_t *symbols;
+  size_t *counts;
+  size_t capacity;  // a power of 2
+  unsigned int bits;  // log2(capacity)
+  size_t distinct;  // number of occupied slots
+  size_t total;  // number of symbols counted
+};
+
+// Space-Saving sketch (Metwally, Agrawal and El Abbadi, 2005) for approximate top-k over a stream, using a fixed number of counters.
+struct spaceSaving {
+  size_t capacity;  // number of counters
+  size_t size;  // counters in use
+  size_t total;  // number of symbols counted
+  uint32_t *symbols;  // counter -> symbol
+  size_t *counts;  // counter -> count
+  size_t *errors;  // counter -> count overestimate bound
+  size_t *heap;  // min-heap of counters, ordered by count
+  size_t *heapPos;  // counter -> position in heap
+  struct u32CountTable index;  // symbol -> counter (the "count" field holds counter + 1)
+};
+
+void initCountTable(struct u32CountTable *table, size_t expectedDistinct);
+void countTableAdd(struct u32CountTable *table, const uint32_t *data, size_t datalen);
+size_t countTableFind(const struct u32CountTable *table, uint32_t symbol);
+size_t countTableTopK(const struct u32CountTable *table, size_t k, struct symbolCount *out);
+void freeCountTable(struct u32CountTable *table);
+
+void initSpaceSaving(struct spaceSaving *sketch, size_t capacity);
+void spaceSavingAdd(struct spaceSaving *sketch, const uint32_t *data, size_t datalen);
+size_t spaceSavingTopK(const struct spaceSaving *sketch, size_t k, struct symbolCount *out);
+void freeSpaceSaving(struct spaceSaving *sketch);
+#endif
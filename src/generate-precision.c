@@ -8,6 +8,7 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <limits.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -30,6 +31,8 @@ int main(void) {
   uint32_t ecx = 0;
   uint32_t edx = 0;
   uint32_t ids = 0;
+  uint32_t family = 0;
+  bool isAMD = false;
 #endif
 
   printf("#ifndef PRECISION_H\n");
@@ -53,9 +56,13 @@ int main(void) {
 #if defined(__x86_64) || defined(__x86_64__)
   __get_cpuid(0, &eax, &ebx, &ecx, &edx);
   ids = eax;
+  // "AuthenticAMD"
+  isAMD = (ebx == 0x68747541) && (edx == 0x69746e65) && (ecx == 0x444d4163);
 
   if (ids >= 1) {
     __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    family = (eax >> 8) & 0xF;
+    if (family == 0xF) family += (eax >> 20) & 0xFF;
     if (ecx & bit_SSE4_2) {
       printf("#define SSE42\n");
     }
@@ -80,9 +87,13 @@ int main(void) {
   }
 
   if (ids >= 7) {
-    __get_cpuid(7, &eax, &ebx, &ecx, &edx);
+    __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
     if (ebx & bit_BMI2) {
       printf("#define BMI2\n");
+      // PEXT and PDEP are microcoded (and slow) on AMD processors prior to Zen 3.
+      if (isAMD && (family < 0x19)) {
+        printf("#define SLOWPEXT\n");
+      }
     }
   }
 #endif
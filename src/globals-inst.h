@@ -12,16 +12,25 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "entlib.h"
 #include "globals.h"
 
-int configVerbose = 0;
-bool configBootstrapParams = false;
-size_t configThreadCount = 0;
-double globalErrors[ERRORSLOTS] = {-1.0};
-char errorLabels[ERRORSLOTS][LABELLEN] = {0};
+_Thread_local int configVerbose = 0;
+_Thread_local bool configBootstrapParams = false;
+_Thread_local size_t configThreadCount = 0;
+_Thread_local double globalErrors[ERRORSLOTS] = {-1.0};
+_Thread_local char errorLabels[ERRORSLOTS][LABELLEN] = {0};
 
-double configBootstrapConfidence = 0.99;
-size_t configBootstrapRounds = 15000;
+_Thread_local double configBootstrapConfidence = 0.99;
+_Thread_local size_t configBootstrapRounds = 15000;
+
+_Thread_local FILE *configTelemetry = NULL;
+_Thread_local size_t globalScratchBytes = 0;
+_Thread_local size_t globalScratchPeak = 0;
+_Thread_local jmp_buf *globalFatalJump = NULL;
+_Thread_local int globalFatalStatus = 0;
+_Thread_local struct trackedAllocation globalTracked[TRACKEDSLOTS];
+_Thread_local size_t globalTrackedCount = 0;
 #endif
@@ -13,16 +13,111 @@
 #define ERRORSLOTS 16
 #define LABELLEN 64
 
+#include <assert.h>
+#include <setjmp.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
 
-extern int configVerbose;
-extern bool configBootstrapParams;
-extern size_t configThreadCount;
-extern double globalErrors[ERRORSLOTS];
-extern char errorLabels[ERRORSLOTS][LABELLEN];
+/*The configuration is per thread, so that libtheseus calls (which each set it from their context) can run concurrently.
+ *Threads started by a program don't inherit it: they must be given the starting thread's copy (see loadThreadConfig()).
+ */
+extern _Thread_local int configVerbose;
+extern _Thread_local bool configBootstrapParams;
+extern _Thread_local size_t configThreadCount;
+extern _Thread_local double globalErrors[ERRORSLOTS];
+extern _Thread_local char errorLabels[ERRORSLOTS][LABELLEN];
+
+extern _Thread_local double configBootstrapConfidence;
+extern _Thread_local size_t configBootstrapRounds;
+
+// JSON lines performance records are written here (NULL for none); see telemetry.h.
+extern _Thread_local FILE *configTelemetry;
+// Per-thread estimator scratch memory: the bytes presently allocated, and the high-water mark.
+extern _Thread_local size_t globalScratchBytes;
+extern _Thread_local size_t globalScratchPeak;
+
+struct threadConfig {
+  int verbose;
+  bool bootstrapParams;
+  size_t threadCount;
+  double bootstrapConfidence;
+  size_t bootstrapRounds;
+  FILE *telemetry;
+};
+
+static inline void saveThreadConfig(struct threadConfig *config) {
+  config->verbose = configVerbose;
+  config->bootstrapParams = configBootstrapParams;
+  config->threadCount = configThreadCount;
+  config->bootstrapConfidence = configBootstrapConfidence;
+  config->bootstrapRounds = configBootstrapRounds;
+  config->telemetry = configTelemetry;
+}
+
+static inline void loadThreadConfig(const struct threadConfig *config) {
+  configVerbose = config->verbose;
+  configBootstrapParams = config->bootstrapParams;
+  configThreadCount = config->threadCount;
+  configBootstrapConfidence = config->bootstrapConfidence;
+  configBootstrapRounds = config->bootstrapRounds;
+  configTelemetry = config->telemetry;
+}
+
+/*Where fatal errors go. The command line tools leave this NULL, so the error ends the program with the given exit status
+ *(from sysexits.h); libtheseus points it at a jmp_buf so that the error is instead returned to its caller.
+ */
+extern _Thread_local jmp_buf *globalFatalJump;
+extern _Thread_local int globalFatalStatus;
+
+/*Working storage that a fatal error would otherwise leak. While a jump is set, such storage is tracked (along with the
+ *function that releases it) from its allocation until it is freed, and whoever set the jump calls releaseTracked() after
+ *the jump is taken.
+ */
+#define TRACKEDSLOTS 64
+
+struct trackedAllocation {
+  void *block;
+  void (*release)(void *);
+};
+
+extern _Thread_local struct trackedAllocation globalTracked[TRACKEDSLOTS];
+extern _Thread_local size_t globalTrackedCount;
+
+static inline void trackAllocation(void *block, void (*release)(void *)) {
+  if (globalFatalJump != NULL) {
+    assert(globalTrackedCount < TRACKEDSLOTS);
+    globalTracked[globalTrackedCount].block = block;
+    globalTracked[globalTrackedCount].release = release;
+    globalTrackedCount++;
+  }
+}
+
+static inline void untrackAllocation(const void *block) {
+  for (size_t j = globalTrackedCount; j > 0; j--) {
+    if (globalTracked[j - 1].block == block) {
+      globalTrackedCount--;
+      globalTracked[j - 1] = globalTracked[globalTrackedCount];
+      return;
+    }
+  }
+}
+
+static inline void releaseTracked(void) {
+  while (globalTrackedCount > 0) {
+    globalTrackedCount--;
+    globalTracked[globalTrackedCount].release(globalTracked[globalTrackedCount].block);
+  }
+}
 
-extern double configBootstrapConfidence;
-extern size_t configBootstrapRounds;
+static inline noreturn void fatalError(int status) {
+  if (globalFatalJump != NULL) {
+    globalFatalStatus = status;
+    longjmp(*globalFatalJump, 1);
+  }
+  exit(status);
+}
 
 #endif
@@ -8,6 +8,7 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,7 +18,9 @@
 #include <string.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "precision.h"
+#include "textio.h"
 /*
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
@@ -29,19 +32,37 @@ noreturn static void useageExit(void) {
 
 int main(void) {
   uint32_t data;
-  int res;
-  uint32_t indata;
+  uint64_t inInt;
+  char *curline;
+  char *curloc;
+  char *afterInt;
+  struct textReader reader;
+  struct blockWriter writer;
 
-  while (feof(stdin) == 0) {
-    res = scanf("%x\n", &indata);
-    data = (uint32_t)indata;
-    if (res == 1) {
-      if (fwrite(&data, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
+  initTextReader(&reader, stdin);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+
+  while ((curline = readTextLine(&reader, NULL)) != NULL) {
+    // Values are separated by white space; blank lines are ignored.
+    curloc = curline;
+    for (;;) {
+      while ((*curloc == ' ') || (*curloc == '\t') || (*curloc == '\r')) curloc++;
+      if (*curloc == '\0') break;
+
+      errno = 0;
+      inInt = textToUint64(curloc, &afterInt, 16);
+      if ((*curloc == '-') || (afterInt == curloc) || (errno == ERANGE) || (inInt > UINT32_MAX) || ((*afterInt != ' ') && (*afterInt != '\t') && (*afterInt != '\r') && (*afterInt != '\0'))) {
+        fprintf(stderr, "data error on line %zu\n", reader.lineNumber);
+        exit(EX_DATAERR);
       }
+      data = (uint32_t)inInt;
+      writeElement(&writer, &data);
+      curloc = afterInt;
     }
   }
 
+  freeBlockWriter(&writer);
+  freeTextReader(&reader);
+
   return (0);
 }
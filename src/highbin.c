@@ -23,31 +23,31 @@
 #include "fancymath.h"
 #include "globals-inst.h"
 #include "precision.h"
-#include "rbt_misc.h"
-#include "red_black_tree.h"
 
-#define LEFTENDPOINTFLAG 0x02
-#define RIGHTENDPOINTFLAG 0x01
+// Number of output symbols buffered per write
+#define OUTPUTBLOCKLEN 65536
+// Largest symbol range that is rewritten using a direct look-up table
+#define REWRITELUTMAX (((size_t)1) << 28)
 
 // Some notes on data structures:
 // if we have k symbols, symbolTable is (at least) a k x 3 matrix of uint32_t values
 // symbolTable[3j+0] is the untranslated (raw) data
 // symbolTable[3j+1] is the population of that data element data
-// symbolTable[3j+2] is for flags denoting interval endpoints
+// symbolTable[3j+2] is reserved for flags
 
 // If we have k intervals, interval arrays are stored as:
 // intervals[3j+0] is the untranslated (raw) data interval start (inclusive)
-// intervals[3j+0] is the untranslated (raw) data interval end (inclusive)
-// intervals[3j+1] is the population of that interval
-
-struct intervalNode {
-  uint64_t treeKey;
-  struct intervalNode *nextNode;
-  struct intervalNode *priorNode;
-
-  uint32_t intervalStart;  // The first translated
-  uint32_t intervalEnd;
-  uint32_t intervalPop;  // The population of elements in this interval
+// intervals[3j+1] is the untranslated (raw) data interval end (inclusive)
+// intervals[3j+2] is the population of that interval
+
+// The greedy grouping bucketer tracks intervals by the index of their first symbol.
+// Each interval is keyed by (combined population with the following interval) << 32 | (raw interval start),
+// and the intervals are kept in a binary min-heap indexed by these keys.
+struct intervalHeap {
+  uint64_t *keys;  // keys[j] is the key of the interval starting at symbol j
+  size_t *heap;  // heap[p] is the starting symbol of the interval at heap position p
+  size_t *position;  // position[j] is the heap position of the interval starting at symbol j
+  size_t size;
 };
 
 noreturn static void useageExit(void) {
@@ -59,22 +59,6 @@ noreturn static void useageExit(void) {
   exit(EX_USAGE);
 }
 
-static int uintcompare(const void *in1, const void *in2) {
-  const uint32_t *left;
-  const uint32_t *right;
-
-  left = in1;
-  right = in2;
-
-  if (*left < *right) {
-    return (-1);
-  } else if (*left > *right) {
-    return (1);
-  } else {
-    return (0);
-  }
-}
-
 // Make sure that the intervals are well ordered.
 static int intervalCompare(const void *in1, const void *in2) {
   const uint32_t *left;
@@ -103,22 +87,6 @@ static int intervalCompare(const void *in1, const void *in2) {
   }
 }
 
-static int intervalMembershipCompare(const void *vkey, const void *elem) {
-  const uint32_t *key;
-  const uint32_t *interval;
-
-  key = vkey;
-  interval = elem;
-
-  if (*key < *interval) {
-    return (-1);
-  } else if (*key > *(interval + 1)) {
-    return (1);
-  } else {
-    return (0);
-  }
-}
-
 /*Tests:
  * buckets == targetBuckets
  * buckets > targetBuckets
@@ -155,91 +123,75 @@ static double chiSquareScore(uint32_t *intervals, size_t buckets, double targetP
   return (score / targetPopulation);
 }
 
-static int treeIndexCompare(const void *ap, const void *bp) {
-  const uint64_t a = *((const uint64_t *)ap);
-  const uint64_t b = *((const uint64_t *)bp);
+static void heapSwap(struct intervalHeap *h, size_t a, size_t b) {
+  size_t tmp;
 
-  if (a > b) {
-    return 1;
-  } else if (a < b) {
-    return -1;
-  } else {
-    return 0;
-  }
+  tmp = h->heap[a];
+  h->heap[a] = h->heap[b];
+  h->heap[b] = tmp;
+  h->position[h->heap[a]] = a;
+  h->position[h->heap[b]] = b;
 }
 
-static void updateTreeKey(struct intervalNode *currentInterval) {
-  uint64_t newCombinedPopulation;
-  uint64_t intervalStart;
-
-  assert(currentInterval != NULL);
-  assert(currentInterval->intervalStart <= 0xFFFFFFFF);
+static void heapSiftUp(struct intervalHeap *h, size_t p) {
+  size_t parent;
 
-  intervalStart = currentInterval->intervalStart;
-
-  if (currentInterval->nextNode != NULL) {
-    newCombinedPopulation = currentInterval->intervalPop + currentInterval->nextNode->intervalPop;
-  } else {
-    newCombinedPopulation = UINT_MAX;
+  while (p > 0) {
+    parent = (p - 1) >> 1;
+    if (h->keys[h->heap[parent]] <= h->keys[h->heap[p]]) {
+      break;
+    }
+    heapSwap(h, p, parent);
+    p = parent;
   }
-
-  assert(newCombinedPopulation <= 0xFFFFFFFF);
-
-  currentInterval->treeKey = ((newCombinedPopulation << 32) | intervalStart);
 }
 
-static rb_red_blk_tree *initIntervalSearch(uint32_t *symbolTable, size_t symbolCount, struct intervalNode **outhead) {
-  struct intervalNode *currentInterval;
-  struct intervalNode *lastInterval = NULL;
-  rb_red_blk_tree *tree;
-  size_t i;
-
-  assert(symbolCount > 0);
-
-  tree = RBTreeCreate(treeIndexCompare, NullFunction, NullFunction);
-  assert(tree != NULL);
+static void heapSiftDown(struct intervalHeap *h, size_t p) {
+  size_t child;
 
-  fprintf(stderr, "BBGG: Inserting symbols into RBT.\n");
-  if ((currentInterval = malloc(sizeof(struct intervalNode))) == NULL) {
-    perror("Can't allocate array for current interval");
-    exit(EX_OSERR);
+  while ((child = 2 * p + 1) < h->size) {
+    if ((child + 1 < h->size) && (h->keys[h->heap[child + 1]] < h->keys[h->heap[child]])) {
+      child++;
+    }
+    if (h->keys[h->heap[p]] <= h->keys[h->heap[child]]) {
+      break;
+    }
+    heapSwap(h, p, child);
+    p = child;
   }
+}
 
-  currentInterval->intervalStart = symbolTable[0];
-  currentInterval->intervalEnd = symbolTable[0];
-  currentInterval->intervalPop = symbolTable[1];
-  currentInterval->nextNode = NULL;
-  currentInterval->priorNode = NULL;
-
-  *outhead = currentInterval;
+/*Restore the heap property after the key of the interval starting at symbol j has changed*/
+static void heapUpdate(struct intervalHeap *h, size_t j) {
+  heapSiftUp(h, h->position[j]);
+  heapSiftDown(h, h->position[j]);
+}
 
-  lastInterval = currentInterval;
+static void heapRemove(struct intervalHeap *h, size_t j) {
+  size_t p;
 
-  for (i = 1; i < symbolCount; i++) {
-    if ((currentInterval = malloc(sizeof(struct intervalNode))) == NULL) {
-      perror("Can't allocate array for current interval");
-      exit(EX_OSERR);
-    }
-
-    currentInterval->intervalStart = symbolTable[3 * i];
-    currentInterval->intervalEnd = symbolTable[3 * i];
-    currentInterval->intervalPop = symbolTable[3 * i + 1];
+  p = h->position[j];
+  assert(p < h->size);
+  h->size--;
+  if (p != h->size) {
+    heapSwap(h, p, h->size);
+    heapUpdate(h, h->heap[p]);
+  }
+  h->position[j] = SIZE_MAX;
+}
 
-    currentInterval->priorNode = lastInterval;
-    lastInterval->nextNode = currentInterval;
+static uint64_t intervalKey(const uint32_t *symbolTable, const uint32_t *intervalPop, const size_t *nextInterval, size_t j) {
+  uint64_t newCombinedPopulation;
 
-    updateTreeKey(lastInterval);
-    RBTreeInsert(tree, &(lastInterval->treeKey), lastInterval);
-    lastInterval = currentInterval;
+  if (nextInterval[j] != SIZE_MAX) {
+    newCombinedPopulation = (uint64_t)intervalPop[j] + (uint64_t)intervalPop[nextInterval[j]];
+  } else {
+    newCombinedPopulation = UINT_MAX;
   }
 
-  /*get the last symbol into a special interval*/
-  currentInterval->nextNode = NULL;
-
-  updateTreeKey(currentInterval);
-  RBTreeInsert(tree, &(currentInterval->treeKey), currentInterval);
+  assert(newCombinedPopulation <= 0xFFFFFFFF);
 
-  return (tree);
+  return ((newCombinedPopulation << 32) | (uint64_t)symbolTable[3 * j]);
 }
 
 /*test cases:
@@ -248,117 +200,110 @@ static rb_red_blk_tree *initIntervalSearch(uint32_t *symbolTable, size_t symbolC
  * many common symbols, but not enough for distinct buckets
  * one symbol
  */
-static double bucketByGreedyGrouping(uint32_t *symbolTable, size_t symbolCount, /*@out@*/ uint32_t *intervals, size_t *buckets, double targetPopulation) {
+static double bucketByGreedyGrouping(const uint32_t *symbolTable, size_t symbolCount, /*@out@*/ uint32_t *intervals, size_t *buckets, double targetPopulation) {
+  struct intervalHeap h;
+  size_t *nextInterval;
+  size_t *priorInterval;
+  size_t *intervalEnd;
+  uint32_t *intervalPop;
   size_t curBuckets;
-  size_t i;
-  rb_red_blk_tree *tree;
-  rb_red_blk_node *curNode;
-  rb_red_blk_node *nextNode;
-  rb_red_blk_node *priorNode;
-  struct intervalNode *currentInterval;
-  struct intervalNode *lastInterval;
-  struct intervalNode *nextInterval;
-  struct intervalNode *priorInterval;
-  struct intervalNode *intervalHead;
-  uint64_t nextIndex;
-  uint64_t priorIndex;
+  size_t curInterval;
+  size_t mergedInterval;
   size_t targetBuckets;
+  size_t i, j;
 
   assert(buckets != NULL);
   assert(*buckets > 0);
   assert(symbolTable != NULL);
   assert(intervals != NULL);
+  assert(symbolCount > 0);
 
   targetBuckets = *buckets;
 
-  /*Clear out any endpoints marked*/
-  for (i = 0; i < symbolCount; i++) {
-    symbolTable[i * 3 + 2] = 0;
+  if (((h.keys = malloc(symbolCount * sizeof(uint64_t))) == NULL) || ((h.heap = malloc(symbolCount * sizeof(size_t))) == NULL) || ((h.position = malloc(symbolCount * sizeof(size_t))) == NULL)) {
+    perror("Can't allocate interval heap");
+    exit(EX_OSERR);
   }
 
-  tree = initIntervalSearch(symbolTable, symbolCount, &intervalHead);
-  assert(tree != NULL);
-  assert(intervalHead != NULL);
-
-  fprintf(stderr, "BBGG: Combining small adjacent interval pairs.\n");
+  if (((nextInterval = malloc(symbolCount * sizeof(size_t))) == NULL) || ((priorInterval = malloc(symbolCount * sizeof(size_t))) == NULL) || ((intervalEnd = malloc(symbolCount * sizeof(size_t))) == NULL) || ((intervalPop = malloc(symbolCount * sizeof(uint32_t))) == NULL)) {
+    perror("Can't allocate interval arrays");
+    exit(EX_OSERR);
+  }
 
-  for (curBuckets = symbolCount; curBuckets > *buckets; curBuckets--) {
-    curNode = RBMinQuery(tree);
-    assert(curNode != NULL);
-    currentInterval = curNode->info;
+  fprintf(stderr, "BBGG: Building interval heap.\n");
+  for (j = 0; j < symbolCount; j++) {
+    nextInterval[j] = (j + 1 < symbolCount) ? (j + 1) : SIZE_MAX;
+    priorInterval[j] = (j > 0) ? (j - 1) : SIZE_MAX;
+    intervalEnd[j] = j;
+    intervalPop[j] = symbolTable[3 * j + 1];
+  }
 
-    /*We shouldn't get the end node here*/
-    assert(currentInterval->nextNode != NULL);
+  for (j = 0; j < symbolCount; j++) {
+    h.keys[j] = intervalKey(symbolTable, intervalPop, nextInterval, j);
+    h.heap[j] = j;
+    h.position[j] = j;
+  }
+  h.size = symbolCount;
 
-    nextIndex = (currentInterval->nextNode)->treeKey;
-    nextNode = RBExactQuery(tree, &nextIndex);
-    assert(nextNode != NULL);
-    nextInterval = nextNode->info;
+  /*Floyd's heap construction*/
+  for (j = symbolCount / 2; j > 0; j--) {
+    heapSiftDown(&h, j - 1);
+  }
 
-    currentInterval->intervalEnd = nextInterval->intervalEnd;
-    currentInterval->intervalPop += nextInterval->intervalPop;
-    currentInterval->nextNode = nextInterval->nextNode;
+  fprintf(stderr, "BBGG: Combining small adjacent interval pairs.\n");
 
-    if (currentInterval->nextNode != NULL) {
-      currentInterval->nextNode->priorNode = currentInterval;
-    }
+  for (curBuckets = symbolCount; curBuckets > *buckets; curBuckets--) {
+    assert(h.size == curBuckets);
+    curInterval = h.heap[0];
 
-    RBDelete(tree, nextNode);
-    RBDelete(tree, curNode);
+    /*We shouldn't get the end interval here*/
+    mergedInterval = nextInterval[curInterval];
+    assert(mergedInterval != SIZE_MAX);
 
-    updateTreeKey(currentInterval);
-    RBTreeInsert(tree, &(currentInterval->treeKey), currentInterval);
+    intervalEnd[curInterval] = intervalEnd[mergedInterval];
+    intervalPop[curInterval] += intervalPop[mergedInterval];
+    nextInterval[curInterval] = nextInterval[mergedInterval];
 
-    if (currentInterval->priorNode != NULL) {
-      priorIndex = currentInterval->priorNode->treeKey;
-      priorNode = RBExactQuery(tree, &priorIndex);
-      assert(priorNode != NULL);
+    if (nextInterval[curInterval] != SIZE_MAX) {
+      priorInterval[nextInterval[curInterval]] = curInterval;
+    }
 
-      priorInterval = priorNode->info;
-      assert(priorInterval != NULL);
+    heapRemove(&h, mergedInterval);
 
-      RBDelete(tree, priorNode);
+    h.keys[curInterval] = intervalKey(symbolTable, intervalPop, nextInterval, curInterval);
+    heapUpdate(&h, curInterval);
 
-      updateTreeKey(priorInterval);
-      RBTreeInsert(tree, &(priorInterval->treeKey), priorInterval);
+    if (priorInterval[curInterval] != SIZE_MAX) {
+      h.keys[priorInterval[curInterval]] = intervalKey(symbolTable, intervalPop, nextInterval, priorInterval[curInterval]);
+      heapUpdate(&h, priorInterval[curInterval]);
     }
-
-    assert(nextInterval != NULL);
-    free(nextInterval);
-    nextInterval = NULL;
   }
 
   fprintf(stderr, "BBGG: Extracting intervals.\n");
 
-  currentInterval = intervalHead;
   i = 0;
-  while (currentInterval != NULL) {
-    intervals[3 * i] = currentInterval->intervalStart;
-    intervals[3 * i + 1] = currentInterval->intervalEnd;
-    intervals[3 * i + 2] = currentInterval->intervalPop;
-
-    curNode = RBExactQuery(tree, &(currentInterval->treeKey));
-    RBDelete(tree, curNode);
-
-    lastInterval = currentInterval;
-    currentInterval = currentInterval->nextNode;
-    assert(lastInterval != NULL);
-    free(lastInterval);
-    lastInterval = NULL;
+  for (j = 0; j != SIZE_MAX; j = nextInterval[j]) {
+    intervals[3 * i] = symbolTable[3 * j];
+    intervals[3 * i + 1] = symbolTable[3 * intervalEnd[j]];
+    intervals[3 * i + 2] = intervalPop[j];
     i++;
   }
+  assert(i == curBuckets);
 
-  /*The tree should be empty. Destroy it*/
-  assert(NULL == RBMinQuery(tree));
-  RBTreeDestroy(tree);
-  tree = NULL;
+  free(h.keys);
+  free(h.heap);
+  free(h.position);
+  free(nextInterval);
+  free(priorInterval);
+  free(intervalEnd);
+  free(intervalPop);
 
   *buckets = curBuckets;
 
   return (chiSquareScore(intervals, curBuckets, targetPopulation, targetBuckets));
 }
 
-static double bucketByOrderedGreedy(uint32_t *symbolTable, size_t symbolCount, uint32_t *intervals, size_t *buckets, double targetPopulation) {
+static double bucketByOrderedGreedy(const uint32_t *symbolTable, size_t symbolCount, uint32_t *intervals, size_t *buckets, double targetPopulation) {
   size_t i;
   size_t curSymbol;
   size_t localTargetPopulation;
@@ -425,15 +370,36 @@ static double bucketByOrderedGreedy(uint32_t *symbolTable, size_t symbolCount, u
   return (chiSquareScore(intervals, *buckets, targetPopulation, targetBuckets));
 }
 
+/*populationPrefix[j] is the total population of symbols 0, ..., j-1 so that the population of the symbols
+ *in the closed index interval [a, b] is populationPrefix[b+1] - populationPrefix[a].
+ */
+static size_t *populationPrefixSums(const uint32_t *symbolTable, size_t symbolCount) {
+  size_t *populationPrefix;
+  size_t j;
+
+  if ((populationPrefix = malloc((symbolCount + 1) * sizeof(size_t))) == NULL) {
+    perror("Can't allocate array for population prefix sums");
+    exit(EX_OSERR);
+  }
+
+  populationPrefix[0] = 0;
+  for (j = 0; j < symbolCount; j++) {
+    populationPrefix[j + 1] = populationPrefix[j] + symbolTable[3 * j + 1];
+  }
+
+  return populationPrefix;
+}
+
 /*This function takes single interval, and looks for a good place to split it
  *(in a way that minimizes the resulting chi square sum)
- *It returns 1 if a split occurred, and 0 otherwise
- *This operates on the symbolTable, and the left and right endpoints are indexes.
+ *The left and right endpoints are symbol indexes.
+ *It returns the index of the first symbol in the new right-hand interval if a split occurred, and 0 otherwise
  */
-static size_t medianSplit(uint32_t *symbolTable, size_t leftEndpoint, size_t rightEndpoint) {
+static size_t medianSplit(const size_t *populationPrefix, size_t leftEndpoint, size_t rightEndpoint) {
   size_t intervalCount;
   size_t fullIntervalCount;
   size_t intervalTarget;
+  size_t low, high, mid;
   size_t i;
 
   /*If the right and left endpoint of this interval are equal, we can't do anything to split it*/
@@ -442,123 +408,86 @@ static size_t medianSplit(uint32_t *symbolTable, size_t leftEndpoint, size_t rig
   }
 
   /*Count the number of samples are in this closed interval*/
-  fullIntervalCount = 0;
-  for (i = leftEndpoint; i <= rightEndpoint; i++) {
-    fullIntervalCount += symbolTable[3 * i + 1];
-  }
+  fullIntervalCount = populationPrefix[rightEndpoint + 1] - populationPrefix[leftEndpoint];
 
   /*We're looking for the median, so half should be on each side*/
   /* This is the same as intervalTarget /= 2;*/
   intervalTarget = fullIntervalCount >> 1;
 
-  /*We necessarily include the first symbol within the first resulting interval*/
-  intervalCount = symbolTable[3 * leftEndpoint + 1];
-  /* Add until:
-   *  We've added the right endpoint
-   *  adding the next interval puts us over the target
+  /*We necessarily include the first symbol within the first resulting interval.
+   *Find the first symbol i whose inclusion puts us over the target (every symbol has a non-zero population,
+   *so the prefix sums are strictly increasing).
    */
-  for (i = leftEndpoint + 1; (i <= rightEndpoint) && ((intervalCount + symbolTable[3 * i + 1]) <= intervalTarget); i++) {
-    intervalCount += symbolTable[3 * i + 1];
+  low = leftEndpoint + 1;
+  high = rightEndpoint + 1;
+  while (low < high) {
+    mid = low + ((high - low) >> 1);
+    if (populationPrefix[mid + 1] - populationPrefix[leftEndpoint] > intervalTarget) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
   }
+  i = low;
+  assert(i <= rightEndpoint);
+  intervalCount = populationPrefix[i] - populationPrefix[leftEndpoint];
 
-  /* if we haven't added the right endpoint, check if we should do so
-   *
-   */
-  if ((i <= rightEndpoint) && ((2 * intervalCount + symbolTable[3 * i + 1]) <= fullIntervalCount)) {
+  /* Check if we should include symbol i */
+  if ((2 * intervalCount + (populationPrefix[i + 1] - populationPrefix[i])) <= fullIntervalCount) {
     /*It is better to include the current value*/
-    symbolTable[3 * i + 2] |= RIGHTENDPOINTFLAG;
-    symbolTable[3 * (i + 1) + 2] |= LEFTENDPOINTFLAG;
+    assert(i < rightEndpoint);
+    return i + 1;
   } else {
-    symbolTable[3 * (i - 1) + 2] |= RIGHTENDPOINTFLAG;
-    symbolTable[3 * i + 2] |= LEFTENDPOINTFLAG;
+    return i;
   }
-
-  return 1;
 }
 
-/*Setup the interval table based on the intervals noted in the symbol table*/
-static size_t extractIntervals(uint32_t *symbolTable, size_t symbolCount, uint32_t *intervals) {
-  size_t currentLeftEndpoint;
-  size_t currentRightEndpoint;
-  uint32_t currentIntervalCount;
-  size_t i, j;
-
-  /*Fill out the interval table*/
-  currentLeftEndpoint = SIZE_MAX;
-  currentRightEndpoint = SIZE_MAX;
-  j = 0;
-  currentIntervalCount = 0;
-
-  for (i = 0; i < symbolCount; i++) {
-    if ((symbolTable[i * 3 + 2] & LEFTENDPOINTFLAG) != 0) {
-      assert(currentLeftEndpoint == SIZE_MAX);
-      currentLeftEndpoint = i;
-      currentIntervalCount = 0;
-    }
-
-    /*At this point, the left endpoint should be established*/
-    assert(currentLeftEndpoint != SIZE_MAX);
-    currentIntervalCount += symbolTable[i * 3 + 1];
+/*Setup the interval table based on the interval starting points in cuts*/
+/*cuts[cutCount] is symbolCount*/
+static void extractIntervals(const uint32_t *symbolTable, const size_t *populationPrefix, const size_t *cuts, size_t cutCount, uint32_t *intervals) {
+  size_t j;
 
-    if ((symbolTable[i * 3 + 2] & RIGHTENDPOINTFLAG) != 0) {
-      // End the interval
-      assert(currentRightEndpoint == SIZE_MAX);
-      currentRightEndpoint = i;
-      intervals[j * 3] = symbolTable[currentLeftEndpoint * 3];
-      intervals[j * 3 + 1] = symbolTable[currentRightEndpoint * 3];
-      intervals[j * 3 + 2] = currentIntervalCount;
-      currentRightEndpoint = SIZE_MAX;
-      currentLeftEndpoint = SIZE_MAX;
-      currentIntervalCount = 0;
-      j++;
-    }
+  for (j = 0; j < cutCount; j++) {
+    intervals[j * 3] = symbolTable[cuts[j] * 3];
+    intervals[j * 3 + 1] = symbolTable[(cuts[j + 1] - 1) * 3];
+    intervals[j * 3 + 2] = (uint32_t)(populationPrefix[cuts[j + 1]] - populationPrefix[cuts[j]]);
   }
-
-  return (j);
 }
 
-/*Go through all the intervals (as noted within the symbolTable), and split each one (if possible) */
-/*Return the number of additional intervals*/
-static size_t medianSplitEachInterval(uint32_t *symbolTable, size_t symbolCount) {
-  size_t currentLeftEndpoint;
-  size_t currentRightEndpoint;
-  size_t addedBuckets;
+/*Go through all the intervals (as noted within cuts), and split each one (if possible) */
+/*The resulting interval starting points are written to newCuts. Return the new number of intervals.*/
+static size_t medianSplitEachInterval(const size_t *populationPrefix, const size_t *cuts, size_t cutCount, size_t *newCuts) {
+  size_t newCutCount;
+  size_t split;
   size_t j;
 
-  /*Now, for each required halving, median split each existing interval*/
-  currentLeftEndpoint = SIZE_MAX;
-  currentRightEndpoint = SIZE_MAX;
-  addedBuckets = 0;
-
-  for (j = 0; j < symbolCount; j++) {
-    if ((symbolTable[j * 3 + 2] & LEFTENDPOINTFLAG) != 0) {
-      assert(currentLeftEndpoint == SIZE_MAX);
-      currentLeftEndpoint = j;
-    }
-
-    assert(currentLeftEndpoint != SIZE_MAX);
-
-    if ((symbolTable[j * 3 + 2] & RIGHTENDPOINTFLAG) != 0) {
-      assert(currentRightEndpoint == SIZE_MAX);
-      currentRightEndpoint = j;
-      // Split the interval
-      addedBuckets += medianSplit(symbolTable, currentLeftEndpoint, currentRightEndpoint);
-      currentRightEndpoint = SIZE_MAX;
-      currentLeftEndpoint = SIZE_MAX;
+  newCutCount = 0;
+  for (j = 0; j < cutCount; j++) {
+    newCuts[newCutCount++] = cuts[j];
+    // Split the interval
+    split = medianSplit(populationPrefix, cuts[j], cuts[j + 1] - 1);
+    if (split != 0) {
+      newCuts[newCutCount++] = split;
     }
   }
-  return (addedBuckets);
+
+  newCuts[newCutCount] = cuts[cutCount];
+  return (newCutCount);
 }
 
-static double bucketByMedianSplitting(uint32_t *symbolTable, size_t symbolCount, /*@out@*/ uint32_t *intervals, size_t *buckets, double targetPopulation) {
+static double bucketByMedianSplitting(const uint32_t *symbolTable, size_t symbolCount, /*@out@*/ uint32_t *intervals, size_t *buckets, double targetPopulation) {
   size_t expBuckets;
   size_t logBuckets;
   size_t currentBuckets;
   size_t lastBuckets;
   size_t targetBuckets;
-  size_t i, j;
+  size_t i;
   double curChi, oldChi;
   uint32_t *lastIntervals;
+  size_t *populationPrefix;
+  size_t *cuts;
+  size_t *newCuts;
+  size_t *tmpCuts;
 
   /*Find the nearest power of 2 equal to or greater than buckets (expBuckets)*/
   /*Put the log of expBuckets into logBuckets*/
@@ -582,30 +511,35 @@ static double bucketByMedianSplitting(uint32_t *symbolTable, size_t symbolCount,
     exit(EX_OSERR);
   }
 
+  /*Set up the interval starting point lists*/
+  if (((cuts = malloc((symbolCount + 1) * sizeof(size_t))) == NULL) || ((newCuts = malloc((symbolCount + 1) * sizeof(size_t))) == NULL)) {
+    perror("Can't allocate array for interval starting points");
+    exit(EX_OSERR);
+  }
+
+  populationPrefix = populationPrefixSums(symbolTable, symbolCount);
+
   targetBuckets = *buckets;
 
   fprintf(stderr, "BBMS: Targeting %zu buckets (%zu initial cuts)\n", targetBuckets, logBuckets);
 
-  /*Clear out any endpoints marked*/
-  for (i = 0; i < symbolCount; i++) {
-    symbolTable[i * 3 + 2] = 0;
-  }
-
   /*Mark initial interval endpoints*/
-  symbolTable[2] = LEFTENDPOINTFLAG;
-  symbolTable[(symbolCount - 1) * 3 + 2] |= RIGHTENDPOINTFLAG;
+  cuts[0] = 0;
+  cuts[1] = symbolCount;
   currentBuckets = 1;
 
   /*do the initial set of median splitting*/
   for (i = 0; i < logBuckets; i++) {
-    currentBuckets += medianSplitEachInterval(symbolTable, symbolCount);
+    currentBuckets = medianSplitEachInterval(populationPrefix, cuts, currentBuckets, newCuts);
+    tmpCuts = cuts;
+    cuts = newCuts;
+    newCuts = tmpCuts;
   }
 
   fprintf(stderr, "BBMS: Initial cuts rendered %zu intervals\n", currentBuckets);
 
   /*Form up the intervals from the initial approach*/
-  j = extractIntervals(symbolTable, symbolCount, intervals);
-  assert(j == currentBuckets);
+  extractIntervals(symbolTable, populationPrefix, cuts, currentBuckets, intervals);
   curChi = chiSquareScore(intervals, currentBuckets, targetPopulation, targetBuckets);
   oldChi = curChi;
   lastBuckets = currentBuckets;
@@ -615,10 +549,12 @@ static double bucketByMedianSplitting(uint32_t *symbolTable, size_t symbolCount,
     memcpy(lastIntervals, intervals, 3 * sizeof(uint32_t) * lastBuckets);
     oldChi = curChi;
 
-    currentBuckets += medianSplitEachInterval(symbolTable, symbolCount);
+    currentBuckets = medianSplitEachInterval(populationPrefix, cuts, currentBuckets, newCuts);
+    tmpCuts = cuts;
+    cuts = newCuts;
+    newCuts = tmpCuts;
 
-    j = extractIntervals(symbolTable, symbolCount, intervals);
-    assert(j == currentBuckets);
+    extractIntervals(symbolTable, populationPrefix, cuts, currentBuckets, intervals);
     curChi = chiSquareScore(intervals, currentBuckets, targetPopulation, targetBuckets);
   }
 
@@ -632,6 +568,9 @@ static double bucketByMedianSplitting(uint32_t *symbolTable, size_t symbolCount,
   assert(lastIntervals != NULL);
   free(lastIntervals);
   lastIntervals = NULL;
+  free(cuts);
+  free(newCuts);
+  free(populationPrefix);
 
   *buckets = currentBuckets;
 
@@ -667,6 +606,80 @@ static bool testIntervals(uint32_t *intervals, size_t numOfIntervals, size_t dat
   return (true);
 }
 
+/*LSD radix sort of the L values in data into sortedData, 8 bits per pass.
+ *All four digit histograms are gathered in a single pass, and passes where every value shares the same digit are skipped.
+ */
+static void radixSortUint32(const uint32_t *data, uint32_t *sortedData, size_t L) {
+  size_t (*digitCounts)[256];
+  size_t offset;
+  size_t count;
+  size_t i;
+  unsigned int pass;
+  unsigned int shift;
+  unsigned int digit;
+  const uint32_t *src;
+  uint32_t *dst;
+  uint32_t *scratch = NULL;
+
+  assert(L > 0);
+
+  if ((digitCounts = calloc(4, sizeof(*digitCounts))) == NULL) {
+    perror("Can't allocate array for radix sort histograms");
+    exit(EX_OSERR);
+  }
+
+  for (i = 0; i < L; i++) {
+    digitCounts[0][data[i] & 0xFF]++;
+    digitCounts[1][(data[i] >> 8) & 0xFF]++;
+    digitCounts[2][(data[i] >> 16) & 0xFF]++;
+    digitCounts[3][data[i] >> 24]++;
+  }
+
+  src = data;
+  dst = sortedData;
+
+  for (pass = 0; pass < 4; pass++) {
+    shift = 8 * pass;
+
+    /*Is this digit the same for every value?*/
+    if (digitCounts[pass][(data[0] >> shift) & 0xFF] == L) {
+      continue;
+    }
+
+    /*Convert the histogram into starting offsets*/
+    offset = 0;
+    for (digit = 0; digit < 256; digit++) {
+      count = digitCounts[pass][digit];
+      digitCounts[pass][digit] = offset;
+      offset += count;
+    }
+
+    if (dst == NULL) {
+      /*The scratch buffer is only needed for a second non-trivial pass*/
+      if ((scratch = malloc(L * sizeof(uint32_t))) == NULL) {
+        perror("Can't allocate array for radix sort");
+        exit(EX_OSERR);
+      }
+      dst = scratch;
+    }
+
+    for (i = 0; i < L; i++) {
+      dst[digitCounts[pass][(src[i] >> shift) & 0xFF]++] = src[i];
+    }
+
+    /*The next pass reads what was just written, and writes to the other working buffer*/
+    src = dst;
+    dst = (dst == sortedData) ? scratch : sortedData;
+  }
+
+  if (src != sortedData) {
+    memcpy(sortedData, src, L * sizeof(uint32_t));
+  }
+
+  free(scratch);
+  free(digitCounts);
+}
+
 static uint32_t *generateSymbolTable(uint32_t *data, size_t L, size_t *outNumOfSymbols) {
   uint32_t m;
   uint32_t bits;
@@ -693,7 +706,7 @@ static uint32_t *generateSymbolTable(uint32_t *data, size_t L, size_t *outNumOfS
   bits = (uint32_t)doubleBits;
   fprintf(stderr, "Maximum symbol is %u (%u bit)\n", m, bits);
 
-  if (((double)(3 * m) < (((double)L) + 1.39 * ((double)L) * log2((double)L))) && (log2((double)m + 1.0) < 28.0)) {
+  if (((double)(3 * m) < 8.0 * ((double)L)) && (log2((double)m + 1.0) < 28.0)) {
     fprintf(stderr, "Using a look-up table approach\n");
     /*A table based approach is likely better*/
     /*3m + L ops*/
@@ -745,7 +758,7 @@ static uint32_t *generateSymbolTable(uint32_t *data, size_t L, size_t *outNumOfS
   } else {
     /*Likely better to do a sorting-based approach*/
     /*Or the lookup table is likely to be larger than 1 GB*/
-    /*2L + 1.39 * L * log2(L) operations*/
+    /*At most 9L operations*/
 
     fprintf(stderr, "Using a sorting approach\n");
 
@@ -754,15 +767,10 @@ static uint32_t *generateSymbolTable(uint32_t *data, size_t L, size_t *outNumOfS
       exit(EX_OSERR);
     }
 
-    fprintf(stderr, "Copying data...\n");
-
-    /*L ops*/
-    memcpy(sortedData, data, L * sizeof(uint32_t));
-
     fprintf(stderr, "Sorting data...\n");
 
-    /*1.39 * L * log2(L) ops on average*/
-    qsort(sortedData, L, sizeof(uint32_t), uintcompare);
+    /*L + 2L per non-trivial pass*/
+    radixSortUint32(data, sortedData, L);
 
     fprintf(stderr, "Tabulating symbols...\n");
 
@@ -810,6 +818,126 @@ static uint32_t *generateSymbolTable(uint32_t *data, size_t L, size_t *outNumOfS
   return (symbolTable);
 }
 
+/*Compile the (sorted, disjoint) interval table into a direct look-up table indexed by (symbol - first interval start).
+ *Unobserved symbols that fall between two intervals are assigned to the following interval; these never occur in the data.
+ */
+static statData_t *compileRewriteTable(const uint32_t *intervals, size_t buckets, size_t span) {
+  statData_t *lookupTable;
+  size_t i;
+  size_t j;
+  size_t base;
+
+  assert(buckets > 0);
+  assert(buckets - 1 <= STATDATA_MAX);
+
+  if ((lookupTable = malloc(span * sizeof(statData_t))) == NULL) {
+    perror("Can't allocate array for rewrite look-up table");
+    exit(EX_OSERR);
+  }
+
+  base = intervals[0];
+  j = 0;
+  for (i = 0; i < buckets; i++) {
+    for (; j <= (size_t)intervals[3 * i + 1] - base; j++) {
+      lookupTable[j] = (statData_t)i;
+    }
+  }
+  assert(j == span);
+
+  return lookupTable;
+}
+
+/*Branch-free search for the last interval whose start point is <= key.
+ *Requires starts[0] <= key. The loop has a fixed trip count of about log2(buckets), and the compiler renders the
+ *conditional as a conditional move.
+ */
+static size_t intervalSearch(const uint32_t *starts, size_t buckets, uint32_t key) {
+  const uint32_t *base = starts;
+  size_t n = buckets;
+  size_t half;
+
+  while (n > 1) {
+    half = n >> 1;
+    base = (base[half] <= key) ? (base + half) : base;
+    n -= half;
+  }
+
+  return (size_t)(base - starts);
+}
+
+/*Rewrite each sample as the index of the interval that contains it, and write the result to stdout.
+ *If the observed symbol range is not much larger than the data, this is a direct table look-up; otherwise it is
+ *a branch-free search over a packed array of interval start points.
+ *Output is written in blocks of OUTPUTBLOCKLEN symbols.
+ */
+static void rewriteData(const uint32_t *data, size_t datalen, const uint32_t *intervals, size_t buckets) {
+  statData_t outputBlock[OUTPUTBLOCKLEN];
+  statData_t *lookupTable = NULL;
+  uint32_t *starts = NULL;
+  uint32_t lowSymbol;
+  uint32_t highSymbol;
+  size_t span;
+  size_t blockLen;
+  size_t curInterval;
+  size_t i;
+  size_t j;
+
+  assert(buckets > 0);
+
+  lowSymbol = intervals[0];
+  highSymbol = intervals[3 * (buckets - 1) + 1];
+  assert(lowSymbol <= highSymbol);
+  span = (size_t)(highSymbol - lowSymbol) + 1;
+
+  if ((span <= 4 * datalen) && (span <= REWRITELUTMAX)) {
+    fprintf(stderr, "Using a %zu entry rewrite look-up table\n", span);
+    lookupTable = compileRewriteTable(intervals, buckets, span);
+  } else {
+    fprintf(stderr, "Using a search over %zu interval start points\n", buckets);
+    if ((starts = malloc(buckets * sizeof(uint32_t))) == NULL) {
+      perror("Can't allocate array for interval start points");
+      exit(EX_OSERR);
+    }
+    for (j = 0; j < buckets; j++) {
+      starts[j] = intervals[3 * j];
+    }
+  }
+
+  for (i = 0; i < datalen; i += blockLen) {
+    blockLen = ((datalen - i) < OUTPUTBLOCKLEN) ? (datalen - i) : OUTPUTBLOCKLEN;
+
+    for (j = 0; j < blockLen; j++) {
+      if ((data[i + j] < lowSymbol) || (data[i + j] > highSymbol)) {
+        fprintf(stderr, "Can't find the correct interval.\n");
+        exit(EX_DATAERR);
+      }
+
+      if (lookupTable != NULL) {
+        outputBlock[j] = lookupTable[data[i + j] - lowSymbol];
+      } else {
+        curInterval = intervalSearch(starts, buckets, data[i + j]);
+        if (data[i + j] > intervals[3 * curInterval + 1]) {
+          fprintf(stderr, "Can't find the correct interval.\n");
+          exit(EX_DATAERR);
+        }
+        outputBlock[j] = (statData_t)curInterval;
+      }
+    }
+
+    if (fwrite(outputBlock, sizeof(statData_t), blockLen, stdout) != blockLen) {
+      perror("Can't write output to stdout");
+      exit(EX_OSERR);
+    }
+  }
+
+  if (lookupTable != NULL) {
+    free(lookupTable);
+  }
+  if (starts != NULL) {
+    free(starts);
+  }
+}
+
 int main(int argc, char *argv[]) {
   FILE *infp;
   uint32_t *data = NULL;
@@ -824,17 +952,12 @@ int main(int argc, char *argv[]) {
   double BBGGscore;
   double BBOGscore;
   double BBMSscore;
-  size_t i;
   uint32_t outputBits;
   size_t outputBuckets;
   size_t datalen;
-  uint32_t *curinterval;
   long outputInt;
   size_t numOfSymbols;
   double targetPopulation;
-  uint32_t curLocation;
-  size_t offset;
-  statData_t outputSymbol;
 
   assert(PRECISION(UINT_MAX) >= 32);
   assert(PRECISION(ULONG_MAX) > 32);
@@ -985,27 +1108,7 @@ int main(int argc, char *argv[]) {
   assert(outputBuckets - 1 <= STATDATA_MAX);
 
   fprintf(stderr, "Translating data...\n");
-  for (i = 0; i < datalen; i++) {
-    if ((curinterval = bsearch(data + i, rewriteTable, outputBuckets, 3 * sizeof(uint32_t), intervalMembershipCompare)) == NULL) {
-      perror("Can't find the correct interval.");
-      exit(EX_DATAERR);
-    }
-
-    assert(curinterval >= rewriteTable);
-    assert((curinterval - rewriteTable) % 3 == 0);
-    offset = (uint64_t)(curinterval - rewriteTable) / 3;
-    assert(offset <= UINT32_MAX);
-    curLocation = (uint32_t)offset;
-
-    assert(((size_t)curLocation) < outputBuckets);
-
-    outputSymbol = (statData_t)curLocation;
-
-    if (fwrite(&outputSymbol, sizeof(statData_t), 1, stdout) != 1) {
-      perror("Can't write output to stdout");
-      exit(EX_OSERR);
-    }
-  }
+  rewriteData(data, datalen, rewriteTable, outputBuckets);
 
   free(rewriteTable);
   free(data);
@@ -134,7 +134,7 @@ double incbeta(double a, double b, double x) {
           fprintf(stderr, "Found an overflow ");
         }
         fprintf(stderr, "\n");
-        exit(EX_DATAERR);
+        fatalError(EX_DATAERR);
       }
 
       assert(fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW) == 0);
@@ -143,5 +143,5 @@ double incbeta(double a, double b, double x) {
   }
 
   fprintf(stderr, "incbeta result did not converge\n");
-  exit(EX_DATAERR);
+  fatalError(EX_DATAERR);
 }
@@ -19,6 +19,7 @@
 #include <time.h>
 
 #include "binio.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -34,18 +35,32 @@ noreturn static void useageExit(void) {
   exit(EX_USAGE);
 }
 
+static size_t inputLength(FILE *input) {
+  size_t fileSize;
+
+  fileSize = getfilesize(input);
+  if ((fileSize % sizeof(statData_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+
+  return fileSize / sizeof(statData_t);
+}
+
 int main(int argc, char *argv[]) {
-  FILE *infp;
+  FILE *infp1;
+  FILE *infp2;
   size_t datalen1, datalen2;
-  statData_t *data1;
-  statData_t *data2;
-  statData_t *combinedData;
   size_t symbolSets;
+  struct blockReader reader1;
+  struct blockReader reader2;
+  struct blockWriter writer;
+  const statData_t *block1;
+  const statData_t *block2;
+  size_t blockLen1, blockLen2;
+  size_t pos1, pos2;
   int opt;
 
   configVerbose = 0;
-  data1 = NULL;
-  data2 = NULL;
 
   assert(PRECISION(UINT_MAX) >= 32);
 
@@ -66,61 +81,99 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  if ((infp = fopen(argv[0], "rb")) == NULL) {
+  if ((infp1 = fopen(argv[0], "rb")) == NULL) {
     perror("Can't open inputfile1");
     exit(EX_NOINPUT);
   }
 
-  datalen1 = readuintfile(infp, &data1);
-  assert(data1 != NULL);
+  datalen1 = inputLength(infp1);
 
   if (configVerbose > 0) {
     fprintf(stderr, "Read in %zu integers from inputfile1\n", datalen1);
   }
-  if (fclose(infp) != 0) {
-    perror("Couldn't close inputfile1");
-    exit(EX_OSERR);
-  }
 
   assert(datalen1 > 0);
 
-  if ((infp = fopen(argv[1], "rb")) == NULL) {
+  if ((infp2 = fopen(argv[1], "rb")) == NULL) {
     perror("Can't open inputfile2");
     exit(EX_NOINPUT);
   }
 
-  datalen2 = readuintfile(infp, &data2);
-  assert(data2 != NULL);
+  datalen2 = inputLength(infp2);
 
   if (configVerbose > 0) {
     fprintf(stderr, "Read in %zu integers from inputfile2\n", datalen2);
   }
-  if (fclose(infp) != 0) {
-    perror("Couldn't close inputfile2");
-    exit(EX_OSERR);
-  }
 
   assert(datalen2 > 0);
 
-  symbolSets = (datalen1<datalen2)?datalen1:datalen2;
+  symbolSets = (datalen1 < datalen2) ? datalen1 : datalen2;
 
-  if((combinedData = malloc(sizeof(statData_t)*symbolSets*2))==NULL) {
-    perror("Couldn't allocate memory");
-    exit(EX_OSERR);
+  // Both inputs are read a block at a time; the two streams' blocks need not line up.
+  initBlockReader(&reader1, infp1, sizeof(statData_t), true);
+  initBlockReader(&reader2, infp2, sizeof(statData_t), true);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+
+  blockLen1 = pos1 = 0;
+  blockLen2 = pos2 = 0;
+  block1 = NULL;
+  block2 = NULL;
+
+  while (symbolSets > 0) {
+    statData_t *out;
+    size_t outLen;
+    size_t pairs;
+
+    if (pos1 == blockLen1) {
+      if ((blockLen1 = readBlock(&reader1, (const void **)&block1)) == 0) break;
+      pos1 = 0;
+    }
+
+    if (pos2 == blockLen2) {
+      if ((blockLen2 = readBlock(&reader2, (const void **)&block2)) == 0) break;
+      pos2 = 0;
+    }
+
+    out = reserveElements(&writer, &outLen);
+    pairs = outLen / 2;
+    if (pairs == 0) {
+      // Not enough room for a pair; write what's buffered and try again.
+      flushBlockWriter(&writer);
+      continue;
+    }
+    if (pairs > blockLen1 - pos1) pairs = blockLen1 - pos1;
+    if (pairs > blockLen2 - pos2) pairs = blockLen2 - pos2;
+    if (pairs > symbolSets) pairs = symbolSets;
+
+    for (size_t i = 0; i < pairs; i++) {
+      out[2 * i] = block1[pos1 + i];
+      out[2 * i + 1] = block2[pos2 + i];
+    }
+
+    commitElements(&writer, 2 * pairs);
+    pos1 += pairs;
+    pos2 += pairs;
+    symbolSets -= pairs;
   }
 
-  for(size_t i=0; i<symbolSets; i++) {
-    combinedData[2*i] = data1[i];
-    combinedData[2*i+1] = data2[i];
+  if (symbolSets != 0) {
+    fprintf(stderr, "Input ended early\n");
+    exit(EX_DATAERR);
   }
 
-  if (fwrite(combinedData, sizeof(statData_t), symbolSets*2, stdout) != symbolSets*2) {
-    perror("Can't write to output");
+  freeBlockReader(&reader1);
+  freeBlockReader(&reader2);
+  freeBlockWriter(&writer);
+
+  if (fclose(infp1) != 0) {
+    perror("Couldn't close inputfile1");
+    exit(EX_OSERR);
+  }
+
+  if (fclose(infp2) != 0) {
+    perror("Couldn't close inputfile2");
     exit(EX_OSERR);
   }
 
-  free(data1);
-  free(data2);
-  free(combinedData);
   return EX_OK;
 }
@@ -0,0 +1,216 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sysexits.h>
+
+#include "entlib.h"
+#include "libtheseus.h"
+
+/*Calls the libtheseus assessments on short data (too short for some or all of the estimators) and checks that each call
+ *returns a status, rather than ending the program. It then runs assessments on several threads at once (each with its
+ *own context), and checks that they match the same assessments run one at a time. This links against libtheseus.a, as a
+ *library user would.
+ */
+
+#define MAXTESTLEN 16
+#define THREADCOUNT 4
+#define THREADROUNDS 3
+#define THREADTESTLEN 5000
+
+enum testPattern { constantPattern, alternatingPattern, distinctPattern, binaryPattern, bytePattern };
+static const char *const patternNames[] = {"constant", "alternating", "distinct", "binary", "byte"};
+
+static const uint32_t testMasks[] = {0xFFFF, MCVESTIMATEMASK, COLSESTIMATEMASK, SAESTIMATEMASK, TREELZ78YESTIMATEMASK};
+
+static void fillPattern(enum testPattern pattern, statData_t *data, size_t datalen) {
+  uint32_t state = 0x2545F491U;
+
+  for (size_t j = 0; j < datalen; j++) {
+    state = state * 1664525U + 1013904223U;
+
+    switch (pattern) {
+      case constantPattern:
+        data[j] = 0;
+        break;
+      case alternatingPattern:
+        data[j] = (statData_t)(j & 1U);
+        break;
+      case distinctPattern:
+        data[j] = (statData_t)(j * 17U);
+        break;
+      case binaryPattern:
+        data[j] = (statData_t)(state >> 31);
+        break;
+      case bytePattern:
+        data[j] = (statData_t)(state >> 24);
+        break;
+      default:
+        data[j] = 0;
+        break;
+    }
+  }
+}
+
+// A call must return a status; an assessment that succeeded must also produce an estimate.
+static bool checkAssessment(const char *function, int status, const struct theseusAssessment *result, enum testPattern pattern, size_t datalen, uint32_t testMask) {
+  bool passed;
+
+  switch (status) {
+    case THESEUS_OK:
+      passed = isfinite(result->assessedEntropy) && (result->assessedEntropy >= 0.0);
+      break;
+    case THESEUS_EINVAL:
+    case THESEUS_EDATA:
+      passed = true;
+      break;
+    default:
+      passed = false;
+      break;
+  }
+
+  if (!passed) {
+    fprintf(stderr, "%s: %s data, length %zu, estimators 0x%X: status %d, assessed entropy %.17g\n", function, patternNames[pattern], datalen, testMask, status, result->assessedEntropy);
+  }
+
+  return passed;
+}
+
+struct threadTest {
+  pthread_t thread;
+  enum testPattern pattern;
+  statData_t data[THREADTESTLEN];
+  double expected;
+  size_t failures;
+};
+
+static void *assessInThread(void *ptr) {
+  struct threadTest *test = ptr;
+  struct theseusOptions options;
+  struct theseusContext *context;
+  struct theseusAssessment result;
+
+  theseusDefaultOptions(&options);
+  options.deterministic = true;
+
+  if ((context = theseusCreateContext(&options)) == NULL) {
+    test->failures++;
+    return NULL;
+  }
+
+  for (size_t r = 0; r < THREADROUNDS; r++) {
+    int status = theseusNonIIDAssessment(context, test->data, THREADTESTLEN, &result);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+    if ((status != THESEUS_OK) || (result.assessedEntropy != test->expected)) {
+#pragma GCC diagnostic pop
+      fprintf(stderr, "theseusNonIIDAssessment on a thread: %s data: status %d, assessed entropy %.17g (expected %.17g)\n", patternNames[test->pattern], status, result.assessedEntropy, test->expected);
+      test->failures++;
+    }
+  }
+
+  theseusFreeContext(context);
+  return NULL;
+}
+
+// Returns the number of failures.
+static size_t testThreads(size_t *calls) {
+  static struct threadTest tests[THREADCOUNT];
+  struct theseusContext *context;
+  struct theseusAssessment result;
+  size_t failures = 0;
+
+  if ((context = theseusCreateContext(NULL)) == NULL) {
+    fprintf(stderr, "Can't create a libtheseus context\n");
+    exit(EX_OSERR);
+  }
+
+  for (size_t t = 0; t < THREADCOUNT; t++) {
+    tests[t].pattern = (enum testPattern)(alternatingPattern + t);
+    tests[t].failures = 0;
+    fillPattern(tests[t].pattern, tests[t].data, THREADTESTLEN);
+
+    if (theseusNonIIDAssessment(context, tests[t].data, THREADTESTLEN, &result) != THESEUS_OK) {
+      fprintf(stderr, "theseusNonIIDAssessment: %s data: no reference result\n", patternNames[tests[t].pattern]);
+      exit(EX_SOFTWARE);
+    }
+    tests[t].expected = result.assessedEntropy;
+    (*calls)++;
+  }
+  theseusFreeContext(context);
+
+  for (size_t t = 0; t < THREADCOUNT; t++) {
+    if (pthread_create(&tests[t].thread, NULL, assessInThread, &tests[t]) != 0) {
+      perror("Can't create a thread");
+      exit(EX_OSERR);
+    }
+  }
+
+  for (size_t t = 0; t < THREADCOUNT; t++) {
+    if (pthread_join(tests[t].thread, NULL) != 0) {
+      perror("Can't join a thread");
+      exit(EX_OSERR);
+    }
+    failures += tests[t].failures;
+    *calls += THREADROUNDS;
+  }
+
+  return failures;
+}
+
+int main(void) {
+  struct theseusOptions options;
+  struct theseusContext *context;
+  struct theseusAssessment result;
+  statData_t data[MAXTESTLEN];
+  size_t failures = 0;
+  size_t calls = 0;
+  int status;
+
+  for (size_t m = 0; m < sizeof(testMasks) / sizeof(testMasks[0]); m++) {
+    theseusDefaultOptions(&options);
+    options.deterministic = true;
+    options.testMask = testMasks[m];
+
+    if ((context = theseusCreateContext(&options)) == NULL) {
+      fprintf(stderr, "Can't create a libtheseus context\n");
+      exit(EX_OSERR);
+    }
+
+    for (int p = constantPattern; p <= bytePattern; p++) {
+      for (size_t datalen = 1; datalen <= MAXTESTLEN; datalen++) {
+        fillPattern((enum testPattern)p, data, datalen);
+
+        result.assessedEntropy = -1.0;
+        status = theseusNonIIDAssessment(context, data, datalen, &result);
+        if (!checkAssessment("theseusNonIIDAssessment", status, &result, (enum testPattern)p, datalen, testMasks[m])) failures++;
+
+        result.assessedEntropy = -1.0;
+        status = theseusBitstringAssessment(context, data, datalen, &result);
+        if (!checkAssessment("theseusBitstringAssessment", status, &result, (enum testPattern)p, datalen, testMasks[m])) failures++;
+
+        calls += 2;
+      }
+    }
+
+    theseusFreeContext(context);
+  }
+
+  failures += testThreads(&calls);
+
+  printf("%zu libtheseus calls, %zu failures\n", calls, failures);
+  return (failures == 0) ? 0 : EX_SOFTWARE;
+}
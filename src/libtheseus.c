@@ -0,0 +1,320 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <fenv.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+#include "assessments.h"
+#include "bitstats.h"
+#include "bootstrap.h"
+#include "entlib.h"
+#include "globals-inst.h"
+#include "health-tests.h"
+#include "libtheseus.h"
+#include "randlib.h"
+#include "translate.h"
+
+struct theseusContext {
+  struct theseusOptions options;
+  struct randstate rstate;
+};
+
+/*The state of the calling thread that is replaced for the duration of a library call. A fatal error in the estimators
+ *(which would end a command line tool) returns to fatalJump.
+ */
+struct libraryCall {
+  jmp_buf fatalJump;
+  fenv_t fenv;
+  size_t scratchBytes;
+};
+
+/*The estimators read their configuration from the per-thread variables in globals.h, so each call sets them from its
+ *context, and calls on different threads don't interact.
+ */
+static void enterLibrary(const struct theseusContext *context, struct libraryCall *call) {
+  // The estimators check the floating point exception flags, so they must start clear; the caller's are restored on leaving.
+  feholdexcept(&call->fenv);
+  call->scratchBytes = globalScratchBytes;
+  globalFatalJump = &call->fatalJump;
+
+  configVerbose = context->options.verbose;
+  configBootstrapConfidence = context->options.bootstrapConfidence;
+  configBootstrapRounds = context->options.bootstrapRounds;
+  configBootstrapParams = false;
+  configTelemetry = context->options.telemetry;
+
+  for (size_t j = 0; j < ERRORSLOTS; j++) {
+    globalErrors[j] = -1.0;
+    errorLabels[j][0] = '\0';
+  }
+}
+
+// After a fatal error, this frees the working storage that the failed estimator had allocated.
+static void leaveLibrary(struct libraryCall *call) {
+  releaseTracked();
+  globalFatalJump = NULL;
+  globalScratchBytes = call->scratchBytes;
+  fesetenv(&call->fenv);
+}
+
+// The status for a call that ended with a fatal error.
+static int fatalStatus(void) {
+  return (globalFatalStatus == EX_OSERR) ? THESEUS_ENOMEM : THESEUS_EDATA;
+}
+
+/*Whether any of the estimators in testMask always produces an estimate. The others may decline to (reporting -1.0),
+ *and an assessment needs at least one.
+ */
+static bool producesEstimate(uint32_t testMask, size_t k) {
+  uint32_t always = MCVESTIMATEMASK | LAGESTIMATEMASK | TREEMMCESTIMATEMASK | TREELZ78YESTIMATEMASK;
+
+  if (k == 2) always |= MARKOVESTIMATEMASK;
+  return (testMask & always) != 0;
+}
+
+void theseusDefaultOptions(struct theseusOptions *options) {
+  assert(options != NULL);
+
+  options->verbose = 0;
+  options->testMask = 0xFFFF;
+  options->deterministic = false;
+  options->bootstrapConfidence = 0.99;
+  options->bootstrapRounds = 15000;
+  options->telemetry = NULL;
+}
+
+// Seeding reads the system's random source, which can fail.
+static bool seedContext(struct randstate *rstate) {
+  jmp_buf fatalJump;
+
+  globalFatalJump = &fatalJump;
+  if (setjmp(fatalJump) != 0) {
+    globalFatalJump = NULL;
+    return false;
+  }
+  seedGenerator(rstate);
+  globalFatalJump = NULL;
+
+  return true;
+}
+
+/*Returns NULL if the context can't be allocated (or its RNG can't be seeded). A NULL options pointer selects the default
+ *options.
+ */
+struct theseusContext *theseusCreateContext(const struct theseusOptions *options) {
+  struct theseusContext *context;
+
+  if ((context = malloc(sizeof(struct theseusContext))) == NULL) return NULL;
+
+  if (options == NULL) {
+    theseusDefaultOptions(&context->options);
+  } else {
+    context->options = *options;
+  }
+
+  initGenerator(&context->rstate);
+  context->rstate.deterministic = context->options.deterministic;
+  if (!seedContext(&context->rstate)) {
+    free(context);
+    return NULL;
+  }
+
+  return context;
+}
+
+void theseusFreeContext(struct theseusContext *context) {
+  free(context);
+}
+
+static void copyAssessment(const struct entropyTestingResult *in, size_t k, struct theseusAssessment *out) {
+  out->symbolCount = k;
+  out->mcv = in->mcv.done ? in->mcv.entropy : -1.0;
+  out->collision = in->cols.done ? in->cols.entropy : -1.0;
+  out->markov = in->markov.done ? in->markov.entropy : -1.0;
+  out->compression = in->comp.done ? in->comp.entropy : -1.0;
+  out->tTuple = in->sa.tTupleDone ? in->sa.tTupleEntropy : -1.0;
+  out->lrs = in->sa.lrsDone ? in->sa.lrsEntropy : -1.0;
+  out->multiMCW = in->mcw.done ? in->mcw.entropy : -1.0;
+  out->lag = in->lag.done ? in->lag.entropy : -1.0;
+  out->multiMMC = in->mmc.done ? in->mmc.entropy : -1.0;
+  out->lz78y = in->lz78y.done ? in->lz78y.entropy : -1.0;
+  out->assessedEntropy = in->assessedEntropy;
+  out->assessedIIDEntropy = in->assessedIIDEntropy;
+  out->runTime = in->runTime;
+}
+
+// Data with fewer than 2 symbols can't contain entropy (as reported by non-iid-main).
+static void zeroAssessment(size_t k, struct theseusAssessment *out) {
+  struct entropyTestingResult empty;
+
+  initEntropyTestingResult("", &empty);
+  empty.assessedEntropy = 0.0;
+  empty.assessedIIDEntropy = 0.0;
+  empty.runTime = 0.0;
+  copyAssessment(&empty, k, out);
+}
+
+/*The SP 800-90B non-IID assessment of the data as literal symbols (H_original).
+ *The data is translated to the symbols (0, ..., k-1) on a copy, so the caller's buffer isn't modified.
+ *Returns THESEUS_EINVAL if there is too little data for any of the selected estimators that always produce an estimate.
+ */
+int theseusNonIIDAssessment(struct theseusContext *context, const statData_t *data, size_t datalen, struct theseusAssessment *result) {
+  struct entropyTestingResult assessment;
+  struct libraryCall call;
+  statData_t *symbols;
+  uint32_t testMask;
+  double median;
+  size_t k;
+
+  if ((context == NULL) || (data == NULL) || (datalen == 0) || (result == NULL)) return THESEUS_EINVAL;
+
+  if ((symbols = malloc(datalen * sizeof(statData_t))) == NULL) return THESEUS_ENOMEM;
+  memcpy(symbols, data, datalen * sizeof(statData_t));
+
+  enterLibrary(context, &call);
+  if (setjmp(call.fatalJump) != 0) {
+    leaveLibrary(&call);
+    free(symbols);
+    return fatalStatus();
+  }
+
+  k = 0;
+  translate(symbols, datalen, &k, &median);
+
+  if (k < 2) {
+    zeroAssessment(k, result);
+  } else {
+    testMask = applicableEstimators(datalen, k, context->options.testMask);
+    if (!producesEstimate(testMask, k)) {
+      leaveLibrary(&call);
+      free(symbols);
+      return THESEUS_EINVAL;
+    }
+
+    entropyAssessment(symbols, datalen, k, testMask, &assessment, "Literal", 0);
+    copyAssessment(&assessment, k, result);
+  }
+  leaveLibrary(&call);
+
+  free(symbols);
+  return THESEUS_OK;
+}
+
+/*The SP 800-90B non-IID assessment of the bitstring formed from the bits in use (H_bitstring), most significant bit first.
+ *The result is per bit. Short data is handled as in theseusNonIIDAssessment().
+ */
+int theseusBitstringAssessment(struct theseusContext *context, const statData_t *data, size_t datalen, struct theseusAssessment *result) {
+  struct entropyTestingResult assessment;
+  struct libraryCall call;
+  statData_t *bits;
+  statData_t activeBits;
+  uint32_t testMask;
+  size_t bitWidth;
+
+  if ((context == NULL) || (data == NULL) || (datalen == 0) || (result == NULL)) return THESEUS_EINVAL;
+
+  activeBits = getActiveBitsSD(data, datalen);
+  bitWidth = (size_t)__builtin_popcount(activeBits);
+
+  if (bitWidth == 0) {
+    zeroAssessment(1, result);
+    return THESEUS_OK;
+  }
+
+  if ((bits = malloc(datalen * bitWidth * sizeof(statData_t))) == NULL) return THESEUS_ENOMEM;
+  makeBitstring(data, bits, datalen, activeBits, false);
+
+  testMask = applicableEstimators(datalen * bitWidth, 2, context->options.testMask);
+  if (!producesEstimate(testMask, 2)) {
+    free(bits);
+    return THESEUS_EINVAL;
+  }
+
+  enterLibrary(context, &call);
+  if (setjmp(call.fatalJump) != 0) {
+    leaveLibrary(&call);
+    free(bits);
+    return fatalStatus();
+  }
+
+  entropyAssessment(bits, datalen * bitWidth, 2, testMask, &assessment, "Bitstring", 0);
+  copyAssessment(&assessment, 2, result);
+  leaveLibrary(&call);
+
+  free(bits);
+  return THESEUS_OK;
+}
+
+/*Count the SP 800-90B Section 4.4 health test failures over the data.
+ *A cutoff of 0 disables that test.
+ */
+int theseusHealthTests(struct theseusContext *context, const statData_t *data, size_t datalen, size_t rctCutoff, size_t aptCutoff, size_t aptWindow, struct theseusHealthResult *result) {
+  struct libraryCall call;
+  struct RCTstate rct;
+  struct APTstate apt;
+
+  if ((context == NULL) || ((data == NULL) && (datalen > 0)) || (result == NULL)) return THESEUS_EINVAL;
+  if ((aptCutoff > 0) && ((aptWindow < 2) || (aptCutoff > aptWindow))) return THESEUS_EINVAL;
+
+  enterLibrary(context, &call);
+  if (setjmp(call.fatalJump) != 0) {
+    leaveLibrary(&call);
+    return fatalStatus();
+  }
+
+  initRCT(rctCutoff, &rct);
+  initAPT(aptCutoff, aptWindow, &apt);
+
+  for (size_t i = 0; i < datalen; i++) {
+    if (rctCutoff > 0) RCT(data[i], &rct);
+    if (aptCutoff > 0) APT(data[i], &apt);
+  }
+  leaveLibrary(&call);
+
+  result->rctFailures = rct.RCT_Failures;
+  result->aptFailures = apt.APT_Failures;
+  result->aptWindows = apt.APT_Window_Count;
+
+  return THESEUS_OK;
+}
+
+/*The BCa bootstrap estimate of the p-th percentile of the values, with a confidence interval at the context's bootstrap
+ *confidence level. The values are copied, so the caller's buffer isn't modified.
+ */
+int theseusBootstrapPercentile(struct theseusContext *context, double p, const double *values, size_t count, double *estimate, double confidenceInterval[2]) {
+  struct libraryCall call;
+  double *sample;
+
+  if ((context == NULL) || (values == NULL) || (count == 0) || (estimate == NULL) || (confidenceInterval == NULL)) return THESEUS_EINVAL;
+  if (!((p >= 0.0) && (p <= 1.0))) return THESEUS_EINVAL;
+
+  if ((sample = malloc(count * sizeof(double))) == NULL) return THESEUS_ENOMEM;
+  memcpy(sample, values, count * sizeof(double));
+
+  enterLibrary(context, &call);
+  if (setjmp(call.fatalJump) != 0) {
+    leaveLibrary(&call);
+    free(sample);
+    return fatalStatus();
+  }
+
+  *estimate = BCaBootstrapPercentile(p, sample, count, -DBL_INFINITY, DBL_INFINITY, confidenceInterval, context->options.bootstrapRounds, context->options.bootstrapConfidence, &context->rstate);
+  leaveLibrary(&call);
+
+  free(sample);
+  return THESEUS_OK;
+}
@@ -0,0 +1,80 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef LIBTHESEUS_H
+#define LIBTHESEUS_H
+
+/*The libtheseus C API: the SP 800-90B estimators and health tests applied to in-memory data.
+ *Each call takes a context (holding the options and the RNG state) rather than using the command-line tools' global
+ *configuration, and returns its results in a struct. Errors are returned as a status; the library never ends the
+ *program (other than on a failed assert), and a call that fails frees the memory it allocated.
+ *Calls on different contexts may run concurrently on different threads; a context must only be used by one call at a time.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "enttypes.h"
+
+// Only the functions marked THESEUS_API are exported from the library.
+#define THESEUS_API __attribute__((visibility("default")))
+
+#define THESEUS_OK 0
+#define THESEUS_EINVAL 1  // an argument was invalid
+#define THESEUS_ENOMEM 2  // memory could not be allocated
+#define THESEUS_EDATA 3  // an estimator couldn't assess the data (e.g., a numerical failure)
+
+struct theseusOptions {
+  int verbose;  // diagnostic output to stderr (0 for none)
+  uint32_t testMask;  // the estimators to run, as the non-iid-main "-b" option (0xFFFF for all)
+  bool deterministic;  // use a fixed RNG seed
+  double bootstrapConfidence;
+  size_t bootstrapRounds;
+  FILE *telemetry;  // per-estimator (and bootstrap load-balance) performance records are written here as JSON lines (NULL for none)
+};
+
+/*Min entropy results, in bits per symbol. Estimators that weren't run (or don't apply) are reported as -1.0; this
+ *includes those selected by testMask that need more data than was supplied (see the *MINLEN values in entlib.h).
+ */
+struct theseusAssessment {
+  size_t symbolCount;  // the number of distinct symbols assessed
+  double mcv;
+  double collision;
+  double markov;
+  double compression;
+  double tTuple;
+  double lrs;
+  double multiMCW;
+  double lag;
+  double multiMMC;
+  double lz78y;
+  double assessedEntropy;  // the minimum over the estimators
+  double assessedIIDEntropy;  // the MCV estimate
+  double runTime;  // CPU seconds (on the calling thread)
+};
+
+struct theseusHealthResult {
+  size_t rctFailures;
+  size_t aptFailures;
+  size_t aptWindows;  // the number of complete APT windows
+};
+
+struct theseusContext;
+
+THESEUS_API void theseusDefaultOptions(struct theseusOptions *options);
+THESEUS_API struct theseusContext *theseusCreateContext(const struct theseusOptions *options);
+THESEUS_API void theseusFreeContext(struct theseusContext *context);
+
+THESEUS_API int theseusNonIIDAssessment(struct theseusContext *context, const statData_t *data, size_t datalen, struct theseusAssessment *result);
+THESEUS_API int theseusBitstringAssessment(struct theseusContext *context, const statData_t *data, size_t datalen, struct theseusAssessment *result);
+THESEUS_API int theseusHealthTests(struct theseusContext *context, const statData_t *data, size_t datalen, size_t rctCutoff, size_t aptCutoff, size_t aptWindow, struct theseusHealthResult *result);
+THESEUS_API int theseusBootstrapPercentile(struct theseusContext *context, double p, const double *values, size_t count, double *estimate, double confidenceInterval[2]);
+#endif
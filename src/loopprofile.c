@@ -0,0 +1,351 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <math.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+#include "globals.h"
+#include "loopprofile.h"
+
+// Loops are reported as balanced if the busiest thread does no more than this much more than the average thread.
+#define BALANCED_IMBALANCE 1.1
+// A suggested dynamic chunk should take at least this long, so that handing out chunks is cheap by comparison.
+#define TARGET_CHUNK_SECONDS 1.0e-4
+// ...and there should be at least this many chunks per thread, so that there is something left to balance with.
+#define MIN_CHUNKS_PER_THREAD 4
+
+static int costCompare(const void *in1, const void *in2) {
+  double left = *(const double *)in1;
+  double right = *(const double *)in2;
+
+  if (left < right) return -1;
+  if (left > right) return 1;
+  return 0;
+}
+
+static void *profileCalloc(size_t count, size_t size) {
+  void *out;
+
+  if ((out = calloc(count, size)) == NULL) {
+    perror("Can't allocate loop profile");
+    fatalError(EX_OSERR);
+  }
+  return out;
+}
+
+double loopProfileNow(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1.0e-9;
+}
+
+void loopProfileInit(struct loopProfile *profile, const char *name, size_t iterations, bool perIteration, bool runtimeSchedule) {
+  assert((profile != NULL) && (name != NULL));
+
+  memset(profile, 0, sizeof(struct loopProfile));
+  profile->name = name;
+  profile->iterations = iterations;
+  profile->runtimeSchedule = runtimeSchedule;
+  profile->active = (configTelemetry != NULL) || (configVerbose > 1);
+  if (!profile->active) return;
+
+  profile->threadSlots = (size_t)omp_get_max_threads();
+  profile->threadBusy = profileCalloc(profile->threadSlots, sizeof(double));
+  profile->threadBegin = profileCalloc(profile->threadSlots, sizeof(double));
+  profile->threadFinish = profileCalloc(profile->threadSlots, sizeof(double));
+  profile->threadIterations = profileCalloc(profile->threadSlots, sizeof(size_t));
+  if (perIteration && (iterations > 0)) profile->iterationCost = profileCalloc(iterations, sizeof(double));
+  profile->start = loopProfileNow();
+}
+
+// Called by the thread that ran the iteration; each iteration is only run once, so there is no contention.
+void loopProfileIteration(struct loopProfile *profile, size_t iteration, double iterationStart) {
+  if (!profile->active || (profile->iterationCost == NULL)) return;
+
+  assert(iteration < profile->iterations);
+  profile->iterationCost[iteration] = loopProfileNow() - iterationStart;
+}
+
+// Called by each thread in the team once it is out of iterations (so the loop should be "nowait").
+void loopProfileThreadDone(struct loopProfile *profile, double threadStart, size_t threadIterations) {
+  double now;
+  size_t thread;
+
+  if (!profile->active) return;
+
+  now = loopProfileNow();
+  thread = (size_t)omp_get_thread_num();
+  assert(thread < profile->threadSlots);
+
+  profile->threadBusy[thread] = now - threadStart;
+  profile->threadBegin[thread] = threadStart - profile->start;
+  profile->threadFinish[thread] = now - profile->start;
+  profile->threadIterations[thread] = threadIterations;
+#pragma omp atomic write
+  profile->teamSize = (size_t)omp_get_num_threads();
+}
+
+static void scheduleName(char *out, size_t outlen, bool runtimeSchedule) {
+  omp_sched_t kind;
+  int chunk;
+  unsigned int kindValue;
+  const char *kindName;
+
+  if (!runtimeSchedule) {
+    snprintf(out, outlen, "static");
+    return;
+  }
+
+  omp_get_schedule(&kind, &chunk);
+  // Ignore the monotonic modifier.
+  kindValue = (unsigned int)kind & 0x7fffffffU;
+  if (kindValue == (unsigned int)omp_sched_static) {
+    kindName = "static";
+  } else if (kindValue == (unsigned int)omp_sched_dynamic) {
+    kindName = "dynamic";
+  } else if (kindValue == (unsigned int)omp_sched_guided) {
+    kindName = "guided";
+  } else {
+    kindName = "auto";
+  }
+
+  if (chunk > 0) {
+    snprintf(out, outlen, "%s,%d", kindName, chunk);
+  } else {
+    snprintf(out, outlen, "%s", kindName);
+  }
+}
+
+/*The imbalance that the loop would have had under the default static schedule, which hands each thread a single
+ *contiguous run of iterations (with the first iterations % teamSize threads getting one extra).
+ */
+static double staticImbalance(const double *iterationCost, size_t iterations, size_t teamSize) {
+  size_t perThread = iterations / teamSize;
+  size_t remainder = iterations % teamSize;
+  size_t j = 0;
+  double total = 0.0;
+  double busiest = 0.0;
+
+  for (size_t i = 0; i < teamSize; i++) {
+    size_t end = j + perThread + ((i < remainder) ? 1 : 0);
+    double busy = 0.0;
+
+    for (; j < end; j++) busy += iterationCost[j];
+    if (busy > busiest) busiest = busy;
+    total += busy;
+  }
+  assert(j == iterations);
+
+  return (total > 0.0) ? busiest * (double)teamSize / total : 1.0;
+}
+
+/*Suggest an OMP_SCHEDULE value. Loops that would be balanced under a static schedule (and loops with no more
+ *iterations than threads, where the schedule can't help) are best left static. If it isn't known how a static schedule
+ *would do, a schedule that is already balanced is kept. Otherwise, hand out dynamic chunks that are long enough to
+ *amortize the scheduling cost; if that would leave too few chunks per thread, use guided scheduling instead.
+ */
+static void suggestSchedule(char *out, size_t outlen, size_t iterations, size_t teamSize, double predictedStatic, double imbalance, double meanCost, const char *currentSchedule) {
+  size_t chunk;
+  size_t maxChunk;
+
+  if ((teamSize <= 1) || (iterations <= teamSize) || (isfinite(predictedStatic) && (predictedStatic <= BALANCED_IMBALANCE))) {
+    snprintf(out, outlen, "static");
+    return;
+  }
+
+  if (!isfinite(predictedStatic) && (imbalance <= BALANCED_IMBALANCE)) {
+    snprintf(out, outlen, "%s", currentSchedule);
+    return;
+  }
+
+  maxChunk = iterations / (MIN_CHUNKS_PER_THREAD * teamSize);
+  if (maxChunk == 0) maxChunk = 1;
+
+  if ((meanCost > 0.0) && (meanCost < TARGET_CHUNK_SECONDS)) {
+    chunk = (size_t)ceil(TARGET_CHUNK_SECONDS / meanCost);
+  } else {
+    chunk = 1;
+  }
+
+  if (chunk > maxChunk) {
+    snprintf(out, outlen, "guided");
+  } else {
+    snprintf(out, outlen, "dynamic,%zu", chunk);
+  }
+}
+
+static void jsonNumber(FILE *out, double value) {
+  if (isfinite(value)) {
+    fprintf(out, "%.9g", value);
+  } else {
+    fprintf(out, "null");
+  }
+}
+
+/*Summarize the loop (to configTelemetry as a single JSON object, and to stderr if configVerbose > 1), and release the
+ *profile's storage. This is called after the parallel region has ended.
+ */
+void loopProfileFinish(struct loopProfile *profile) {
+  size_t teamSize;
+  double wall;
+  double firstBegin = INFINITY;
+  double lastFinish = 0.0;
+  double firstFinish = INFINITY;
+  double busyTotal = 0.0;
+  double busyMax = 0.0;
+  double imbalance = 1.0;
+  double utilization = 1.0;
+  double meanCost = NAN;
+  double costMin = NAN;
+  double costMedian = NAN;
+  double costP90 = NAN;
+  double costMax = NAN;
+  double costCV = NAN;
+  double predictedStatic = NAN;
+  char currentSchedule[32];
+  char suggestedSchedule[32];
+
+  assert(profile != NULL);
+  if (!profile->active) return;
+
+  teamSize = profile->teamSize;
+  assert((teamSize > 0) && (teamSize <= profile->threadSlots));
+
+  // The loop is timed from when the first thread started on it (which may be well after the profile was initialized,
+  // if the team had other work to do first) until the last thread was done.
+  for (size_t i = 0; i < teamSize; i++) {
+    if (profile->threadBegin[i] < firstBegin) firstBegin = profile->threadBegin[i];
+    if (profile->threadFinish[i] > lastFinish) lastFinish = profile->threadFinish[i];
+    if (profile->threadFinish[i] < firstFinish) firstFinish = profile->threadFinish[i];
+    if (profile->threadBusy[i] > busyMax) busyMax = profile->threadBusy[i];
+    busyTotal += profile->threadBusy[i];
+  }
+  wall = fmax(lastFinish - firstBegin, 0.0);
+
+  if (busyTotal > 0.0) imbalance = busyMax * (double)teamSize / busyTotal;
+  if (wall > 0.0) utilization = busyTotal / ((double)teamSize * wall);
+
+  if (profile->iterationCost != NULL) {
+    double costTotal = 0.0;
+    double costSquares = 0.0;
+
+    for (size_t j = 0; j < profile->iterations; j++) {
+      costTotal += profile->iterationCost[j];
+      costSquares += profile->iterationCost[j] * profile->iterationCost[j];
+    }
+    meanCost = costTotal / (double)profile->iterations;
+    costCV = (meanCost > 0.0) ? sqrt(fmax(costSquares / (double)profile->iterations - meanCost * meanCost, 0.0)) / meanCost : 0.0;
+
+    predictedStatic = staticImbalance(profile->iterationCost, profile->iterations, teamSize);
+
+    qsort(profile->iterationCost, profile->iterations, sizeof(double), costCompare);
+    costMin = profile->iterationCost[0];
+    costMedian = profile->iterationCost[profile->iterations / 2];
+    costP90 = profile->iterationCost[(profile->iterations * 9) / 10];
+    costMax = profile->iterationCost[profile->iterations - 1];
+  } else if (profile->iterations > 0) {
+    meanCost = busyTotal / (double)profile->iterations;
+  }
+
+  scheduleName(currentSchedule, sizeof(currentSchedule), profile->runtimeSchedule);
+  // Without per-iteration costs, the measured imbalance is only a prediction for the static schedule if that's what ran.
+  if (!isfinite(predictedStatic) && (strcmp(currentSchedule, "static") == 0)) predictedStatic = imbalance;
+  // Loops that don't use the runtime schedule must stay static (e.g., to keep deterministic runs repeatable).
+  if (profile->runtimeSchedule) {
+    suggestSchedule(suggestedSchedule, sizeof(suggestedSchedule), profile->iterations, teamSize, predictedStatic, imbalance, meanCost, currentSchedule);
+  } else {
+    suggestedSchedule[0] = '\0';
+  }
+
+  if (configTelemetry != NULL) {
+    char *record = NULL;
+    size_t recordLength = 0;
+    FILE *out;
+    struct timespec now;
+
+    if ((out = open_memstream(&record, &recordLength)) == NULL) {
+      perror("Can't build loop profile record");
+      fatalError(EX_OSERR);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    fprintf(out, "{\"time\":%.6f,\"event\":\"parallel-loop\",\"loop\":\"%s\",\"schedule\":\"%s\",\"threads\":%zu,\"iterations\":%zu,\"wall_s\":%.9f,\"busy_s\":%.9f,\"utilization\":%.6f,\"imbalance\":%.6f,\"tail_s\":%.9f",
+            (double)now.tv_sec + (double)now.tv_nsec * 1.0e-9, profile->name, currentSchedule, teamSize, profile->iterations, wall, busyTotal, utilization, imbalance, lastFinish - firstFinish);
+
+    fprintf(out, ",\"thread_busy_s\":[");
+    for (size_t i = 0; i < teamSize; i++) fprintf(out, "%s%.9f", (i == 0) ? "" : ",", profile->threadBusy[i]);
+    fprintf(out, "],\"thread_idle_s\":[");
+    for (size_t i = 0; i < teamSize; i++) fprintf(out, "%s%.9f", (i == 0) ? "" : ",", fmax(wall - profile->threadBusy[i], 0.0));
+    fprintf(out, "],\"thread_iterations\":[");
+    for (size_t i = 0; i < teamSize; i++) fprintf(out, "%s%zu", (i == 0) ? "" : ",", profile->threadIterations[i]);
+
+    fprintf(out, "],\"cost_mean_s\":");
+    jsonNumber(out, meanCost);
+    fprintf(out, ",\"cost_min_s\":");
+    jsonNumber(out, costMin);
+    fprintf(out, ",\"cost_median_s\":");
+    jsonNumber(out, costMedian);
+    fprintf(out, ",\"cost_p90_s\":");
+    jsonNumber(out, costP90);
+    fprintf(out, ",\"cost_max_s\":");
+    jsonNumber(out, costMax);
+    fprintf(out, ",\"cost_cv\":");
+    jsonNumber(out, costCV);
+    fprintf(out, ",\"static_imbalance\":");
+    jsonNumber(out, predictedStatic);
+    if (profile->runtimeSchedule) {
+      fprintf(out, ",\"suggested_schedule\":\"%s\"}\n", suggestedSchedule);
+    } else {
+      fprintf(out, ",\"suggested_schedule\":null}\n");
+    }
+
+    if (fclose(out) != 0) {
+      perror("Can't build loop profile record");
+      fatalError(EX_OSERR);
+    }
+
+    // A single write, so that records from different threads aren't interleaved.
+    fputs(record, configTelemetry);
+    free(record);
+  }
+
+  if (configVerbose > 1) {
+    fprintf(stderr, "Parallel loop %s (schedule %s): %zu iterations on %zu threads in %.6g s; utilization %.1f%%, imbalance %.3f, tail %.6g s", profile->name, currentSchedule, profile->iterations, teamSize, wall, utilization * 100.0, imbalance,
+            lastFinish - firstFinish);
+    if (profile->iterationCost != NULL) fprintf(stderr, "; iteration cost median %.6g s, p90 %.6g s, max %.6g s", costMedian, costP90, costMax);
+    if (profile->runtimeSchedule) fprintf(stderr, "; suggested OMP_SCHEDULE=%s", suggestedSchedule);
+    fprintf(stderr, "\n");
+  }
+
+  free(profile->threadBusy);
+  free(profile->threadBegin);
+  free(profile->threadFinish);
+  free(profile->threadIterations);
+  free(profile->iterationCost);
+  profile->threadBusy = NULL;
+  profile->threadBegin = NULL;
+  profile->threadFinish = NULL;
+  profile->threadIterations = NULL;
+  profile->iterationCost = NULL;
+  profile->active = false;
+}
+
+// Set the schedule used by schedule(runtime) loops, unless the user has chosen one using OMP_SCHEDULE.
+void loopScheduleDefault(omp_sched_t kind, int chunk) {
+  if (getenv("OMP_SCHEDULE") == NULL) omp_set_schedule(kind, chunk);
+}
@@ -0,0 +1,60 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef LOOPPROFILE_H
+#define LOOPPROFILE_H
+
+#include <omp.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*Load balance of a single OpenMP work-sharing loop. Profiling is only active when there is somewhere to report it
+ *(configTelemetry is set, or configVerbose > 1); otherwise the calls below do nothing.
+ *
+ *The intended use is:
+ *  loopProfileInit(&profile, "name", iterations, true, true);
+ *  #pragma omp parallel
+ *  {
+ *    double threadStart = loopProfileNow();
+ *    size_t threadIterations = 0;
+ *    #pragma omp for schedule(runtime) nowait
+ *    for (size_t j = 0; j < iterations; j++) {
+ *      double iterationStart = loopProfileNow();
+ *      ...
+ *      loopProfileIteration(&profile, j, iterationStart);
+ *      threadIterations++;
+ *    }
+ *    loopProfileThreadDone(&profile, threadStart, threadIterations);
+ *  }
+ *  loopProfileFinish(&profile);
+ *
+ *Per-iteration costs should only be kept for loops whose iterations are expensive relative to reading the clock.
+ */
+struct loopProfile {
+  const char *name;
+  bool active;
+  bool runtimeSchedule;  // the loop uses schedule(runtime), rather than the default static schedule
+  size_t iterations;
+  size_t threadSlots;  // omp_get_max_threads() when the profile was initialized
+  size_t teamSize;  // threads in the team that ran the loop
+  double start;  // monotonic seconds
+  double *threadBusy;  // seconds each thread spent working through its iterations
+  double *threadBegin;  // seconds from start until each thread began its iterations
+  double *threadFinish;  // seconds from start until each thread finished its iterations
+  size_t *threadIterations;
+  double *iterationCost;  // seconds for each iteration; NULL unless per-iteration costs are kept
+};
+
+double loopProfileNow(void);
+void loopProfileInit(struct loopProfile *profile, const char *name, size_t iterations, bool perIteration, bool runtimeSchedule);
+void loopProfileIteration(struct loopProfile *profile, size_t iteration, double iterationStart);
+void loopProfileThreadDone(struct loopProfile *profile, double threadStart, size_t threadIterations);
+void loopProfileFinish(struct loopProfile *profile);
+void loopScheduleDefault(omp_sched_t kind, int chunk);
+#endif
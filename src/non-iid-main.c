@@ -31,8 +31,10 @@
 #include "bootstrap.h"
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "entlib.h"
 #include "globals-inst.h"
+#include "loopprofile.h"
 #include "precision.h"
 #include "randlib.h"
 #include "translate.h"
@@ -76,175 +78,11 @@ noreturn static void useageExit(void) {
   fprintf(stderr, "-F\tEstablish an overall assessment based on bootstrap of final assessments.\n");
   fprintf(stderr, "-S\tEstablish an overall assessment using a large block assessment.\n");
   fprintf(stderr, "-X <s>\tSerially XOR s consecutive random values.\n");
+  fprintf(stderr, "-J <file>\tWrite performance telemetry (a JSON object per line for each estimator run, each block assessment and each parallel loop) to <file>.\n");
   fprintf(stderr, "The final assessment is the minimum of the overall assessments.\n");
   exit(EX_USAGE);
 }
 
-static void makeBitstring(statData_t *data, statData_t *bitData, size_t datalen, statData_t activeBits, bool configLittleEndian) {
-  // Populate bitData
-  statData_t bitsToDo;
-  statData_t *curBitData;
-  statData_t curBit;
-
-  curBitData = bitData;
-  for (size_t l = 0; l < datalen; l++) {
-    if (configLittleEndian) {
-      curBit = 0x01;
-    } else {
-      curBit = highBit(activeBits);
-    }
-
-    bitsToDo = activeBits;
-
-    while (bitsToDo != 0) {
-      if ((curBit & bitsToDo) != 0) {
-        *curBitData = ((curBit & data[l]) == 0) ? 0 : 1;
-        curBitData++;
-        bitsToDo = (statData_t)(bitsToDo & (~curBit));
-      }
-
-      if (configLittleEndian) {
-        curBit = (statData_t)(curBit << 1);
-      } else {
-        curBit = (statData_t)(curBit >> 1);
-      }
-    }
-  }
-  assert((size_t)(curBitData - bitData) == datalen * ((size_t)__builtin_popcount(activeBits)));
-}
-
-static double doAssessment(const statData_t *data, size_t datalen, size_t k, uint32_t configTestBitmask, struct entropyTestingResult *result, const char *label) {
-  struct timespec startTime;
-  struct timespec endTime;
-  struct timespec overallStartTime;
-  struct timespec overallEndTime;
-  double minminent;
-  double minIIDminent;
-  double curminent, curminent2;
-  size_t j;
-
-  initEntropyTestingResult(label, result);
-
-  minminent = DBL_INFINITY;
-  minIIDminent = DBL_INFINITY;
-
-  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &overallStartTime);
-
-  if (configTestBitmask & MCVESTIMATEMASK) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-
-    curminent = mostCommonValueEstimate(data, datalen, k, &(result->mcv));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    minminent = curminent;
-    minIIDminent = curminent;
-    result->mcv.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((k == 2) && (configTestBitmask & COLSESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = collisionEstimate(data, datalen, &(result->cols));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if ((curminent >= 0) && (curminent < minminent)) {
-      minminent = curminent;
-    }
-    result->cols.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((k == 2) && (configTestBitmask & MARKOVESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = markovEstimate(data, datalen, &(result->markov));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if (curminent < minminent) {
-      minminent = curminent;
-    }
-
-    result->markov.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((k == 2) && (configTestBitmask & COMPESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = compressionEstimate(data, datalen, &(result->comp));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if ((curminent >= 0.0) && (curminent < minminent)) {
-      minminent = curminent;
-    }
-    result->comp.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((configTestBitmask & SAESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    SAalgs(data, datalen, k, &(result->sa));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    curminent = result->sa.tTupleEntropy;
-    curminent2 = result->sa.lrsEntropy;
-    result->sa.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-
-    if ((curminent >= 0) && (curminent < minminent)) {
-      minminent = curminent;
-    }
-    if ((curminent2 >= 0.0) && (curminent2 < minminent)) {
-      minminent = curminent2;
-    }
-  }
-
-  if ((configTestBitmask & MCWESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = multiMCWPredictionEstimate(data, datalen, k, &(result->mcw));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if ((curminent >= 0.0) && (curminent < minminent)) {
-      minminent = curminent;
-    }
-    result->mcw.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((configTestBitmask & LAGESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = lagPredictionEstimate(data, datalen, k, &(result->lag));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if (curminent < minminent) {
-      minminent = curminent;
-    }
-    result->lag.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((configTestBitmask & TREEMMCESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = treeMultiMMCPredictionEstimate(data, datalen, k, &(result->mmc));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if (curminent < minminent) {
-      minminent = curminent;
-    }
-    result->mmc.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  if ((configTestBitmask & TREELZ78YESTIMATEMASK)) {
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &startTime);
-    curminent = treeLZ78YPredictionEstimate(data, datalen, k, &(result->lz78y));
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endTime);
-    if (curminent < minminent) {
-      minminent = curminent;
-    }
-    result->lz78y.runTime = ((double)endTime.tv_sec + (double)endTime.tv_nsec * 1.0e-9) - ((double)startTime.tv_sec + (double)startTime.tv_nsec * 1.0e-9);
-  }
-
-  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &overallEndTime);
-
-  result->runTime = ((double)overallEndTime.tv_sec + (double)overallEndTime.tv_nsec * 1.0e-9) - ((double)overallStartTime.tv_sec + (double)overallStartTime.tv_nsec * 1.0e-9);
-
-  if (configVerbose > 3) {
-    for (j = 0; j < ERRORSLOTS; j++) {
-      if (globalErrors[j] >= 0.0) fprintf(stderr, "%s rel errors = %.17g\n", errorLabels[j], globalErrors[j]);
-    }
-  }
-
-  assert(isfinite(minminent) != 0);
-  result->assessedEntropy = minminent;
-
-  result->assessedIIDEntropy = minIIDminent;
-
-  return minminent;
-}
-
 int main(int argc, char *argv[]) {
   FILE *infp;
   size_t datalen;
@@ -279,6 +117,10 @@ int main(int argc, char *argv[]) {
   size_t evaluationBlockSize;
   struct randstate rstate;
   size_t configRandomRounds;
+  struct loopProfile generationProfile;
+  struct loopProfile literalProfile;
+  struct loopProfile bitstringProfile;
+  struct threadConfig config;
   statData_t activeBits = 0;
   double configRONu;
   bool configRingOscillator;
@@ -312,7 +154,7 @@ int main(int argc, char *argv[]) {
 
   initGenerator(&rstate);
 
-  while ((opt = getopt(argc, argv, "fvsicrl:b:gR:L:B:PFSN:O:dX:M")) != -1) {
+  while ((opt = getopt(argc, argv, "fvsicrl:b:gR:L:B:PFSN:O:dX:MJ:")) != -1) {
     switch (opt) {
       case 'v':
         configVerbose++;
@@ -440,6 +282,12 @@ int main(int argc, char *argv[]) {
       case 'd':
         rstate.deterministic = true;
         break;
+      case 'J':
+        if ((configTelemetry = fopen(optarg, "w")) == NULL) {
+          perror("Can't open telemetry file");
+          exit(EX_CANTCREAT);
+        }
+        break;
       default: /* ? */
         useageExit();
     }
@@ -450,6 +298,9 @@ int main(int argc, char *argv[]) {
 
   seedGenerator(&rstate);
 
+  // Blocks are handed out one at a time unless OMP_SCHEDULE says otherwise.
+  loopScheduleDefault(omp_sched_dynamic, 1);
+
   if (configVerbose > 0) fprintf(stderr, "Verbosity set to %d\n", configVerbose);
 
   if (configUseFile) {
@@ -740,19 +591,28 @@ int main(int argc, char *argv[]) {
           fprintf(stderr, "%" PRIdMAX " Generate %zu bits from a simulated ring oscillator for round %zu. ", (intmax_t)time(NULL), configRandDataSize, i + 1);
         }
 
+        saveThreadConfig(&config);
+        loopProfileInit(&generationProfile, "generate-ro", generationBlocks, true, false);
 #pragma omp parallel
         {
           double samplePhase = 0.0;
           double oscPhase;  // Initial phase is random
           struct randstate threadrstate;
+          double threadStart;
+          size_t threadIterations = 0;
+
+          loadThreadConfig(&config);
           initGenerator(&threadrstate);
           threadrstate.deterministic = rstate.deterministic;
           seedGenerator(&threadrstate);
 
           // We thread across generationBlocks, so configRandDataSize should be made large to allow for multi threading speedups.
-#pragma omp for
+          // Each thread has its own RNG, so the schedule must stay static for deterministic runs to be repeatable.
+          threadStart = loopProfileNow();
+#pragma omp for nowait
           for (size_t l = 0; l < generationBlocks; l++) {
             double localSampleFreq;
+            double iterationStart = loopProfileNow();
             // Each generationBlock reflects data used in a different evaluation.
             oscPhase = randomUnit(&threadrstate);  // Initial phase is random
             if (configRONu < 0.0) {  // if Nu < 0, then we're supposed to randomly vary it randomly.
@@ -770,22 +630,39 @@ int main(int argc, char *argv[]) {
             for (size_t j = 0; j < evaluationBlockSize*configSerialXOR; j++) {
               data[l*evaluationBlockSize*configSerialXOR + j] = ringOscillatorNextNonDeterministicSample(oscFreq, oscJitter, &oscPhase, localSampleFreq, &samplePhase, &threadrstate);
             }
+            loopProfileIteration(&generationProfile, l, iterationStart);
+            threadIterations++;
           }
+          loopProfileThreadDone(&generationProfile, threadStart, threadIterations);
         } // end parallel
+        loopProfileFinish(&generationProfile);
       } else {
         if (configVerbose > 0) fprintf(stderr, "%" PRIdMAX " Generate %zu integers for round %zu. ", (intmax_t)time(NULL), configRandDataSize, i + 1);
+        saveThreadConfig(&config);
+        loopProfileInit(&generationProfile, "generate", generationBlocks, true, false);
 #pragma omp parallel
         {
           struct randstate threadrstate;
+          double threadStart;
+          size_t threadIterations = 0;
+
+          loadThreadConfig(&config);
           initGenerator(&threadrstate);
           threadrstate.deterministic = rstate.deterministic;
           seedGenerator(&threadrstate);
 
-#pragma omp for
+          // As above, this schedule must stay static.
+          threadStart = loopProfileNow();
+#pragma omp for nowait
           for (size_t l = 0; l < generationBlocks; l++) {
+            double iterationStart = loopProfileNow();
             genRandInts(data + l * evaluationBlockSize*configSerialXOR, evaluationBlockSize*configSerialXOR, (uint32_t)(configK - 1), &threadrstate);
+            loopProfileIteration(&generationProfile, l, iterationStart);
+            threadIterations++;
           }
+          loopProfileThreadDone(&generationProfile, threadStart, threadIterations);
         } //end parallel
+        loopProfileFinish(&generationProfile);
       }
 
       //Do any XORing here
@@ -806,30 +683,53 @@ int main(int argc, char *argv[]) {
     if (configVerbose > 0) fprintf(stderr, "Dataset preparation done.\n");
 
     // All the data is in place now.
+    // The per-block assessment cost varies considerably, so these loops use the runtime schedule (by default, dynamic).
+    saveThreadConfig(&config);
+    if (configEval != bitstring) loopProfileInit(&literalProfile, "assess-literal", blockCount + 1 - startIndex, true, true);
+    if (configEval != raw) loopProfileInit(&bitstringProfile, "assess-bitstring", blockCount + 1 - startIndex, true, true);
     #pragma omp parallel
     {
+      double threadStart;
+      size_t threadIterations;
+
+      loadThreadConfig(&config);
+
       if (configEval != bitstring) {
         // We thread across blockCount, so datalen should be made large to allow for multi threading speedups.
-        #pragma omp for
+        threadStart = loopProfileNow();
+        threadIterations = 0;
+        #pragma omp for schedule(runtime) nowait
         for (size_t j = startIndex; j <= blockCount; j++) {
+          double iterationStart = loopProfileNow();
           if (j != 0)
-            doAssessment(data + (j - 1) * evaluationBlockSize, evaluationBlockSize, k, configTestBitmask, rawResults + (i * blockCount) + j, "Literal");
+            entropyAssessment(data + (j - 1) * evaluationBlockSize, evaluationBlockSize, k, configTestBitmask, rawResults + (i * blockCount) + j, "Literal", (i * blockCount) + j);
           else
-            doAssessment(data, datalen, k, configTestBitmask, rawResults, "Literal");
+            entropyAssessment(data, datalen, k, configTestBitmask, rawResults, "Literal", 0);
+          loopProfileIteration(&literalProfile, j - startIndex, iterationStart);
+          threadIterations++;
         }
+        loopProfileThreadDone(&literalProfile, threadStart, threadIterations);
       } //end literal evaluation
 
       if (configEval != raw) {
         assert(bitDatalen > 0);
-        #pragma omp for
+        threadStart = loopProfileNow();
+        threadIterations = 0;
+        #pragma omp for schedule(runtime) nowait
         for (size_t j = startIndex; j <= blockCount; j++) {
+          double iterationStart = loopProfileNow();
           if (j != 0)
-            doAssessment(bitData + (j - 1) * bitBlockSize, bitBlockSize, 2, configTestBitmask, binaryResults + (i * blockCount) + j, "Bitstring");
+            entropyAssessment(bitData + (j - 1) * bitBlockSize, bitBlockSize, 2, configTestBitmask, binaryResults + (i * blockCount) + j, "Bitstring", (i * blockCount) + j);
           else
-            doAssessment(bitData, bitDatalen, 2, configTestBitmask, binaryResults, "Bitstring");
+            entropyAssessment(bitData, bitDatalen, 2, configTestBitmask, binaryResults, "Bitstring", 0);
+          loopProfileIteration(&bitstringProfile, j - startIndex, iterationStart);
+          threadIterations++;
         }
+        loopProfileThreadDone(&bitstringProfile, threadStart, threadIterations);
       } //end bitstring evaluation
     } //end parallel region
+    if (configEval != bitstring) loopProfileFinish(&literalProfile);
+    if (configEval != raw) loopProfileFinish(&bitstringProfile);
 
   } // round for loop
 
@@ -1091,5 +991,10 @@ int main(int argc, char *argv[]) {
     blockResultsIID = NULL;
   }
 
+  if ((configTelemetry != NULL) && (fclose(configTelemetry) != 0)) {
+    perror("Can't close telemetry file");
+    exit(EX_IOERR);
+  }
+
   return 0;
 }
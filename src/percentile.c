@@ -22,6 +22,7 @@
 #include "bootstrap.h"
 #include "fancymath.h"
 #include "globals-inst.h"
+#include "loopprofile.h"
 #include "precision.h"
 #include "randlib.h"
 
@@ -135,6 +136,9 @@ int main(int argc, char *argv[]) {
   argc -= optind;
   argv += optind;
 
+  // The schedule(runtime) loops stay static unless OMP_SCHEDULE says otherwise.
+  loopScheduleDefault(omp_sched_static, 0);
+
   if ((argc != 1) && (argc != 2)) {
     useageExit();
   }
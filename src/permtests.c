@@ -125,6 +125,8 @@ static uint32_t lastReportedPassed = 0;
 static uint32_t configK = 2;
 static bool configComplete = false;
 static bool configDeterministic = false;
+// The testing threads take the main thread's configuration.
+static struct threadConfig mainConfig;
 
 void *doTestingThread(void *ptr);
 
@@ -895,6 +897,7 @@ void *doTestingThread(void *ptr) {
   bool continueWork;
   size_t compressionStringLen;
 
+  loadThreadConfig(&mainConfig);
   initGenerator(&rstate);
 
   // This is the per-thread-specific data, including working area for all the tests and the shuffled data.
@@ -1219,6 +1222,8 @@ int main(int argc, char *argv[]) {
     exit(EX_OSERR);
   }
 
+  saveThreadConfig(&mainConfig);
+
   // start up the initial thread (which will initially calculate the reference data an record it in permResultArray[0])
   if (pthread_create(&(threads[0]), NULL, doTestingThread, (void *)inData) != 0) {
     perror("Can't create a thread");
@@ -15,6 +15,7 @@
 
 #include "globals.h"
 #include "poolalloc.h"
+#include "telemetry.h"
 
 /*A simple pool (block) allocator to deal with all the small allocs in the code*/
 
@@ -29,8 +30,9 @@ static void allocSegment(struct memSegment *new) {
 
   if ((new->segmentStart = malloc(new->blockSize *new->blockCount)) == NULL) {
     perror("Can't allocate data for segment backing");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  scratchAllocated(new->blockSize * new->blockCount);
   for (j = 0, curLoc = new->segmentStart; j < new->blockCount - 1; j++, curLoc += new->blockSize) {
     // populate the list with pointers to the next location.
     nextLoc = curLoc + new->blockSize;
@@ -42,6 +44,10 @@ static void allocSegment(struct memSegment *new) {
   memcpy(curLoc, &nextLoc, sizeof(char *));
 }
 
+static void releasePool(void *pool) {
+  delPool(pool);
+}
+
 struct memSegment *initPool(size_t bsize, size_t bcount) {
   size_t slop = bsize % sizeof(void *);
   struct memSegment *startSegment;
@@ -50,7 +56,7 @@ struct memSegment *initPool(size_t bsize, size_t bcount) {
 
   if ((startSegment = malloc(sizeof(struct memSegment))) == NULL) {
     perror("Can't allocate initial segment");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   if (slop != 0) {
@@ -62,6 +68,8 @@ struct memSegment *initPool(size_t bsize, size_t bcount) {
   startSegment->blockSize = bsize;
   startSegment->blockCount = bcount;
   startSegment->nextSegment = NULL;
+  startSegment->segmentStart = NULL;
+  trackAllocation(startSegment, releasePool);
   allocSegment(startSegment);
   startSegment->nextFree = startSegment->segmentStart;
   return (startSegment);
@@ -75,11 +83,16 @@ size_t delPool(struct memSegment *pool) {
 
   assert(pool != NULL);
   bsize = pool->blockSize;
+  untrackAllocation(pool);
 
   while (pool != NULL) {
     next = pool->nextSegment;
-    blockCount += pool->blockCount;
-    free(pool->segmentStart);
+    // A fatal error may leave the last segment without its storage.
+    if (pool->segmentStart != NULL) {
+      blockCount += pool->blockCount;
+      free(pool->segmentStart);
+      scratchFreed(pool->blockSize * pool->blockCount);
+    }
     free(pool);
     pool = next;
   }
@@ -121,7 +134,7 @@ void *blockAlloc(struct memSegment *pool) {
     // Start on a new segment.
     if ((newSegment = malloc(sizeof(struct memSegment))) == NULL) {
       perror("Can't allocate initial segment");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
 
     endSegment->nextSegment = newSegment;
@@ -19,6 +19,7 @@
 
 #include "entlib.h"
 #include "fancymath.h"
+#include "globals.h"
 #include "randlib.h"
 
 #define uint128_t __uint128_t
@@ -67,22 +68,22 @@ void seedGenerator(struct randstate *rstate) {
   if (!rstate->deterministic) {
     if ((infp = fopen("/dev/urandom", "rb")) == NULL) {
       perror("Can't open random source");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
 
     if (fread(rstate->xoshiro256starstarState, sizeof(uint64_t), 4, infp) != 4) {
       perror("Can't read random seed");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
 
     if (fread(MTini, sizeof(uint32_t), 4, infp) != 4) {
       perror("Can't read random seed");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
 
     if (fclose(infp) != 0) {
       perror("Couldn't close random source");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
   } else {
     memcpy(rstate->xoshiro256starstarState, xoshiro256starstarIni, sizeof(uint64_t) * 4);
@@ -249,6 +250,20 @@ uint64_t randomRange64(uint64_t s, struct randstate *rstate) {
   }
 }
 
+/*A counter-based generator: the output depends only on the key and the counter, so a stream of these values can be produced
+ *in pieces (in any order, or in parallel) with the same result.
+ *This is the SplitMix64 output function applied to key + (counter + 1) * gamma; see Steele, Lea and Flood,
+ *"Fast Splittable Pseudorandom Number Generators" (2014).
+ */
+uint64_t counterRandom64(uint64_t key, uint64_t counter) {
+  uint64_t z;
+
+  z = key + (counter + 1) * UINT64_C(0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
 /*This produces a bit that is biased; the bias (c) reflects the probability
 of a 0, which is (c+1.0)/2.0*/
 /*So, c should be in the range [-1, 1]*/
@@ -396,7 +411,7 @@ unsigned char *genRandBitBytes(double bias, size_t datalen, struct randstate *rs
 
   if ((data = malloc(datalen * sizeof(unsigned char))) == NULL) {
     perror("Can't allocate memory for randomly generated data for review.");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   for (i = 0; i < datalen; i++) {
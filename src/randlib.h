@@ -67,6 +67,7 @@ uint64_t randomu64(struct randstate *rstate);
 uint32_t randomu32(struct randstate *rstate);
 uint32_t randomRange(uint32_t high, struct randstate *rstate);
 uint64_t randomRange64(uint64_t high, struct randstate *rstate);
+uint64_t counterRandom64(uint64_t key, uint64_t counter);
 uint32_t genRandBiasedBit(double bias, struct randstate *rstate);
 unsigned char *genRandBitBytes(double bias, size_t datalen, struct randstate *rstate);
 void genRandInts(statData_t *data, size_t datalen, uint32_t k, struct randstate *rstate);
@@ -21,6 +21,7 @@
 #include <sysexits.h>
 
 #include "globals-inst.h"
+#include "loopprofile.h"
 #include "randlib.h"
 #include "precision.h"
 
@@ -154,6 +155,8 @@ static void simulateBound(long double alpha, double H, size_t simulation_rounds)
   double p;
   size_t totalSymbols = 0;
   size_t totalRuns = 0;
+  struct loopProfile profile;
+  struct threadConfig config;
 
   assert(H > 0);
 
@@ -167,14 +170,20 @@ static void simulateBound(long double alpha, double H, size_t simulation_rounds)
   }
   resultsLength = DEFAULT_MAX_RUN_LENGTH;
 
+  saveThreadConfig(&config);
+  loopProfileInit(&profile, "rct-sim", simulation_rounds, false, true);
 #pragma omp parallel
   {
     struct randstate rstate;
     size_t *localResults = NULL;
     size_t localResultsLength = 0;
     uint64_t seed[4];
+    double threadStart;
+    size_t threadIterations = 0;
     size_t curSymbol;
 
+    loadThreadConfig(&config);
+
     if((localResults = calloc(DEFAULT_MAX_RUN_LENGTH, sizeof(size_t)))==NULL) {
       fprintf(stderr, "Can't allocate results array.\n");
       exit(EX_OSERR);
@@ -187,7 +196,9 @@ static void simulateBound(long double alpha, double H, size_t simulation_rounds)
 
     curSymbol = (size_t)floor(fastRandomUnit(seed) / p);
 
-#pragma omp for
+    // The rounds are independent and only tallied, so the runtime schedule is safe to use here (by default, static).
+    threadStart = loopProfileNow();
+#pragma omp for schedule(runtime) nowait
     for (size_t i = 0; i < simulation_rounds; i++) {
       size_t curRun = simulateCount(p, &curSymbol, seed);
 
@@ -199,7 +210,9 @@ static void simulateBound(long double alpha, double H, size_t simulation_rounds)
   
       assert(curRun < localResultsLength);
       localResults[curRun]++;
+      threadIterations++;
     }
+    loopProfileThreadDone(&profile, threadStart, threadIterations);
 
 #pragma omp critical(resultUpdate)
     {
@@ -211,6 +224,7 @@ static void simulateBound(long double alpha, double H, size_t simulation_rounds)
     }
     free(localResults);
   }
+  loopProfileFinish(&profile);
 
   for (size_t i = 1; i < resultsLength; i++)  {
     totalSymbols += (results[i] * i);
@@ -297,6 +311,9 @@ int main(int argc, char *argv[]) {
   argc -= optind;
   argv += optind;
 
+  // The schedule(runtime) loops stay static unless OMP_SCHEDULE says otherwise.
+  loopScheduleDefault(omp_sched_static, 0);
+
   if (argc != 1) {
     useageExit();
   }
@@ -43,6 +43,7 @@ struct threadData {
   size_t simulationRounds;
   bool configFixedSymbol;
   size_t *results;
+  struct threadConfig config;
 };
 
 static inline size_t sizeMax(size_t a, size_t b) {
@@ -211,10 +212,11 @@ static void *simulateBoundThread(void *ptr) {
 
   assert(ptr != NULL);
 
-  initGenerator(&rstate);
-
   // This is the per-thread-specific data, including working area for all the tests and the shuffled data.
   localThreadData = (struct threadData *)ptr;
+  loadThreadConfig(&localThreadData->config);
+
+  initGenerator(&rstate);
 
   assert((localThreadData->alpha > 0.0) && (localThreadData->alpha <= 1.0));
   assert(localThreadData->k > 1);
@@ -290,6 +292,7 @@ static size_t simulateBound(double alpha, size_t k, double p, size_t subsetSize,
   baseThreadData.p = p;
   baseThreadData.subsetSize = subsetSize;
   baseThreadData.configFixedSymbol = configFixedSymbol;
+  saveThreadConfig(&baseThreadData.config);
 
   taskQuotient = simulationRounds / configThreadCount;
   taskRemainder = simulationRounds % configThreadCount;
@@ -21,6 +21,7 @@
 #include "entlib.h"
 #include "globals.h"
 #include "sa.h"
+#include "telemetry.h"
 
 /*Using the Kasai (et al.) O(n) time "13n space" algorithm.*/
 //In this implementation, we use 4 byte indexes
@@ -38,8 +39,9 @@ static void sa2lcp(const statData_t *s, size_t n, saidx_t *sa, saidx_t *lcp) {
 
   if ((rank = (saidx_t *)malloc((size_t)(n + 1) * sizeof(saidx_t))) == NULL) {
     perror("Can't allocate working space for algorithm");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  scratchAllocated((size_t)(n + 1) * sizeof(saidx_t));
 
   for (i = 0; i <= (saidx_t)n; i++) rank[i] = -1;
 
@@ -74,6 +76,7 @@ static void sa2lcp(const statData_t *s, size_t n, saidx_t *sa, saidx_t *lcp) {
   }
 
   free(rank);
+  scratchFreed((size_t)(n + 1) * sizeof(saidx_t));
 }
 
 /*Using the Kasai (et al.) O(n) time "25n space" algorithm.*/
@@ -91,8 +94,9 @@ static void sa2lcp64(const statData_t *s, size_t n, saidx64_t *sa, saidx64_t *lc
 
   if ((rank = (saidx64_t *)malloc((size_t)(n + 1) * sizeof(saidx64_t))) == NULL) {
     perror("Can't allocate working space for algorithm");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  scratchAllocated((size_t)(n + 1) * sizeof(saidx64_t));
 
   for (i = 0; i <= (saidx64_t)n; i++) rank[i] = -1;
 
@@ -127,6 +131,7 @@ static void sa2lcp64(const statData_t *s, size_t n, saidx64_t *sa, saidx64_t *lc
   }
 
   free(rank);
+  scratchFreed((size_t)(n + 1) * sizeof(saidx64_t));
 }
 
 static int compareIntegerString(const statData_t *corpis, saidx_t o1, saidx_t o2, size_t n) {
@@ -172,7 +177,7 @@ static bool isValidSA(const statData_t *corpis, size_t n, saidx_t *SA) {
 
   if ((presentArray = malloc((n + 1) * sizeof(uint8_t))) == NULL) {
     perror("Can't allocate indicator array");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   /*First, test that this is a permutation*/
@@ -212,7 +217,7 @@ static bool isValidSA64(const statData_t *corpis, size_t n, saidx64_t *SA) {
 
   if ((presentArray = malloc((n + 1) * sizeof(uint8_t))) == NULL) {
     perror("Can't allocate indicator array");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
 
   /*First, test that this is a permutation*/
@@ -248,8 +253,8 @@ static bool isValidSA64(const statData_t *corpis, size_t n, saidx64_t *SA) {
 }
 #endif
 
-static const statData_t *globalS;
-static size_t globalN;
+static _Thread_local const statData_t *globalS;
+static _Thread_local size_t globalN;
 
 static int SAcmp(const void *o1, const void *o2) {
   return (compareIntegerString(globalS, *((const saidx_t *)o1), *((const saidx_t *)o2), globalN));
@@ -294,8 +299,9 @@ void calcSALCP(const statData_t *inData, size_t n, size_t k, saidx_t *SA, saidx_
 #if STATDATA_MAX >= 256
     if ((smallData = (uint8_t *)malloc((n) * sizeof(uint8_t))) == NULL) {
       perror("Can't allocate smaller array");
-      exit(EX_OSERR);
+      fatalError(EX_OSERR);
     }
+    scratchAllocated(n * sizeof(uint8_t));
 
     for (j = 0; j < n; j++) {
       assert(inData[j] < 256);
@@ -304,6 +310,7 @@ void calcSALCP(const statData_t *inData, size_t n, size_t k, saidx_t *SA, saidx_
 
     res = divsufsort((sauchar_t *)smallData, (saidx_t *)(SA + 1), (saidx_t)(n));
     free(smallData);
+    scratchFreed(n * sizeof(uint8_t));
 #else
     res = divsufsort((const sauchar_t *)inData, (saidx_t *)(SA + 1), (saidx_t)(n));
 #endif
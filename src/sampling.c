@@ -0,0 +1,237 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+#include "binio.h"
+#include "blockio.h"
+#include "randlib.h"
+#include "sampling.h"
+#include "textio.h"
+
+/*Sampling with replacement, without holding the population in memory.
+ *The sample indices are drawn up front and sorted, so the population can be gathered in a single sequential pass.
+ *A sorted list of independent uniform draws, put into a uniformly random order, has the same distribution as
+ *the original sequence of draws, so a final shuffle of the gathered values restores the expected output.
+ */
+
+// The largest element that shuffleElements supports
+#define SAMPLINGMAXELEMENT 16
+
+/*LSD radix sort, 8 bits per pass. Only the low-order bytes that can be non-zero (given maxValue) are processed.*/
+static void radixSortUint64(uint64_t *data, size_t datalen, uint64_t maxValue) {
+  uint64_t *scratch;
+  uint64_t *src;
+  uint64_t *dst;
+  uint64_t *tmp;
+  size_t counts[256];
+  size_t total;
+  size_t curCount;
+  unsigned int shift;
+
+  if (datalen < 2) return;
+
+  if ((scratch = malloc(datalen * sizeof(uint64_t))) == NULL) {
+    perror("Can't allocate sort buffer");
+    exit(EX_OSERR);
+  }
+
+  src = data;
+  dst = scratch;
+  for (shift = 0; (shift < 64) && ((maxValue >> shift) != 0); shift += 8) {
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < datalen; i++) counts[(src[i] >> shift) & 0xFFU]++;
+
+    total = 0;
+    for (size_t j = 0; j < 256; j++) {
+      curCount = counts[j];
+      counts[j] = total;
+      total += curCount;
+    }
+
+    for (size_t i = 0; i < datalen; i++) dst[counts[(src[i] >> shift) & 0xFFU]++] = src[i];
+
+    tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != data) memcpy(data, src, datalen * sizeof(uint64_t));
+  free(scratch);
+}
+
+/*Draw count indices uniformly (with replacement) from [0, populationSize), and sort them.*/
+void drawSortedIndices(uint64_t *indices, size_t count, uint64_t populationSize, struct randstate *rstate) {
+  assert((indices != NULL) || (count == 0));
+  assert(populationSize > 0);
+
+  for (size_t i = 0; i < count; i++) {
+    indices[i] = randomRange64(populationSize - 1, rstate);
+  }
+
+  radixSortUint64(indices, count, populationSize - 1);
+}
+
+/*Fisher-Yates shuffle of count elements, each elementSize bytes.*/
+void shuffleElements(void *data, size_t count, size_t elementSize, struct randstate *rstate) {
+  unsigned char *elements;
+  unsigned char temp[SAMPLINGMAXELEMENT];
+  size_t j;
+
+  assert((data != NULL) || (count == 0));
+  assert((elementSize > 0) && (elementSize <= SAMPLINGMAXELEMENT));
+
+  elements = data;
+  for (size_t i = count; i > 1; i--) {
+    j = (size_t)randomRange64(i - 1, rstate);
+    if (j != i - 1) {
+      memcpy(temp, elements + (i - 1) * elementSize, elementSize);
+      memcpy(elements + (i - 1) * elementSize, elements + j * elementSize, elementSize);
+      memcpy(elements + j * elementSize, temp, elementSize);
+    }
+  }
+}
+
+static uint64_t *allocateIndices(size_t sampleCount) {
+  uint64_t *indices;
+
+  if ((indices = malloc(sampleCount * sizeof(uint64_t))) == NULL) {
+    perror("Can't allocate array for sample indices");
+    exit(EX_OSERR);
+  }
+
+  return indices;
+}
+
+/*Sample sampleCount elements (with replacement) from the binary file input, which is read once, sequentially.
+ *Returns the number of elements in the file (the population size).
+ */
+uint64_t sampleBinaryFile(FILE *input, size_t elementSize, void *output, size_t sampleCount, struct randstate *rstate) {
+  uint64_t populationSize;
+  uint64_t *indices;
+  uint64_t offset;
+  size_t next;
+  size_t count;
+  const unsigned char *block;
+  unsigned char *outputElements;
+  struct blockReader reader;
+
+  assert(input != NULL);
+  assert(output != NULL);
+  assert(elementSize > 0);
+
+  populationSize = getfilesize(input) / elementSize;
+  if (populationSize == 0) return 0;
+
+  indices = allocateIndices(sampleCount);
+  drawSortedIndices(indices, sampleCount, populationSize, rstate);
+
+  outputElements = output;
+  offset = 0;
+  next = 0;
+  initBlockReader(&reader, input, elementSize, true);
+  while ((next < sampleCount) && ((count = readBlock(&reader, (const void **)&block)) > 0)) {
+    while ((next < sampleCount) && (indices[next] < offset + count)) {
+      memcpy(outputElements + next * elementSize, block + (indices[next] - offset) * elementSize, elementSize);
+      next++;
+    }
+    offset += count;
+  }
+  freeBlockReader(&reader);
+
+  if (next != sampleCount) {
+    fprintf(stderr, "Input file was truncated while sampling\n");
+    exit(EX_DATAERR);
+  }
+
+  free(indices);
+  shuffleElements(output, sampleCount, elementSize, rstate);
+
+  return populationSize;
+}
+
+/*Parse one line in the format used by readasciiuint64s. Returns false at the end of the input.*/
+static bool readAsciiUint64Line(struct textReader *reader, uint64_t *value) {
+  char *curline;
+  unsigned long long inInt;
+  char *afterInt;
+
+  if ((curline = readTextLine(reader, NULL)) == NULL) return false;
+
+  errno = 0;
+  inInt = textToUint64(curline, &afterInt, 0);
+
+  if (((*afterInt != '\r') && (*afterInt != '\0')) || ((inInt == ULLONG_MAX) && (errno == ERANGE))) {
+    fprintf(stderr, "data error on line %zu\n", reader->lineNumber);
+    exit(EX_DATAERR);
+  }
+  *value = inInt;
+  return true;
+}
+
+/*Sample sampleCount values (with replacement) from a file of decimal values, one per line.
+ *The file is read twice: once to count the values, and once to gather the sample.
+ *Returns the number of values in the file (the population size).
+ */
+uint64_t sampleAsciiUint64File(FILE *input, uint64_t *output, size_t sampleCount, struct randstate *rstate) {
+  uint64_t populationSize;
+  uint64_t *indices;
+  uint64_t lineIndex;
+  uint64_t value;
+  size_t next;
+  struct textReader reader;
+
+  assert(input != NULL);
+  assert(output != NULL);
+
+  populationSize = 0;
+  initTextReader(&reader, input);
+  while (readAsciiUint64Line(&reader, &value)) populationSize++;
+  freeTextReader(&reader);
+  if (populationSize == 0) return 0;
+
+  if (fseek(input, 0, SEEK_SET) < 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
+  }
+  clearerr(input);
+
+  indices = allocateIndices(sampleCount);
+  drawSortedIndices(indices, sampleCount, populationSize, rstate);
+
+  lineIndex = 0;
+  next = 0;
+  initTextReader(&reader, input);
+  while ((next < sampleCount) && readAsciiUint64Line(&reader, &value)) {
+    while ((next < sampleCount) && (indices[next] == lineIndex)) {
+      output[next] = value;
+      next++;
+    }
+    lineIndex++;
+  }
+  freeTextReader(&reader);
+
+  if (next != sampleCount) {
+    fprintf(stderr, "Input file was truncated while sampling\n");
+    exit(EX_DATAERR);
+  }
+
+  free(indices);
+  shuffleElements(output, sampleCount, sizeof(uint64_t), rstate);
+
+  return populationSize;
+}
@@ -0,0 +1,23 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "randlib.h"
+
+void drawSortedIndices(uint64_t *indices, size_t count, uint64_t populationSize, struct randstate *rstate);
+void shuffleElements(void *data, size_t count, size_t elementSize, struct randstate *rstate);
+uint64_t sampleBinaryFile(FILE *input, size_t elementSize, void *output, size_t sampleCount, struct randstate *rstate);
+uint64_t sampleAsciiUint64File(FILE *input, uint64_t *output, size_t sampleCount, struct randstate *rstate);
+#endif
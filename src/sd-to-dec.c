@@ -18,16 +18,28 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "entlib.h"
+#include "textio.h"
 
 int main(void) {
-  statData_t indata;
+  const statData_t *indata;
+  struct blockReader reader;
+  struct textWriter writer;
+  size_t count;
+  size_t i;
 
-  while (feof(stdin) == 0) {
-    if (fread(&indata, sizeof(statData_t), 1, stdin) == 1) {
-      printf("%u\n", indata);
+  initBlockReader(&reader, stdin, sizeof(statData_t), false);
+  initTextWriter(&writer, stdout);
+
+  while ((count = readBlock(&reader, (const void **)&indata)) > 0) {
+    for (i = 0; i < count; i++) {
+      writeDecimalLine(&writer, indata[i]);
     }
   }
 
+  freeBlockReader(&reader);
+  freeTextWriter(&writer);
+
   return (0);
 }
@@ -13,7 +13,6 @@
 #include <libgen.h>
 #include <limits.h>
 #include <math.h>
-#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -21,11 +20,13 @@
 #include <stdlib.h>
 #include <stdnoreturn.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sysexits.h>
 #include <unistd.h>
 
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "enttypes.h"
 #include "globals-inst.h"
 #include "globals.h"
@@ -34,177 +35,403 @@
 
 static uint32_t *data;
 static size_t datalen;
-static pthread_mutex_t threadsWaitingMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_barrier_t joinBarrier;
 static bool configConservative = false;
+static bool configMarginalize = false;
 
-static uint32_t threadsWaiting;
+// Marginalization mode is only supported when the full table of packed symbols remains reasonably small.
+#define MARGINALMAXBITS 16U
+
+/* In marginalization mode, the data is summarized once by the count of each packed active-bit symbol and
+ * the count of each observed adjacent pair of packed symbols. The NSA Markov estimate depends on the data
+ * only through these counts (and the last symbol), so the counts for any mask can be derived from this table
+ * without re-reading the data.
+ */
+struct pairTable {
+  uint32_t activeBits;
+  uint32_t symbolBits;  // The hamming weight of activeBits
+  size_t L;
+  uint32_t lastSymbol;
+  size_t *symbolCounts;  // 2^symbolBits entries
+  size_t distinctPairs;
+  uint32_t *pairs;  // (prior symbol << symbolBits) | current symbol
+  size_t *pairCounts;
+};
+
+static struct pairTable marginalTable;
+
+// Masks are passed to the worker threads through an in-process queue, and the assessments are returned through a second queue.
+// The master thread never has more than "capacity" masks in flight (either pending, being assessed, or awaiting collection),
+// so neither ring buffer can overflow.
+struct maskResult {
+  uint32_t mask;
+  double assessment;
+};
+
+struct taskQueue {
+  pthread_mutex_t lock;
+  pthread_cond_t taskReady;  // Signaled when a mask is submitted, or when the workers should exit
+  pthread_cond_t resultReady;  // Signaled when an assessment is available
+  size_t capacity;
+  uint32_t *pendingMasks;  // Ring buffer of masks waiting for a worker
+  size_t pendingHead;
+  size_t pendingCount;
+  struct maskResult *results;  // Ring buffer of completed assessments
+  size_t resultsHead;
+  size_t resultsCount;
+  bool exiting;
+};
 
-enum workerState { INITSTATE, WORKSTATE, LISTENSTATE, SENDSTATE, WAITSTATE, DONESTATE, RESULTSTATE };
 struct threadInfoType {
   pthread_t threadID;
   uint32_t localThreadID;
-  int assignmentWriteFD;  // this is only written by the master process
-  int assignmentReadFD;  // This is only read by the processing threads
-  int resultsWriteFD;  // This is only written by the processing threads
-  int resultsReadFD;  // this is only read by the master process
-  enum workerState state;
-  size_t jobsAssigned;
+  size_t jobsCompleted;
+  struct taskQueue *queue;
+  struct threadConfig config;
 };
 
-enum workerCommand { EXITCMD, ASSIGNMENTCMD, JOINCMD };
-struct assignmentType {
-  enum workerCommand command;
+/* The assessment memo is a binary file consisting of MEMOMAGIC followed by fixed-size records (in native byte order).
+ * A record is appended as each new assessment is made, so an interrupted run loses at most the assessments in flight.
+ * Records are keyed by a hash of the input data, the input length, the mask and the conservative flag, so one memo file
+ * may be shared across several inputs and modes.
+ */
+#define MEMOMAGIC "THSBMEMO"
+#define MEMOMAGICLEN 8
+struct memoRecord {
+  uint64_t inputHash;
+  uint64_t inputLength;
   uint32_t mask;
+  uint32_t conservative;
+  double assessment;
 };
 
-enum workerResponse { READYRSP, ASSESSMENTRSP };
-struct assessmentType {
-  enum workerResponse response;
-  uint32_t mask;
-  double assessment;
+// An open addressing hash table of the memo records relevant to this run. Mask 0 is never assessed, so it marks empty slots.
+struct assessmentMemo {
+  FILE *fp;
+  uint64_t inputHash;
+  uint64_t inputLength;
+  uint32_t conservative;
+  size_t capacity;  // A power of 2
+  size_t used;
+  uint32_t *masks;
+  double *assessments;
+  size_t hits;
 };
 
+static struct assessmentMemo *memo = NULL;
+
 struct bestMaskData {
   double entropy;
   uint32_t mask;
 };
 
-static uint32_t getThreadsWaiting(void) {
-  uint32_t localThreadsWaiting;
-
-  if (pthread_mutex_lock(&threadsWaitingMutex) != 0) {
+static void lockQueue(struct taskQueue *queue) {
+  if (pthread_mutex_lock(&queue->lock) != 0) {
     perror("Can't get mutex");
     pthread_exit(NULL);
   }
+}
 
-  localThreadsWaiting = threadsWaiting;
-
-  if (pthread_mutex_unlock(&threadsWaitingMutex) != 0) {
-    perror("Can't get mutex");
+static void unlockQueue(struct taskQueue *queue) {
+  if (pthread_mutex_unlock(&queue->lock) != 0) {
+    perror("Can't release mutex");
     pthread_exit(NULL);
   }
+}
 
-  return localThreadsWaiting;
+static void initTaskQueue(struct taskQueue *queue, size_t capacity) {
+  assert(queue != NULL);
+  assert(capacity > 0);
+
+  if ((pthread_mutex_init(&queue->lock, NULL) != 0) || (pthread_cond_init(&queue->taskReady, NULL) != 0) || (pthread_cond_init(&queue->resultReady, NULL) != 0)) {
+    perror("Can't initialize the task queue");
+    exit(EX_OSERR);
+  }
+
+  if (((queue->pendingMasks = malloc(sizeof(uint32_t) * capacity)) == NULL) || ((queue->results = malloc(sizeof(struct maskResult) * capacity)) == NULL)) {
+    perror("Can't get memory for the task queue");
+    exit(EX_OSERR);
+  }
+
+  queue->capacity = capacity;
+  queue->pendingHead = 0;
+  queue->pendingCount = 0;
+  queue->resultsHead = 0;
+  queue->resultsCount = 0;
+  queue->exiting = false;
 }
 
-static void incThreadsWaiting(void) {
-  if (pthread_mutex_lock(&threadsWaitingMutex) != 0) {
-    perror("Can't get mutex");
-    pthread_exit(NULL);
+static void freeTaskQueue(struct taskQueue *queue) {
+  assert(queue->pendingCount == 0);
+  assert(queue->resultsCount == 0);
+
+  pthread_cond_destroy(&queue->taskReady);
+  pthread_cond_destroy(&queue->resultReady);
+  pthread_mutex_destroy(&queue->lock);
+  free(queue->pendingMasks);
+  free(queue->results);
+  queue->pendingMasks = NULL;
+  queue->results = NULL;
+}
+
+// Called by the master thread. The caller is responsible for keeping the number of masks in flight below the queue capacity.
+static void submitMask(struct taskQueue *queue, uint32_t mask) {
+  lockQueue(queue);
+  assert(queue->pendingCount < queue->capacity);
+  queue->pendingMasks[(queue->pendingHead + queue->pendingCount) % queue->capacity] = mask;
+  queue->pendingCount++;
+  if (pthread_cond_signal(&queue->taskReady) != 0) {
+    perror("Can't signal worker threads");
+    exit(EX_OSERR);
   }
+  unlockQueue(queue);
+}
 
-  assert(threadsWaiting < UINT32_MAX);
-  threadsWaiting++;
+// Called by the master thread; blocks until some assessment is available.
+static void collectAssessment(struct taskQueue *queue, uint32_t *mask, double *assessment) {
+  assert(mask != NULL);
+  assert(assessment != NULL);
 
-  if (pthread_mutex_unlock(&threadsWaitingMutex) != 0) {
-    perror("Can't get mutex");
-    pthread_exit(NULL);
+  lockQueue(queue);
+  while (queue->resultsCount == 0) {
+    if (pthread_cond_wait(&queue->resultReady, &queue->lock) != 0) {
+      perror("Can't wait for worker threads");
+      exit(EX_OSERR);
+    }
   }
+
+  *mask = queue->results[queue->resultsHead].mask;
+  *assessment = queue->results[queue->resultsHead].assessment;
+  queue->resultsHead = (queue->resultsHead + 1) % queue->capacity;
+  queue->resultsCount--;
+  unlockQueue(queue);
 }
 
-static void decThreadsWaiting(void) {
-  if (pthread_mutex_lock(&threadsWaitingMutex) != 0) {
-    perror("Can't get mutex");
-    pthread_exit(NULL);
+// Called by the worker threads; blocks until a mask is available. Returns false if the worker should exit.
+static bool takeMask(struct taskQueue *queue, uint32_t *mask) {
+  bool haveMask;
+
+  assert(mask != NULL);
+
+  lockQueue(queue);
+  while ((queue->pendingCount == 0) && !queue->exiting) {
+    if (pthread_cond_wait(&queue->taskReady, &queue->lock) != 0) {
+      perror("Can't wait for assignment");
+      pthread_exit(NULL);
+    }
+  }
+
+  if (queue->pendingCount > 0) {
+    *mask = queue->pendingMasks[queue->pendingHead];
+    queue->pendingHead = (queue->pendingHead + 1) % queue->capacity;
+    queue->pendingCount--;
+    haveMask = true;
+  } else {
+    haveMask = false;
   }
+  unlockQueue(queue);
 
-  assert(threadsWaiting > 0);
-  threadsWaiting--;
+  return haveMask;
+}
 
-  if (pthread_mutex_unlock(&threadsWaitingMutex) != 0) {
-    perror("Can't get mutex");
+// Called by the worker threads.
+static void postAssessment(struct taskQueue *queue, uint32_t mask, double assessment) {
+  size_t slot;
+
+  lockQueue(queue);
+  assert(queue->resultsCount < queue->capacity);
+  slot = (queue->resultsHead + queue->resultsCount) % queue->capacity;
+  queue->results[slot].mask = mask;
+  queue->results[slot].assessment = assessment;
+  queue->resultsCount++;
+  if (pthread_cond_signal(&queue->resultReady) != 0) {
+    perror("Can't signal master thread");
     pthread_exit(NULL);
   }
+  unlockQueue(queue);
 }
 
-static void readMessage(int fd, void *buffer, size_t len) {
-  ssize_t result = 0;
-  size_t readin = 0;
+// FNV-1a, applied to 32-bit words, followed by a final avalanche step.
+static uint64_t hashInput(const uint32_t *indata, size_t L) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
 
-  assert(errno == 0);
+  for (size_t i = 0; i < L; i++) {
+    hash ^= indata[i];
+    hash *= 0x100000001b3ULL;
+  }
 
-  while (readin < len) {
-    result = read(fd, buffer, len - readin);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
 
-    if (result < 0) {
-      if ((errno == EAGAIN) || (errno == EINTR)) {
-        perror("Error reading pipe; continuing");
-        errno = 0;
-      } else {
-        perror("Read error in computing thread");
-        pthread_exit(NULL);
-      }
-    } else {
-      readin += (size_t)result;
-    }
+static size_t memoSlot(const struct assessmentMemo *table, uint32_t mask) {
+  size_t slot = ((size_t)mask * 2654435761U) & (table->capacity - 1);
+
+  while ((table->masks[slot] != 0) && (table->masks[slot] != mask)) {
+    slot = (slot + 1) & (table->capacity - 1);
   }
+
+  return slot;
 }
 
-static void writeMessage(int fd, void *buffer, size_t len) {
-  ssize_t result = 0;
-  size_t wroteOut = 0;
+static bool memoLookup(const struct assessmentMemo *table, uint32_t mask, double *assessment) {
+  size_t slot = memoSlot(table, mask);
 
-  assert(errno == 0);
+  if (table->masks[slot] == mask) {
+    *assessment = table->assessments[slot];
+    return true;
+  } else {
+    return false;
+  }
+}
 
-  while (wroteOut < len) {
-    result = write(fd, buffer, len - wroteOut);
+static void memoInsert(struct assessmentMemo *table, uint32_t mask, double assessment) {
+  size_t slot;
 
-    if (result < 0) {
-      if ((errno == EAGAIN) || (errno == EINTR)) {
-        perror("Error writing to pipe; continuing");
-        errno = 0;
-      } else {
-        perror("Write error in computing thread");
-        pthread_exit(NULL);
+  assert(mask != 0);
+
+  // Keep the load factor at or below 1/2
+  if (2 * (table->used + 1) > table->capacity) {
+    uint32_t *oldMasks = table->masks;
+    double *oldAssessments = table->assessments;
+    size_t oldCapacity = table->capacity;
+
+    table->capacity = 2 * oldCapacity;
+    if (((table->masks = calloc(table->capacity, sizeof(uint32_t))) == NULL) || ((table->assessments = malloc(table->capacity * sizeof(double))) == NULL)) {
+      perror("Can't allocate memory for the assessment memo");
+      exit(EX_OSERR);
+    }
+
+    for (size_t i = 0; i < oldCapacity; i++) {
+      if (oldMasks[i] != 0) {
+        slot = memoSlot(table, oldMasks[i]);
+        table->masks[slot] = oldMasks[i];
+        table->assessments[slot] = oldAssessments[i];
       }
-    } else {
-      wroteOut += (size_t)result;
     }
+
+    free(oldMasks);
+    free(oldAssessments);
   }
+
+  slot = memoSlot(table, mask);
+  if (table->masks[slot] == 0) {
+    table->masks[slot] = mask;
+    table->used++;
+  }
+  table->assessments[slot] = assessment;
 }
 
-static enum workerCommand getAssignment(int fd, uint32_t *mask) {
-  struct assignmentType localAssignment;
+// Open (or create) the memo file, and load all the records that apply to this input and mode.
+static struct assessmentMemo *openMemo(const char *filename, const uint32_t *indata, size_t L, bool conservative) {
+  struct assessmentMemo *table;
+  struct memoRecord record;
+  struct stat fileStat;
+  char magic[MEMOMAGICLEN];
+  size_t recordCount;
+  size_t loaded = 0;
+
+  if ((table = malloc(sizeof(struct assessmentMemo))) == NULL) {
+    perror("Can't allocate memory for the assessment memo");
+    exit(EX_OSERR);
+  }
 
-  assert(mask != NULL);
+  table->inputHash = hashInput(indata, L);
+  table->inputLength = (uint64_t)L;
+  table->conservative = conservative ? 1U : 0U;
+  table->capacity = 1024;
+  table->used = 0;
+  table->hits = 0;
 
-  readMessage(fd, &localAssignment, sizeof(struct assignmentType));
-  *mask = localAssignment.mask;
+  if (((table->masks = calloc(table->capacity, sizeof(uint32_t))) == NULL) || ((table->assessments = malloc(table->capacity * sizeof(double))) == NULL)) {
+    perror("Can't allocate memory for the assessment memo");
+    exit(EX_OSERR);
+  }
 
-  return localAssignment.command;
-}
+  // Reads may be from anywhere, but all writes append.
+  if ((table->fp = fopen(filename, "a+b")) == NULL) {
+    perror("Can't open assessment memo file");
+    exit(EX_CANTCREAT);
+  }
 
-static enum workerResponse getAssessment(int fd, uint32_t *mask, double *assessment) {
-  struct assessmentType localAssessment;
+  if (fstat(fileno(table->fp), &fileStat) != 0) {
+    perror("Can't stat assessment memo file");
+    exit(EX_IOERR);
+  }
 
-  assert(mask != NULL);
-  assert(assessment != NULL);
+  if (fileStat.st_size == 0) {
+    if ((fwrite(MEMOMAGIC, 1, MEMOMAGICLEN, table->fp) != MEMOMAGICLEN) || (fflush(table->fp) != 0)) {
+      perror("Can't write assessment memo header");
+      exit(EX_IOERR);
+    }
+  } else {
+    rewind(table->fp);
+    if ((fread(magic, 1, MEMOMAGICLEN, table->fp) != MEMOMAGICLEN) || (memcmp(magic, MEMOMAGIC, MEMOMAGICLEN) != 0)) {
+      fprintf(stderr, "File %s is not a selectbits assessment memo.\n", filename);
+      exit(EX_DATAERR);
+    }
 
-  readMessage(fd, &localAssessment, sizeof(struct assessmentType));
-  *assessment = localAssessment.assessment;
-  *mask = localAssessment.mask;
+    // A run that was interrupted mid-write may have left a partial record; discard it so that later appends stay aligned.
+    recordCount = ((size_t)fileStat.st_size - MEMOMAGICLEN) / sizeof(struct memoRecord);
+    if ((size_t)fileStat.st_size != MEMOMAGICLEN + recordCount * sizeof(struct memoRecord)) {
+      fprintf(stderr, "Discarding a partial record at the end of the assessment memo.\n");
+      if (ftruncate(fileno(table->fp), (off_t)(MEMOMAGICLEN + recordCount * sizeof(struct memoRecord))) != 0) {
+        perror("Can't truncate assessment memo file");
+        exit(EX_IOERR);
+      }
+    }
 
-  return localAssessment.response;
+    for (size_t i = 0; i < recordCount; i++) {
+      if (fread(&record, sizeof(struct memoRecord), 1, table->fp) != 1) {
+        perror("Can't read assessment memo record");
+        exit(EX_IOERR);
+      }
+
+      if ((record.inputHash == table->inputHash) && (record.inputLength == table->inputLength) && (record.conservative == table->conservative) && (record.mask != 0)) {
+        memoInsert(table, record.mask, record.assessment);
+        loaded++;
+      }
+    }
+  }
+
+  fprintf(stderr, "Loaded %zu prior assessments from %s (input hash 0x%016llX)\n", loaded, filename, (unsigned long long)table->inputHash);
+
+  return table;
 }
 
-static void sendAssignment(int fd, uint32_t mask, enum workerCommand command) {
-  struct assignmentType localAssignment;
+// Add a new assessment to the memo file (and the in-memory table). Assessments that are already present are not duplicated.
+static void memoStore(struct assessmentMemo *table, uint32_t mask, double assessment) {
+  struct memoRecord record;
+  double priorAssessment;
+
+  if (memoLookup(table, mask, &priorAssessment)) return;
+
+  memoInsert(table, mask, assessment);
 
-  localAssignment.mask = mask;
-  localAssignment.command = command;
+  record.inputHash = table->inputHash;
+  record.inputLength = table->inputLength;
+  record.mask = mask;
+  record.conservative = table->conservative;
+  record.assessment = assessment;
 
-  writeMessage(fd, &localAssignment, sizeof(struct assignmentType));
+  if ((fwrite(&record, sizeof(struct memoRecord), 1, table->fp) != 1) || (fflush(table->fp) != 0)) {
+    perror("Can't write to assessment memo file");
+    exit(EX_IOERR);
+  }
 }
 
-static void sendAssessment(int fd, double assessment, uint32_t mask, enum workerResponse response) {
-  struct assessmentType localAssessment;
+static void closeMemo(struct assessmentMemo *table) {
+  fprintf(stderr, "Reused %zu prior assessments; assessment memo now has %zu entries for this input.\n", table->hits, table->used);
 
-  localAssessment.assessment = assessment;
-  localAssessment.mask = mask;
-  localAssessment.response = response;
+  if (fclose(table->fp) != 0) {
+    perror("Can't close assessment memo file");
+    exit(EX_IOERR);
+  }
 
-  writeMessage(fd, &localAssessment, sizeof(struct assessmentType));
+  free(table->masks);
+  free(table->assessments);
+  free(table);
 }
 
 static double processAndAssess(uint32_t currentMask, const uint32_t *indata, statData_t *rewrittendata, size_t indatalen) {
@@ -214,82 +441,165 @@ static double processAndAssess(uint32_t currentMask, const uint32_t *indata, sta
   return NSAMarkovEstimate(rewrittendata, indatalen, k, "Literal", configConservative, 0.0);
 }
 
+// Tabulate the symbol and adjacent pair counts for the packed active bits using a single pass over the data.
+// The pairs are bucketed by their prior symbol (a counting sort), and each bucket is then tallied.
+static void buildPairTable(const uint32_t *indata, size_t L, uint32_t activeBits, struct pairTable *table) {
+  size_t fullk;
+  size_t *bucketStart;
+  size_t *tally;
+  uint16_t *successors;
+  size_t maxPairs;
+  uint32_t prior;
+
+  assert(indata != NULL);
+  assert(table != NULL);
+  assert(L > 1);
+
+  table->activeBits = activeBits;
+  table->symbolBits = (uint32_t)__builtin_popcount(activeBits);
+  table->L = L;
+  assert(table->symbolBits <= MARGINALMAXBITS);
+
+  fullk = (size_t)1 << table->symbolBits;
+  maxPairs = ((L - 1) < fullk * fullk) ? (L - 1) : (fullk * fullk);
+
+  if (((table->symbolCounts = calloc(fullk, sizeof(size_t))) == NULL) || ((bucketStart = calloc(fullk + 1, sizeof(size_t))) == NULL) || ((tally = calloc(fullk, sizeof(size_t))) == NULL) ||
+      ((successors = malloc((L - 1) * sizeof(uint16_t))) == NULL) || ((table->pairs = malloc(maxPairs * sizeof(uint32_t))) == NULL) || ((table->pairCounts = malloc(maxPairs * sizeof(size_t))) == NULL)) {
+    perror("Can't allocate memory for the pair table");
+    exit(EX_OSERR);
+  }
+
+  // Pass 1: symbol counts. The number of pairs starting with each symbol is the symbol count, excluding the last symbol.
+  for (size_t i = 0; i < L; i++) {
+    table->symbolCounts[extractbits(indata[i], activeBits)]++;
+  }
+  table->lastSymbol = extractbits(indata[L - 1], activeBits);
+
+  for (size_t i = 0; i < fullk; i++) {
+    bucketStart[i + 1] = bucketStart[i] + table->symbolCounts[i] - ((i == table->lastSymbol) ? 1U : 0U);
+  }
+  assert(bucketStart[fullk] == L - 1);
+
+  // Pass 2: place each successor symbol in the bucket for its prior symbol.
+  // tally is temporarily used as the fill pointer for each bucket.
+  prior = extractbits(indata[0], activeBits);
+  for (size_t i = 1; i < L; i++) {
+    uint32_t cur = extractbits(indata[i], activeBits);
+    successors[bucketStart[prior] + tally[prior]] = (uint16_t)cur;
+    tally[prior]++;
+    prior = cur;
+  }
+
+  for (size_t i = 0; i < fullk; i++) tally[i] = 0;
+
+  // Tally each bucket, and emit the distinct pairs.
+  table->distinctPairs = 0;
+  for (size_t a = 0; a < fullk; a++) {
+    for (size_t j = bucketStart[a]; j < bucketStart[a + 1]; j++) {
+      tally[successors[j]]++;
+    }
+
+    for (size_t j = bucketStart[a]; j < bucketStart[a + 1]; j++) {
+      if (tally[successors[j]] != 0) {
+        assert(table->distinctPairs < maxPairs);
+        table->pairs[table->distinctPairs] = (uint32_t)((a << table->symbolBits) | successors[j]);
+        table->pairCounts[table->distinctPairs] = tally[successors[j]];
+        table->distinctPairs++;
+        tally[successors[j]] = 0;
+      }
+    }
+  }
+
+  fprintf(stderr, "Pair table contains %zu distinct pairs of %zu-bit symbols\n", table->distinctPairs, (size_t)table->symbolBits);
+
+  free(successors);
+  free(tally);
+  free(bucketStart);
+}
+
+static void freePairTable(struct pairTable *table) {
+  free(table->symbolCounts);
+  free(table->pairs);
+  free(table->pairCounts);
+  table->symbolCounts = NULL;
+  table->pairs = NULL;
+  table->pairCounts = NULL;
+}
+
+// Derive the symbol and transition counts for currentMask from the pair table, and then assess these counts.
+// symbolMap is scratch space of length 2^(table->symbolBits)
+static double marginalizeAndAssess(uint32_t currentMask, const struct pairTable *table, statData_t *symbolMap) {
+  size_t k = 1U << ((size_t)__builtin_popcount(currentMask));
+  size_t fullk = (size_t)1 << table->symbolBits;
+  uint32_t packedMask;
+  size_t *count;
+  size_t *oij;
+  double result;
+
+  assert((currentMask & ~(table->activeBits)) == 0);
+  packedMask = extractbits(currentMask, table->activeBits);
+
+  if (((count = calloc(k, sizeof(size_t))) == NULL) || ((oij = calloc(k * k, sizeof(size_t))) == NULL)) {
+    perror("Memory allocation error in computing thread");
+    pthread_exit(NULL);
+  }
+
+  for (size_t a = 0; a < fullk; a++) {
+    symbolMap[a] = (statData_t)extractbits((uint32_t)a, packedMask);
+    count[symbolMap[a]] += table->symbolCounts[a];
+  }
+
+  for (size_t j = 0; j < table->distinctPairs; j++) {
+    uint32_t priorSymbol = table->pairs[j] >> table->symbolBits;
+    uint32_t curSymbol = table->pairs[j] & (uint32_t)(fullk - 1);
+    oij[(size_t)symbolMap[priorSymbol] * k + (size_t)symbolMap[curSymbol]] += table->pairCounts[j];
+  }
+
+  result = NSAMarkovEstimateFromCounts(count, oij, symbolMap[table->lastSymbol], table->L, k, "Literal", configConservative, 0.0);
+
+  free(count);
+  free(oij);
+  return result;
+}
+
 static void *doAssessmentThread(void *opaqueDataIn) {
   struct threadInfoType *threadInfo;
   statData_t *rewrittendata;
+  size_t scratchLen;
   uint32_t currentMask;
-  bool working = true;
-  enum workerCommand command;
   double assessedEnt;
-  int res;
 
   threadInfo = (struct threadInfoType *)opaqueDataIn;
+  loadThreadConfig(&threadInfo->config);
   if (configVerbose > 1) {
-    fprintf(stderr, "Thread %u in INIT State\n", threadInfo->localThreadID);
+    fprintf(stderr, "Thread %u starting\n", threadInfo->localThreadID);
   }
 
-  if ((rewrittendata = malloc(sizeof(statData_t) * datalen)) == NULL) {
+  // In marginalization mode, the scratch space is the packed symbol map; otherwise it holds the rewritten data.
+  scratchLen = configMarginalize ? ((size_t)1 << marginalTable.symbolBits) : datalen;
+
+  if ((rewrittendata = malloc(sizeof(statData_t) * scratchLen)) == NULL) {
     perror("Memory allocation error in computing thread");
     pthread_exit(NULL);
   }
 
-  while (working) {
-    // Request an assignment
-    threadInfo->state = SENDSTATE;
-    if (configVerbose > 1) {
-      fprintf(stderr, "Thread %u in SEND State\n", threadInfo->localThreadID);
-    }
-    sendAssessment(threadInfo->resultsWriteFD, -DBL_INFINITY, 0, READYRSP);
-
-    // Receive a command
-    threadInfo->state = LISTENSTATE;
+  while (takeMask(threadInfo->queue, &currentMask)) {
     if (configVerbose > 1) {
-      fprintf(stderr, "Thread %u in LISTEN State\n", threadInfo->localThreadID);
+      fprintf(stderr, "Thread %u assessing 0x%08x\n", threadInfo->localThreadID, currentMask);
     }
-    command = getAssignment(threadInfo->assignmentReadFD, &currentMask);
 
-    if (command == ASSIGNMENTCMD) {
-      // Assignment was received
-      // perform the assessment
-      threadInfo->state = WORKSTATE;
-      if (configVerbose > 1) {
-        fprintf(stderr, "Thread %u in WORK State; assignment is 0x%08x\n", threadInfo->localThreadID, currentMask);
-      }
+    if (configMarginalize) {
+      assessedEnt = marginalizeAndAssess(currentMask, &marginalTable, rewrittendata);
+    } else {
       assessedEnt = processAndAssess(currentMask, data, rewrittendata, datalen);
-
-      // send the results
-      threadInfo->state = RESULTSTATE;
-      if (configVerbose > 1) {
-        fprintf(stderr, "Thread %u in RESULT State\n", threadInfo->localThreadID);
-      }
-      sendAssessment(threadInfo->resultsWriteFD, assessedEnt, currentMask, ASSESSMENTRSP);
-    } else if (command == JOINCMD) {
-      threadInfo->state = WAITSTATE;
-      if (configVerbose > 1) {
-        fprintf(stderr, "Thread %u in WAIT State\n", threadInfo->localThreadID);
-      }
-      incThreadsWaiting();
-
-      // Join the barrier
-      res = pthread_barrier_wait(&joinBarrier);
-      if ((res != PTHREAD_BARRIER_SERIAL_THREAD) && (res != 0)) {
-        perror("Can't synchronize threads");
-        pthread_exit(NULL);
-      }
-
-      // All done; everyone arrived
-      decThreadsWaiting();
-    } else if (command == EXITCMD) {
-      threadInfo->state = DONESTATE;
-      if (configVerbose > 1) {
-        fprintf(stderr, "Thread %u in DONE State\n", threadInfo->localThreadID);
-      }
-      working = false;
     }
+
+    threadInfo->jobsCompleted++;
+    postAssessment(threadInfo->queue, currentMask, assessedEnt);
   }
 
   if (configVerbose > 1) {
-    fprintf(stderr, "Thread %u exiting.\n", threadInfo->localThreadID);
+    fprintf(stderr, "Thread %u exiting after %zu assessments.\n", threadInfo->localThreadID, threadInfo->jobsCompleted);
   }
 
   // We have been told that no more assignments are available
@@ -321,39 +631,12 @@ static uint32_t nextFixedHammingWeight(unsigned in) {
   }
 }
 
-static void setupThreads(uint32_t threadCount, struct threadInfoType *threadInfo, struct pollfd *pfds) {
-  uint32_t curThread;
-  int localFDs[2];
-
-  // first, the barrier for join steps
-  if (pthread_barrier_init(&joinBarrier, NULL, threadCount + 1) < 0) {
-    perror("Can't init barrier");
-    exit(EX_OSERR);
-  }
-
-  // Now setup pipe pairs to communicate with all the threads
-  for (curThread = 0; curThread < threadCount; curThread++) {
-    // Make the command and results pipe pairs
-    if (pipe(localFDs) != 0) {
-      perror("Can't make pipes");
-      exit(EX_OSERR);
-    }
-    threadInfo[curThread].assignmentReadFD = localFDs[0];
-    threadInfo[curThread].assignmentWriteFD = localFDs[1];
-
-    if (pipe(localFDs) != 0) {
-      perror("Can't make pipes");
-      exit(EX_OSERR);
-    }
-    threadInfo[curThread].resultsReadFD = localFDs[0];
-    pfds[curThread].fd = localFDs[0];
-    pfds[curThread].events = POLLIN;
-    pfds[curThread].revents = 0;
-    threadInfo[curThread].resultsWriteFD = localFDs[1];
-    threadInfo[curThread].state = INITSTATE;
-    threadInfo[curThread].jobsAssigned = 0;
-
+static void setupThreads(uint32_t threadCount, struct threadInfoType *threadInfo, struct taskQueue *queue) {
+  for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
+    threadInfo[curThread].jobsCompleted = 0;
+    threadInfo[curThread].queue = queue;
     threadInfo[curThread].localThreadID = (uint32_t)curThread;
+    saveThreadConfig(&threadInfo[curThread].config);
     // Start up threads here
     if (pthread_create(&(threadInfo[curThread].threadID), NULL, doAssessmentThread, (void *)&(threadInfo[curThread])) != 0) {
       perror("Can't create a thread");
@@ -376,38 +659,92 @@ static uint32_t processorCount(void) {
 }
 
 // Ask all the threads to exit after calculation results are all collected
-static void killThreads(uint32_t threadCount, struct threadInfoType *threadInfo) {
+static void killThreads(uint32_t threadCount, struct threadInfoType *threadInfo, struct taskQueue *queue) {
+  if (configVerbose > 1) {
+    fprintf(stderr, "Requesting that all threads exit.\n");
+  }
+
+  lockQueue(queue);
+  assert(queue->pendingCount == 0);
+  queue->exiting = true;
+  if (pthread_cond_broadcast(&queue->taskReady) != 0) {
+    perror("Can't signal worker threads");
+    exit(EX_OSERR);
+  }
+  unlockQueue(queue);
+
   for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
-    uint32_t inMask;
-    double assessedEnt;
-    enum workerResponse response;
+    if (pthread_join(threadInfo[curThread].threadID, NULL) != 0) {
+      perror("Can't wait for thread to end.");
+      exit(EX_OSERR);
+    }
+  }
+}
+
+// Queue a mask for assessment. If the assessment is already in the memo, it is posted directly to the results.
+static void dispatchMask(struct taskQueue *queue, uint32_t mask) {
+  double assessment;
 
+  if ((memo != NULL) && memoLookup(memo, mask, &assessment)) {
     if (configVerbose > 1) {
-      fprintf(stderr, "Requesting that thread %u exits.\n", (uint32_t)curThread);
+      fprintf(stderr, "Reusing prior assessment for bitmask: 0x%08X\n", mask);
     }
-    response = getAssessment(threadInfo[curThread].resultsReadFD, &inMask, &assessedEnt);
-    assert(response == READYRSP);
+    memo->hits++;
+    postAssessment(queue, mask, assessment);
+  } else {
+    submitMask(queue, mask);
+  }
+}
 
-    sendAssignment(threadInfo[curThread].assignmentWriteFD, 0, EXITCMD);
-    if (pthread_join(threadInfo[curThread].threadID, NULL) < 0) {
-      perror("Can't wait for thread to end.");
-      exit(EX_OSERR);
+// Collect an assessment, and record it in the memo.
+static void gatherAssessment(struct taskQueue *queue, uint32_t *mask, double *assessment) {
+  collectAssessment(queue, mask, assessment);
+
+  if (memo != NULL) {
+    memoStore(memo, *mask, *assessment);
+  }
+}
+
+// Find the next mask of the same hamming weight (in packed form) that could plausibly be better than the current best symbol.
+// Returns 0 if there are no further masks of this weight.
+static uint32_t nextCandidateMask(uint32_t curMask, uint32_t localNominalBits, uint32_t activeBits, double bitAssessments[8][16], double bestEnt) {
+  while (true) {
+    double curEntBound = 0.0;
+
+    curMask = nextFixedHammingWeight(curMask);
+
+    if ((curMask > localNominalBits) || (curMask == 0)) {
+      return 0;
+    }
+
+    // Could this symbol possibly be better than the current best symbol?
+    // Use a per-nibble assessment to (over-)estimate the possible entropy.
+    // If this over-estimate is too small, we can just skip this symbol.
+    // Note, this is in packed form!
+    for (uint32_t i = 0; i < 8; i++) {
+      curEntBound += bitAssessments[i][(curMask >> (i << 2)) & 0xF];
+    }
+
+    if (curEntBound < bestEnt) {
+      fprintf(stderr, "Upper entropy bound (%.17g) less than current best entropy (%.17g). Skipping mask 0x%08X (weight: %u).\n", curEntBound, bestEnt, expandBits(curMask, activeBits), (uint32_t)__builtin_popcount(curMask));
+    } else {
+      return curMask;
     }
   }
 }
 
 // Computation pattern:
-//    Send all the assignments
-//    Wait for the last few to finish; ask all finished compute threads to join the barrier
-//    Once all the threads have joined the barrier, have the base thread (here) join the barrier (releasing all the compute threads for the next computation)
-static bool findBestSymbol(FILE *statfile, uint32_t curHammingWeight, uint32_t activeBits, size_t *usedBits, struct bestMaskData *bestMasks, double bitAssessments[8][16], uint32_t threadCount, struct threadInfoType *threadInfo, struct pollfd *pfds) {
+//    Keep the queue full of candidate masks (the next candidate is only selected once there is room for it, so the pruning uses the best entropy seen thus far)
+//    Collect each assessment as it arrives
+//    Once there are no more candidates and all masks in flight are collected, this hamming weight is complete.
+static bool findBestSymbol(FILE *statfile, uint32_t curHammingWeight, uint32_t activeBits, size_t *usedBits, struct bestMaskData *bestMasks, double bitAssessments[8][16], struct taskQueue *queue) {
   double assessedEnt, bestHammingEnt;
   uint32_t curMask;
   uint32_t expandedCurrentMask;
   uint32_t localNominalBits;
-  int res;
   double bestEnt;
   uint32_t bestEntMask;
+  size_t inFlight;
 
   bestEnt = -1.0;
   bestEntMask = 0;
@@ -427,183 +764,70 @@ static bool findBestSymbol(FILE *statfile, uint32_t curHammingWeight, uint32_t a
   // Get the first curMask for this hamming weight
   bestHammingEnt = 0.0;
   curMask = incToHammingWeight(0, curHammingWeight);
-  expandedCurrentMask = expandBits(curMask, activeBits);
-  assert(__builtin_popcount(curMask) == __builtin_popcount(expandedCurrentMask));
+  if (curMask > localNominalBits) curMask = 0;
+  inFlight = 0;
 
-  fprintf(stderr, "Doing Waiting for message from thread.\n");
+  do {
+    // Fill the queue
+    while ((curMask != 0) && (inFlight < queue->capacity)) {
+      expandedCurrentMask = expandBits(curMask, activeBits);
+      assert(__builtin_popcount(curMask) == __builtin_popcount(expandedCurrentMask));
+      assert((uint32_t)__builtin_popcount(expandedCurrentMask) == curHammingWeight);
 
-  // send all the assignments
-  while ((curMask > 0) && (curMask <= localNominalBits)) {
-    if (configVerbose > 1) {
-      fprintf(stderr, "Waiting for message from thread.\n");
-    }
-    if ((res = poll(pfds, threadCount, -1)) < 0) {
-      perror("Can't poll computing threads");
-      exit(EX_OSERR);
-    }
-    if (configVerbose > 1) {
-      fprintf(stderr, "Got responses from %d thread.\n", res);
+      if (configVerbose > 1) {
+        fprintf(stderr, "Sending current bitmask: 0x%08X (weight: %u)\n", expandedCurrentMask, curHammingWeight);
+      }
+      dispatchMask(queue, expandedCurrentMask);
+      inFlight++;
+
+      // Now look for the next assignment
+      curMask = nextCandidateMask(curMask, localNominalBits, activeBits, bitAssessments, bestEnt);
     }
 
-    // Find the first thread waiting for work
-    for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
-      if ((pfds[curThread].revents & POLLIN) != 0) {
-        enum workerResponse response;
-        uint32_t inMask;
-        response = getAssessment(threadInfo[curThread].resultsReadFD, &inMask, &assessedEnt);
+    if (inFlight > 0) {
+      uint32_t inMask;
+      uint32_t responseHammingWeight;
 
-        if ((response == READYRSP) && (curMask <= localNominalBits) && (curMask > 0)) {
-          // This thread wants an assignment. Provide it with one.
-          bool lookForMask = true;
-          assert((uint32_t)__builtin_popcount(expandedCurrentMask) == curHammingWeight);
+      gatherAssessment(queue, &inMask, &assessedEnt);
+      inFlight--;
 
-          if (configVerbose > 1) {
-            fprintf(stderr, "Sending current bitmask: 0x%08X (weight: %u)\n", expandedCurrentMask, curHammingWeight);
-          }
-          threadInfo[curThread].jobsAssigned++;
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, expandedCurrentMask, ASSIGNMENTCMD);
-
-          // Now look for the next assignment
-          while (lookForMask && (curMask <= localNominalBits) && (curMask > 0)) {
-            double curEntBound = 0.0;
-
-            curMask = nextFixedHammingWeight(curMask);
-
-            if ((curMask > localNominalBits) || (curMask == 0)) {
-              break;
-            }
-
-            expandedCurrentMask = expandBits(curMask, activeBits);
-            assert(__builtin_popcount(curMask) == __builtin_popcount(expandedCurrentMask));
-            lookForMask = false;
-
-            // Could this symbol possibly be better than the current best symbol?
-            // Use a per-nibble assessment to (over-)estimate the possible entropy.
-            // If this over-estimate is too small, we can just skip this symbol.
-            // Note, this is in packed form!
-            for (uint32_t i = 0; i < 8; i++) {
-              curEntBound += bitAssessments[i][(curMask >> (i << 2)) & 0xF];
-            }
-
-            if ((curEntBound < bestEnt) && (curMask <= localNominalBits) && (curMask > 0)) {
-              lookForMask = true;
-              fprintf(stderr, "Upper entropy bound (%.17g) less than current best entropy (%.17g). Skipping mask 0x%08X (weight: %u).\n", curEntBound, bestEnt, expandedCurrentMask, curHammingWeight);
-            }
-          }
-        } else if ((response == READYRSP) && ((curMask > localNominalBits) || (curMask == 0))) {
-          // This thread wants an assignment, but we don't have any more. Ask the thread to wait.
-          if (configVerbose > 1) {
-            fprintf(stderr, "Sending JOIN command.\n");
-          }
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, 0, JOINCMD);
-        } else if (response == ASSESSMENTRSP) {
-          uint32_t responseHammingWeight;
-          // This thread is reporting in with an assessment (presumably for the current hamming weight).
-          if (configVerbose > 1) {
-            fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
-          }
+      // This is an assessment for the current hamming weight.
+      if (configVerbose > 1) {
+        fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
+      }
 
-          assert(threadInfo[curThread].jobsAssigned > 0);
+      responseHammingWeight = (uint32_t)__builtin_popcount(inMask);
+      assert(responseHammingWeight == curHammingWeight);
 
-          responseHammingWeight = (uint32_t)__builtin_popcount(inMask);
-          assert(responseHammingWeight == curHammingWeight);
+      assert(assessedEnt <= (double)curHammingWeight);
+      assert(assessedEnt >= 0.0);
 
-          assert(assessedEnt <= (double)curHammingWeight);
-          assert(assessedEnt >= 0.0);
+      // Is this the best we've seen for this hamming weight?
+      if (assessedEnt > bestHammingEnt) {
+        bestHammingEnt = assessedEnt;
+      }
 
-          // Is this the best we've seen for this hamming weight?
-          if (assessedEnt > bestHammingEnt) {
-            bestHammingEnt = assessedEnt;
+      // Is this the best we've seen over all?
+      if (assessedEnt > bestEnt) {
+        bestEnt = assessedEnt;
+        bestEntMask = inMask;
+        bestMasks[curHammingWeight - 1].mask = inMask;
+        bestMasks[curHammingWeight - 1].entropy = assessedEnt;
+        fprintf(stderr, "New best entropy: %.17g (mask: 0x%08X, weight: %u)\n", bestEnt, bestEntMask, curHammingWeight);
+
+        // Note the bits present in the current best symbol.
+        for (uint32_t i = 0; i < 32; i++) {
+          if (bestEntMask & (1U << (uint32_t)i)) {
+            usedBits[i]++;
           }
-
-          // Is this the best we've seen over all?
-          if (assessedEnt > bestEnt) {
-            bestEnt = assessedEnt;
-            bestEntMask = inMask;
-            bestMasks[curHammingWeight - 1].mask = inMask;
-            bestMasks[curHammingWeight - 1].entropy = assessedEnt;
-            fprintf(stderr, "New best entropy: %.17g (mask: 0x%08X, weight: %u)\n", bestEnt, bestEntMask, curHammingWeight);
-
-            // Note the bits present in the current best symbol.
-            for (uint32_t i = 0; i < 32; i++) {
-              if (bestEntMask & (1U << (uint32_t)i)) {
-                usedBits[i]++;
-              }
-            }
-          } else {
-            // This is not better than the best one we've seen thus far
-            fprintf(stderr, "Encountered sub-optimal entropy: %.17g (mask 0x%08X, weight: %u). Best entropy is still %.17g (mask: 0x%08X, weight: %u)\n", assessedEnt, inMask, curHammingWeight, bestEnt, bestEntMask,
-                    (uint32_t)__builtin_popcount((uint32_t)bestEntMask));
-          }  // end if assessedEnt > bestEnt
-        }  // end if workerResponse == ASSESSMENTRSP
-      }  // endif POLLIN flag is set
-    }  // For loop, iterating through the threads waiting for a response.
-  }  // while we haven't reached the maximum for this hamming weight.
-
-  // Wait for the last few to finish; ask all finished compute threads to join the barrier
-  // Now, we've run out of symbols to assign at this hamming weight, but need to wait for any stragglers
-  // Do the join.
-  while (getThreadsWaiting() < threadCount) {
-    if (poll(pfds, threadCount, 1) < 0) {
-      perror("Can't poll computing threads");
-      exit(EX_OSERR);
+        }
+      } else {
+        // This is not better than the best one we've seen thus far
+        fprintf(stderr, "Encountered sub-optimal entropy: %.17g (mask 0x%08X, weight: %u). Best entropy is still %.17g (mask: 0x%08X, weight: %u)\n", assessedEnt, inMask, curHammingWeight, bestEnt, bestEntMask,
+                (uint32_t)__builtin_popcount((uint32_t)bestEntMask));
+      }  // end if assessedEnt > bestEnt
     }
-
-    for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
-      if ((pfds[curThread].revents & POLLIN) != 0) {
-        enum workerResponse response;
-        uint32_t inMask;
-        response = getAssessment(threadInfo[curThread].resultsReadFD, &inMask, &assessedEnt);
-
-        if (response == READYRSP) {
-          // This thread wants an assignment, but we don't have any more. Ask the thread to wait.
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, 0, JOINCMD);
-        } else if (response == ASSESSMENTRSP) {
-          uint32_t responseHammingWeight;
-          // This thread is reporting in with an assessment for the current hamming weight.
-          if (configVerbose > 1) {
-            fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
-          }
-
-          assert(threadInfo[curThread].jobsAssigned > 0);
-
-          responseHammingWeight = (uint32_t)__builtin_popcount(inMask);
-          assert(responseHammingWeight == curHammingWeight);
-
-          assert(assessedEnt <= (double)curHammingWeight);
-          assert(assessedEnt >= 0.0);
-
-          // Is this the best we've seen for this hamming weight?
-          if (assessedEnt > bestHammingEnt) {
-            bestHammingEnt = assessedEnt;
-          }
-
-          // Is this the best we've seen over all?
-          if (assessedEnt > bestEnt) {
-            bestEnt = assessedEnt;
-            bestEntMask = inMask;
-            bestMasks[curHammingWeight - 1].mask = inMask;
-            bestMasks[curHammingWeight - 1].entropy = assessedEnt;
-            fprintf(stderr, "New best entropy: %.17g (mask: 0x%08X, weight: %u)\n", bestEnt, bestEntMask, curHammingWeight);
-
-            // Note the bits present in the current best symbol.
-            for (uint32_t i = 0; i < 32; i++) {
-              if (bestEntMask & (1U << (uint32_t)i)) {
-                usedBits[i]++;
-              }
-            }
-          } else {
-            // This is not better than the best one we've seen thus far
-            fprintf(stderr, "Encountered sub-optimal entropy: %.17g (mask 0x%08X, weight: %u). Best entropy is still %.17g (mask: 0x%08X, weight: %u).\n", assessedEnt, inMask, curHammingWeight, bestEnt, bestEntMask,
-                    (uint32_t)__builtin_popcount((uint32_t)bestEntMask));
-          }  // end if assessedEnt > bestEnt
-        }  // end if workerResponse == ASSESSMENTRSP
-      }  // endif POLLIN flag is set
-    }  // for loop iterating through the threads
-  }  // end while loop getThreadsWaiting() < threadCount
-
-  // We've now waited for all the stragglers
-  assert(getThreadsWaiting() == threadCount);
+  } while ((curMask != 0) || (inFlight > 0));
 
   // Report out on the progress thus far.
   fprintf(stderr, "Best entropy up to weight %u: %.17g (mask: 0x%08X). Best this weight: %.17g\n", curHammingWeight, bestEnt, bestEntMask, bestHammingEnt);
@@ -616,15 +840,6 @@ static bool findBestSymbol(FILE *statfile, uint32_t curHammingWeight, uint32_t a
     }
   }
 
-  // Once all the threads have joined the barrier, have the base thread (here) join the barrier (releasing all the compute threads for the next computation)
-  // Finish the barrier
-  // This should release all the processing threads
-  res = pthread_barrier_wait(&joinBarrier);
-  if ((res != PTHREAD_BARRIER_SERIAL_THREAD) && (res != 0)) {
-    perror("Can't synchronize threads");
-    exit(EX_OSERR);
-  }
-
   // Did the current hamming weight's highest-entropy symbol entropy decrease substantially?
   if (bestHammingEnt < bestEnt * .99) {
     fprintf(stderr, "Last round's hamming entropy decreased. Stopping.\n");
@@ -634,173 +849,89 @@ static bool findBestSymbol(FILE *statfile, uint32_t curHammingWeight, uint32_t a
   }
 }
 
-static void doNibbleAssessments(double bitAssessments[8][16], uint32_t activeBits, uint32_t threadCount, struct threadInfoType *threadInfo, struct pollfd *pfds) {
-  uint32_t curMask;
-  int res;
+// Record the assessment of a mask that is contained within a single nibble (of the packed mask).
+static void recordNibbleAssessment(double bitAssessments[8][16], uint32_t inMask, double assessedEnt, uint32_t activeBits) {
+  uint32_t inMaskWt;
+  uint32_t compressedInMask;
+
+  fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
+
+  inMaskWt = (uint32_t)__builtin_popcount(inMask);
+  assert((inMaskWt <= 4) && (inMaskWt > 0));
+  compressedInMask = extractbits(inMask, activeBits);
+
+  for (uint32_t nibblePos = 0; nibblePos < 8; nibblePos++) {
+    uint32_t curNibblePattern = 0xFU << (nibblePos << 2U);
+    if ((curNibblePattern & compressedInMask) != 0) {
+      assert((compressedInMask & (~curNibblePattern)) == 0);
+      bitAssessments[nibblePos][compressedInMask >> (nibblePos << 2U)] = assessedEnt;
+      break;
+    }
+  }
+}
+
+static void doNibbleAssessments(double bitAssessments[8][16], uint32_t activeBits, struct taskQueue *queue) {
   uint32_t nominalBits;
-  uint32_t expandedCurrentMask;
-  uint32_t nibbleNum = 0;
-  uint32_t nibbleVal = 1;
+  size_t inFlight = 0;
+  uint32_t inMask;
+  double assessedEnt;
 
   nominalBits = extractbits(activeBits, activeBits);
   assert(__builtin_popcount(nominalBits) > 0);
 
-  // send all the assignments
-  bitAssessments[0][0] = 0;
-  curMask = 1;
-  expandedCurrentMask = expandBits(curMask, activeBits);
-
-  while ((curMask > 0)) {
-    if (configVerbose > 1) {
-      fprintf(stderr, "Waiting for message from thread.\n");
-    }
-    if ((res = poll(pfds, threadCount, -1)) < 0) {
-      perror("Can't poll computing threads");
-      exit(EX_OSERR);
-    }
-    if (configVerbose > 1) {
-      fprintf(stderr, "Got responses from %d thread.\n", res);
+  // Masks that are not possible (and the empty mask) contribute nothing.
+  for (uint32_t nibbleNum = 0; nibbleNum < 8; nibbleNum++) {
+    for (uint32_t nibbleVal = 0; nibbleVal < 16; nibbleVal++) {
+      bitAssessments[nibbleNum][nibbleVal] = 0.0;
     }
+  }
 
-    // Find the first thread waiting for work
-    for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
-      if ((pfds[curThread].revents & POLLIN) != 0) {
-        enum workerResponse response;
-        uint32_t inMask;
-        double assessedEnt;
-
-        response = getAssessment(threadInfo[curThread].resultsReadFD, &inMask, &assessedEnt);
+  // send all the assignments
+  for (uint32_t nibbleNum = 0; nibbleNum < 8; nibbleNum++) {
+    for (uint32_t nibbleVal = 1; nibbleVal < 16; nibbleVal++) {
+      uint32_t curMask = nibbleVal << (nibbleNum << 2);
+      uint32_t expandedCurrentMask;
+
+      if ((curMask & nominalBits) != curMask) continue;
+
+      // This mask will work. Populate the expanded mask
+      expandedCurrentMask = expandBits(curMask, activeBits);
+      assert(__builtin_popcount(curMask) == __builtin_popcount(expandedCurrentMask));
+
+      // If the queue is full, wait for a result
+      if (inFlight == queue->capacity) {
+        gatherAssessment(queue, &inMask, &assessedEnt);
+        inFlight--;
+        recordNibbleAssessment(bitAssessments, inMask, assessedEnt, activeBits);
+      }
 
-        if ((response == READYRSP) && (curMask > 0)) {
-          // This thread wants an assignment. Provide it with one.
-          if (configVerbose > 1) {
-            fprintf(stderr, "Sending current bitmask: 0x%08X\n", expandedCurrentMask);
-          }
-          threadInfo[curThread].jobsAssigned++;
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, expandedCurrentMask, ASSIGNMENTCMD);
-
-          // Now look for the next assignment
-          while (curMask > 0) {
-            nibbleVal++;
-
-            if (nibbleVal >= 16) {
-              nibbleNum++;
-              if (nibbleNum >= 8) {
-                curMask = 0;
-                expandedCurrentMask = 0;
-                break;
-              } else {
-                bitAssessments[nibbleNum][0] = 0.0;
-                nibbleVal = 1;
-              }
-            }
-
-            curMask = nibbleVal << (nibbleNum << 2);
-            if ((curMask & nominalBits) == curMask) {
-              // This mask will work. Populate the expanded mask
-              expandedCurrentMask = expandBits(curMask, activeBits);
-              assert(__builtin_popcount(curMask) == __builtin_popcount(expandedCurrentMask));
-              break;
-            } else {
-              bitAssessments[nibbleNum][nibbleVal] = 0.0;
-            }
-          }
-        } else if ((response == READYRSP) && (curMask == 0)) {
-          // This thread wants an assignment, but we don't have any more. Ask the thread to wait.
-          if (configVerbose > 1) {
-            fprintf(stderr, "Sending JOIN command.\n");
-          }
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, 0, JOINCMD);
-        } else if (response == ASSESSMENTRSP) {
-          uint32_t nibblePos;
-          uint32_t inMaskWt;
-          uint32_t compressedInMask;
-          // This thread is reporting in with an assessment (presumably for some nibble).
-          fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
-
-          inMaskWt = (uint32_t)__builtin_popcount(inMask);
-          assert((inMaskWt <= 4) && (inMaskWt > 0));
-          assert(threadInfo[curThread].jobsAssigned > 0);
-          compressedInMask = extractbits(inMask, activeBits);
-
-          for (nibblePos = 0; nibblePos < 8; nibblePos++) {
-            uint32_t curNibblePattern = 0xFU << (nibblePos << 2U);
-            if ((curNibblePattern & compressedInMask) != 0) {
-              assert((compressedInMask & (~curNibblePattern)) == 0);
-              bitAssessments[nibblePos][compressedInMask >> (nibblePos << 2U)] = assessedEnt;
-              break;
-            }
-          }
-        }  // end if workerResponse == ASSESSMENTRSP
-      }  // endif POLLIN flag is set
-    }  // For loop, iterating through the threads waiting for a response.
-  }  // while we haven't gone through all the nibbles
-
-  // Wait for the last few to finish; ask all finished compute threads to join the barrier
-  // Now, we've run out of symbols to assign at this hamming weight, but need to wait for any stragglers
-  // Do the join.
-  while (getThreadsWaiting() < threadCount) {
-    if (poll(pfds, threadCount, 1) < 0) {
-      perror("Can't poll computing threads");
-      exit(EX_OSERR);
+      if (configVerbose > 1) {
+        fprintf(stderr, "Sending current bitmask: 0x%08X\n", expandedCurrentMask);
+      }
+      dispatchMask(queue, expandedCurrentMask);
+      inFlight++;
     }
+  }
 
-    for (uint32_t curThread = 0; curThread < threadCount; curThread++) {
-      if ((pfds[curThread].revents & POLLIN) != 0) {
-        enum workerResponse response;
-        uint32_t inMask;
-        double assessedEnt;
-        response = getAssessment(threadInfo[curThread].resultsReadFD, &inMask, &assessedEnt);
-
-        if (response == READYRSP) {
-          // This thread wants an assignment, but we don't have any more. Ask the thread to wait.
-          sendAssignment(threadInfo[curThread].assignmentWriteFD, 0, JOINCMD);
-        } else if (response == ASSESSMENTRSP) {
-          uint32_t nibblePos;
-          uint32_t inMaskWt;
-          uint32_t compressedInMask;
-          // This thread is reporting in with an assessment (presumably for some nibble).
-          fprintf(stderr, "Received assessment for bitmask: 0x%08X (%.17g)\n", inMask, assessedEnt);
-
-          inMaskWt = (uint32_t)__builtin_popcount(inMask);
-          assert((inMaskWt <= 4) && (inMaskWt > 0));
-          assert(threadInfo[curThread].jobsAssigned > 0);
-          compressedInMask = extractbits(inMask, activeBits);
-
-          for (nibblePos = 0; nibblePos < 8; nibblePos++) {
-            uint32_t curNibblePattern = 0xFU << (nibblePos << 2U);
-            if ((curNibblePattern & compressedInMask) != 0) {
-              assert((compressedInMask & (~curNibblePattern)) == 0);
-              bitAssessments[nibblePos][compressedInMask >> (nibblePos << 2U)] = assessedEnt;
-              break;
-            }
-          }
-        }  // end if workerResponse == ASSESSMENTRSP
-      }  // endif POLLIN flag is set
-    }  // for loop iterating through the threads
-  }  // end while loop getThreadsWaiting() < threadCount
-
-  // We've now waited for all the stragglers
-  assert(getThreadsWaiting() == threadCount);
-
-  // Once all the threads have joined the barrier, have the base thread (here) join the barrier (releasing all the compute threads for the next computation)
-  // Finish the barrier
-  // This should release all the processing threads
-  res = pthread_barrier_wait(&joinBarrier);
-  if ((res != PTHREAD_BARRIER_SERIAL_THREAD) && (res != 0)) {
-    perror("Can't synchronize threads");
-    exit(EX_OSERR);
+  // Wait for the last few to finish
+  while (inFlight > 0) {
+    gatherAssessment(queue, &inMask, &assessedEnt);
+    inFlight--;
+    recordNibbleAssessment(bitAssessments, inMask, assessedEnt, activeBits);
   }
 }
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, "selectbits [-l logging dir] [-v] [-t <n>] [-c] inputfile outputBits\n");
+  fprintf(stderr, "selectbits [-l logging dir] [-v] [-t <n>] [-q <n>] [-c] [-m] [-r <memofile>] inputfile outputBits\n");
   fprintf(stderr, "inputfile is assumed to be a stream of uint32_ts\n");
   fprintf(stderr, "-t <n> \t uses <n> computing threads. (default: ceiling(number of cores * 1.3))\n");
+  fprintf(stderr, "-q <n> \t allow up to <n> masks to be queued or in progress at once. (default: 2 * number of computing threads)\n");
   fprintf(stderr, "-l <dir> \t uses <dir> to contain the log (default: current working directory)\n");
   fprintf(stderr, "-v \t verbose mode.\n");
   fprintf(stderr, "-c \t Conservative mode (use confidence intervals with the Markov estimation).\n");
+  fprintf(stderr, "-m \t Marginalization mode (tabulate symbol pairs once, and derive each mask's counts from this table). Requires at most %u active bits.\n", MARGINALMAXBITS);
+  fprintf(stderr, "-r <memofile> \t Reuse the assessments stored in <memofile>, and record all new assessments there.\n");
   exit(EX_USAGE);
 }
 
@@ -815,13 +946,15 @@ int main(int argc, char *argv[]) {
   struct bestMaskData bestMasks[32];
   char statusfilename[8192];
   FILE *statfile;
-  struct pollfd *pfds;
   int opt;
   long inparam;
   uint32_t threadCount;
+  size_t queueDepth;
   struct threadInfoType *threadInfo;
+  struct taskQueue queue;
   uint32_t activeBitsHammingWeight;
   char logdir[4096];
+  char memofilename[4096];
   bool notDone;
   double bitAssessments[8][16];  // nibble index (least to most significant nibbles of curMask; LSN is index 0, MSN is nibble 7) followed by the nibble value
 
@@ -839,14 +972,16 @@ int main(int argc, char *argv[]) {
   }
 
   threadCount = 0;
+  queueDepth = 0;
   datalen = 0;
   configVerbose = 0;
   strncpy(logdir, ".", sizeof(logdir));
+  memofilename[0] = '\0';
 
   assert(PRECISION(UINT_MAX) >= 32);
 
   // Process the command line
-  while ((opt = getopt(argc, argv, "l:vt:c")) != -1) {
+  while ((opt = getopt(argc, argv, "l:vt:q:cmr:")) != -1) {
     switch (opt) {
       case 'v':
         configVerbose++;
@@ -854,6 +989,9 @@ int main(int argc, char *argv[]) {
       case 'c':
         configConservative = true;
         break;
+      case 'm':
+        configMarginalize = true;
+        break;
       case 't':
         inparam = strtol(optarg, NULL, 10);
         if ((inparam <= 0) || (inparam > 10000)) {
@@ -861,10 +999,21 @@ int main(int argc, char *argv[]) {
         }
         threadCount = (uint32_t)inparam;
         break;
+      case 'q':
+        inparam = strtol(optarg, NULL, 10);
+        if ((inparam <= 0) || (inparam > 1000000)) {
+          useageExit();
+        }
+        queueDepth = (size_t)inparam;
+        break;
       case 'l':
         strncpy(logdir, optarg, sizeof(logdir));
         logdir[sizeof(logdir) - 1] = 0;
         break;
+      case 'r':
+        strncpy(memofilename, optarg, sizeof(memofilename));
+        memofilename[sizeof(memofilename) - 1] = 0;
+        break;
       default: /* '?' */
         useageExit();
     }
@@ -928,6 +1077,28 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "Shifted mask: 0x%08X\n", nominalBits);
 
+  // The memo is keyed on the input data, so this must be done before the data may be freed.
+  if (memofilename[0] != '\0') {
+    memo = openMemo(memofilename, data, datalen, configConservative);
+  }
+
+  if (configMarginalize && (activeBitsHammingWeight > MARGINALMAXBITS)) {
+    fprintf(stderr, "There are %u active bits, but marginalization mode supports at most %u. Disabling marginalization mode.\n", activeBitsHammingWeight, MARGINALMAXBITS);
+    configMarginalize = false;
+  }
+
+  if (configMarginalize && (datalen <= 2)) {
+    fprintf(stderr, "Too little data for marginalization mode. Disabling marginalization mode.\n");
+    configMarginalize = false;
+  }
+
+  if (configMarginalize) {
+    // After this point, all the assessments are made using the pair table, so the data is no longer needed.
+    buildPairTable(data, datalen, activeBits, &marginalTable);
+    free(data);
+    data = NULL;
+  }
+
   // Try to figure out how many threads to use
   if (threadCount == 0) {
     threadCount = (uint32_t)floor(1.3 * (double)processorCount());
@@ -935,26 +1106,26 @@ int main(int argc, char *argv[]) {
 
   assert(threadCount >= 1);
 
-  fprintf(stderr, "Using %u threads\n", threadCount);
+  if (queueDepth == 0) {
+    queueDepth = 2 * (size_t)threadCount;
+  }
+
+  fprintf(stderr, "Using %u threads with up to %zu masks in flight\n", threadCount, queueDepth);
 
   // Setup the threads
   if ((threadInfo = malloc(sizeof(struct threadInfoType) * threadCount)) == NULL) {
-    perror("Can't get memory for thread structures (1)");
-    exit(EX_OSERR);
-  }
-
-  if ((pfds = malloc(sizeof(struct pollfd) * threadCount)) == NULL) {
-    perror("Can't get memory for thread structures (2)");
+    perror("Can't get memory for thread structures");
     exit(EX_OSERR);
   }
 
-  setupThreads(threadCount, threadInfo, pfds);
+  initTaskQueue(&queue, queueDepth);
+  setupThreads(threadCount, threadInfo, &queue);
 
   // Populate the per-nibble patterns used for bounding the min entropy.
   fprintf(stderr, "Pre-calculating nibble entropy for estimation\n");
 
   // Calculate our guess for the entropy associated with each nibble
-  doNibbleAssessments(bitAssessments, activeBits, threadCount, threadInfo, pfds);
+  doNibbleAssessments(bitAssessments, activeBits, &queue);
 
   // Now process the various bitmasks, explored by hamming weight
   fprintf(stderr, "Starting main assessments.\n");
@@ -962,11 +1133,12 @@ int main(int argc, char *argv[]) {
   notDone = true;
 
   for (curHammingWeight = 1; notDone && (curHammingWeight <= outputBits); curHammingWeight++) {
-    notDone = findBestSymbol(statfile, curHammingWeight, activeBits, usedBits, bestMasks, bitAssessments, threadCount, threadInfo, pfds);
+    notDone = findBestSymbol(statfile, curHammingWeight, activeBits, usedBits, bestMasks, bitAssessments, &queue);
   }
 
   // Kill the threads, and don't move on until they are all gone.
-  killThreads(threadCount, threadInfo);
+  killThreads(threadCount, threadInfo, &queue);
+  freeTaskQueue(&queue);
 
   // All the worker threads are done, the poor dears.
   fprintf(statfile, "Final Best Masks: \n");
@@ -986,9 +1158,10 @@ int main(int argc, char *argv[]) {
   fflush(statfile);
 
   fclose(statfile);
+  if (memo != NULL) closeMemo(memo);
   free(data);
+  if (configMarginalize) freePairTable(&marginalTable);
   free(threadInfo);
-  free(pfds);
 
   return EX_OK;
 }
@@ -0,0 +1,72 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "globals.h"
+#include "telemetry.h"
+
+static double timespecSeconds(const struct timespec *in) {
+  return (double)in->tv_sec + (double)in->tv_nsec * 1.0e-9;
+}
+
+/*Starting a span resets the thread's scratch high-water mark, so spans on a thread can't be nested.*/
+void telemetryStart(struct telemetrySpan *span) {
+  assert(span != NULL);
+
+  span->scratchBase = globalScratchBytes;
+  globalScratchPeak = globalScratchBytes;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &span->cpuStart);
+  clock_gettime(CLOCK_MONOTONIC, &span->wallStart);
+}
+
+void telemetryStop(struct telemetrySpan *span) {
+  struct timespec wallEnd;
+  struct timespec cpuEnd;
+
+  assert(span != NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+
+  span->wallTime = timespecSeconds(&wallEnd) - timespecSeconds(&span->wallStart);
+  span->cpuTime = timespecSeconds(&cpuEnd) - timespecSeconds(&span->cpuStart);
+  assert(globalScratchPeak >= span->scratchBase);
+  span->scratchPeak = globalScratchPeak - span->scratchBase;
+}
+
+/*Write one JSON object (on a single line) describing the span to configTelemetry, if it is set.
+ *The estimator may be NULL (for events that cover several estimators). A negative entropy is reported as null.
+ */
+void telemetryRecord(const char *event, const char *label, size_t block, const char *estimator, size_t samples, size_t k, const struct telemetrySpan *span, double entropy) {
+  struct timespec now;
+  char entropyText[32];
+
+  assert((event != NULL) && (label != NULL) && (span != NULL));
+
+  if (configTelemetry == NULL) return;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  if ((entropy >= 0.0) && isfinite(entropy)) {
+    snprintf(entropyText, sizeof(entropyText), "%.17g", entropy);
+  } else {
+    snprintf(entropyText, sizeof(entropyText), "null");
+  }
+
+  // A single call, so that records from different threads aren't interleaved.
+  fprintf(configTelemetry, "{\"time\":%.6f,\"event\":\"%s\",\"label\":\"%s\",\"block\":%zu,\"estimator\":%s%s%s,\"thread\":%ld,\"samples\":%zu,\"k\":%zu,\"wall_s\":%.9f,\"cpu_s\":%.9f,\"scratch_bytes\":%zu,\"samples_per_s\":%.6g,\"entropy\":%s}\n", timespecSeconds(&now), event, label, block, (estimator == NULL) ? "" : "\"",
+          (estimator == NULL) ? "null" : estimator, (estimator == NULL) ? "" : "\"", (long)syscall(SYS_gettid), samples, k, span->wallTime, span->cpuTime, span->scratchPeak, (span->wallTime > 0.0) ? (double)samples / span->wallTime : 0.0, entropyText);
+}
@@ -0,0 +1,45 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "globals.h"
+
+/*The estimators run entirely on the calling thread, so their large working storage (suffix and LCP arrays, dictionary
+ *pools, count tables and so on) is accounted per thread as it is allocated and freed.
+ */
+static inline void scratchAllocated(size_t bytes) {
+  globalScratchBytes += bytes;
+  if (globalScratchBytes > globalScratchPeak) globalScratchPeak = globalScratchBytes;
+}
+
+static inline void scratchFreed(size_t bytes) {
+  assert(globalScratchBytes >= bytes);
+  globalScratchBytes -= bytes;
+}
+
+// A timed region on the calling thread.
+struct telemetrySpan {
+  struct timespec wallStart;
+  struct timespec cpuStart;
+  size_t scratchBase;
+  double wallTime;  // seconds
+  double cpuTime;  // this thread's CPU seconds
+  size_t scratchPeak;  // peak scratch bytes allocated within the span
+};
+
+void telemetryStart(struct telemetrySpan *span);
+void telemetryStop(struct telemetrySpan *span);
+void telemetryRecord(const char *event, const char *label, size_t block, const char *estimator, size_t samples, size_t k, const struct telemetrySpan *span, double entropy);
+#endif
@@ -0,0 +1,374 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+
+#include "textio.h"
+
+// The largest integer such that it and all smaller integers are exactly representable as a double
+#define TEXTIO_MAXEXACTINT (((uint64_t)1) << 53)
+// Any 19 decimal digit value fits in a uint64_t
+#define TEXTIO_MAXDECDIGITS 19
+#define TEXTIO_MAXHEXDIGITS 16
+
+// The powers of 10 that are exactly representable as doubles
+static const double exactPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+#define TEXTIO_MAXEXACTPOWER ((int)(sizeof(exactPowersOfTen) / sizeof(double)) - 1)
+
+// Room for any formatted value, and its newline
+#define TEXTIO_MAXFORMATTED 24
+
+// The decimal representations of 00 through 99
+static const char digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char hexDigits[17] = "0123456789ABCDEF";
+
+void initTextReader(struct textReader *reader, FILE *input) {
+  assert(reader != NULL);
+  assert(input != NULL);
+
+  reader->input = input;
+  reader->capacity = TEXTIO_BLOCKBYTES;
+  reader->start = 0;
+  reader->end = 0;
+  reader->lineNumber = 0;
+  reader->eof = false;
+
+  if ((reader->buffer = malloc(reader->capacity + 1)) == NULL) {
+    perror("Can't allocate text input buffer");
+    exit(EX_OSERR);
+  }
+}
+
+void freeTextReader(struct textReader *reader) {
+  assert(reader != NULL);
+
+  free(reader->buffer);
+  reader->buffer = NULL;
+  reader->capacity = 0;
+}
+
+/*Move any partial line to the front of the buffer, and fill the rest of the buffer from the input.*/
+static void refillTextReader(struct textReader *reader) {
+  size_t res;
+  char *newBuffer;
+
+  if (reader->start > 0) {
+    memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+
+  // A single line fills the buffer; make room for more.
+  if (reader->end == reader->capacity) {
+    if ((newBuffer = realloc(reader->buffer, 2 * reader->capacity + 1)) == NULL) {
+      perror("Can't extend text input buffer");
+      exit(EX_OSERR);
+    }
+    reader->buffer = newBuffer;
+    reader->capacity *= 2;
+  }
+
+  res = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end, reader->input);
+  reader->end += res;
+
+  if (res == 0) {
+    if (ferror(reader->input) != 0) {
+      perror("Error reading input file");
+      exit(EX_OSERR);
+    }
+    reader->eof = true;
+  }
+}
+
+/*Returns the next line (without its newline, and null terminated), or NULL at the end of the input.
+ *The returned line remains valid until the next call. The line may be modified in place by the caller.
+ *The newline scan uses memchr, which the C library vectorizes.
+ */
+char *readTextLine(struct textReader *reader, size_t *length) {
+  char *line;
+  char *newline;
+  size_t searched = 0;
+
+  assert(reader != NULL);
+
+  for (;;) {
+    line = reader->buffer + reader->start;
+    if ((newline = memchr(line + searched, '\n', reader->end - reader->start - searched)) != NULL) {
+      *newline = '\0';
+      reader->start += (size_t)(newline - line) + 1;
+      break;
+    }
+
+    if (reader->eof) {
+      // The final line may lack a newline.
+      if (reader->start == reader->end) return NULL;
+      newline = reader->buffer + reader->end;
+      *newline = '\0';
+      reader->start = reader->end;
+      break;
+    }
+
+    searched = reader->end - reader->start;
+    refillTextReader(reader);
+  }
+
+  reader->lineNumber++;
+  if (length != NULL) *length = (size_t)(newline - line);
+  return line;
+}
+
+/*A drop-in replacement for strtod.
+ *Plain decimal values with at most 19 significant digits and a small decimal exponent are handled directly: the significand
+ *is exactly representable as a double, as is the power of 10, so a single (correctly rounded) IEEE multiply or divide yields the
+ *correctly rounded result. See Clinger, "How to Read Floating Point Numbers Accurately" (1990).
+ *Everything else (leading white space, hexadecimal, infinities, NaNs, long significands, large exponents) is left to strtod.
+ */
+double textToDouble(const char *str, char **endptr) {
+  const char *cur = str;
+  bool negative = false;
+  uint64_t significand = 0;
+  int digits = 0;
+  int fractionDigits = 0;
+  int exponent = 0;
+  bool anyDigits = false;
+  double result;
+
+  assert(str != NULL);
+
+  if ((*cur == '-') || (*cur == '+')) {
+    negative = (*cur == '-');
+    cur++;
+  }
+
+  // strtod treats "0x" as the start of a hexadecimal value.
+  if ((cur[0] == '0') && ((cur[1] == 'x') || (cur[1] == 'X'))) return strtod(str, endptr);
+
+  for (; (*cur >= '0') && (*cur <= '9'); cur++) {
+    anyDigits = true;
+    // Leading zeros aren't significant.
+    if ((significand != 0) || (*cur != '0')) {
+      if (++digits > TEXTIO_MAXDECDIGITS) return strtod(str, endptr);
+      significand = significand * 10 + (uint64_t)(*cur - '0');
+    }
+  }
+
+  if (*cur == '.') {
+    cur++;
+    for (; (*cur >= '0') && (*cur <= '9'); cur++) {
+      anyDigits = true;
+      fractionDigits++;
+      if ((significand != 0) || (*cur != '0')) {
+        if (++digits > TEXTIO_MAXDECDIGITS) return strtod(str, endptr);
+        significand = significand * 10 + (uint64_t)(*cur - '0');
+      }
+    }
+  }
+
+  if (!anyDigits) return strtod(str, endptr);
+
+  // An exponent is only consumed if it has at least one digit.
+  if ((*cur == 'e') || (*cur == 'E')) {
+    const char *expCur = cur + 1;
+    bool negativeExponent = false;
+
+    if ((*expCur == '-') || (*expCur == '+')) {
+      negativeExponent = (*expCur == '-');
+      expCur++;
+    }
+
+    if ((*expCur >= '0') && (*expCur <= '9')) {
+      for (; (*expCur >= '0') && (*expCur <= '9'); expCur++) {
+        // Anything this large goes to strtod anyway.
+        if (exponent < 10000) exponent = exponent * 10 + (*expCur - '0');
+      }
+      if (negativeExponent) exponent = -exponent;
+      cur = expCur;
+    }
+  }
+
+  exponent -= fractionDigits;
+
+  if (significand == 0) {
+    result = 0.0;
+  } else if ((significand <= TEXTIO_MAXEXACTINT) && (exponent >= -TEXTIO_MAXEXACTPOWER) && (exponent <= TEXTIO_MAXEXACTPOWER)) {
+    if (exponent >= 0) {
+      result = (double)significand * exactPowersOfTen[exponent];
+    } else {
+      result = (double)significand / exactPowersOfTen[-exponent];
+    }
+  } else {
+    return strtod(str, endptr);
+  }
+
+  if (endptr != NULL) *endptr = (char *)(uintptr_t)cur;
+  return negative ? -result : result;
+}
+
+static inline int hexDigitValue(char c) {
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+/*A drop-in replacement for strtoull.
+ *Unsigned decimal and hexadecimal values that can't overflow are handled directly; everything else is left to strtoull.
+ */
+uint64_t textToUint64(const char *str, char **endptr, int base) {
+  const char *cur = str;
+  uint64_t result = 0;
+  int digits = 0;
+  int digit;
+
+  assert(str != NULL);
+
+  if (base == 0) {
+    // Base 0 infers octal from a leading 0 and hexadecimal from a leading 0x; only the plain decimal case is handled here.
+    if ((*cur >= '1') && (*cur <= '9')) {
+      base = 10;
+    } else {
+      return strtoull(str, endptr, 0);
+    }
+  }
+
+  if (base == 10) {
+    for (; (*cur >= '0') && (*cur <= '9'); cur++) {
+      if (++digits > TEXTIO_MAXDECDIGITS) return strtoull(str, endptr, base);
+      result = result * 10 + (uint64_t)(*cur - '0');
+    }
+  } else if (base == 16) {
+    if ((cur[0] == '0') && ((cur[1] == 'x') || (cur[1] == 'X')) && (hexDigitValue(cur[2]) >= 0)) cur += 2;
+    for (; (digit = hexDigitValue(*cur)) >= 0; cur++) {
+      if (((result != 0) || (digit != 0)) && (++digits > TEXTIO_MAXHEXDIGITS)) return strtoull(str, endptr, base);
+      result = (result << 4) | (uint64_t)digit;
+    }
+  } else {
+    return strtoull(str, endptr, base);
+  }
+
+  // No digits (or a leading sign or white space).
+  if (cur == str) return strtoull(str, endptr, base);
+
+  if (endptr != NULL) *endptr = (char *)(uintptr_t)cur;
+  return result;
+}
+
+/*Write the decimal representation of value to out (without a terminator), and return its length.
+ *This matches printf's "%u" conversion. Digits are produced two at a time from a table, which halves the number of divisions.
+ */
+size_t formatDecimal(char *out, uint64_t value) {
+  size_t length;
+  size_t pos;
+  uint64_t temp;
+  size_t pair;
+
+  assert(out != NULL);
+
+  length = 1;
+  for (temp = value; temp >= 10; temp /= 10) length++;
+
+  pos = length;
+  while (value >= 100) {
+    pair = (size_t)(value % 100) * 2;
+    value /= 100;
+    out[--pos] = digitPairs[pair + 1];
+    out[--pos] = digitPairs[pair];
+  }
+
+  if (value >= 10) {
+    pair = (size_t)value * 2;
+    out[--pos] = digitPairs[pair + 1];
+    out[--pos] = digitPairs[pair];
+  } else {
+    out[--pos] = (char)('0' + value);
+  }
+
+  assert(pos == 0);
+  return length;
+}
+
+/*Write the hexadecimal representation of value to out (without a terminator), and return its length.
+ *This matches printf's "%X" conversion.
+ */
+size_t formatHex(char *out, uint64_t value) {
+  size_t length;
+
+  assert(out != NULL);
+
+  length = (value == 0) ? 1 : (size_t)((67 - __builtin_clzll(value)) / 4);
+  for (size_t pos = length; pos > 0; pos--) {
+    out[pos - 1] = hexDigits[value & 0xFU];
+    value >>= 4;
+  }
+
+  return length;
+}
+
+void initTextWriter(struct textWriter *writer, FILE *output) {
+  assert(writer != NULL);
+  assert(output != NULL);
+
+  writer->output = output;
+  writer->used = 0;
+
+  if ((writer->buffer = malloc(TEXTIO_BLOCKBYTES)) == NULL) {
+    perror("Can't allocate text output buffer");
+    exit(EX_OSERR);
+  }
+}
+
+void flushTextWriter(struct textWriter *writer) {
+  assert(writer != NULL);
+
+  if (writer->used > 0) {
+    if (fwrite(writer->buffer, 1, writer->used, writer->output) != writer->used) {
+      perror("Can't write to output");
+      exit(EX_OSERR);
+    }
+    writer->used = 0;
+  }
+}
+
+void freeTextWriter(struct textWriter *writer) {
+  assert(writer != NULL);
+
+  flushTextWriter(writer);
+  free(writer->buffer);
+  writer->buffer = NULL;
+}
+
+void writeDecimalLine(struct textWriter *writer, uint64_t value) {
+  if (writer->used + TEXTIO_MAXFORMATTED > TEXTIO_BLOCKBYTES) flushTextWriter(writer);
+  writer->used += formatDecimal(writer->buffer + writer->used, value);
+  writer->buffer[writer->used++] = '\n';
+}
+
+void writeHexLine(struct textWriter *writer, uint64_t value) {
+  if (writer->used + TEXTIO_MAXFORMATTED > TEXTIO_BLOCKBYTES) flushTextWriter(writer);
+  writer->used += formatHex(writer->buffer + writer->used, value);
+  writer->buffer[writer->used++] = '\n';
+}
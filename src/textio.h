@@ -0,0 +1,53 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#ifndef TEXTIO_H
+#define TEXTIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Bytes requested from the input per read
+#define TEXTIO_BLOCKBYTES (((size_t)1) << 20)
+
+// Reads a text stream a large block at a time, and hands out one line at a time.
+struct textReader {
+  FILE *input;
+  char *buffer;
+  size_t capacity;  // usable bytes in the buffer (one more is allocated for a terminator)
+  size_t start;  // the beginning of the next unread line
+  size_t end;  // the end of the data in the buffer
+  size_t lineNumber;  // the number of the line most recently returned (starting at 1)
+  bool eof;
+};
+
+// Collects formatted text and writes it a large block at a time.
+struct textWriter {
+  FILE *output;
+  char *buffer;
+  size_t used;  // bytes presently buffered
+};
+
+void initTextReader(struct textReader *reader, FILE *input);
+char *readTextLine(struct textReader *reader, size_t *length);
+void freeTextReader(struct textReader *reader);
+
+double textToDouble(const char *str, char **endptr);
+uint64_t textToUint64(const char *str, char **endptr, int base);
+
+size_t formatDecimal(char *out, uint64_t value);
+size_t formatHex(char *out, uint64_t value);
+void initTextWriter(struct textWriter *writer, FILE *output);
+void writeDecimalLine(struct textWriter *writer, uint64_t value);
+void writeHexLine(struct textWriter *writer, uint64_t value);
+void flushTextWriter(struct textWriter *writer);
+void freeTextWriter(struct textWriter *writer);
+#endif
@@ -19,6 +19,7 @@
 #include <sysexits.h>
 #include "globals.h"
 
+#if STATDATA_BITS > 8
 static int statDataCompare(const void *in1, const void *in2) {
   const statData_t *left;
   const statData_t *right;
@@ -35,118 +36,89 @@ static int statDataCompare(const void *in1, const void *in2) {
   }
 }
 
-static size_t sortRelabel(statData_t *data, size_t datalen, size_t *k, double *translatedMedian) {
-  statData_t *sorteddata = NULL;
-  statData_t *rewritetable = NULL;
-  size_t i;
-  bool needToRewrite = false;
-  statData_t *cursymbol;
-  statData_t medianLow, medianHigh;
-
-  assert(data != NULL);
-  assert(k != NULL);
-  assert(translatedMedian != NULL);
-  assert(*k >= 2);
-  assert(datalen > 2);
-
-  /* 2 L + 1.39*L*log2(L) + L*log2(l) */
-  if (configVerbose > 0) {
-    fprintf(stderr, "Checking if we need to translate data: ");
+#endif
+
+// Accumulate the translated median, one translated symbol at a time (in order).
+// j is the translated symbol, and symbolCount is the number of times it occurs.
+static void updateTranslatedMedian(size_t j, size_t symbolCount, size_t L, size_t *count, double *translatedMedian) {
+  size_t targetCount = L / 2;
+  size_t medianSlop = L % 2;
+  size_t newcount = *count + symbolCount;
+
+  if (*count < targetCount) {
+    if (targetCount == newcount) {
+      if (configVerbose > 2) fprintf(stderr, "Prior count under target, newcount equal to target. ");
+      if (medianSlop == 1) {
+        // Odd case
+        *translatedMedian = (double)j + 1.0;
+        if (configVerbose > 2) fprintf(stderr, "Select next symbol. ");
+      } else {
+        // even case
+        *translatedMedian = (double)j + 0.5;
+        if (configVerbose > 2) fprintf(stderr, "Select space halfway to next symbol. ");
+      }
+    } else if (targetCount < newcount) {
+      // For both the even and odd case, there is no averaging necessary in this case
+      *translatedMedian = (double)j;
+      if (configVerbose > 2) fprintf(stderr, "Prior count under target, newcount is above target. Median %.17g.\n", *translatedMedian);
+    }
   }
 
-  if ((sorteddata = malloc(datalen * sizeof(statData_t))) == NULL) {
-    perror("Can't allocate array for sorted data");
-    exit(EX_OSERR);
-  }
+  *count = newcount;
+}
 
-  /* L ops */
-  memcpy(sorteddata, data, datalen * sizeof(statData_t));
+// Translate using a histogram indexed by the symbol value.
+// symbolCount is the histogram of S (of length *k), so this requires just one additional pass through the data (and only if translation is necessary).
+static bool histogramRelabel(statData_t *S, size_t L, const size_t *symbolCount, size_t *k, double *translatedMedian) {
+  statData_t *rewritetable;
+  size_t i, j;
+  bool translateNeeded;
+  size_t count;
 
-  /* 1.39*L*log2(L) ops on average */
-  qsort(sorteddata, datalen, sizeof(statData_t), statDataCompare);
+  assert(S != NULL);
+  assert(symbolCount != NULL);
+  assert(k != NULL);
+  assert(translatedMedian != NULL);
+  assert(*k >= 2);
+  assert(*k - 1 <= STATDATA_MAX);
+  assert(L > 2);
 
-  if ((rewritetable = malloc(datalen * sizeof(statData_t))) == NULL) {
-    perror("Can't allocate array for rewrite table");
-    assert(sorteddata != NULL);
-    free(sorteddata);
-    sorteddata = NULL;
-    exit(EX_OSERR);
+  if ((rewritetable = malloc(sizeof(statData_t) * (*k))) == NULL) {
+    perror("Memory allocation error");
+    fatalError(EX_OSERR);
   }
 
-  /* L ops */
-  rewritetable[0] = sorteddata[0];
-  *k = 0;
-  needToRewrite = false;
-  if (rewritetable[*k] != *k) {
-    needToRewrite = true;
-  }
+  if (configVerbose > 2) fprintf(stderr, "targetCount: %zu, medianSlop: %zu\n", L / 2, L % 2);
 
-  for (i = 1; i < datalen; i++) {
-    if (sorteddata[i] != rewritetable[*k]) {
-      (*k)++;
-      rewritetable[*k] = sorteddata[i];
-      if (!needToRewrite && (rewritetable[*k] != (statData_t)(*k))) {
-        needToRewrite = true;
-      }
+  /* k ops */
+  j = 0;
+  count = 0;
+  for (i = 0; i < (*k); i++) {
+    if (symbolCount[i] != 0) {
+      // record the symbol map
+      rewritetable[i] = (statData_t)j;
+      updateTranslatedMedian(j, symbolCount[i], L, &count, translatedMedian);
+      j++;
     }
   }
-  (*k)++;
-
-  medianLow = sorteddata[datalen / 2 - ((datalen % 2 == 0) ? 1 : 0)];
-  medianHigh = sorteddata[datalen / 2];
+  assert(count == L);
 
-  assert(sorteddata != NULL);
-  free(sorteddata);
-  sorteddata = NULL;
-
-  /* L * log2(l) */
-  if (needToRewrite) {
-    /* L ops */
-    if (configVerbose > 0) {
-      fprintf(stderr, "Translating data\n");
-    }
-    for (i = 0; i < datalen; i++) {
-      /* each on takes log2( l ) */
-      if ((cursymbol = bsearch(data + i, rewritetable, *k, sizeof(statData_t), statDataCompare)) == NULL) {
-        perror("Can't find the correct value for translation.");
-        assert(rewritetable != NULL);
-        free(rewritetable);
-        rewritetable = NULL;
-        exit(EX_DATAERR);
-      }
+  if (*k != j) {
+    *k = j;
 
-      assert(cursymbol >= rewritetable);
-      data[i] = (statData_t)(cursymbol - rewritetable);
-    }
+    translateNeeded = true;
     if (configVerbose > 0) {
-      fprintf(stderr, "Found %zu symbols total.\n", *k);
-    }
-
-    // Translate the median values
-    if ((cursymbol = bsearch(&medianLow, rewritetable, *k, sizeof(statData_t), statDataCompare)) == NULL) {
-      perror("Can't find the correct value for translation.");
-      assert(rewritetable != NULL);
-      free(rewritetable);
-      rewritetable = NULL;
-      exit(EX_DATAERR);
+      fprintf(stderr, "Translation is necessary... Found %zu symbols total.\n", j);
     }
-
-    assert(cursymbol >= rewritetable);
-    medianLow = (statData_t)(cursymbol - rewritetable);
-
-    if ((cursymbol = bsearch(&medianHigh, rewritetable, *k, sizeof(statData_t), statDataCompare)) == NULL) {
-      perror("Can't find the correct value for translation.");
-      assert(rewritetable != NULL);
-      free(rewritetable);
-      rewritetable = NULL;
-      exit(EX_DATAERR);
+    /* L ops */
+    for (i = 0; i < L; i++) {
+      assert(symbolCount[S[i]] != 0);
+      S[i] = rewritetable[S[i]];
     }
-
-    assert(cursymbol >= rewritetable);
-    medianHigh = (statData_t)(cursymbol - rewritetable);
   } else {
+    translateNeeded = false;
     if (configVerbose > 0) {
-      fprintf(stderr, "No\n");
+      fprintf(stderr, "No translation is necessary.\n");
     }
   }
 
@@ -154,128 +126,198 @@ static size_t sortRelabel(statData_t *data, size_t datalen, size_t *k, double *t
   free(rewritetable);
   rewritetable = NULL;
 
-  // Note, neither overflow nor underflow are an issue here.
-  *translatedMedian = ((double)medianHigh + (double)medianLow) / 2.0;
-  return (needToRewrite);
+  return translateNeeded;
 }
 
+#if STATDATA_BITS > 8
+// Translate using a table indexed by the symbol value; this is appropriate when the largest symbol isn't too large.
+/* 2 L + 2 k ops total */
 static bool tableRelabel(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
-  int64_t *rewritetable;
   size_t *symbolCount;
-  size_t i, j;
   bool translateNeeded;
-  size_t count;
-  size_t targetCount, medianSlop;
-  size_t newcount;
 
   assert(S != NULL);
   assert(k != NULL);
-  assert(translatedMedian != NULL);
   assert(*k >= 2);
   assert(*k - 1 <= STATDATA_MAX);
-  assert(L > 2);
 
-  /* 2 L + 3 k ops total */
-  if ((rewritetable = malloc(sizeof(int64_t) * (*k))) == NULL) {
+  if ((symbolCount = calloc(*k, sizeof(size_t))) == NULL) {
     perror("Memory allocation error");
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
+  }
+
+  /* L ops */
+  for (size_t j = 0; j < L; j++) {
+    assert(S[j] < (*k));
+    symbolCount[S[j]]++;
   }
 
-  if ((symbolCount = malloc(sizeof(size_t) * (*k))) == NULL) {
+  translateNeeded = histogramRelabel(S, L, symbolCount, k, translatedMedian);
+
+  assert(symbolCount != NULL);
+  free(symbolCount);
+  symbolCount = NULL;
+
+  return translateNeeded;
+}
+
+struct symbolHashTable {
+  size_t capacity;  // A power of 2
+  size_t used;
+  statData_t *symbols;
+  size_t *values;  // The symbol count, and later the translated symbol
+  bool *occupied;
+};
+
+static size_t symbolHashSlot(const struct symbolHashTable *table, statData_t symbol) {
+  size_t slot = (size_t)(((uint64_t)symbol * 0x9E3779B97F4A7C15ULL) >> 32) & (table->capacity - 1);
+
+  while (table->occupied[slot] && (table->symbols[slot] != symbol)) {
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+
+  return slot;
+}
+
+static void initSymbolHashTable(struct symbolHashTable *table, size_t capacity) {
+  table->capacity = capacity;
+  table->used = 0;
+  if ((table->symbols = malloc(sizeof(statData_t) * capacity)) == NULL) {
+    perror("Memory allocation error");
+    fatalError(EX_OSERR);
+  }
+  trackAllocation(table->symbols, free);
+
+  if ((table->values = malloc(sizeof(size_t) * capacity)) == NULL) {
     perror("Memory allocation error");
-    assert(rewritetable != NULL);
-    free(rewritetable);
-    rewritetable = NULL;
-    exit(EX_OSERR);
+    fatalError(EX_OSERR);
   }
+  trackAllocation(table->values, free);
 
-  /* 2 k ops */
-  for (j = 0; j < (*k); j++) {
-    symbolCount[j] = 0;
+  if ((table->occupied = calloc(capacity, sizeof(bool))) == NULL) {
+    perror("Memory allocation error");
+    fatalError(EX_OSERR);
   }
+  trackAllocation(table->occupied, free);
+}
+
+static void freeSymbolHashTable(struct symbolHashTable *table) {
+  untrackAllocation(table->symbols);
+  untrackAllocation(table->values);
+  untrackAllocation(table->occupied);
+  free(table->symbols);
+  free(table->values);
+  free(table->occupied);
+  table->symbols = NULL;
+  table->values = NULL;
+  table->occupied = NULL;
+}
+
+static void countSymbol(struct symbolHashTable *table, statData_t symbol) {
+  size_t slot = symbolHashSlot(table, symbol);
+
+  if (!table->occupied[slot]) {
+    // Keep the load factor at or below 1/2
+    if (2 * (table->used + 1) > table->capacity) {
+      struct symbolHashTable larger;
+
+      initSymbolHashTable(&larger, 2 * table->capacity);
+      for (size_t i = 0; i < table->capacity; i++) {
+        if (table->occupied[i]) {
+          size_t newSlot = symbolHashSlot(&larger, table->symbols[i]);
+          larger.occupied[newSlot] = true;
+          larger.symbols[newSlot] = table->symbols[i];
+          larger.values[newSlot] = table->values[i];
+        }
+      }
+      larger.used = table->used;
+      freeSymbolHashTable(table);
+      *table = larger;
+      slot = symbolHashSlot(table, symbol);
+    }
 
-  for (j = 0; j < (*k); j++) {
-    rewritetable[j] = -1;
+    table->occupied[slot] = true;
+    table->symbols[slot] = symbol;
+    table->values[slot] = 0;
+    table->used++;
   }
 
+  table->values[slot]++;
+}
+
+// Translate using a hash table of the distinct symbols; this is appropriate when the largest symbol is large relative to the data length.
+// This requires two passes through the data (one to count, and one to translate, if necessary), and extra memory proportional to the number of distinct symbols.
+static bool hashRelabel(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
+  struct symbolHashTable table;
+  statData_t *distinctSymbols;
+  bool translateNeeded;
+  size_t count;
+  size_t j;
+
+  assert(S != NULL);
+  assert(k != NULL);
+  assert(translatedMedian != NULL);
+  assert(L > 2);
+
+  initSymbolHashTable(&table, 1024);
+
   /* L ops */
-  for (j = 0; j < L; j++) {
-    assert(S[j] < (*k));
-    symbolCount[S[j]]++;
+  for (size_t i = 0; i < L; i++) {
+    countSymbol(&table, S[i]);
+  }
+
+  if ((distinctSymbols = malloc(sizeof(statData_t) * table.used)) == NULL) {
+    perror("Memory allocation error");
+    fatalError(EX_OSERR);
   }
 
-  /* k ops */
   j = 0;
-  count = 0;
-  targetCount = L / 2;
-  medianSlop = L % 2;
-  if (configVerbose > 2) fprintf(stderr, "targetCount: %zu, medianSlop: %zu\n", targetCount, medianSlop);
+  for (size_t i = 0; i < table.capacity; i++) {
+    if (table.occupied[i]) distinctSymbols[j++] = table.symbols[i];
+  }
+  assert(j == table.used);
 
-  for (i = 0; i < (*k); i++) {
-    if (symbolCount[i] != 0) {
-      // record the symbol map
-      assert(rewritetable[i] == -1);
-      rewritetable[i] = (int64_t)j;
-      newcount = count + symbolCount[i];
-
-      if (count < targetCount) {
-        if (targetCount == newcount) {
-          if (configVerbose > 2) fprintf(stderr, "Prior count under target, newcount equal to target. ");
-          if (medianSlop == 1) {
-            // Odd case
-            *translatedMedian = (double)j + 1.0;
-            if (configVerbose > 2) fprintf(stderr, "Select next symbol. ");
-          } else {
-            // even case
-            *translatedMedian = (double)j + 0.5;
-            if (configVerbose > 2) fprintf(stderr, "Select space halfway to next symbol. ");
-          }
-        } else if (targetCount < newcount) {
-          // For both the even and odd case, there is no averaging necessary in this case
-          *translatedMedian = (double)j;
-          if (configVerbose > 2) fprintf(stderr, "Prior count under target, newcount is above target. Median %.17g.\n", *translatedMedian);
-        }
-      }
+  /* l * log2(l) ops */
+  qsort(distinctSymbols, table.used, sizeof(statData_t), statDataCompare);
 
-      count = newcount;
-      j++;
-    }
+  // Translation is necessary unless the symbols are exactly 0, ..., l-1
+  translateNeeded = ((size_t)distinctSymbols[table.used - 1] + 1 != table.used);
+
+  // Establish the translated median, and replace each count with the translated symbol
+  count = 0;
+  for (j = 0; j < table.used; j++) {
+    size_t slot = symbolHashSlot(&table, distinctSymbols[j]);
+    assert(table.occupied[slot]);
+    updateTranslatedMedian(j, table.values[slot], L, &count, translatedMedian);
+    table.values[slot] = j;
   }
+  assert(count == L);
 
-  if (*k != j) {
-    *k = j;
+  *k = table.used;
 
-    translateNeeded = true;
+  if (translateNeeded) {
     if (configVerbose > 0) {
-      fprintf(stderr, "Translation is necessary... Found %zu symbols total.\n", j);
+      fprintf(stderr, "Translation is necessary... Found %zu symbols total.\n", *k);
     }
+
     /* L ops */
-    for (i = 0; i < L; i++) {
-      assert(rewritetable[S[i]] >= 0);
-      assert(rewritetable[S[i]] < (int64_t)(*k));
-      S[i] = (statData_t)rewritetable[S[i]];
+    for (size_t i = 0; i < L; i++) {
+      S[i] = (statData_t)table.values[symbolHashSlot(&table, S[i])];
     }
   } else {
-    translateNeeded = false;
     if (configVerbose > 0) {
       fprintf(stderr, "No translation is necessary.\n");
     }
   }
 
-  assert(rewritetable != NULL);
-  free(rewritetable);
-  rewritetable = NULL;
-
-  assert(symbolCount != NULL);
-  free(symbolCount);
-  symbolCount = NULL;
+  free(distinctSymbols);
+  freeSymbolHashTable(&table);
 
   return translateNeeded;
 }
+#endif
 
 bool translate(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
-  size_t i;
-  size_t maxSymbols;
   bool didTranslate;
 
   assert(S != NULL);
@@ -314,8 +356,31 @@ bool translate(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
     return (didTranslate);
   }
 
+#if STATDATA_BITS == 8
+  // A histogram of all possible symbols is small, so the translation can proceed directly from one histogram pass.
+  {
+    size_t symbolCount[STATDATA_MAX + 1] = {0};
+
+    /* L ops */
+    for (size_t j = 0; j < L; j++) {
+      symbolCount[S[j]]++;
+    }
+
+    for (*k = STATDATA_MAX + 1; symbolCount[*k - 1] == 0; (*k)--)
+      ;
+
+    if (configVerbose > 0) {
+      fprintf(stderr, "At most %zu symbols.\n", *k);
+    }
+
+    // Catch the all zeros case
+    if (*k < 2) return false;
+
+    return histogramRelabel(S, L, symbolCount, k, translatedMedian);
+  }
+#else
   *k = 0;
-  for (i = 0; i < L; i++) {
+  for (size_t i = 0; i < L; i++) {
     if (*k < S[i]) {
       *k = S[i];
     }
@@ -323,8 +388,6 @@ bool translate(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
 
   (*k)++;
 
-  maxSymbols = ((*k < L) ? *k : L);
-
   if (configVerbose > 0) {
     fprintf(stderr, "At most %zu symbols.\n", *k);
   }
@@ -332,19 +395,21 @@ bool translate(statData_t *S, size_t L, size_t *k, double *translatedMedian) {
   // Catch the all zeros case
   if (*k < 2) return false;
 
-  /* 2 L + 1.39*L*log2(L) + L*log2(l) */
-  if (((2.0 * (double)(L + *k)) < ((double)L) * (1.39 * log2((double)L) + log2((double)maxSymbols))) && (log2((double)*k) < 28.0)) {
+  /* The table approach takes 2 L + 2 k ops (and k words of memory), whereas the hash approach takes
+   * about 2 L + l*log2(l) ops (where l is the number of distinct symbols, and l <= L) and memory proportional to l.
+   */
+  if ((*k <= 4 * L) && (log2((double)*k) < 28.0)) {
     if (configVerbose > 0) {
       fprintf(stderr, "Table based translation approach.\n");
     }
     didTranslate = tableRelabel(S, L, k, translatedMedian);
   } else {
     if (configVerbose > 0) {
-      fprintf(stderr, "Sorting based translation approach.\n");
+      fprintf(stderr, "Hash based translation approach.\n");
     }
-    /*It is likely quicker to just sort the list and relabel*/
-    didTranslate = sortRelabel(S, L, k, translatedMedian);
+    didTranslate = hashRelabel(S, L, k, translatedMedian);
   }
 
   return didTranslate;
+#endif
 }
@@ -17,6 +17,7 @@
 #include <unistd.h>
 
 #include "binutil.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -48,10 +49,16 @@ static void bitmask(uint64_t *input, int bitpos) {
 }
 
 int main(int argc, char *argv[]) {
-  uint64_t data[2];
-  statData_t outdata;
+  const uint64_t *data;
+  statData_t *outdata;
   uint64_t curbitmask[2];
-  size_t res;
+  size_t word;
+  uint64_t shift;
+  size_t outcount;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
   int bitpos;
   int opt;
   bool configReverse;
@@ -86,16 +93,30 @@ int main(int argc, char *argv[]) {
     reverse128(curbitmask);
   }
 
-  while (feof(stdin) == 0) {
-    res = fread(data, sizeof(uint64_t), 2, stdin);
-    if (res == 2) {
-      outdata = (((curbitmask[0] & data[0]) | (curbitmask[1] & data[1])) == 0) ? 0 : 1;
-      if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
+  // Each element is a pair of uint64_ts
+  initBlockReader(&reader, stdin, 2 * sizeof(uint64_t), false);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+
+  // Only one bit is set, so only one of the two words need be examined.
+  word = (curbitmask[0] == 0) ? 1 : 0;
+  shift = (uint64_t)__builtin_ctzll(curbitmask[word]);
+
+  while ((count = readBlock(&reader, (const void **)&data)) > 0) {
+    data += word;
+    while (count > 0) {
+      outdata = reserveElements(&writer, &outcount);
+      if (outcount > count) outcount = count;
+      for (i = 0; i < outcount; i++) {
+        outdata[i] = (statData_t)((data[2 * i] >> shift) & 1U);
       }
+      commitElements(&writer, outcount);
+      data += 2 * outcount;
+      count -= outcount;
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
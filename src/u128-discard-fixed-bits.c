@@ -19,6 +19,7 @@
 
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -34,13 +35,14 @@ int main(int argc, char *argv[]) {
   FILE *infp;
   size_t datalen;
   uint32_t *data = NULL;
-  uint32_t *dataPartition[4];
+  uint32_t *output = NULL;
   size_t i, j;
   uint32_t bitmask[4];
-  uint32_t maxval, minval;
   uint32_t bits;
   double doubleBits;
   int outputGroup;
+  struct bitStatistics stats;
+  struct extractPlan plan;
 
   assert(PRECISION(UINT_MAX) >= 32);
   assert(PRECISION(SIZE_MAX) > 32);
@@ -51,6 +53,10 @@ int main(int argc, char *argv[]) {
 
   outputGroup = atoi(argv[2]);
 
+  if ((outputGroup < 0) || (outputGroup > 3)) {
+    useageExit();
+  }
+
   if ((infp = fopen(argv[1], "rb")) == NULL) {
     perror("Can't open file");
     exit(EX_NOINPUT);
@@ -61,67 +67,46 @@ int main(int argc, char *argv[]) {
   assert(datalen > 0);
   assert((datalen % 4) == 0);
 
-  dataPartition[0] = calloc(datalen / 4, sizeof(uint32_t));
-  dataPartition[1] = calloc(datalen / 4, sizeof(uint32_t));
-  dataPartition[2] = calloc(datalen / 4, sizeof(uint32_t));
-  dataPartition[3] = calloc(datalen / 4, sizeof(uint32_t));
-
-  if ((dataPartition[0] == NULL) || (dataPartition[1] == NULL) || (dataPartition[2] == NULL) || (dataPartition[3] == NULL)) {
-    perror("Can't allocate partitions");
-    exit(EX_OSERR);
-  }
-
-  for (j = 0; j < datalen; j++) {
-    (dataPartition[j & 0x3])[j >> 2] = data[j];
-  }
-
   fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
   if (fclose(infp) != 0) {
     perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
+  // Each group is a column of the interleaved data, so it can be summarized in place.
   for (j = 0; j < 4; j++) {
-    maxval = 0;
-    minval = UINT_MAX;
-
-    for (i = 0; i < datalen / 4; i++) {
-      if ((dataPartition[j])[i] > maxval) {
-        maxval = (dataPartition[j])[i];
-      }
-      if ((dataPartition[j])[i] < minval) {
-        minval = (dataPartition[j])[i];
-      }
-    }
-    doubleBits = ceil(log2((double)maxval + 1.0));
+    getBitStatistics(&stats, data + j, datalen / 4, 4);
+
+    doubleBits = ceil(log2((double)stats.maxValue + 1.0));
     assert(doubleBits >= 0.0);
     bits = (uint32_t)doubleBits;
 
-    bitmask[j] = getActiveBits(dataPartition[j], datalen / 4);
-
-    fprintf(stderr, "Symbols in the range [%u, %u] (%u bit: bitmask 0x%08X)\n", minval, maxval, bits, bitmask[j]);
+    bitmask[j] = activeBitsFromStatistics(&stats);
 
-    for (i = 0; i < datalen / 4; i++) {
-      (dataPartition[j])[i] = extractbits((dataPartition[j])[i], bitmask[j]);
-    }
+    fprintf(stderr, "Symbols in the range [%u, %u] (%u bit: bitmask 0x%08X)\n", stats.minValue, stats.maxValue, bits, bitmask[j]);
   }
 
   fprintf(stderr, "%d bits total\n", __builtin_popcount(bitmask[0]) + __builtin_popcount(bitmask[1]) + __builtin_popcount(bitmask[2]) + __builtin_popcount(bitmask[3]));
 
   fprintf(stderr, "Outputting group %d\n", outputGroup);
 
+  if ((output = malloc(sizeof(uint32_t) * (datalen / 4))) == NULL) {
+    perror("Can't allocate output array");
+    exit(EX_OSERR);
+  }
+
+  initExtractPlan(&plan, bitmask[outputGroup]);
   for (i = 0; i < datalen / 4; i++) {
-    if (fwrite(&((dataPartition[outputGroup])[i]), sizeof(uint32_t), 1, stdout) != 1) {
-      perror("Can't write output to stdout");
-      exit(EX_OSERR);
-    }
+    output[i] = extractPlanValue(&plan, data[4 * i + (size_t)outputGroup]);
+  }
+
+  if (fwrite(output, sizeof(uint32_t), datalen / 4, stdout) != datalen / 4) {
+    perror("Can't write output to stdout");
+    exit(EX_OSERR);
   }
 
   free(data);
-  free(dataPartition[0]);
-  free(dataPartition[1]);
-  free(dataPartition[2]);
-  free(dataPartition[3]);
+  free(output);
 
   return EX_OK;
 }
@@ -19,11 +19,14 @@
 #include <sysexits.h>
 #include <math.h>
 
+#include "blockio.h"
 #include "precision.h"
 #include "fancymath.h"
 
 int main(void) {
-  size_t res;
+  size_t blockCount;
+  const uint16_t *block;
+  struct blockReader reader;
   size_t symbolCount[UINT16_MAX+1] = {0};
   size_t maxSymbolCount = 0;
   size_t symbols = 0;
@@ -32,15 +35,14 @@ int main(void) {
   double phat;
 
 
-  while (feof(stdin) == 0) {
-    uint16_t indata;
-
-    res = fread(&indata, sizeof(uint16_t), 1, stdin);
-    if (res == 1) {
-      symbolCount[indata]++;
-      symbols++;
+  initBlockReader(&reader, stdin, sizeof(uint16_t), true);
+  while ((blockCount = readBlock(&reader, (const void **)&block)) > 0) {
+    for (size_t j = 0; j < blockCount; j++) {
+      symbolCount[block[j]]++;
     }
+    symbols += blockCount;
   }
+  freeBlockReader(&reader);
 
   for(uint32_t j=0; j<=UINT16_MAX; j++) {
     if(symbolCount[j] > maxSymbolCount) {
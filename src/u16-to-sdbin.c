@@ -15,6 +15,7 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "entlib.h"
 
 noreturn static void useageExit(void) {
@@ -30,6 +31,11 @@ noreturn static void useageExit(void) {
 int main(int argc, char *argv[]) {
   statData_t outdata;
   uint16_t indata;
+  const uint16_t *inBlock;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
   uint16_t bitmask;
   size_t j;
   bool configLTH;
@@ -56,8 +62,12 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  while (feof(stdin) == 0) {
-    if (fread(&indata, sizeof(uint16_t), 1, stdin) == 1) {
+  initBlockReader(&reader, stdin, sizeof(uint16_t), false);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (i = 0; i < count; i++) {
+      indata = inBlock[i];
       if (configBigEndian) {
         indata = (uint16_t)(((indata >> 8) & 0x00FF) | ((indata << 8) & 0xFF00));
       }
@@ -69,10 +79,7 @@ int main(int argc, char *argv[]) {
 
       for (j = 0; j < 16; j++) {
         outdata = (statData_t)(((indata & bitmask) == 0) ? 0U : 1U);
-        if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-          perror("Can't write to output");
-          exit(EX_OSERR);
-        }
+        writeElement(&writer, &outdata);
 
         if (configLTH) {
           bitmask = (uint16_t)((bitmask << 1) & 0xFFFF);
@@ -83,5 +90,8 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "precision.h"
 
 noreturn static void useageExit(void) {
@@ -29,10 +30,14 @@ noreturn static void useageExit(void) {
 }
 
 int main(int argc, char *argv[]) {
-  size_t res;
   bool configDiffMode;
   uint16_t lastSymbol;
   int opt;
+  const uint16_t *inBlock;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
 
   assert(PRECISION(UINT_MAX) == 32);
 
@@ -52,22 +57,24 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
+  initBlockReader(&reader, stdin, sizeof(uint16_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+
   if (configDiffMode) {
-    res = fread(&lastSymbol, sizeof(uint16_t), 1, stdin);
-    if (res != 1) {
-      perror("Can't read initial symbol");
+    if (!readElement(&reader, &lastSymbol)) {
+      fprintf(stderr, "Can't read initial symbol\n");
       exit(EX_OSERR);
     }
   } else {
     lastSymbol = 0;
   }
 
-  while (feof(stdin) == 0) {
-    uint32_t outdata;
-    uint16_t indata;
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (i = 0; i < count; i++) {
+      uint32_t outdata;
+      uint16_t indata;
 
-    res = fread(&indata, sizeof(uint16_t), 1, stdin);
-    if (res == 1) {
+      indata = inBlock[i];
       if (configDiffMode) {
         uint16_t curdelta;
         curdelta = (uint16_t)(indata - lastSymbol);
@@ -77,12 +84,12 @@ int main(int argc, char *argv[]) {
         outdata = (uint32_t)indata;
       }
 
-      if (fwrite(&outdata, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
-      }
+      writeElement(&writer, &outdata);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
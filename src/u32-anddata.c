@@ -16,6 +16,7 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "precision.h"
 
 noreturn static void useageExit(void) {
@@ -30,8 +31,13 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  uint32_t data;
+  const uint32_t *data;
+  uint32_t outData;
   uint32_t andMask;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
   long long int inll;
 
   if (argc == 3) {
@@ -57,20 +63,19 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "Outputting data\n");
 
-  while (feof(infp) == 0) {
-    if (fread(&data, sizeof(uint32_t), 1, infp) == 1) {
-      data &= andMask;
+  initBlockReader(&reader, infp, sizeof(uint32_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
 
-      if (fwrite(&data, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write output to stdout");
-        exit(EX_OSERR);
-      }
-    } else {
-      perror("Can't read input from file");
-      exit(EX_OSERR);
+  while ((count = readBlock(&reader, (const void **)&data)) > 0) {
+    for (i = 0; i < count; i++) {
+      outData = data[i] & andMask;
+      writeElement(&writer, &outData);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   fclose(infp);
 
   return EX_OK;
@@ -18,6 +18,7 @@
 #include <unistd.h>
 
 #include "binutil.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -86,10 +87,17 @@ static void strtoindexarray(const char *nptr, uint8_t *bitpos) {
 }
 
 int main(int argc, char *argv[]) {
-  uint32_t data;
+  const uint32_t *inBlock;
+  uint32_t *outBlock;
   uint8_t outputBitpos[33];  // msb to lsb
+  size_t bitCount;
   int opt;
   bool configReverse;
+  struct blockReader reader;
+  struct blockWriter writer;
+  struct permutePlan plan;
+  size_t count;
+  size_t outcount;
 
   memset(outputBitpos, 32, sizeof(outputBitpos));
   configReverse = false;
@@ -115,26 +123,26 @@ int main(int argc, char *argv[]) {
     strtoindexarray(argv[0], outputBitpos);
   }
 
-  while (feof(stdin) == 0) {
-    uint32_t curOutput = 0;
-    size_t res;
+  for (bitCount = 0; outputBitpos[bitCount] < 32; bitCount++)
+    ;
 
-    if (fread(&data, sizeof(uint32_t), 1, stdin) == 1) {
-      uint8_t curOutputIndex = 0;
-      if (configReverse) {
-        data = reverse32(data);
-      }
+  // The byte reversal (if any) is folded into the permutation.
+  initPermutePlan(&plan, outputBitpos, bitCount, configReverse);
 
-      while (outputBitpos[curOutputIndex] < 32) {
-        curOutput = curOutput << 1;
-        curOutput = curOutput | ((data >> outputBitpos[curOutputIndex]) & 1U);
-        curOutputIndex++;
-      }
+  initBlockReader(&reader, stdin, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
 
-      res = fwrite(&curOutput, sizeof(uint32_t), 1, stdout);
-      assert(res == 1);
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (size_t i = 0; i < count; i += outcount) {
+      outBlock = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      permutePlanArray(&plan, inBlock + i, outBlock, outcount);
+      commitElements(&writer, outcount);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
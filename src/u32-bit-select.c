@@ -17,6 +17,7 @@
 #include <unistd.h>
 
 #include "binutil.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -32,11 +33,18 @@ noreturn static void useageExit(void) {
 }
 
 int main(int argc, char *argv[]) {
-  uint32_t data;
+  const uint32_t *data;
   uint32_t curbitmask;
   int bitpos;
   int opt;
   bool configReverse;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
+  size_t outcount;
+  statData_t *outdata;
+  struct extractPlan plan;
 
   configReverse = false;
 
@@ -69,19 +77,22 @@ int main(int argc, char *argv[]) {
     curbitmask = reverse32(curbitmask);
   }
 
-  while (feof(stdin) == 0) {
-    size_t res;
-    statData_t outdata;
+  initBlockReader(&reader, stdin, sizeof(uint32_t), false);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
 
-    res = fread(&data, sizeof(uint32_t), 1, stdin);
-    if (res == 1) {
-      outdata = (statData_t)(((curbitmask & data) == 0) ? 0U : 1U);
-      if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
-      }
+  initExtractPlan(&plan, curbitmask);
+
+  while ((count = readBlock(&reader, (const void **)&data)) > 0) {
+    for (i = 0; i < count; i += outcount) {
+      outdata = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      extractPlanArray(&plan, data + i, outdata, outcount);
+      commitElements(&writer, outcount);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
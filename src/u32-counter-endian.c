@@ -18,8 +18,8 @@
 #include <string.h>
 #include <sysexits.h>
 
-#include "binio.h"
-#include "binutil.h"
+#include "blockio.h"
+#include "convert.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -33,16 +33,18 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  size_t datalen;
-  uint32_t *data = NULL;
-  size_t i;
-  size_t incCountNative, incCountReversed;
+  const uint32_t *inBlock;
+  uint32_t *outBlock;
+  size_t count;
+  size_t outcount;
   bool configDiffMode;
   int opt;
+  struct blockReader reader;
+  struct blockWriter writer;
+  struct u32CounterStats stats;
+  struct u32CounterDecoder decoder;
 
   configDiffMode = false;
-  incCountNative = 0;
-  incCountReversed = 0;
 
   while ((opt = getopt(argc, argv, "d")) != -1) {
     switch (opt) {
@@ -66,43 +68,46 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint32file(infp, &data);
-  assert(data != NULL);
-
-  fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
-
-  if (fclose(infp) != 0) {
-    perror("Can't close intput file");
-    exit(EX_OSERR);
+  // First pass: vote on the byte order.
+  initU32CounterStats(&stats);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    u32CounterScan(&stats, inBlock, count);
   }
+  freeBlockReader(&reader);
 
-  for (i = 1; i < datalen; i++) {
-    if (data[i - 1] <= data[i]) incCountNative++;
-    if (reverse32(data[i - 1]) <= reverse32(data[i])) incCountReversed++;
-  }
+  fprintf(stderr, "Read in %zu uint32_ts\n", stats.count);
 
-  if (incCountNative >= incCountReversed) {
-    fprintf(stderr, "Native format detected (%.17g vs %.17g)\n", ((double)incCountNative) / ((double)datalen), ((double)incCountReversed) / ((double)datalen));
+  if (stats.incNative >= stats.incReversed) {
+    fprintf(stderr, "Native format detected (%.17g vs %.17g)\n", ((double)stats.incNative) / ((double)stats.count), ((double)stats.incReversed) / ((double)stats.count));
   } else {
-    fprintf(stderr, "Reversed format detected (%.17g vs %.17g)\n", ((double)incCountReversed) / ((double)datalen), ((double)incCountNative) / ((double)datalen));
-    for (i = 0; i < datalen; i++) {
-      data[i] = reverse32(data[i]);
-    }
+    fprintf(stderr, "Reversed format detected (%.17g vs %.17g)\n", ((double)stats.incReversed) / ((double)stats.count), ((double)stats.incNative) / ((double)stats.count));
   }
 
-  if (configDiffMode) {
-    for (i = 1; i < datalen; i++) {
-      data[i - 1] = data[i] - data[i - 1];
+  // Second pass: output the (possibly reversed) values or differences.
+  if (fseek(infp, 0, SEEK_SET) < 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
+  }
+  clearerr(infp);
+
+  initU32CounterDecoder(&decoder, stats.incNative < stats.incReversed, configDiffMode, 0);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (size_t i = 0; i < count; i += outcount) {
+      outBlock = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      commitElements(&writer, u32CounterDecode(&decoder, inBlock + i, outBlock, outcount));
     }
-    datalen--;
   }
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
 
-  if (fwrite(data, sizeof(uint32_t), datalen, stdout) != datalen) {
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
-  free(data);
-
   return (0);
 }
@@ -18,7 +18,8 @@
 #include <string.h>
 #include <sysexits.h>
 
-#include "binio.h"
+#include "blockio.h"
+#include "convert.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -31,12 +32,14 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  size_t datalen;
-  uint32_t *data = NULL;
-  size_t i;
-  uint32_t delta;
-  uint32_t mindelta = UINT32_MAX;
-  uint32_t maxdelta = 0;
+  const uint32_t *inBlock;
+  uint32_t *outBlock;
+  size_t count;
+  size_t outcount;
+  struct blockReader reader;
+  struct blockWriter writer;
+  struct u32CounterStats stats;
+  struct u32CounterDecoder decoder;
 
   if (argc != 2) {
     useageExit();
@@ -47,42 +50,49 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint32file(infp, &data);
-  assert(data != NULL);
-
-  fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
-  if (fclose(infp) != 0) {
-    perror("Can't close intput file");
-    exit(EX_OSERR);
+  // First pass: find the delta range.
+  initU32CounterStats(&stats);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    u32CounterScan(&stats, inBlock, count);
   }
+  freeBlockReader(&reader);
+
+  fprintf(stderr, "Read in %zu uint32_ts\n", stats.count);
 
-  if (datalen < 2) {
+  if (stats.count < 2) {
     fprintf(stderr, "Too little data\n");
     exit(EX_DATAERR);
   }
 
-  for (i = 1; i < datalen; i++) {
-    delta = data[i] - data[i - 1];
-    if (delta < mindelta) mindelta = delta;
-    if (delta > maxdelta) maxdelta = delta;
-    data[i - 1] = delta;
+  if (stats.minDelta != 0) {
+    fprintf(stderr, "Shifting data down by %u. Maximum value now %u\n", stats.minDelta, stats.maxDelta - stats.minDelta);
   }
-  if (mindelta != 0) {
-    fprintf(stderr, "Shifting data down by %u. Maximum value now %u\n", mindelta, maxdelta - mindelta);
 
-    for (i = 0; i < datalen - 1; i++) {
-      data[i] -= mindelta;
+  // Second pass: output the shifted deltas.
+  if (fseek(infp, 0, SEEK_SET) < 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
+  }
+  clearerr(infp);
+
+  initU32CounterDecoder(&decoder, false, true, stats.minDelta);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (size_t i = 0; i < count; i += outcount) {
+      outBlock = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      commitElements(&writer, u32CounterDecode(&decoder, inBlock + i, outBlock, outcount));
     }
   }
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
 
-  if (fwrite(data, sizeof(uint32_t), datalen - 1, stdout) != datalen - 1) {
-    if (data != NULL) free(data);
-    data = NULL;
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
-  if (data != NULL) free(data);
-  data = NULL;
   return (0);
 }
@@ -20,88 +20,65 @@
 #include <string.h>
 
 #include "binio.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
 #include "fancymath.h"
+#include "frequency.h"
 #include "randlib.h"
 
-static int uintcompare(const void *in1, const void *in2) {
-  const uint32_t *left;
-  const uint32_t *right;
-
-  left = in1;
-  right = in2;
-
-  if (*left < *right) {
-    return (-1);
-  } else if (*left > *right) {
-    return (1);
-  } else {
-    return (0);
-  }
-}
-
-/*This is the Fisher Yates shuffle*/
-/*See https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle*/
-static void FYShuffle64(size_t *data, size_t datalen, struct randstate *rstate) {
-  assert(datalen > 0);
-  assert(datalen <= UINT64_MAX);
-
-  for (size_t i = datalen - 1; i >= 1; i--) {
-    size_t tmp;
-    size_t j = randomRange64((uint64_t)i, rstate);
-    tmp = data[i];
-    data[i] = data[j];
-    data[j] = tmp;
-  }
-}
-
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, "u32-decrease-entropy [-v] <updated apparent entropy> <infile>\n");
+  fprintf(stderr, "u32-decrease-entropy [-v] [-d] <updated apparent entropy> <infile>\n");
   fprintf(stderr, "Makes the found most common symbol more common (by randomly replacing other symbols with\n");
   fprintf(stderr, "the identified most common symbol), until the data has approximately the target entropy.\n");
   fprintf(stderr, "This simulates the SP 800-90B Section 4.5 Criterion (b) failure mode.\n");
   fprintf(stderr, "Outputs the resulting data to stdout in u32 format.\n");
   fprintf(stderr, "-v Increase verbosity. Can be used multiple times.\n");
+  fprintf(stderr, "-d Make the RNG deterministic.\n");
   exit(EX_USAGE);
 }
 
 int main(int argc, char *argv[]) {
   FILE *infp;
+  size_t fileSize;
   size_t datalen;
-  uint32_t *data = NULL;
-  uint32_t *sortedData = NULL;
-  size_t *nonMLSIndexes = NULL;
+  struct u32CountTable table;
+  struct symbolCount mostCommon;
+  struct blockReader reader;
+  struct blockWriter writer;
+  const uint32_t *block;
+  size_t blockLen;
   size_t maxSymbolCount = 0;
   uint32_t MLS = 0;
-  size_t curSymbolCount = 0;
-  size_t k = 0;
-  uint32_t curSymbol;
   double phat;
   double targetphat;
   struct randstate rstate;
+  uint64_t selectionKey;
   int opt;
   char *endptr;
   double indouble;
   double configTargetEntropy;
   size_t targetMaxSymbolCount;
-  size_t nonMLScount=0;
-  size_t curIndexPos;
+  size_t nonMLScount = 0;
+  size_t nonMLSseen;
   size_t convertToMLS;
+  size_t converted;
 
   initGenerator(&rstate);
-  seedGenerator(&rstate);
 
   configVerbose = 0;
 
-  while ((opt = getopt(argc, argv, "v")) != -1) {
+  while ((opt = getopt(argc, argv, "vd")) != -1) {
     switch (opt) {
       case 'v':
         // Output more debug information.
         configVerbose++;
         break;
+      case 'd':
+        rstate.deterministic = true;
+        break;
       default: /* ? */
         useageExit();
     }
@@ -114,6 +91,8 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
+  seedGenerator(&rstate);
+
   endptr=NULL;
   indouble = strtod(argv[0], &endptr);
 #pragma GCC diagnostic push
@@ -134,67 +113,45 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  if ((datalen = readuint32file(infp, &data)) < 1) {
+  fileSize = getfilesize(infp);
+  if ((fileSize % sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+
+  if ((datalen = fileSize / sizeof(uint32_t)) < 1) {
     perror("Data file is empty");
     exit(EX_DATAERR);
   }
 
-  assert(data != NULL);
-
   if(configVerbose > 0) fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
-  assert(datalen > 0);
 
-  if (fclose(infp) != 0) {
-    perror("Can't close input file");
-    exit(EX_OSERR);
+  // Pass 1: count the symbols, keeping only the counts.
+  if(configVerbose > 0) fprintf(stderr, "Counting the symbols\n");
+  initCountTable(&table, 0);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((blockLen = readBlock(&reader, (const void **)&block)) > 0) {
+    countTableAdd(&table, block, blockLen);
   }
+  freeBlockReader(&reader);
 
-  if((sortedData = malloc(datalen*sizeof(uint32_t)))==NULL) {
-    perror("Can't allocate memory for sorting");
-    exit(EX_OSERR);
+  if (table.total != datalen) {
+    fprintf(stderr, "Input file changed while reading\n");
+    exit(EX_DATAERR);
   }
 
-  memcpy(sortedData, data, datalen*sizeof(uint32_t));
-
-  //Sort the data
-  if(configVerbose > 0) fprintf(stderr, "Sorting the data\n");
-  qsort(sortedData, datalen, sizeof(uint32_t), uintcompare);
-
-
+  // Ties are broken in favor of the smaller symbol.
   if(configVerbose > 0) fprintf(stderr, "Finding the MLS\n");
-  MLS = curSymbol = sortedData[0];
-  curSymbolCount = 1;
-
-  for(size_t j=1; j<datalen; j++) {
-    if(sortedData[j] == curSymbol) {
-       curSymbolCount ++;
-    } else {
-       //This is a transition.
-       k++;
-       if(curSymbolCount > maxSymbolCount) {
-          maxSymbolCount = curSymbolCount;
-          MLS = curSymbol;
-       }
-
-       curSymbolCount = 1;
-       curSymbol = sortedData[j];
-    }
-  }
-  //This is a transition.
-  k++;
-  if(curSymbolCount > maxSymbolCount) {
-    maxSymbolCount = curSymbolCount;
-    MLS = curSymbol;
-  }
-
-
-  free(sortedData);
+  countTableTopK(&table, 1, &mostCommon);
+  MLS = mostCommon.symbol;
+  maxSymbolCount = mostCommon.count;
 
   if(configVerbose > 0) {
-    fprintf(stderr, "Encountered %zu distinct symbols.\n", k);
+    fprintf(stderr, "Encountered %zu distinct symbols.\n", table.distinct);
     fprintf(stderr, "Most likely symbol is 0x%08X (count %zu)\n", MLS, maxSymbolCount);
   }
 
+  freeCountTable(&table);
+
   phat=((double)maxSymbolCount) / ((double)datalen);
   if(configVerbose > 0) fprintf(stderr, "p_hat = %.17g\n", phat);
 
@@ -208,45 +165,67 @@ int main(int argc, char *argv[]) {
 
   assert(datalen > maxSymbolCount);
   nonMLScount = datalen - maxSymbolCount;
+  convertToMLS = targetMaxSymbolCount - maxSymbolCount;
+  assert(convertToMLS <= nonMLScount);
 
-  if((nonMLSIndexes = malloc(nonMLScount*sizeof(size_t)))==NULL) {
-    perror("Can't allocate memory for index list");
+  /*Pass 2: Change randomly selected non-MLS values to MLS values.
+   *This is selection sampling (Knuth, TAOCP Vol. 2, Section 3.4.2, Algorithm S): each non-MLS value is selected with probability
+   *(conversions still needed) / (non-MLS values not yet seen), which selects a uniformly random subset of exactly convertToMLS
+   *of the non-MLS values. The random value for each decision is drawn from a counter-based generator indexed by the non-MLS
+   *value's position, so the result depends only on the seed and the data, not on how the input is chunked.
+   */
+  selectionKey = randomu64(&rstate);
+  if (fseek(infp, 0, SEEK_SET) != 0) {
+    perror("Can't rewind input file");
     exit(EX_OSERR);
   }
+  clearerr(infp);
 
-  for(size_t index = 0; index < nonMLScount; index++) nonMLSIndexes[index] = datalen;
-
-  /*Find all the non-MLS indexes*/
-  curIndexPos = 0;
-  for(size_t curIndex=0; curIndex < datalen; curIndex++) {
-    if(data[curIndex] != MLS) {
-      nonMLSIndexes[curIndexPos] = curIndex;
-      curIndexPos++;
+  if(configVerbose > 0) fprintf(stderr, "Writing the modified dataset\n");
+  nonMLSseen = 0;
+  converted = 0;
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+  while ((blockLen = readBlock(&reader, (const void **)&block)) > 0) {
+    size_t done = 0;
+
+    while (done < blockLen) {
+      size_t outLen;
+      uint32_t *out = reserveElements(&writer, &outLen);
+
+      if (outLen > blockLen - done) outLen = blockLen - done;
+
+      for (size_t i = 0; i < outLen; i++) {
+        uint32_t value = block[done + i];
+
+        if ((value != MLS) && (converted < convertToMLS)) {
+          uint64_t draw = counterRandom64(selectionKey, nonMLSseen);
+          // floor(draw * remaining / 2^64) is (nearly) uniform on [0, remaining).
+          uint64_t position = (uint64_t)(((unsigned __int128)draw * (nonMLScount - nonMLSseen)) >> 64);
+
+          if (position < convertToMLS - converted) {
+            value = MLS;
+            converted++;
+          }
+          nonMLSseen++;
+        }
+
+        out[i] = value;
+      }
+
+      commitElements(&writer, outLen);
+      done += outLen;
     }
   }
-  assert(curIndexPos == nonMLScount);
-
-  /*Determine the order that the non-MLS values will be changes to MLS values.*/
-  FYShuffle64(nonMLSIndexes, nonMLScount, &rstate);
-
-  /*Change randomly selected non-MLS values to MLS values.*/
-  convertToMLS = targetMaxSymbolCount - maxSymbolCount;
-  assert(convertToMLS <= nonMLScount);
-  for(size_t i = 0; i < convertToMLS; i++) {
-    assert(nonMLSIndexes[i] < datalen);
-    assert(data[nonMLSIndexes[i]] != MLS);
-    data[nonMLSIndexes[i]] = MLS;
-  }
+  freeBlockReader(&reader);
+  freeBlockWriter(&writer);
 
-  free(nonMLSIndexes);
+  assert(converted == convertToMLS);
 
-  if(configVerbose > 0) fprintf(stderr, "Writing the modified dataset\n");
-  if (fwrite(data, sizeof(uint32_t), datalen, stdout) != datalen) {
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close input file");
     exit(EX_OSERR);
   }
 
-  free(data);
-  
   return EX_OK;
 }
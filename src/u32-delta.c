@@ -17,7 +17,8 @@
 #include <string.h>
 #include <sysexits.h>
 
-#include "binio.h"
+#include "blockio.h"
+#include "convert.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -31,14 +32,14 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  size_t datalen;
-  uint32_t *data = NULL;
-  size_t i;
-  int64_t *delta = NULL;
-  int64_t min;
-  int64_t max;
-  int64_t newmax;
-  int64_t curdelta;
+  const uint32_t *inBlock;
+  uint32_t *outBlock;
+  size_t count;
+  size_t outcount;
+  struct blockReader reader;
+  struct blockWriter writer;
+  struct u32CounterStats stats;
+  struct u32CounterDecoder decoder;
 
   if (argc != 2) {
     useageExit();
@@ -49,66 +50,41 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint32file(infp, &data);
-  assert(data != NULL);
-
-  fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
-  if (fclose(infp) != 0) {
-    perror("Can't close intput file");
-    exit(EX_OSERR);
-  }
-
-  if ((delta = malloc(datalen * sizeof(int64_t))) == NULL) {
-    perror("Can't allocate extra memory");
-    exit(EX_OSERR);
-  }
-
-  max = INT64_MIN;
-  min = INT64_MAX;
-
-  if (datalen < 2) {
-    fprintf(stderr, "Too little data\n");
-    exit(EX_DATAERR);
+  // First pass: find the delta range.
+  initU32CounterStats(&stats);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    u32CounterScan(&stats, inBlock, count);
   }
+  freeBlockReader(&reader);
 
-  for (i = 1; i < datalen; i++) {
-    curdelta = (int64_t)data[i] - (int64_t)data[i - 1];
-
-    delta[i - 1] = curdelta;
-    if (curdelta < min) min = curdelta;
-    if (curdelta > max) max = curdelta;
-  }
+  fprintf(stderr, "Read in %zu uint32_ts\n", stats.count);
 
-  newmax = max - min;
+  // Second pass: output the translated deltas.
+  initU32CounterDecoder(&decoder, false, true, u32DeltaTranslateOffset(&stats));
 
-  fprintf(stderr, "min diff: %" PRId64 ", max diff: %" PRId64 "\n", min, max);
-  if (newmax > UINT32_MAX) {
-    if (delta != NULL) free(delta);
-    delta = NULL;
-    if (data != NULL) free(data);
-    data = NULL;
-    fprintf(stderr, "Can't map this to the appropriate range\n");
-    exit(EX_DATAERR);
+  if (fseek(infp, 0, SEEK_SET) < 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
   }
-
-  for (i = 0; i < datalen - 1; i++) {
-    assert(delta[i] >= min);
-    assert(delta[i] - min <= UINT32_MAX);
-    data[i] = (uint32_t)(delta[i] - min);
+  clearerr(infp);
+
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (size_t i = 0; i < count; i += outcount) {
+      outBlock = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      commitElements(&writer, u32CounterDecode(&decoder, inBlock + i, outBlock, outcount));
+    }
   }
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
 
-  if (fwrite(data, sizeof(uint32_t), datalen - 1, stdout) != datalen - 1) {
-    if (delta != NULL) free(delta);
-    delta = NULL;
-    if (data != NULL) free(data);
-    data = NULL;
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
-  if (delta != NULL) free(delta);
-  delta = NULL;
-  if (data != NULL) free(data);
-  data = NULL;
   return (0);
 }
@@ -19,6 +19,7 @@
 
 #include "binio.h"
 #include "binutil.h"
+#include "bitstats.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -36,9 +37,10 @@ int main(int argc, char *argv[]) {
   uint32_t *data = NULL;
   size_t i;
   uint32_t bitmask;
-  uint32_t maxval, minval;
   uint32_t bits;
   double doubleBits;
+  struct bitStatistics stats;
+  struct extractPlan plan;
 
   if (argc != 2) {
     useageExit();
@@ -59,29 +61,20 @@ int main(int argc, char *argv[]) {
     exit(EX_OSERR);
   }
 
-  maxval = 0;
-  minval = UINT_MAX;
+  getBitStatistics(&stats, data, datalen, 1);
 
-  for (i = 0; i < datalen; i++) {
-    if (data[i] > maxval) {
-      maxval = data[i];
-    }
-    if (data[i] < minval) {
-      minval = data[i];
-    }
-  }
-
-  doubleBits = ceil(log2((double)maxval + 1.0));
+  doubleBits = ceil(log2((double)stats.maxValue + 1.0));
   assert(doubleBits >= 0.0);
   bits = (uint32_t)doubleBits;
 
-  bitmask = getActiveBits(data, datalen);
+  bitmask = activeBitsFromStatistics(&stats);
 
-  fprintf(stderr, "Symbols in the range [%u, %u], %u bit, bitmask: 0x%08X\n", minval, maxval, bits, bitmask);
+  fprintf(stderr, "Symbols in the range [%u, %u], %u bit, bitmask: 0x%08X\n", stats.minValue, stats.maxValue, bits, bitmask);
 
   fprintf(stderr, "Outputting data\n");
+  initExtractPlan(&plan, bitmask);
   for (i = 0; i < datalen; i++) {
-    data[i] = extractbits(data[i], bitmask);
+    data[i] = extractPlanValue(&plan, data[i]);
   }
 
   if (fwrite(data, sizeof(uint32_t), datalen, stdout) != datalen) {
@@ -19,15 +19,17 @@
 #include <sysexits.h>
 
 #include "binio.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, "u32-downsample [-b <block size>] <rate> <data file>\n");
+  fprintf(stderr, "u32-downsample [-b <block size>] [-m <MiB>] <rate> <data file>\n");
   fprintf(stderr, "Groups data by index into modular classes mod <rate> evenly into the block size.\n");
   fprintf(stderr, "<rate>\tNumber of input samples per output samples\n");
   fprintf(stderr, "-b\tSamples per output block (default 1000000)\n");
+  fprintf(stderr, "-m\tMemory used for reordering, in MiB (default 256)\n");
   fprintf(stderr, "The u32 values are output via stdout.\n");
   exit(EX_USAGE);
 }
@@ -36,25 +38,20 @@ int main(int argc, char *argv[]) {
   size_t trimLen;
   uint32_t configRate;
   size_t configBlockSize;
+  size_t configBufferBytes;
   long int inparam;
   int opt;
+  size_t fileSize;
   size_t datalen;
-  uint32_t *data;
-  uint32_t *outputBuffer;
   unsigned long long inint;
   char *nextOption;
   FILE *infp;
-  size_t conjClass;
-  size_t conjClassSubIndex;
-  size_t conjClassPartitionSize;
-  size_t j;
 
   configVerbose = 0;
   configBlockSize = 1000000;
-  data = NULL;
-  outputBuffer = NULL;
+  configBufferBytes = ((size_t)256) << 20;
 
-  while ((opt = getopt(argc, argv, "vb:")) != -1) {
+  while ((opt = getopt(argc, argv, "vb:m:")) != -1) {
     switch (opt) {
       case 'v':
         configVerbose++;
@@ -66,6 +63,13 @@ int main(int argc, char *argv[]) {
         }
         configBlockSize = inint;
         break;
+      case 'm':
+        inint = strtoull(optarg, &nextOption, 0);
+        if ((inint == 0) || (inint > (SIZE_MAX >> 20)) || (errno == EINVAL) || (nextOption == NULL) || (*nextOption != '\0')) {
+          useageExit();
+        }
+        configBufferBytes = ((size_t)inint) << 20;
+        break;
       default: /* ? */
         useageExit();
     }
@@ -85,60 +89,41 @@ int main(int argc, char *argv[]) {
     configRate = (uint32_t)inparam;
   }
 
+  if (configBlockSize == 0) {
+    useageExit();
+  }
+
   if ((infp = fopen(argv[1], "rb")) == NULL) {
     perror("Can't open file");
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint32file(infp, &data);
-  assert(data != NULL);
+  fileSize = getfilesize(infp);
+  if ((fileSize % sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+  datalen = fileSize / sizeof(uint32_t);
 
   if (configVerbose > 0) {
     fprintf(stderr, "Read in %zu uint32_t integers\n", datalen);
   }
-  // Only deal with data than can be evenly partitioned into a multiple of configRate blocks, each of size configBlockSize
-  // remove data
 
+  // Only deal with data than can be evenly partitioned into a multiple of configRate blocks, each of size configBlockSize
   trimLen = datalen % (configRate * configBlockSize);
   fprintf(stderr, "Trimming %zu samples\n", trimLen);
   datalen = datalen - trimLen;
 
-  if (fclose(infp) != 0) {
-    perror("Couldn't close input data file");
-    exit(EX_OSERR);
-  }
-
-  assert(datalen > 0);
-  if ((outputBuffer = malloc(datalen * sizeof(uint32_t))) == NULL) {
-    perror("Can't allocate output buffer");
-    exit(EX_OSERR);
+  if (datalen == 0) {
+    fprintf(stderr, "Too little data\n");
+    exit(EX_DATAERR);
   }
 
-  conjClass = 0;
-  conjClassSubIndex = 0;
-  assert((datalen % configRate) == 0);
-  conjClassPartitionSize = datalen / configRate;
-
-  for (j = 0; j < datalen; j++) {
-    outputBuffer[conjClass * conjClassPartitionSize + conjClassSubIndex] = data[j];
-    conjClass++;
-    if (conjClass == configRate) {
-      conjClass = 0;
-      conjClassSubIndex++;
-    }
-  }
+  writeModularClasses(infp, stdout, sizeof(uint32_t), datalen, configRate, configBufferBytes);
 
-  assert(conjClass == 0);
-  assert((conjClassSubIndex % configBlockSize) == 0);
-
-  free(data);
-
-  if (fwrite(outputBuffer, sizeof(uint32_t), datalen, stdout) != datalen) {
-    perror("Can't write output to stdout");
+  if (fclose(infp) != 0) {
+    perror("Couldn't close input data file");
     exit(EX_OSERR);
   }
 
-  free(outputBuffer);
-
   return (0);
 }
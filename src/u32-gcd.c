@@ -19,6 +19,7 @@
 #include <sysexits.h>
 
 #include "binio.h"
+#include "divisor.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -46,26 +47,6 @@ static int uintcompare(const void *in1, const void *in2) {
   }
 }
 
-static uint32_t gcd(uint32_t a, uint32_t b) {
-  // Make a greater than or equal.
-  if (a < b) {
-    uint32_t c = a;
-    a = b;
-    b = c;
-  }
-
-  while (b != 0) {
-    uint32_t r;
-
-    r = a % b;
-
-    a = b;
-    b = r;
-  }
-
-  return a;
-}
-
 int main(int argc, char *argv[]) {
   FILE *infp;
   size_t datalen;
@@ -92,27 +73,16 @@ int main(int argc, char *argv[]) {
     exit(EX_OSERR);
   }
 
-  if ((gcds = malloc(sizeof(uint32_t) * datalen)) == NULL) {
-    perror("Can't allocate gcd array");
-    exit(EX_OSERR);
-  }
-
   if (datalen < 2) {
     fprintf(stderr, "Too little data\n");
     exit(EX_DATAERR);
   }
 
-  curfactor = data[0];
-  for (i = 1; i < datalen; i++) {
-    gcds[i] = gcd(data[i - 1], data[i]);
-    if (curfactor != 1) curfactor = gcd(data[i], curfactor);
-  }
+  curfactor = u32ArrayGCD(data, datalen);
 
   if (curfactor > 1) {
     fprintf(stderr, "Found common divisor %u\n", curfactor);
-    for (i = 0; i < datalen; i++) {
-      data[i] /= curfactor;
-    }
+    u32DivideExactArray(data, datalen, curfactor);
   } else {
     // Look for an almost common factor
     uint32_t mostCommonGCD = 0;
@@ -121,6 +91,14 @@ int main(int argc, char *argv[]) {
     size_t maxcount = 0;
     double mostCommonGCDrate;
 
+    // The pairwise GCDs are only needed when there is no common factor.
+    if ((gcds = malloc(sizeof(uint32_t) * (datalen - 1))) == NULL) {
+      perror("Can't allocate gcd array");
+      exit(EX_OSERR);
+    }
+
+    u32PairwiseGCD(data, gcds, datalen);
+
     qsort(gcds, datalen - 1, sizeof(uint32_t), uintcompare);
     for (i = 0; i < datalen - 1; i++) {
       if (gcds[i] == curGCD) {
@@ -141,9 +119,7 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Most common gcd is %u (%g)\n", mostCommonGCD, mostCommonGCDrate);
     if ((mostCommonGCDrate > 0.99) && (mostCommonGCD > 1)) {
       fprintf(stderr, "Ignoring fuzz\n");
-      for (i = 0; i < datalen; i++) {
-        data[i] /= mostCommonGCD;
-      }
+      u32DivideArray(data, datalen, mostCommonGCD);
     }
   }
 
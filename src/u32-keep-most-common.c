@@ -22,7 +22,9 @@
 #include <time.h>
 
 #include "binio.h"
+#include "blockio.h"
 #include "entlib.h"
+#include "frequency.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -37,17 +39,16 @@ noreturn static void useageExit(void) {
   exit(EX_USAGE);
 }
 
-// Induce a reverse sort (greatest to smallest)
-static int sizetCompare(const void *in1, const void *in2) {
-  const size_t *left;
-  const size_t *right;
+static int symbolCompare(const void *in1, const void *in2) {
+  const struct symbolCount *left;
+  const struct symbolCount *right;
 
   left = in1;
   right = in2;
 
-  if (*left > *right) {
+  if (left->symbol < right->symbol) {
     return (-1);
-  } else if (*left < *right) {
+  } else if (left->symbol > right->symbol) {
     return (1);
   } else {
     return (0);
@@ -60,8 +61,12 @@ int main(int argc, char *argv[]) {
   uint32_t *data;
   size_t k;
   int opt;
-  size_t *countList;
+  struct u32CountTable table;
+  struct symbolCount top[UINT8_MAX + 2];
+  size_t topCount;
   size_t maxSymbols;
+  uint8_t *translation;
+  struct blockWriter writer;
 
   uint32_t minVal = UINT32_MAX;
   uint32_t maxVal = 0;
@@ -114,59 +119,53 @@ int main(int argc, char *argv[]) {
   }
 
   assert(maxVal >= minVal);
-  maxSymbols = maxVal - minVal + 1;
+  maxSymbols = (size_t)(maxVal - minVal) + 1;
 
-  if ((countList = calloc(maxSymbols, sizeof(size_t))) == NULL) {
-    perror("Can't allocate memory for count list");
-    exit(EX_OSERR);
-  }
-
-  // How many times does each symbol occur?
-  for (size_t j = 0; j < datalen; j++) {
-    countList[data[j] - minVal]++;
-  }
+  // How many times does each symbol occur? Only the symbols that are present are stored, so this is independent of the range.
+  initCountTable(&table, 0);
+  countTableAdd(&table, data, datalen);
 
   // Establish the smallest count that gets an output symbol
   if (maxSymbols <= UINT8_MAX + 1) {
     countCutoff = 0;
   } else {
-    size_t *sortedCountList;
-    if ((sortedCountList = calloc(maxSymbols, sizeof(size_t))) == NULL) {
-      perror("Can't allocate memory for sorted count list");
-      exit(EX_OSERR);
-    }
-
-    // Make a copy of the count list, so we can find the count cutoff
-    memcpy(sortedCountList, countList, sizeof(size_t) * maxSymbols);
-
-    // Sort the count list from greatest to smallest
-    qsort(sortedCountList, maxSymbols, sizeof(size_t), sizetCompare);
-    assert(sortedCountList[0] >= sortedCountList[maxSymbols - 1]);
+    // Symbols that don't occur in the data have a count of 0.
+    memset(top, 0, sizeof(top));
+    topCount = countTableTopK(&table, UINT8_MAX + 2, top);
+    assert(topCount <= UINT8_MAX + 2);
 
     // Make an initial estimate for the countCutoff
-    countCutoff = sortedCountList[UINT8_MAX];
+    countCutoff = top[UINT8_MAX].count;
 
     // This may be too low if there are other symbols with this count; look at the next most common symbol to check
-    if (countCutoff == sortedCountList[UINT8_MAX + 1]) {
+    if (countCutoff == top[UINT8_MAX + 1].count) {
       // This cutoff would lead to too many symbols. Increase the cutoff.
       // Note: this results in < 256 symbols.
       countCutoff++;
     }
-    free(sortedCountList);
   }
 
   if (configVerbose > 0) fprintf(stderr, "Symbol Count Cutoff: %zu\n", countCutoff);
 
-  // Count the actual number of output symbols and change the countList to a translation array
-  k = 0;
-  for (size_t j = 0; j < maxSymbols; j++) {
-    if (countList[j] >= countCutoff) {
-      // There are a suitable number of these symbols. Its translated value is k.
-      countList[j] = k;
-      k++;
-    } else {
-      // flag this symbol as discarded
-      countList[j] = SIZE_MAX;
+  // Count the actual number of output symbols and store the translated values in the count table
+  if ((translation = malloc(table.capacity)) == NULL) {
+    perror("Can't allocate memory for translation table");
+    exit(EX_OSERR);
+  }
+
+  if (countCutoff == 0) {
+    // Every symbol in the range is retained, including those that don't occur.
+    k = maxSymbols;
+    for (size_t j = 0; j < table.capacity; j++) {
+      if (table.counts[j] != 0) translation[j] = (uint8_t)(table.symbols[j] - minVal);
+    }
+  } else {
+    // The retained symbols are all among the top 256; arrange them in order, so that the map is order-preserving.
+    for (k = 0; (k < UINT8_MAX + 1) && (top[k].count >= countCutoff); k++)
+      ;
+    qsort(top, k, sizeof(struct symbolCount), symbolCompare);
+    for (size_t j = 0; j < k; j++) {
+      translation[countTableFind(&table, top[j].symbol)] = (uint8_t)j;
     }
   }
 
@@ -179,23 +178,22 @@ int main(int argc, char *argv[]) {
   outputSize = 0;
 
   // Output the translated data
+  initBlockWriter(&writer, stdout, sizeof(uint8_t));
   for (size_t j = 0; j < datalen; j++) {
-    size_t curSymbolCount = countList[data[j] - minVal];
-    if (curSymbolCount < k) {
-      uint8_t out = (uint8_t)curSymbolCount;
-      if (fwrite(&out, sizeof(uint8_t), 1, stdout) != 1) {
-        perror("Can't write to output");
-        exit(EX_OSERR);
-      }
+    size_t slot = countTableFind(&table, data[j]);
+    if (table.counts[slot] >= countCutoff) {
+      writeElement(&writer, translation + slot);
       outputSize++;
     }
   }
+  freeBlockWriter(&writer);
 
   if (configVerbose > 0) {
     fprintf(stderr, "Total symbols output: %zu (retained %g%% of input data)\n", outputSize, 100.0 * ((double)outputSize) / ((double)datalen));
   }
 
   free(data);
-  free(countList);
+  free(translation);
+  freeCountTable(&table);
   return EX_OK;
 }
@@ -19,10 +19,10 @@
 #include <sysexits.h>
 
 #include "binio.h"
+#include "binning.h"
+#include "blockio.h"
 #include "globals-inst.h"
 #include "precision.h"
-#include "rbt_misc.h"
-#include "red_black_tree.h"
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
@@ -36,13 +36,19 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  uint32_t *data = NULL;
   size_t i;
   int curarg;
   size_t bounds;
   size_t datalen;
   int64_t cutoffs[255];
   int64_t lowbound;
+  uint32_t binCutoffs[BININDEX_MAXCUTOFFS];
+  size_t fileSize;
+  struct binIndex index;
+  struct blockReader reader;
+  struct blockWriter writer;
+  const uint32_t *block;
+  size_t blockLen;
 
   for (i = 0; i < 255; i++) cutoffs[i] = -1;
   // The total number of bins must <= 256, so
@@ -83,38 +89,52 @@ int main(int argc, char *argv[]) {
   }
   fprintf(stderr, "[ %ld, %ld ]\n", cutoffs[bounds - 1], (int64_t)UINT32_MAX);
 
-  datalen = readuint32file(infp, &data);
+  fileSize = getfilesize(infp);
+  if ((fileSize % sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+
+  datalen = fileSize / sizeof(uint32_t);
   if (datalen < 2) {
     useageExit();
   }
 
-  assert(data != NULL);
-
   fprintf(stderr, "Read in %zu samples\n", datalen);
-  if (fclose(infp) != 0) {
-    perror("Can't close input file");
-    exit(EX_OSERR);
+
+  for (i = 0; i < bounds; i++) {
+    binCutoffs[i] = (uint32_t)cutoffs[i];
   }
+  initBinIndex(&index, binCutoffs, bounds);
 
   fprintf(stderr, "Outputting the data...\n");
-  for (i = 0; i < datalen; i++) {
-    // set this to the last valid symbol
-    uint8_t symbol = (uint8_t)bounds;
-    for (uint8_t j = 0; j < bounds; j++) {
-      if (cutoffs[j] > data[i]) {
-        symbol = j;
-        break;
-      }
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint8_t));
+  while ((blockLen = readBlock(&reader, (const void **)&block)) > 0) {
+    size_t done = 0;
+
+    while (done < blockLen) {
+      size_t outLen;
+      uint8_t *out = reserveElements(&writer, &outLen);
+
+      if (outLen > blockLen - done) outLen = blockLen - done;
+      binValues(&index, block + done, out, outLen);
+      commitElements(&writer, outLen);
+      done += outLen;
     }
+  }
+  freeBlockReader(&reader);
+  freeBlockWriter(&writer);
 
-    assert(symbol <= bounds);
+  if (fclose(infp) != 0) {
+    perror("Can't close input file");
+    exit(EX_OSERR);
+  }
 
-    if (fwrite(&symbol, sizeof(uint8_t), 1, stdout) != 1) {
-      perror("Can't write output to stdout");
-      exit(EX_OSERR);
-    }
+  fprintf(stderr, "Bin counts: ");
+  for (i = 0; i <= bounds; i++) {
+    fprintf(stderr, "%zu%s", index.counts[i], (i < bounds) ? ", " : "\n");
   }
 
-  free(data);
+  freeBinIndex(&index);
   return EX_OK;
 }
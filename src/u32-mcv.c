@@ -8,6 +8,7 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <assert.h>
+#include <getopt.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,63 +18,90 @@
 #include <sysexits.h>
 #include <math.h>
 
-#include "binio.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
 #include "fancymath.h"
-
-static int uintcompare(const void *in1, const void *in2) {
-  const uint32_t *left;
-  const uint32_t *right;
-
-  left = in1;
-  right = in2;
-
-  if (*left < *right) {
-    return (-1);
-  } else if (*left > *right) {
-    return (1);
-  } else {
-    return (0);
-  }
-}
+#include "frequency.h"
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, "u32-mcv <inputfile>\n");
+  fprintf(stderr, "u32-mcv [-s counters] <inputfile>\n");
   fprintf(stderr, "inputfile is assumed to be a stream of uint32_ts\n");
+  fprintf(stderr, "-s counters\tEstimate the most common symbol count using a Space-Saving sketch with this many counters, rather than counting exactly.\n");
+  fprintf(stderr, "\t\tThe reported count is an upper bound, so the resulting estimate is conservative.\n");
   exit(EX_USAGE);
 }
 
 int main(int argc, char *argv[]) {
   FILE *infp;
   size_t datalen;
-  uint32_t *data = NULL;
+  const uint32_t *block;
+  size_t blockCount;
+  struct blockReader reader;
+  struct u32CountTable table;
+  struct spaceSaving sketch;
+  struct symbolCount mostCommon;
+  size_t sketchCounters = 0;
+  unsigned long long inint;
   size_t maxSymbolCount = 0;
   uint32_t MLS = 0;
-  size_t curSymbolCount = 0;
   size_t k = 0;
-  uint32_t curSymbol;
+  int opt;
   double pu;
   double phat;
 
-  if (argc != 2) {
+  while ((opt = getopt(argc, argv, "s:")) != -1) {
+    switch (opt) {
+      case 's':
+        inint = strtoull(optarg, NULL, 0);
+        if ((inint == 0) || (inint > SIZE_MAX / sizeof(size_t))) {
+          useageExit();
+        }
+        sketchCounters = (size_t)inint;
+        break;
+      default: /* ? */
+        useageExit();
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc != 1) {
     useageExit();
   }
 
-  if ((infp = fopen(argv[1], "rb")) == NULL) {
+  if ((infp = fopen(argv[0], "rb")) == NULL) {
     perror("Can't open file");
     exit(EX_NOINPUT);
   }
 
-  if ((datalen = readuint32file(infp, &data)) < 1) {
+  // Count the symbols as the data is read, rather than holding (and sorting) the whole file.
+  if (sketchCounters > 0) {
+    initSpaceSaving(&sketch, sketchCounters);
+  } else {
+    initCountTable(&table, 0);
+  }
+
+  datalen = 0;
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((blockCount = readBlock(&reader, (const void **)&block)) > 0) {
+    if (sketchCounters > 0) {
+      spaceSavingAdd(&sketch, block, blockCount);
+    } else {
+      countTableAdd(&table, block, blockCount);
+    }
+    datalen += blockCount;
+  }
+  freeBlockReader(&reader);
+
+  if (datalen < 1) {
     perror("Data file is empty");
     exit(EX_DATAERR);
   }
 
-  assert(data != NULL);
-
   fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
   assert(datalen > 0);
 
@@ -82,36 +110,26 @@ int main(int argc, char *argv[]) {
     exit(EX_OSERR);
   }
 
-  //Sort the data
-  qsort(data, datalen, sizeof(uint32_t), uintcompare);
-
-  MLS = curSymbol = data[0];
-  curSymbolCount = 1;
-
-  for(size_t j=1; j<datalen; j++) {
-    if(data[j] == curSymbol) {
-       curSymbolCount ++;
-    } else {
-       //This is a transition.
-       k++;
-       if(curSymbolCount > maxSymbolCount) {
-          maxSymbolCount = curSymbolCount;
-          MLS = curSymbol;
-       }
-
-       curSymbolCount = 1;
-       curSymbol = data[j];
-    }
-  }
-  //This is a transition.
-  k++;
-  if(curSymbolCount > maxSymbolCount) {
-    maxSymbolCount = curSymbolCount;
-    MLS = curSymbol;
+  // Ties go to the smallest symbol.
+  if (sketchCounters > 0) {
+    k = sketch.size;
+    spaceSavingTopK(&sketch, 1, &mostCommon);
+    freeSpaceSaving(&sketch);
+  } else {
+    k = table.distinct;
+    countTableTopK(&table, 1, &mostCommon);
+    freeCountTable(&table);
   }
+  MLS = mostCommon.symbol;
+  maxSymbolCount = mostCommon.count;
 
-  fprintf(stderr, "Encountered %zu distinct symbols.\n", k);
-  fprintf(stderr, "Most common symbol is 0x%08X (count %zu)\n", MLS, maxSymbolCount);
+  if (sketchCounters > 0) {
+    fprintf(stderr, "Tracked %zu symbols using %zu counters.\n", k, sketchCounters);
+    fprintf(stderr, "Most common symbol is 0x%08X (count at most %zu, at least %zu)\n", MLS, maxSymbolCount, maxSymbolCount - mostCommon.error);
+  } else {
+    fprintf(stderr, "Encountered %zu distinct symbols.\n", k);
+    fprintf(stderr, "Most common symbol is 0x%08X (count %zu)\n", MLS, maxSymbolCount);
+  }
 
   phat=((double)maxSymbolCount) / ((double)datalen);
   // Note, this is the raw value. A larger value maps to a more conservative estimate, so we then look at upper confidence interval bound.
@@ -129,7 +147,5 @@ int main(int argc, char *argv[]) {
   fprintf(stderr, "p_hat = %.17g\n", phat);
   fprintf(stderr, "p_u = %.17g\n", pu);
   fprintf(stderr, "minentropy = %.17g\n", -log2(pu));
-  free(data);
-
   return EX_OK;
 }
@@ -0,0 +1,502 @@
+/* This file is part of the Theseus distribution.
+ * Copyright 2020 Joshua E. Hill <josh@keypair.us>
+ *
+ * Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+ *
+ * Author(s)
+ * Joshua E. Hill, UL VS LLC.
+ * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+ */
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include "binio.h"
+#include "binutil.h"
+#include "blockio.h"
+#include "convert.h"
+#include "entlib.h"
+#include "globals-inst.h"
+#include "precision.h"
+
+/*Element-wise stages are applied to chunks of this many elements, so that each chunk stays in cache across all the fused stages.*/
+#define PIPELINECHUNK 16384
+
+enum dataWidth { WIDTH_U64, WIDTH_U32, WIDTH_SD };
+
+enum stageKind {
+  // Element-wise stages (fused together and run in parallel across chunks)
+  STAGE_REVERSE64,
+  STAGE_TRUNCATE,
+  STAGE_REVERSE,
+  STAGE_AND,
+  STAGE_SELECT,
+  STAGE_EXPAND,
+  STAGE_BIT,
+  STAGE_TOSD,
+  // Whole-stream stages (each acts as a barrier)
+  STAGE_JENTDELTA,
+  STAGE_XORDIFF,
+  STAGE_DELTA,
+  STAGE_DOWNSAMPLE,
+  STAGE_TRANSLATE,
+  STAGE_SERIALXOR
+};
+
+struct stage {
+  enum stageKind kind;
+  enum dataWidth inWidth;
+  enum dataWidth outWidth;
+  bool elementWise;
+  uint32_t mask;
+  size_t param;
+  size_t blockSize;
+};
+
+static const size_t widthBytes[] = {sizeof(uint64_t), sizeof(uint32_t), sizeof(statData_t)};
+static const char *const widthNames[] = {"uint64_t", "uint32_t", STATDATA_STRING};
+
+noreturn static void useageExit(void) {
+  fprintf(stderr, "Usage:\n");
+  fprintf(stderr, "u32-pipeline [-v] [-u] <inputfile> <stage> [<stage> ...]\n");
+  fprintf(stderr, "Applies a sequence of conversion stages within a single process.\n");
+  fprintf(stderr, "<inputfile>\tThe input data, presumed to be uint32_t (or uint64_t with -u). Use \"-\" for stdin.\n");
+  fprintf(stderr, "-u\tThe input is uint64_t. It is narrowed to uint32_t (with a range check) by the first uint32_t stage.\n");
+  fprintf(stderr, "-v\tVerbose mode.\n");
+  fprintf(stderr, "uint64_t stages:\n");
+  fprintf(stderr, "  jent-delta\tConvert jent format deltas to nanoseconds (as u64-jent-to-delta).\n");
+  fprintf(stderr, "  reverse64\tReverse the byte order of each value.\n");
+  fprintf(stderr, "  truncate\tNarrow to uint32_t, failing if any value is out of range (as u64-to-u32).\n");
+  fprintf(stderr, "uint32_t stages:\n");
+  fprintf(stderr, "  reverse\tReverse the byte order of each value.\n");
+  fprintf(stderr, "  and:<mask>\tAND each value with <mask>.\n");
+  fprintf(stderr, "  select:<mask>\tExtract and pack the bits of each value selected by <mask> (as extractbits).\n");
+  fprintf(stderr, "  expand:<mask>\tDeposit the low bits of each value into the positions set in <mask>.\n");
+  fprintf(stderr, "  bit:<n>\tOutput bit <n> of each value (0 is the lsb, 31 is msb).\n");
+  fprintf(stderr, "  xor-diff\tXOR adjacent values (as u32-xor-diff).\n");
+  fprintf(stderr, "  delta\tExtract deltas and translate them to positive values (as u32-delta).\n");
+  fprintf(stderr, "  downsample:<rate>[:<block size>]\tGroup the data by index mod <rate> (as u32-downsample, default block size 1000000).\n");
+  fprintf(stderr, "  translate\tPerform an order-preserving map to (0, ..., k-1) (as u32-translate-data).\n");
+  fprintf(stderr, "  to-sd\tNarrow to " STATDATA_STRING ", failing if any value is out of range (as u32-to-sd).\n");
+  fprintf(stderr, STATDATA_STRING " stages:\n");
+  fprintf(stderr, "  serial-xor:<c>\tXOR each non-overlapping group of <c> values together.\n");
+  fprintf(stderr, "Runs of element-wise stages are fused and processed in parallel across chunks.\n");
+  fprintf(stderr, "The output is sent to stdout, in the width produced by the last stage.\n");
+  exit(EX_USAGE);
+}
+
+static size_t parseParameter(const char *param, size_t max) {
+  unsigned long long inint;
+  char *nextOption;
+
+  if ((param == NULL) || (*param == '\0')) {
+    useageExit();
+  }
+
+  errno = 0;
+  inint = strtoull(param, &nextOption, 0);
+  if ((errno != 0) || ((*nextOption != '\0') && (*nextOption != ':')) || (inint > max)) {
+    useageExit();
+  }
+
+  return (size_t)inint;
+}
+
+static void parseStage(const char *spec, struct stage *curStage) {
+  const char *param;
+  size_t nameLen;
+
+  param = strchr(spec, ':');
+  nameLen = (param == NULL) ? strlen(spec) : (size_t)(param - spec);
+  if (param != NULL) param++;
+
+  curStage->elementWise = true;
+  curStage->inWidth = WIDTH_U32;
+  curStage->outWidth = WIDTH_U32;
+  curStage->mask = 0;
+  curStage->param = 0;
+  curStage->blockSize = 0;
+
+#define STAGENAME(name) ((nameLen == strlen(name)) && (strncmp(spec, name, nameLen) == 0))
+  if (STAGENAME("jent-delta")) {
+    curStage->kind = STAGE_JENTDELTA;
+    curStage->inWidth = curStage->outWidth = WIDTH_U64;
+    curStage->elementWise = false;
+  } else if (STAGENAME("reverse64")) {
+    curStage->kind = STAGE_REVERSE64;
+    curStage->inWidth = curStage->outWidth = WIDTH_U64;
+  } else if (STAGENAME("truncate")) {
+    curStage->kind = STAGE_TRUNCATE;
+    curStage->inWidth = WIDTH_U64;
+  } else if (STAGENAME("reverse")) {
+    curStage->kind = STAGE_REVERSE;
+  } else if (STAGENAME("and")) {
+    curStage->kind = STAGE_AND;
+    curStage->mask = (uint32_t)parseParameter(param, UINT32_MAX);
+  } else if (STAGENAME("select")) {
+    curStage->kind = STAGE_SELECT;
+    curStage->mask = (uint32_t)parseParameter(param, UINT32_MAX);
+  } else if (STAGENAME("expand")) {
+    curStage->kind = STAGE_EXPAND;
+    curStage->mask = (uint32_t)parseParameter(param, UINT32_MAX);
+  } else if (STAGENAME("bit")) {
+    curStage->kind = STAGE_BIT;
+    curStage->mask = 1U << parseParameter(param, 31);
+  } else if (STAGENAME("to-sd")) {
+    curStage->kind = STAGE_TOSD;
+    curStage->outWidth = WIDTH_SD;
+  } else if (STAGENAME("xor-diff")) {
+    curStage->kind = STAGE_XORDIFF;
+    curStage->elementWise = false;
+  } else if (STAGENAME("delta")) {
+    curStage->kind = STAGE_DELTA;
+    curStage->elementWise = false;
+  } else if (STAGENAME("downsample")) {
+    curStage->kind = STAGE_DOWNSAMPLE;
+    curStage->elementWise = false;
+    curStage->param = parseParameter(param, UINT32_MAX);
+    param = strchr(param, ':');
+    curStage->blockSize = (param == NULL) ? 1000000 : parseParameter(param + 1, SIZE_MAX);
+    if ((curStage->param == 0) || (curStage->blockSize == 0)) useageExit();
+  } else if (STAGENAME("translate")) {
+    curStage->kind = STAGE_TRANSLATE;
+    curStage->elementWise = false;
+  } else if (STAGENAME("serial-xor")) {
+    curStage->kind = STAGE_SERIALXOR;
+    curStage->inWidth = curStage->outWidth = WIDTH_SD;
+    curStage->elementWise = false;
+    curStage->param = parseParameter(param, SIZE_MAX);
+    if (curStage->param == 0) useageExit();
+  } else {
+    fprintf(stderr, "Unknown stage: %s\n", spec);
+    useageExit();
+  }
+#undef STAGENAME
+}
+
+/*Read the entire stream, which need not be seekable.*/
+static size_t readStream(FILE *input, size_t elementSize, void **buffer) {
+  struct blockReader reader;
+  const void *block;
+  size_t count;
+  size_t datalen;
+  size_t allocated;
+  uint8_t *data;
+
+  data = NULL;
+  datalen = 0;
+  allocated = 0;
+
+  initBlockReader(&reader, input, elementSize, true);
+  while ((count = readBlock(&reader, &block)) > 0) {
+    if (datalen + count > allocated) {
+      allocated = (allocated == 0) ? count : allocated;
+      while (datalen + count > allocated) allocated *= 2;
+      if ((data = realloc(data, allocated * elementSize)) == NULL) {
+        perror("Can't allocate input buffer");
+        exit(EX_OSERR);
+      }
+    }
+    memcpy(data + datalen * elementSize, block, count * elementSize);
+    datalen += count;
+  }
+  freeBlockReader(&reader);
+
+  *buffer = data;
+  return datalen;
+}
+
+static uint64_t loadElement(const void *data, enum dataWidth width, size_t index) {
+  switch (width) {
+    case WIDTH_U64:
+      return ((const uint64_t *)data)[index];
+    case WIDTH_U32:
+      return ((const uint32_t *)data)[index];
+    case WIDTH_SD:
+      return ((const statData_t *)data)[index];
+    default:
+      assert(false);
+      return 0;
+  }
+}
+
+static void storeElement(void *data, enum dataWidth width, size_t index, uint64_t value) {
+  switch (width) {
+    case WIDTH_U64:
+      ((uint64_t *)data)[index] = value;
+      break;
+    case WIDTH_U32:
+      ((uint32_t *)data)[index] = (uint32_t)value;
+      break;
+    case WIDTH_SD:
+      ((statData_t *)data)[index] = (statData_t)value;
+      break;
+    default:
+      assert(false);
+  }
+}
+
+/*Apply a fused run of element-wise stages to one chunk, in place. Returns the index within the chunk of the first
+ *value that is out of range for a narrowing stage, or count if all values are in range.*/
+static size_t applyElementStages(uint64_t *chunk, size_t count, const struct stage *stages, size_t stageCount) {
+  size_t i;
+  size_t j;
+
+  for (j = 0; j < stageCount; j++) {
+    switch (stages[j].kind) {
+      case STAGE_REVERSE64:
+        for (i = 0; i < count; i++) chunk[i] = reverse64(chunk[i]);
+        break;
+      case STAGE_TRUNCATE:
+        for (i = 0; i < count; i++) {
+          if (chunk[i] > UINT32_MAX) return i;
+        }
+        break;
+      case STAGE_REVERSE:
+        for (i = 0; i < count; i++) chunk[i] = reverse32((uint32_t)chunk[i]);
+        break;
+      case STAGE_AND:
+        for (i = 0; i < count; i++) chunk[i] &= stages[j].mask;
+        break;
+      case STAGE_SELECT:
+        for (i = 0; i < count; i++) chunk[i] = extractbits((uint32_t)chunk[i], stages[j].mask);
+        break;
+      case STAGE_EXPAND:
+        for (i = 0; i < count; i++) chunk[i] = expandBits((uint32_t)chunk[i], stages[j].mask);
+        break;
+      case STAGE_BIT:
+        for (i = 0; i < count; i++) chunk[i] = ((chunk[i] & stages[j].mask) == 0) ? 0U : 1U;
+        break;
+      case STAGE_TOSD:
+        for (i = 0; i < count; i++) {
+          if (chunk[i] > STATDATA_MAX) return i;
+        }
+        break;
+      case STAGE_JENTDELTA:
+      case STAGE_XORDIFF:
+      case STAGE_DELTA:
+      case STAGE_DOWNSAMPLE:
+      case STAGE_TRANSLATE:
+      case STAGE_SERIALXOR:
+      default:
+        assert(false);
+    }
+  }
+
+  return count;
+}
+
+/*Run a fused sequence of element-wise stages over the whole data set, with the chunks processed in parallel.
+ *Returns the resulting data, which is in outWidth (and replaces the input, which is freed if necessary).*/
+static void *runElementStages(void *data, size_t datalen, enum dataWidth inWidth, enum dataWidth outWidth, const struct stage *stages, size_t stageCount) {
+  void *output;
+  size_t chunkCount;
+  size_t badIndex;
+
+  if (inWidth == outWidth) {
+    output = data;
+  } else if ((output = malloc(datalen * widthBytes[outWidth])) == NULL) {
+    perror("Can't allocate output buffer");
+    exit(EX_OSERR);
+  }
+
+  chunkCount = (datalen + PIPELINECHUNK - 1) / PIPELINECHUNK;
+  badIndex = SIZE_MAX;
+
+#pragma omp parallel
+  {
+    uint64_t *chunk;
+
+    if ((chunk = malloc(sizeof(uint64_t) * PIPELINECHUNK)) == NULL) {
+      perror("Can't allocate chunk buffer");
+      exit(EX_OSERR);
+    }
+
+#pragma omp for
+    for (size_t c = 0; c < chunkCount; c++) {
+      size_t start = c * PIPELINECHUNK;
+      size_t count = (datalen - start < PIPELINECHUNK) ? (datalen - start) : PIPELINECHUNK;
+      size_t processed;
+
+      for (size_t i = 0; i < count; i++) chunk[i] = loadElement(data, inWidth, start + i);
+
+      processed = applyElementStages(chunk, count, stages, stageCount);
+      if (processed < count) {
+#pragma omp critical(badIndexUpdate)
+        {
+          if (start + processed < badIndex) badIndex = start + processed;
+        }
+      } else {
+        for (size_t i = 0; i < count; i++) storeElement(output, outWidth, start + i, chunk[i]);
+      }
+    }
+
+    free(chunk);
+  }
+
+  if (badIndex != SIZE_MAX) {
+    fprintf(stderr, "Value %" PRIu64 " at index %zu is out of range\n", loadElement(data, inWidth, badIndex), badIndex);
+    exit(EX_DATAERR);
+  }
+
+  if (output != data) free(data);
+  return output;
+}
+
+static size_t runStreamStage(void *data, size_t datalen, const struct stage *curStage) {
+  size_t k;
+
+  switch (curStage->kind) {
+    case STAGE_JENTDELTA:
+      jentDeltaToNanoseconds(data, datalen);
+      return datalen;
+    case STAGE_XORDIFF:
+      return u32XORDiff(data, datalen);
+    case STAGE_DELTA:
+      return u32DeltaTranslate(data, datalen);
+    case STAGE_DOWNSAMPLE:
+      return u32Downsample(data, datalen, (uint32_t)curStage->param, curStage->blockSize);
+    case STAGE_TRANSLATE:
+      u32translate(data, datalen, &k);
+      if (configVerbose > 0) fprintf(stderr, "Found %zu symbols\n", k);
+      return datalen;
+    case STAGE_SERIALXOR:
+      return serialXOR(data, datalen, curStage->param);
+    case STAGE_REVERSE64:
+    case STAGE_TRUNCATE:
+    case STAGE_REVERSE:
+    case STAGE_AND:
+    case STAGE_SELECT:
+    case STAGE_EXPAND:
+    case STAGE_BIT:
+    case STAGE_TOSD:
+    default:
+      assert(false);
+      return datalen;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  FILE *infp;
+  struct stage *stages;
+  size_t stageCount;
+  size_t datalen;
+  void *data;
+  enum dataWidth width;
+  enum dataWidth runWidth;
+  bool configU64;
+  size_t runStart;
+  size_t j;
+  int opt;
+
+  configVerbose = 0;
+  configU64 = false;
+  data = NULL;
+
+  while ((opt = getopt(argc, argv, "vu")) != -1) {
+    switch (opt) {
+      case 'v':
+        configVerbose++;
+        break;
+      case 'u':
+        configU64 = true;
+        break;
+      default: /* ? */
+        useageExit();
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc < 2) {
+    useageExit();
+  }
+
+  // Parse the stages, inserting the implicit uint64_t to uint32_t narrowing where a uint32_t stage follows uint64_t data.
+  if ((stages = malloc(sizeof(struct stage) * (size_t)(2 * (argc - 1)))) == NULL) {
+    perror("Can't allocate stage list");
+    exit(EX_OSERR);
+  }
+
+  width = configU64 ? WIDTH_U64 : WIDTH_U32;
+  stageCount = 0;
+  for (int i = 1; i < argc; i++) {
+    parseStage(argv[i], stages + stageCount);
+    if ((width == WIDTH_U64) && (stages[stageCount].inWidth == WIDTH_U32)) {
+      stages[stageCount + 1] = stages[stageCount];
+      parseStage("truncate", stages + stageCount);
+      stageCount++;
+      width = WIDTH_U32;
+    }
+    if (stages[stageCount].inWidth != width) {
+      fprintf(stderr, "Stage %s expects %s data, but is provided %s data\n", argv[i], widthNames[stages[stageCount].inWidth], widthNames[width]);
+      exit(EX_USAGE);
+    }
+    width = stages[stageCount].outWidth;
+    stageCount++;
+  }
+
+  width = configU64 ? WIDTH_U64 : WIDTH_U32;
+  if (strcmp(argv[0], "-") == 0) {
+    datalen = readStream(stdin, widthBytes[width], &data);
+  } else {
+    if ((infp = fopen(argv[0], "rb")) == NULL) {
+      perror("Can't open file");
+      exit(EX_NOINPUT);
+    }
+
+    if (configU64) {
+      datalen = readuint64file(infp, (uint64_t **)&data);
+    } else {
+      datalen = readuint32file(infp, (uint32_t **)&data);
+    }
+
+    if (fclose(infp) != 0) {
+      perror("Couldn't close input data file");
+      exit(EX_OSERR);
+    }
+  }
+
+  if ((datalen == 0) || (data == NULL)) {
+    fprintf(stderr, "Data file is empty\n");
+    exit(EX_DATAERR);
+  }
+
+  if (configVerbose > 0) fprintf(stderr, "Read in %zu %ss\n", datalen, widthNames[width]);
+
+  for (j = 0; j < stageCount;) {
+    if (stages[j].elementWise) {
+      runStart = j;
+      runWidth = width;
+      while ((j < stageCount) && stages[j].elementWise) {
+        width = stages[j].outWidth;
+        j++;
+      }
+      if (configVerbose > 0) fprintf(stderr, "Running %zu fused element-wise stages\n", j - runStart);
+      data = runElementStages(data, datalen, runWidth, width, stages + runStart, j - runStart);
+    } else {
+      datalen = runStreamStage(data, datalen, stages + j);
+      if (configVerbose > 0) fprintf(stderr, "Stage %zu leaves %zu %ss\n", j + 1, datalen, widthNames[width]);
+      j++;
+    }
+  }
+
+  if (fwrite(data, widthBytes[width], datalen, stdout) != datalen) {
+    perror("Can't write output to stdout");
+    exit(EX_OSERR);
+  }
+
+  free(stages);
+  free(data);
+  return EX_OK;
+}
@@ -7,6 +7,7 @@
  * Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
  */
 #include <assert.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <math.h>
 #include <stdbool.h>
@@ -20,6 +21,7 @@
 
 #include "binio.h"
 #include "randlib.h"
+#include "sampling.h"
 #include "globals-inst.h"
 
 noreturn static void useageExit(void) {
@@ -33,9 +35,8 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  uint32_t *data = NULL;
   uint32_t *outputData = NULL;
-  size_t datalen;
+  uint64_t datalen;
   size_t outputDataLen;
   struct randstate rstate;
   unsigned long long inint;
@@ -58,31 +59,24 @@ int main(int argc, char *argv[]) {
   }
   outputDataLen = (size_t)inint;
 
-  datalen = readuint32file(infp, &data);
+  if ((outputData = malloc(outputDataLen * sizeof(uint32_t))) == NULL) {
+    perror("Can't allocate array for output data");
+    exit(EX_OSERR);
+  }
+
+  // The input is streamed rather than read into memory, so only the sample itself need fit in memory.
+  fprintf(stderr, "Randomly selecting data\n");
+  datalen = sampleBinaryFile(infp, sizeof(uint32_t), outputData, outputDataLen, &rstate);
   if (datalen < 1) {
     useageExit();
   }
 
-  assert(data != NULL);
-
-  fprintf(stderr, "Read in %zu samples\n", datalen);
+  fprintf(stderr, "Sampled from %" PRIu64 " samples\n", datalen);
   if (fclose(infp) != 0) {
     perror("Can't close input file");
     exit(EX_OSERR);
   }
 
-  if ((outputData = malloc(outputDataLen * sizeof(uint32_t))) == NULL) {
-      perror("Can't allocate array for output data");
-      exit(EX_OSERR);
-  }
-
-  fprintf(stderr, "Randomly selecting data\n");
-  for(size_t i = 0; i < outputDataLen; i++) {
-    outputData[i] = data[randomRange64(datalen-1, &rstate)];
-  }
-  free(data);
-
-
   fprintf(stderr, "Outputting the data...\n");
   if (fwrite(outputData, sizeof(uint32_t), outputDataLen, stdout) != outputDataLen) {
     perror("Can't write output to stdout");
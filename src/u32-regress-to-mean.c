@@ -30,14 +30,31 @@ noreturn static void useageExit(void) {
   exit(EX_USAGE);
 }
 
+// Target number of samples read and adjusted at once; this is rounded to a whole number of k-blocks.
+#define REGRESSCHUNK (((size_t)1) << 22)
+
+struct blockAdjustment {
+  long double localMean;
+  long double localDelta;
+  uint64_t localSum;
+  uint32_t localMin;
+  uint32_t localMax;
+  int64_t integerAdjust;
+};
+
 int main(int argc, char *argv[]) {
   FILE *infp;
+  size_t fileSize;
   size_t datalen;
   uint32_t *data = NULL;
-  long double globalMean = 0.0L;
+  struct blockAdjustment *adjustments = NULL;
+  unsigned __int128 globalSum;
+  long double globalMean;
   char *nextc;
   size_t k;
   size_t blockCount;
+  size_t chunkBlocks;
+  size_t block;
 
   if (argc != 3) {
     useageExit();
@@ -48,21 +65,21 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  if ((datalen = readuint32file(infp, &data)) < 1) {
+  fileSize = getfilesize(infp);
+  if ((fileSize % sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+
+  if ((datalen = fileSize / sizeof(uint32_t)) < 1) {
     useageExit();
   }
 
-  assert(data != NULL);
   k = strtoul(argv[2], &nextc, 0);
-  if (*nextc != '\0') {
+  if ((*nextc != '\0') || (k == 0)) {
     useageExit();
   }
 
   fprintf(stderr, "Read in %zu uint32_ts\n", datalen);
-  if (fclose(infp) != 0) {
-    perror("Can't close intput file");
-    exit(EX_OSERR);
-  }
 
   // Make k divide datalen. (discard other data)
   blockCount = datalen / k;
@@ -70,53 +87,123 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "Processing %zu blocks of %zu samples each.\n", blockCount, k);
 
-  // Calculate the global mean
-  for (size_t i = 0; i < datalen; i++) {
-    globalMean += (long double)data[i];
+  if (blockCount == 0) {
+    fprintf(stderr, "Too little data\n");
+    exit(EX_DATAERR);
   }
-  globalMean /= (long double)datalen;  // 0 <= globalMean <= UINT32_MAX
-  fprintf(stderr, "Global mean is %.22Lg.\n", globalMean);
 
-  for (size_t i = 0; i < blockCount; i++) {
-    long double localMean = 0.0L;
-    long double localDelta;
+  chunkBlocks = REGRESSCHUNK / k;
+  if (chunkBlocks == 0) chunkBlocks = 1;
+  if (chunkBlocks > blockCount) chunkBlocks = blockCount;
 
-    // Calculate the local mean and the necessary delta to fixup the local data.
-    for (size_t j = 0; j < k; j++) {
-      localMean += (long double)data[i * k + j];
+  if ((data = malloc(chunkBlocks * k * sizeof(uint32_t))) == NULL) {
+    perror("Can't allocate data buffer");
+    exit(EX_OSERR);
+  }
+
+  if ((adjustments = malloc(chunkBlocks * sizeof(struct blockAdjustment))) == NULL) {
+    perror("Can't allocate adjustment buffer");
+    exit(EX_OSERR);
+  }
+
+  /*Pass 1: Calculate the global mean.
+   *The sums are of integers, so they are accumulated exactly (and so independently of the order of the additions).
+   */
+  globalSum = 0;
+  for (block = 0; block < blockCount; block += chunkBlocks) {
+    size_t chunkLen = (((blockCount - block) < chunkBlocks) ? (blockCount - block) : chunkBlocks) * k;
+
+    if (fread(data, sizeof(uint32_t), chunkLen, infp) != chunkLen) {
+      perror("Can't read input file");
+      exit(EX_OSERR);
     }
-    localMean /= (long double)k;  // 0 <= localMean <= UINT32_MAX
 
-    localDelta = globalMean - localMean;
+#pragma omp parallel for reduction(+ : globalSum)
+    for (size_t i = 0; i < chunkLen; i++) {
+      globalSum += data[i];
+    }
+  }
+
+  globalMean = (long double)globalSum / (long double)datalen;  // 0 <= globalMean <= UINT32_MAX
+  fprintf(stderr, "Global mean is %.22Lg.\n", globalMean);
+
+  if (fseek(infp, 0, SEEK_SET) != 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
+  }
+  clearerr(infp);
+
+  // Pass 2: Adjust each k-block, a chunk of blocks at a time.
+  for (block = 0; block < blockCount; block += chunkBlocks) {
+    size_t curBlocks = ((blockCount - block) < chunkBlocks) ? (blockCount - block) : chunkBlocks;
+
+    if (fread(data, sizeof(uint32_t), curBlocks * k, infp) != curBlocks * k) {
+      perror("Can't read input file");
+      exit(EX_OSERR);
+    }
 
-    if (roundl(fabsl(localDelta)) >= 1.0L) {
-      long double newLocalMean = 0.0L;
-      int64_t integerAdjust = (int64_t)roundl(localDelta);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < curBlocks; i++) {
+      uint64_t localSum = 0;
+      uint32_t localMin = UINT32_MAX;
+      uint32_t localMax = 0;
+      const uint32_t *blockData = data + i * k;
 
-      // Rewrite the data block.
+      // Calculate the local mean and the necessary delta to fixup the local data.
       for (size_t j = 0; j < k; j++) {
-        int64_t newdata = (int64_t)data[i * k + j] + integerAdjust;
-        assert(newdata >= 0);
-        assert(newdata <= UINT32_MAX);
-        data[i * k + j] = (uint32_t)newdata;
-        newLocalMean += (long double)newdata;
+        localSum += blockData[j];
+        if (blockData[j] < localMin) localMin = blockData[j];
+        if (blockData[j] > localMax) localMax = blockData[j];
       }
-      newLocalMean /= (long double)k;  // 0 <= newLocalMean <= UINT32_MAX
+      adjustments[i].localMean = (long double)localSum / (long double)k;  // 0 <= localMean <= UINT32_MAX
+      adjustments[i].localDelta = globalMean - adjustments[i].localMean;
+      adjustments[i].localSum = localSum;
+      adjustments[i].localMin = localMin;
+      adjustments[i].localMax = localMax;
+      adjustments[i].integerAdjust = (roundl(fabsl(adjustments[i].localDelta)) >= 1.0L) ? (int64_t)roundl(adjustments[i].localDelta) : 0;
+    }
+
+    // Check and report the adjustments in order.
+    for (size_t i = 0; i < curBlocks; i++) {
+      if (adjustments[i].integerAdjust != 0) {
+        long double newLocalMean;
+
+        assert((int64_t)adjustments[i].localMin + adjustments[i].integerAdjust >= 0);
+        assert((int64_t)adjustments[i].localMax + adjustments[i].integerAdjust <= UINT32_MAX);
+
+        newLocalMean = (long double)((int64_t)adjustments[i].localSum + (int64_t)k * adjustments[i].integerAdjust) / (long double)k;  // 0 <= newLocalMean <= UINT32_MAX
 
-      fprintf(stderr, "Adjusting block %zu by %ld: Block mean: %.22Lg (delta: %.22Lg) -> %.22Lg (delta: %.22Lg)\n", i, integerAdjust, localMean, fabsl(localDelta), newLocalMean, fabsl(globalMean - newLocalMean));
+        fprintf(stderr, "Adjusting block %zu by %ld: Block mean: %.22Lg (delta: %.22Lg) -> %.22Lg (delta: %.22Lg)\n", block + i, adjustments[i].integerAdjust, adjustments[i].localMean, fabsl(adjustments[i].localDelta), newLocalMean, fabsl(globalMean - newLocalMean));
 
-      assert(fabsl(globalMean - newLocalMean) <= fabsl(localDelta));
+        assert(fabsl(globalMean - newLocalMean) <= fabsl(adjustments[i].localDelta));
+      }
+    }
+
+    // Rewrite the data blocks.
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < curBlocks; i++) {
+      uint32_t *blockData = data + i * k;
+      uint32_t integerAdjust = (uint32_t)adjustments[i].integerAdjust;  // Two's complement, so the addition wraps to the adjusted value.
+
+      if (adjustments[i].integerAdjust != 0) {
+        for (size_t j = 0; j < k; j++) {
+          blockData[j] += integerAdjust;
+        }
+      }
+    }
+
+    if (fwrite(data, sizeof(uint32_t), curBlocks * k, stdout) != curBlocks * k) {
+      perror("Can't write to stdout");
+      exit(EX_OSERR);
     }
   }
 
-  if (fwrite(data, sizeof(uint32_t), datalen, stdout) != datalen) {
-    if (data != NULL) free(data);
-    data = NULL;
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
-  if (data != NULL) free(data);
-  data = NULL;
+  free(adjustments);
+  free(data);
   return (0);
 }
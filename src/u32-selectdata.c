@@ -19,6 +19,7 @@
 #include <sysexits.h>
 
 #include "binio.h"
+#include "blockio.h"
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
@@ -56,6 +57,7 @@ int main(int argc, char *argv[]) {
   double trimLowPercent;
   double trimHighPercent;
   double tmpIndex;
+  struct blockWriter writer;
 
   if (argc != 4) {
     useageExit();
@@ -147,14 +149,13 @@ int main(int argc, char *argv[]) {
   fprintf(stderr, "MaxValue = %u\n", highValue);
 
   fprintf(stderr, "Outputting the data...\n");
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
   for (i = 0; i < datalen; i++) {
     if ((data[i] >= lowValue) && (data[i] <= highValue)) {
-      if (fwrite(&(data[i]), sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write output to stdout");
-        exit(EX_OSERR);
-      }
+      writeElement(&writer, &(data[i]));
     }
   }
+  freeBlockWriter(&writer);
 
   free(data);
   return EX_OK;
@@ -13,7 +13,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdnoreturn.h>
+#include "blockio.h"
 #include "precision.h"
+#include "textio.h"
 
 /*noreturn static void useageExit(void)
 {
@@ -26,15 +28,25 @@
 }*/
 
 int main(void) {
-  uint32_t data;
+  const uint32_t *data;
+  struct blockReader reader;
+  struct textWriter writer;
+  size_t count;
+  size_t i;
 
   assert(PRECISION(UINT_MAX) == 32);
 
-  while (feof(stdin) == 0) {
-    if (fread(&data, sizeof(uint32_t), 1, stdin) == 1) {
-      printf("%u\n", data);
+  initBlockReader(&reader, stdin, sizeof(uint32_t), false);
+  initTextWriter(&writer, stdout);
+
+  while ((count = readBlock(&reader, (const void **)&data)) > 0) {
+    for (i = 0; i < count; i++) {
+      writeDecimalLine(&writer, data[i]);
     }
   }
 
+  freeBlockReader(&reader);
+  freeTextWriter(&writer);
+
   return (0);
 }
@@ -23,6 +23,8 @@
 #include <time.h>
 
 #include "binio.h"
+#include "binning.h"
+#include "blockio.h"
 #include "entlib.h"
 #include "globals-inst.h"
 #include "precision.h"
@@ -42,13 +44,17 @@ noreturn static void useageExit(void) {
 
 int main(int argc, char *argv[]) {
   FILE *infp;
+  size_t fileSize;
   size_t datalen;
-  uint32_t *data = NULL;
+  struct rangeHistogram histogram;
+  struct blockReader reader;
+  const uint32_t *block;
+  size_t blockLen;
   bool configMathematica;
   bool configOutputZeros;
   size_t configCountCutoff;
   size_t categoryCount;
-  size_t *categoryTable;
+  const size_t *categoryTable;
   int opt;
   unsigned long long inint;
   uint32_t mindata, maxdata;
@@ -107,8 +113,32 @@ int main(int argc, char *argv[]) {
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint32file(infp, &data);
-  assert(data != NULL);
+  fileSize = getfilesize(infp);
+  if ((fileSize % sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Extra bytes at the end of the file\n");
+  }
+
+  // The first pass finds the range of the data, so that the histogram is allocated once (at its final size) for the second.
+  initRangeHistogram(&histogram);
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((blockLen = readBlock(&reader, (const void **)&block)) > 0) {
+    rangeHistogramScan(&histogram, block, blockLen);
+  }
+  freeBlockReader(&reader);
+
+  rangeHistogramAllocate(&histogram);
+
+  if (fseek(infp, 0, SEEK_SET) != 0) {
+    perror("Can't rewind the input file");
+    exit(EX_OSERR);
+  }
+  initBlockReader(&reader, infp, sizeof(uint32_t), true);
+  while ((blockLen = readBlock(&reader, (const void **)&block)) > 0) {
+    rangeHistogramAdd(&histogram, block, blockLen);
+  }
+  freeBlockReader(&reader);
+
+  datalen = histogram.total;
 
   if (configVerbose > 0) {
     fprintf(stderr, "Read in %zu integers\n", datalen);
@@ -120,13 +150,8 @@ int main(int argc, char *argv[]) {
 
   assert(datalen > 0);
 
-  mindata = UINT32_MAX;
-  maxdata = 0;
-
-  for (size_t i = 0; i < datalen; i++) {
-    if (data[i] < mindata) mindata = data[i];
-    if (data[i] > maxdata) maxdata = data[i];
-  }
+  mindata = histogram.minValue;
+  maxdata = histogram.maxValue;
 
   assert(maxdata >= mindata);
 
@@ -135,17 +160,8 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Maximum symbol: %u\n", maxdata);
   }
 
-  categoryCount = maxdata - mindata + 1;
-
-  if ((categoryTable = calloc(categoryCount, sizeof(size_t))) == NULL) {
-    free(data);
-    perror("Can't allocate data for category table\n");
-    exit(EX_OSERR);
-  }
-
-  for (size_t i = 0; i < datalen; i++) {
-    categoryTable[data[i] - mindata]++;
-  }
+  categoryCount = (size_t)(maxdata - mindata) + 1;
+  categoryTable = histogram.counts + (mindata - histogram.base);
 
   firstDataIndex = categoryCount - 1;
   lastDataIndex = 0;
@@ -196,7 +212,6 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  free(data);
-  free(categoryTable);
+  freeRangeHistogram(&histogram);
   return EX_OK;
 }
@@ -14,6 +14,8 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
+
 /*noreturn static void useageExit(void)
 {
    fprintf(stderr, "Usage:\n");
@@ -24,26 +26,33 @@
 }*/
 
 int main(void) {
-  uint32_t currentData;
+  const uint32_t *currentData;
   uint32_t priorData;
   uint32_t rawData;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
+
+  initBlockReader(&reader, stdin, sizeof(uint32_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
 
   // Read in the first value
-  if (fread(&priorData, sizeof(uint32_t), 1, stdin) != 1) {
-    perror("Can't read initial value");
+  if (!readElement(&reader, &priorData)) {
+    fprintf(stderr, "Can't read initial value\n");
     exit(EX_OSERR);
   }
 
-  while (feof(stdin) == 0) {
-    if (fread(&currentData, sizeof(uint32_t), 1, stdin) == 1) {
-      rawData = priorData ^ currentData;
-      if (fwrite(&rawData, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to output");
-        exit(EX_OSERR);
-      }
-      priorData = currentData;
+  while ((count = readBlock(&reader, (const void **)&currentData)) > 0) {
+    for (i = 0; i < count; i++) {
+      rawData = priorData ^ currentData[i];
+      writeElement(&writer, &rawData);
+      priorData = currentData[i];
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
@@ -14,6 +14,8 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
+
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
   fprintf(stderr, "u32-xor <file1> <file2>\n");
@@ -23,10 +25,13 @@ noreturn static void useageExit(void) {
 }
 
 int main(int argc, char *argv[]) {
-  uint32_t currentData1, currentData2;
+  const uint32_t *currentData1, *currentData2;
   uint32_t outData;
   FILE *fp1, *fp2;
-  bool ready1, ready2;
+  struct blockReader reader1, reader2;
+  struct blockWriter writer;
+  size_t count1, count2;
+  size_t i;
 
   if (argc != 3) useageExit();
 
@@ -39,27 +44,24 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  currentData1 = currentData2 = 0;
-  ready1 = ready2 = false;
+  initBlockReader(&reader1, fp1, sizeof(uint32_t), false);
+  initBlockReader(&reader2, fp2, sizeof(uint32_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
 
-  while ((feof(fp1) == 0) && (feof(fp2) == 0) && (ferror(fp1) == 0) && (ferror(fp2) == 0)) {
-    if (!ready1 && (fread(&currentData1, sizeof(uint32_t), 1, fp1) == 1)) {
-      ready1 = true;
-    }
-    if (!ready2 && (fread(&currentData2, sizeof(uint32_t), 1, fp2) == 1)) {
-      ready2 = true;
-    }
+  // Both streams have the same block size, so only a short block (at the end of a file) is ever unmatched.
+  do {
+    count1 = readBlock(&reader1, (const void **)&currentData1);
+    count2 = readBlock(&reader2, (const void **)&currentData2);
 
-    if (ready1 && ready2) {
-      outData = currentData1 ^ currentData2;
-      if (fwrite(&outData, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to output");
-        exit(EX_OSERR);
-      }
-      ready1 = false;
-      ready2 = false;
+    for (i = 0; (i < count1) && (i < count2); i++) {
+      outData = currentData1[i] ^ currentData2[i];
+      writeElement(&writer, &outData);
     }
-  }
+  } while ((count1 == reader1.blockElements) && (count2 == reader2.blockElements));
+
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader1);
+  freeBlockReader(&reader2);
 
   fclose(fp1);
   fclose(fp2);
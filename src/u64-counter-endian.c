@@ -19,8 +19,6 @@
 
 int main(void) {
   uint64_t *input = NULL;
-  uint64_t *swappedData = NULL;
-  uint64_t *outData = NULL;
   size_t datalen;
   size_t nativeSmallerCount = 0;
 
@@ -29,30 +27,23 @@ int main(void) {
     exit(EX_DATAERR);
   }
 
-  swappedData = malloc(sizeof(uint64_t) * datalen);
-
-  if (swappedData == NULL) {
-    perror("Can't allocate memory.");
-    exit(EX_OSERR);
-  }
-
+  // Vote, then swap in place (if needed), rather than keeping a swapped copy of the data.
   for (size_t i = 0; i < datalen; i++) {
-    swappedData[i] = reverse64(input[i]);
-    if (input[i] <= swappedData[i]) nativeSmallerCount++;
+    nativeSmallerCount += (input[i] <= reverse64(input[i]));
   }
 
   if (nativeSmallerCount >= (datalen - nativeSmallerCount)) {
     fprintf(stderr, "Native byte order seems better (%g)\n", (double)nativeSmallerCount / (double)datalen);
-    outData = input;
   } else {
     fprintf(stderr, "Swapped byte order seems better (%g)\n", (double)(datalen - nativeSmallerCount) / (double)datalen);
-    outData = swappedData;
+    for (size_t i = 0; i < datalen; i++) {
+      input[i] = reverse64(input[i]);
+    }
   }
 
-  if (fwrite(outData, sizeof(uint64_t), datalen, stdout) != datalen) {
+  if (fwrite(input, sizeof(uint64_t), datalen, stdout) != datalen) {
     perror("Can't write out data");
   }
 
-  free(swappedData);
   free(input);
 }
@@ -16,72 +16,106 @@
 #include <stdnoreturn.h>
 #include <string.h>
 #include <sysexits.h>
+#include <unistd.h>
 
-#include "binio.h"
+#include "blockio.h"
+#include "convert.h"
 #include "globals-inst.h"
 #include "precision.h"
 
 noreturn static void useageExit(void) {
   fprintf(stderr, "Usage:\n");
-  fprintf(stderr, "u64-counter-raw <filename>\n");
+  fprintf(stderr, "u64-counter-raw [-g] <filename>\n");
   fprintf(stderr, "Extract deltas treated as 64-bit unsigned counters (that roll may roll over).\n");
+  fprintf(stderr, "-g\tAfter shifting, divide the deltas by their greatest common divisor.\n");
   exit(EX_USAGE);
 }
 
 int main(int argc, char *argv[]) {
   FILE *infp;
-  size_t datalen;
-  uint64_t *data = NULL;
-  size_t i;
-  uint64_t delta;
-  uint64_t mindelta = UINT64_MAX;
-  uint64_t maxdelta = 0;
-
-  if (argc != 2) {
+  const uint64_t *inBlock;
+  uint64_t *outBlock;
+  size_t count;
+  size_t outcount;
+  uint64_t divisor;
+  bool configGCD = false;
+  int opt;
+  struct blockReader reader;
+  struct blockWriter writer;
+  struct u64CounterStats stats;
+  struct u64CounterDecoder decoder;
+
+  while ((opt = getopt(argc, argv, "g")) != -1) {
+    switch (opt) {
+      case 'g':
+        configGCD = true;
+        break;
+      default: /* ? */
+        useageExit();
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc != 1) {
     useageExit();
   }
 
-  if ((infp = fopen(argv[1], "rb")) == NULL) {
+  if ((infp = fopen(argv[0], "rb")) == NULL) {
     perror("Can't open file");
     exit(EX_NOINPUT);
   }
 
-  datalen = readuint64file(infp, &data);
-  assert(data != NULL);
-
-  fprintf(stderr, "Read in %zu uint64_ts\n", datalen);
-  if (fclose(infp) != 0) {
-    perror("Can't close intput file");
-    exit(EX_OSERR);
+  // First pass: find the delta range (and, if requested, the GCD of the shifted deltas).
+  initU64CounterStats(&stats, configGCD);
+  initBlockReader(&reader, infp, sizeof(uint64_t), true);
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    u64CounterScan(&stats, inBlock, count);
   }
+  freeBlockReader(&reader);
 
-  if (datalen < 2) {
+  fprintf(stderr, "Read in %zu uint64_ts\n", stats.count);
+
+  if (stats.count < 2) {
     fprintf(stderr, "Too little data\n");
     exit(EX_DATAERR);
   }
 
-  for (i = 1; i < datalen; i++) {
-    delta = data[i] - data[i - 1];
-    if (delta < mindelta) mindelta = delta;
-    if (delta > maxdelta) maxdelta = delta;
-    data[i - 1] = delta;
+  if (stats.minDelta != 0) {
+    fprintf(stderr, "Shifting data down by %" PRIu64 ". Maximum value now %" PRIu64 "\n", stats.minDelta, stats.maxDelta - stats.minDelta);
+  }
+
+  divisor = 1;
+  if (configGCD && (stats.deltaGCD > 1)) {
+    divisor = stats.deltaGCD;
+    fprintf(stderr, "Dividing data by common divisor %" PRIu64 "\n", divisor);
+  }
+
+  // Second pass: output the shifted (and divided) deltas.
+  if (fseek(infp, 0, SEEK_SET) < 0) {
+    perror("Can't rewind input file");
+    exit(EX_OSERR);
   }
-  if (mindelta != 0) {
-    fprintf(stderr, "Shifting data down by %" PRIu64 ". Maximum value now %" PRIu64 "\n", mindelta, maxdelta - mindelta);
+  clearerr(infp);
 
-    for (i = 0; i < datalen - 1; i++) {
-      data[i] -= mindelta;
+  initU64CounterDecoder(&decoder, stats.minDelta, divisor);
+  initBlockReader(&reader, infp, sizeof(uint64_t), true);
+  initBlockWriter(&writer, stdout, sizeof(uint64_t));
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (size_t i = 0; i < count; i += outcount) {
+      outBlock = reserveElements(&writer, &outcount);
+      if (outcount > count - i) outcount = count - i;
+      commitElements(&writer, u64CounterDecode(&decoder, inBlock + i, outBlock, outcount));
     }
   }
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
 
-  if (fwrite(data, sizeof(uint64_t), datalen - 1, stdout) != datalen - 1) {
-    if (data != NULL) free(data);
-    data = NULL;
-    perror("Can't write to stdout");
+  if (fclose(infp) != 0) {
+    perror("Can't close intput file");
     exit(EX_OSERR);
   }
 
-  if (data != NULL) free(data);
-  data = NULL;
   return (0);
 }
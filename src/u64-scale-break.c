@@ -19,6 +19,7 @@
 #include <sysexits.h>
 
 #include "binutil.h"
+#include "blockio.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -39,6 +40,12 @@ int main(int argc, char *argv[]) {
   char *endptr;
   unsigned long int intval;
   uint64_t bitmask;
+  const uint64_t *inData;
+  uint64_t curVal;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
 
   if (argc != 4) {
     useageExit();
@@ -62,19 +69,17 @@ int main(int argc, char *argv[]) {
   bitmask = (1ULL << configLowBits) - 1ULL;
   fprintf(stderr, "width: %u, scaleHigh: %zu, scaleLow: %zu, bitmask: 0x%016lX\n", configLowBits, configScaleHigh, configScaleLow, bitmask);
 
-  while (feof(stdin) == 0) {
-    uint64_t inData;
-    size_t res;
-    uint64_t curVal;
-    res = fread(&inData, sizeof(uint64_t), 1, stdin);
-    if (res == 1) {
-      curVal = ((inData & bitmask) * configScaleLow) + ((inData >> configLowBits) * configScaleHigh);
+  initBlockReader(&reader, stdin, sizeof(uint64_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint64_t));
 
-      if (fwrite(&curVal, sizeof(uint64_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
-      }
+  while ((count = readBlock(&reader, (const void **)&inData)) > 0) {
+    for (i = 0; i < count; i++) {
+      curVal = ((inData[i] & bitmask) * configScaleLow) + ((inData[i] >> configLowBits) * configScaleHigh);
+      writeElement(&writer, &curVal);
     }
   }
+
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
   return (0);
 }
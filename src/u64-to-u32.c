@@ -18,6 +18,7 @@
 #include <sysexits.h>
 
 #include "binutil.h"
+#include "blockio.h"
 #include "globals-inst.h"
 #include "precision.h"
 
@@ -31,9 +32,13 @@ noreturn static void useageExit(void) {
 }
 
 int main(int argc, char *argv[]) {
-  size_t res;
+  const uint64_t *inBlock;
   uint64_t inData;
   uint32_t out;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
   bool configReverse;
   bool configTruncate;
   int opt;
@@ -60,9 +65,12 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  while (feof(stdin) == 0) {
-    res = fread(&inData, sizeof(uint64_t), 1, stdin);
-    if (res == 1) {
+  initBlockReader(&reader, stdin, sizeof(uint64_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (i = 0; i < count; i++) {
+      inData = inBlock[i];
       if (configReverse) {
         inData = reverse64(inData);
       }
@@ -76,12 +84,12 @@ int main(int argc, char *argv[]) {
         out = (uint32_t)inData;
       }
 
-      if (fwrite(&out, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to stdout");
-        exit(EX_OSERR);
-      }
+      writeElement(&writer, &out);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
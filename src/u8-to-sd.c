@@ -18,6 +18,7 @@
 #include <stdnoreturn.h>
 #include <sysexits.h>
 
+#include "blockio.h"
 #include "entlib.h"
 
 noreturn static void useageExit(void) {
@@ -33,6 +34,11 @@ noreturn static void useageExit(void) {
 int main(int argc, char *argv[]) {
   statData_t outdata;
   uint8_t indata;
+  const uint8_t *inBlock;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
   uint8_t bitmask;
   uint8_t configBitsPerSample;
   uint8_t j;
@@ -75,8 +81,12 @@ int main(int argc, char *argv[]) {
     useageExit();
   }
 
-  while (feof(stdin) == 0) {
-    if (fread(&indata, sizeof(uint8_t), 1, stdin) == 1) {
+  initBlockReader(&reader, stdin, sizeof(uint8_t), false);
+  initBlockWriter(&writer, stdout, sizeof(statData_t));
+
+  while ((count = readBlock(&reader, (const void **)&inBlock)) > 0) {
+    for (i = 0; i < count; i++) {
+      indata = inBlock[i];
       if (configVerbose > 1) fprintf(stderr, "indata: 0x%X\n", indata);
 
       // Set the low order configBitsPerSample bits in the bitmask
@@ -98,10 +108,7 @@ int main(int argc, char *argv[]) {
         }
 
         if (configVerbose > 1) fprintf(stderr, "outdata: 0x%X\n", outdata);
-        if (fwrite(&outdata, sizeof(statData_t), 1, stdout) != 1) {
-          perror("Can't write to output");
-          exit(EX_OSERR);
-        }
+        writeElement(&writer, &outdata);
 
         if (configLTH) {
           bitmask = (uint8_t)(bitmask << configBitsPerSample);
@@ -112,5 +119,8 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdnoreturn.h>
 #include <sysexits.h>
+#include "blockio.h"
 #include "precision.h"
 
 /*noreturn static void useageExit(void)
@@ -27,19 +28,26 @@
 */
 int main(void) {
   uint32_t outdata;
-  uint8_t indata;
+  const uint8_t *indata;
+  struct blockReader reader;
+  struct blockWriter writer;
+  size_t count;
+  size_t i;
 
   assert(PRECISION(UINT_MAX) == 32);
 
-  while (feof(stdin) == 0) {
-    if (fread(&indata, sizeof(uint8_t), 1, stdin) == 1) {
-      outdata = (uint8_t)indata;
-      if (fwrite(&outdata, sizeof(uint32_t), 1, stdout) != 1) {
-        perror("Can't write to output");
-        exit(EX_OSERR);
-      }
+  initBlockReader(&reader, stdin, sizeof(uint8_t), false);
+  initBlockWriter(&writer, stdout, sizeof(uint32_t));
+
+  while ((count = readBlock(&reader, (const void **)&indata)) > 0) {
+    for (i = 0; i < count; i++) {
+      outdata = (uint32_t)indata[i];
+      writeElement(&writer, &outdata);
     }
   }
 
+  freeBlockWriter(&writer);
+  freeBlockReader(&reader);
+
   return (0);
 }
@@ -0,0 +1,377 @@
+#!/usr/bin/perl
+#
+# throughput-bench.pl version 0.0.1
+# This file is part of the Theseus distribution: https://github.com/KeyPair-Consulting/Theseus
+# Copyright 2024 Joshua E. Hill <josh@keypair.us>
+#
+# Licensed under the 3-clause BSD license. For details, see the LICENSE file.
+#
+# Author(s)
+# Joshua E. Hill, KeyPair Consulting, Inc.  <josh@keypair.us>
+#
+#Use this as follows:
+#throughput-bench.pl [-q] [-r <reps>] [-s <MiB>] [-t <regex>] [-b <bindir>]
+#
+#This runs each documented example invocation (the "Example ... with command `./...`" lines in docs/*.md that use files in ex/)
+#on three variants of its input files:
+# ex: the files in ex/. Outputs that have an expected copy in ex/ are checked byte for byte.
+# replica: the whole records of each input file repeated until it is at least the scale size (-s, in MiB; default 64).
+# synthetic: records (bytes, 16/32/64/128-bit words, doubles or text lines, as given by the file name) drawn at random
+#  from each input file, to the same size as the replica. The seed is fixed, so this data is the same for every run.
+#Each variant is run <reps> times (default 3; -q runs only the ex variant once). The report is written to stdout as
+#tab-separated values giving the best wall time, the best CPU (user + system) time, the peak RSS, the input throughput
+#and the digest of the outputs, so that reports from different builds can be compared for both speed and results.
+#The result is "match" or "MISMATCH" where ex/ has expected outputs, "nondeterministic" if the outputs vary between runs,
+#"exit=" or "signal=" if the tool failed, and otherwise "unchecked" (ex) or "ok" (replica and synthetic). Tools that require
+#sorted or monotone input (e.g., double-merge or u32-counter-bitwidth) are expected to reject the scaled variants.
+#The exit status is 1 if any ex output differed from its expected copy.
+#
+#This is Linux specific (the resource usage is collected with wait4). The kernel's peak RSS figure includes this script's
+#own footprint at the fork (about 10 MiB), so it is only informative for the larger variants.
+
+use strict;
+use warnings;
+
+use Digest::MD5;
+use File::Basename;
+use File::Copy;
+use File::Path qw(make_path remove_tree);
+use File::Temp qw(tempdir);
+use FindBin;
+use Getopt::Std;
+use POSIX qw(ceil);
+use Time::HiRes qw(clock_gettime CLOCK_MONOTONIC);
+
+require 'syscall.ph';
+
+my %opts;
+getopts('qr:s:t:b:', \%opts) or usage();
+usage() if @ARGV;
+
+my $reps = $opts{'r'} // 3;
+my $scaleBytes = ($opts{'s'} // 64) * 1024 * 1024;
+my $toolFilter = $opts{'t'};
+my $binDir = $opts{'b'} // "$FindBin::Bin/../src";
+my $exDir = "$FindBin::Bin/../ex";
+my $docDir = "$FindBin::Bin/../docs";
+
+usage() unless (($reps =~ /^\d+$/) && ($reps > 0) && ($scaleBytes > 0));
+
+$reps = 1 if defined($opts{'q'});
+
+sub usage {
+	print STDERR "Usage:\n";
+	print STDERR "throughput-bench.pl [-q] [-r <reps>] [-s <MiB>] [-t <regex>] [-b <bindir>]\n";
+	print STDERR "Runs the documented examples on the ex/ files and on scaled-up and synthetic variants of them.\n";
+	print STDERR "-q\tQuick mode: only check the ex/ variant, running each example once.\n";
+	print STDERR "-r <reps>\tRuns of each example and variant (default 3).\n";
+	print STDERR "-s <MiB>\tThe size of the replica and synthetic inputs (default 64).\n";
+	print STDERR "-t <regex>\tOnly run the tools whose names match this regular expression.\n";
+	print STDERR "-b <bindir>\tThe location of the Theseus binaries (default ../src relative to this script).\n";
+	print STDERR "The report is sent to stdout as tab-separated values.\n";
+	exit 64;
+}
+
+#The size of a record in a file, from the naming convention used in ex/. Text files are sampled by line (size 0).
+sub recordSize {
+	my ($name, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	return 0 if $name =~ /\.txt$/;
+	return 16 if $name =~ /-u128\.bin$/;
+	return 8 if $name =~ /-(u64|double)\.bin$/;
+	return 4 if $name =~ /-u32\.bin$/;
+	return 3 if $name =~ /-3byteblocks\.bin$/;
+	return 2 if $name =~ /-u16\.bin$/;
+	return 1;
+}
+
+#Extract the example invocations from the documentation.
+sub readExamples {
+	my @examples;
+
+	foreach my $doc (sort glob("$docDir/*.md")) {
+		open(my $fh, '<', $doc) or die "Can't open $doc: $!";
+		while (my $line = <$fh>) {
+			next unless $line =~ /^\s*\* Example\s*([A-Za-z0-9]*).*?with command `\.\/([^`]+)`/;
+			my ($id, $command) = ($1, $2);
+			my @tokens = split(/\s+/, $command);
+			my $tool = shift(@tokens);
+			my (@args, @inputs, @outputs, $stdin, $stdout);
+			my $missing = 0;
+
+			next if $command =~ /[|;&\$]/;
+
+			while (@tokens) {
+				my $token = shift(@tokens);
+				if (($token eq '<') || ($token eq '>')) {
+					my $file = shift(@tokens);
+					if ($token eq '<') {
+						$stdin = $file;
+					} else {
+						$stdout = $file;
+					}
+					next;
+				}
+				push(@args, $token);
+			}
+
+			#Files in ex/ are inputs unless they are named as outputs; other data files must be created by the tool.
+			foreach my $file (@args, grep { defined } ($stdin, $stdout)) {
+				next unless $file =~ /\.(bin|txt)$/;
+				if ($file =~ /-output/) {
+					push(@outputs, $file);
+				} elsif (-f "$exDir/$file") {
+					push(@inputs, $file) unless grep { $_ eq $file } @inputs;
+				} else {
+					$missing = 1;
+				}
+			}
+
+			next if $missing;
+			next unless (@inputs || grep { -f "$exDir/$_" } @outputs);
+			next if defined($toolFilter) && ($tool !~ /$toolFilter/);
+
+			push(@examples, {id => ($id ne '') ? $id : $tool, tool => $tool, args => \@args, inputs => \@inputs, stdin => $stdin, stdout => $stdout});
+		}
+		close($fh);
+	}
+
+	return @examples;
+}
+
+#The whole records in a file: lines (each with a newline) for text files, and otherwise fixed size records.
+sub readRecords {
+	my ($file, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	my $recordSize = recordSize($file);
+	my @records;
+
+	open(my $in, '<:raw', "$exDir/$file") or die "Can't open $exDir/$file: $!";
+	my $data = do { local $/; <$in> };
+	close($in);
+
+	if ($recordSize == 0) {
+		@records = grep { /\S/ } split(/(?<=\n)/, $data);
+		$_ .= "\n" foreach grep { !/\n$/ } @records;
+	} else {
+		@records = unpack("(a$recordSize)*", substr($data, 0, length($data) - (length($data) % $recordSize)));
+	}
+	die "$file has no records" unless @records;
+
+	return @records;
+}
+
+#Write the replica or synthetic version of an ex/ file, and return its path.
+#The data is generated in a child process, so that the memory used doesn't count toward the RSS of the tools run later.
+sub scaledInput {
+	my ($file, $variant, $dir, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	my $path = "$dir/$variant/$file";
+	return $path if -f $path;
+
+	make_path("$dir/$variant");
+
+	my $pid = fork();
+	die "Can't fork: $!" unless defined($pid);
+
+	if ($pid == 0) {
+		my @records = readRecords($file);
+		my $size = length(join('', @records));
+		my $copies = ceil($scaleBytes / $size);
+
+		open(my $out, '>:raw', "$path.partial") or die "Can't create $path.partial: $!";
+		if ($variant eq 'replica') {
+			my $data = join('', @records);
+			print $out $data for (1 .. $copies);
+		} else {
+			#The synthetic file has as many records as the replica.
+			my $count = $copies * scalar(@records);
+			srand(0x7e5e05);
+			while ($count > 0) {
+				my $batch = ($count > 65536) ? 65536 : $count;
+				print $out join('', map { $records[int(rand(scalar(@records)))] } (1 .. $batch));
+				$count -= $batch;
+			}
+		}
+		close($out) or die "Can't write $path.partial: $!";
+		rename("$path.partial", $path) or die "Can't rename $path.partial: $!";
+		exit 0;
+	}
+
+	waitpid($pid, 0);
+	die "Can't generate $path" if (($? != 0) || !-f $path);
+
+	return $path;
+}
+
+#Run the command in the directory, returning the exit status, the wall time, the CPU time and the peak RSS (in KiB).
+sub runCommand {
+	my ($dir, $argv, $stdin, $stdout, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	my $start = clock_gettime(CLOCK_MONOTONIC);
+	my $pid = fork();
+	die "Can't fork: $!" unless defined($pid);
+
+	if ($pid == 0) {
+		chdir($dir) or die "Can't change to $dir: $!";
+		open(STDIN, '<', $stdin // '/dev/null') or die "Can't open input: $!";
+		open(STDOUT, '>', $stdout) or die "Can't open output: $!";
+		open(STDERR, '>', 'stderr.log') or die "Can't open stderr.log: $!";
+		exec { $argv->[0] } @$argv;
+		die "Can't run $argv->[0]: $!";
+	}
+
+	#struct rusage begins with two struct timevals, then ru_maxrss (in KiB).
+	my $status = pack('i', 0);
+	my $rusage = "\0" x 144;
+	syscall(&SYS_wait4, $pid + 0, $status, 0, $rusage) == $pid or die "wait4 failed: $!";
+	my $wall = clock_gettime(CLOCK_MONOTONIC) - $start;
+
+	my @usage = unpack('q18', $rusage);
+	my $cpu = $usage[0] + $usage[1] / 1.0e6 + $usage[2] + $usage[3] / 1.0e6;
+	$status = unpack('i', $status);
+
+	return ($status, $wall, $cpu, $usage[4]);
+}
+
+sub fileDigest {
+	my ($path, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	open(my $fh, '<:raw', $path) or die "Can't open $path: $!";
+	my $digest = Digest::MD5->new->addfile($fh)->hexdigest;
+	close($fh);
+	return $digest;
+}
+
+sub sameContents {
+	my ($left, $right, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	return 0 unless (-s $left) == (-s $right);
+	return fileDigest($left) eq fileDigest($right);
+}
+
+#The names and digest of everything the tool wrote (other than its stderr, and any inputs it didn't modify).
+sub runOutputs {
+	my ($runDir, $sources, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	my @outputs;
+	my $md5 = Digest::MD5->new;
+
+	foreach my $file (sort map { basename($_) } glob("$runDir/*")) {
+		next if $file eq 'stderr.log';
+		my $digest = fileDigest("$runDir/$file");
+		next if (defined($sources->{$file}) && ($digest eq fileDigest($sources->{$file})));
+		push(@outputs, $file);
+		$md5->add("$file\0$digest");
+	}
+
+	return ($md5->hexdigest, @outputs);
+}
+
+#Run one example on one variant of its inputs, and report the result.
+sub runExample {
+	my ($example, $variant, $workDir, @bad) = @_;
+	die "Extra argument" if @bad;
+
+	my $runDir = "$workDir/run";
+	my $inputBytes = 0;
+	my %sources;
+	my ($bestWall, $bestCpu, $peakRss, $exitStatus, $result, $digest, @outputs);
+	my $nondeterministic = 0;
+
+	foreach my $file (@{$example->{inputs}}) {
+		$sources{$file} = ($variant eq 'ex') ? "$exDir/$file" : scaledInput($file, $variant, $workDir);
+		$inputBytes += -s $sources{$file};
+	}
+
+	#The ex variant is always run at least twice, so that tools with random output are recognized.
+	my $runs = (($variant eq 'ex') && ($reps < 2)) ? 2 : $reps;
+
+	for my $run (1 .. $runs) {
+		remove_tree($runDir);
+		make_path($runDir);
+
+		#The inputs are copied, as some tools rewrite their input file.
+		foreach my $file (@{$example->{inputs}}) {
+			copy($sources{$file}, "$runDir/$file") or die "Can't copy $sources{$file}: $!";
+		}
+
+		my $stdout = $example->{stdout} // 'stdout.out';
+		my @argv = ("$binDir/$example->{tool}", @{$example->{args}});
+		my ($status, $wall, $cpu, $rss) = runCommand($runDir, \@argv, $example->{stdin}, $stdout);
+
+		$bestWall = $wall if (!defined($bestWall) || ($wall < $bestWall));
+		$bestCpu = $cpu if (!defined($bestCpu) || ($cpu < $bestCpu));
+		$peakRss = $rss if (!defined($peakRss) || ($rss > $peakRss));
+		$exitStatus = $status;
+
+		#A failed run is the last, so its outputs are digested too (the report always has a digest).
+		if (($variant eq 'ex') || ($run == $runs) || ($status != 0)) {
+			my ($runDigest, @runOutputs) = runOutputs($runDir, \%sources);
+			$nondeterministic = 1 if (defined($digest) && ($digest ne $runDigest));
+			($digest, @outputs) = ($runDigest, @runOutputs);
+		}
+
+		last if $status != 0;
+	}
+
+	if ($exitStatus != 0) {
+		$result = (($exitStatus & 0x7f) == 0) ? "exit=" . (($exitStatus >> 8) & 0xff) : "signal=" . ($exitStatus & 0x7f);
+	} elsif ($nondeterministic) {
+		$result = 'nondeterministic';
+	} elsif ($variant ne 'ex') {
+		$result = 'ok';
+	} else {
+		my @checked = grep { -f "$exDir/$_" } @outputs;
+		my @differ = grep { !sameContents("$runDir/$_", "$exDir/$_") } @checked;
+		if (@differ) {
+			$result = 'MISMATCH:' . join(',', @differ);
+		} elsif (@checked) {
+			$result = 'match';
+		} else {
+			$result = 'unchecked';
+		}
+	}
+
+	my $rate = ($bestWall > 0) ? $inputBytes / $bestWall : 0;
+	printf("%s\t%s\t%s\t%d\t%.6f\t%.6f\t%d\t%.0f\t%s\t%s\n", $example->{id}, $example->{tool}, $variant, $inputBytes, $bestWall, $bestCpu, $peakRss, $rate, $result, $digest);
+
+	remove_tree($runDir);
+	return $result;
+}
+
+$| = 1;
+
+my @examples = readExamples();
+die "No examples found" unless @examples;
+
+my $workDir = tempdir("theseus-bench-XXXXXX", TMPDIR => 1, CLEANUP => 1);
+my $mismatches = 0;
+
+print "example\ttool\tvariant\tinput_bytes\twall_s\tcpu_s\tmax_rss_kib\tbytes_per_s\tresult\toutput_md5\n";
+
+foreach my $example (@examples) {
+	my @variants = ('ex');
+	push(@variants, 'replica', 'synthetic') if (!defined($opts{'q'}) && @{$example->{inputs}});
+
+	foreach my $variant (@variants) {
+		my $result = runExample($example, $variant, $workDir);
+		if (($variant eq 'ex') && ($result =~ /^MISMATCH/)) {
+			print STDERR "$example->{id} ($example->{tool}): output differs from ex/: $result\n";
+			$mismatches++;
+		}
+	}
+
+	#Drop this example's scaled inputs.
+	remove_tree("$workDir/replica", "$workDir/synthetic");
+}
+
+print STDERR "$mismatches example(s) did not reproduce the expected outputs.\n" if $mismatches;
+exit($mismatches ? 1 : 0);